@@ -24,6 +24,28 @@
 #include "contactor_hv.h"
 #include "MailboxTask.h"
 
+/* *************************************************************************
+ * static int evsnap(struct CONTACTORFUNCTION* pcf, struct MAILBOXCAN* pmbx, struct MAILBOXSNAP* psnap, uint32_t notebit);
+ * @brief	: Snapshot of a mailbox for an event; on failure the event comes back later
+ * @param	: pmbx = mailbox; psnap = where the copy goes
+ * @param	: notebit = this event's notification bit (re-posted on failure)
+ * @return	: 0 = 'psnap' OK; -1 = no copy (counted, notification re-posted)
+ * NOTE: MailboxTask runs above this task, so the update in progress is a 'direct'
+ *       mailbox load in the RX ISR, or a writer at this priority: one yield and a
+ *       retry nearly always gets it.  Otherwise the event is not lost: the bit is set
+ *       again and handled on the next pass of the task loop.
+ * *************************************************************************/
+static int evsnap(struct CONTACTORFUNCTION* pcf, struct MAILBOXCAN* pmbx, struct MAILBOXSNAP* psnap, uint32_t notebit)
+{
+	if (MailboxTask_snapshot(pmbx, psnap) == 0) return 0;
+
+	taskYIELD(); // Let a writer at this priority finish
+	if (MailboxTask_snapshot(pmbx, psnap) == 0) return 0;
+
+	pcf->snapfailct += 1;
+	xTaskNotify(ContactorTaskHandle, notebit, eSetBits);
+	return -1;
+}
 /* *************************************************************************
  * void ContactorEvents_00(struct CONTACTORFUNCTION* pcf);
  * @brief	: ADC readings available
@@ -49,14 +71,22 @@ dbgCE1 += 1;
 	pcf->evstat &= ~CNCTEVTIMER3;	// Clear timeout bit 
 	pcf->evstat |= CNCTEVHV;      // Show new HV readings available
 	pcf->hvuartctr += 1;		// Running count of lines received
+
+#ifdef CONTACTORHBPERIODIC
+	/* Latest readings into the heartbeat payloads (sent from the tick hook). */
+	contactor_msg1(pcf, 0); // Battery string voltage and current
+	contactor_msg2(pcf, 0); // DMOC+ and DMOC- voltages
+#endif
 	return;
 }
 /* *************************************************************************
  * void ContactorEvents_02(struct CONTACTORFUNCTION* pcf);
- * @brief	: (spare)
+ * @brief	: CAN TX done: a paced command response msg has gone out
  * *************************************************************************/
 void ContactorEvents_02(struct CONTACTORFUNCTION* pcf)
 {
+	contactor_cmd_msg_txdone(pcf); // Queue next msg, if any
+	return;
 }
 /* *************************************************************************
  * void ContactorEvents_03(struct CONTACTORFUNCTION* pcf);
@@ -74,7 +104,7 @@ void ContactorEvents_03(struct CONTACTORFUNCTION* pcf)
 }
 /* *************************************************************************
  * void ContactorEvents_04(struct CONTACTORFUNCTION* pcf);
- * @brief	: TIMER1: Command Keep Alive failed (loss of command control)
+ * @brief	: Command Keep Alive failed (loss of command control): MailboxTask deadline
  * *************************************************************************/
 uint32_t dbgev04;
 
@@ -91,9 +121,13 @@ dbgev04 += 1;
 //	contactor_msg_ka(pcf);
 	pcf->outstat |=  CNCTOUT05KA;  // Output status bit: Show keep-alive
 
+#ifndef CONTACTORHBPERIODIC
 	/* Send with CAN id for heartbeat. */
 	contactor_msg1(pcf, 0); // Send battery string voltage and current
 	contactor_msg2(pcf, 0); // Send DMOC+ and DMOC- voltages
+#else
+	/* Heartbeat msgs are periodic from the tick hook (can_txsched.c). */
+#endif
 
 	return;
 }
@@ -112,6 +146,9 @@ void ContactorEvents_05(struct CONTACTORFUNCTION* pcf)
  * *************************************************************************/
 void ContactorEvents_06(struct CONTACTORFUNCTION* pcf)
 {
+	/* Copy of the command msg that an update cannot change while in use */
+	if (evsnap(pcf, pcf->pmbx_cid_cmd_i, &pcf->snap_cmd_i, CNCTBIT06) != 0) return;
+
 	contactor_cmd_msg_i(pcf); // Build and send CAN msg with data requested
 	return;
 }
@@ -123,14 +160,13 @@ uint8_t dbgevcmd;
 
 void ContactorEvents_07(struct CONTACTORFUNCTION* pcf)
 {
-	BaseType_t bret = xTimerReset(pcf->swtimer1, 10);
-	if (bret != pdPASS) {morse_trap(44);}
-
+	/* Keep-alive deadline restarted by the msg arrival (MailboxTask) */
 	pcf->outstat |=  CNCTOUT05KA;  // Output status bit: Show keep-alive
 	pcf->evstat  &= ~CNCTEVTIMER1; // Reset timer1 keep-alive timed-out bit
 
-	/* Incoming command byte with command bits */
-	uint8_t cmd = pcf->pmbx_cid_keepalive_i->ncan.can.cd.uc[0];
+	/* Incoming command byte with command bits (copy is also used by 'contactor_msg_ka') */
+	if (evsnap(pcf, pcf->pmbx_cid_keepalive_i, &pcf->snap_keepalive_i, CNCTBIT07) != 0) return;
+	uint8_t cmd = pcf->snap_keepalive_i.ncan.can.cd.uc[0];
 dbgevcmd = cmd;
 
 	/* Update connect request status bits */
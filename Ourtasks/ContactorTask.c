@@ -28,15 +28,6 @@ osThreadId ContactorTaskHandle;
 
 struct CONTACTORFUNCTION contactorfunction;
 
-/* *************************************************************************
- * void swtim1_callback(TimerHandle_t tm);
- * @brief	: Software timer 1 timeout callback
- * *************************************************************************/
-static void swtim1_callback(TimerHandle_t tm)
-{
-	xTaskNotify(ContactorTaskHandle, CNCTBIT04, eSetBits);
-	return;
-}
 /* *************************************************************************
  * void swtim2_callback(TimerHandle_t tm);
  * @brief	: Software timer 2 timeout callback
@@ -97,10 +88,8 @@ void StartContactorTask(void const * argument)
 	/* CAN hardware filter: restrict incoming to necessary CAN msgs. */
 	contactor_func_init_canfilter(pcf);
       
-	/* Create timer for keep-alive.  Auto-reload/periodic */
-	pcf->swtimer1 = xTimerCreate("swtim1",pcf->ka_k,pdTRUE,\
-		(void *) 0, swtim1_callback);
-	if (pcf->swtimer1 == NULL) {morse_trap(41);}
+	/* Keep-alive timeout: MailboxTask deadline on the keep-alive mailbox
+	   (contactor_func_init_init) notifies CNCTBIT04. */
 
 	/* Create timer for other delays. One-shot */
 	pcf->swtimer2 = xTimerCreate("swtim2",10,pdFALSE,\
@@ -112,10 +101,6 @@ void StartContactorTask(void const * argument)
 		(void *) 0, &swtim3_callback);
 	if (pcf->swtimer3 == NULL) {morse_trap(43);}
 
-	/* Start command/keep-alive timer */
-	BaseType_t bret = xTimerReset(pcf->swtimer1, 10);
-	if (bret != pdPASS) {morse_trap(44);}
-
 	/* Upon startup allow some sensor readings to settle. */
 	pcf->state = OTOSETTLING;
 
@@ -145,7 +130,8 @@ if (pcf->evstat != 0) morse_trap(46); // Debugging check
 			noteuse |= CNCTBIT01;
 		}
 		if ((noteval & CNCTBIT02) != 0)
-		{ // (spare)
+		{ // CAN TX done: paced command response msg went out
+			ContactorEvents_02(pcf);
 			noteuse |= CNCTBIT02;
 		}
 		if ((noteval & CNCTBIT03) != 0)
@@ -14,6 +14,8 @@
 #include "stm32f1xx_hal.h"
 #include "adc_idx_v_struct.h"
 #include "CanTask.h"
+#include "can_txsched.h"
+#include "MailboxTask.h"
 
 /* 
 =========================================      
@@ -103,13 +105,18 @@ NOTES:
 
 */
 
+/* Heartbeat msgs (cid_hb1, cid_hb2):
+   Not defined: sent when the command keep-alive fails to arrive (ContactorEvents_04).
+   Defined: periodic, every hbct1_k/hbct2_k ticks from the tick hook (can_txsched.c),
+            payloads refreshed with each HV sensor line. */
+//#define CONTACTORHBPERIODIC
 
 /* Task notification bit assignments. */
 #define CNCTBIT00	(1 << 0)  // ADCTask has new readings
 #define CNCTBIT01	(1 << 1)  // HV sensors usart RX line ready
-#define CNCTBIT02	(1 << 2)  // spare
+#define CNCTBIT02	(1 << 2)  // CAN TX done: paced command response msgs
 #define CNCTBIT03	(1 << 3)  // TIMER 3: uart RX keep-alive
-#define CNCTBIT04	(1 << 4)  // TIMER 1: Command Keep Alive
+#define CNCTBIT04	(1 << 4)  // Command Keep Alive timeout (MailboxTask deadline)
 #define CNCTBIT05	(1 << 5)  // TIMER 2: Multiple use delays
 // MailboxTask notification bits for CAN msg mailboxes
 #define CNCTBIT06	(1 << 6)  // CANID_CMD: incoming command:        cid_cmd_i 
@@ -215,6 +222,8 @@ enum CONTACTOR_CMD_CODES
 	UARTWHV3,
 	CAL5V,
 	CAL12V,
+	CANTXLATSTATS,    // CAN TX latency stats: payload[1] = id index, [2] = select
+	CANLOADSTAT,      // CAN bus load (100 ms, 1 s, 10 s) and TX errors (last 1 s)
 };
 
 /* CAN msg array index names. */
@@ -292,7 +301,6 @@ struct CONTACTORFUNCTION
 	/* Setup serial receive for uart (HV sensing) */
 	struct SERIALRCVBCB* prbcb3;	// usart3
 
-	TimerHandle_t swtimer1; // Software timer1: command/keep-alive
 	TimerHandle_t swtimer2; // Software timer2: multiple purpose delay
 	TimerHandle_t swtimer3; // Software timer3: uart RX/keep-alive
 
@@ -304,6 +312,10 @@ struct CONTACTORFUNCTION
 	struct MAILBOXCAN* pmbx_cid_cmd_i;      //
 	struct MAILBOXCAN* pmbx_cid_keepalive_i; //
 	struct MAILBOXCAN* pmbx_cid_gps_sync;   //
+	/* Consistent copies taken when the notification is handled (MailboxTask_snapshot) */
+	struct MAILBOXSNAP snap_cmd_i;          // cid_cmd_i
+	struct MAILBOXSNAP snap_keepalive_i;    // cid_keepalive_i
+	uint32_t snapfailct;                    // Count: snapshot failed after a retry (event re-posted)
 
 	uint32_t ipwmpct1;     // Period ct PWM after closure delay at 100% coil #1
 	uint32_t ipwmpct2;     // Period ct PWM after closure delay at 100% coil #2
@@ -317,6 +329,19 @@ struct CONTACTORFUNCTION
 
 	/* CAN msgs */
 	struct CANTXQMSG canmsg[NUMCANMSGS];
+
+#ifdef CONTACTORHBPERIODIC
+	/* Heartbeat msgs: sent by the tick hook (can_txsched.c) */
+	struct CANTXSCHED* ptxsched_hb1; // hv1:cur1, every hbct1_k ticks
+	struct CANTXSCHED* ptxsched_hb2; // hv2:hv3, every hbct2_k ticks
+#endif
+
+	/* Multi-msg command responses: next msg is queued when the previous has gone out */
+	struct CANTXDONE txdone; // TX done notification: CNCTBIT02
+	uint8_t txpgidx;  // CANTXLATSTATS: CAN id index
+	uint8_t txpgsel;  // CANTXLATSTATS: select
+	uint8_t txpgitem; // CANTXLATSTATS: next item to send
+	uint8_t txpgn;    // CANTXLATSTATS: number of items (0 = none in progress)
 };
 
 /* *************************************************************************/
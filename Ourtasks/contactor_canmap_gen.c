@@ -0,0 +1,63 @@
+/* Generated by canmap_gen from contactor_canmap.def: do not edit ('make canmap') */
+
+#include "ContactorTask.h"
+#include "contactor_canmap_gen.h"
+
+/* Notification blocks: grouped by mailbox (task handles filled in at startup) */
+static struct CANNOTIFYLIST canmap_note[CANMAPNOTENUM] = {
+	{.notebit = CNCTBIT08}, // GPS_SYNC
+	{.notebit = CNCTBIT06}, // CMD_I
+	{.notebit = CNCTBIT07}, // KEEPALIVE_I
+};
+
+/* Notification policy state, same index (zero: MBXNOTEALWAYS) */
+static struct MBXNOTEPOL canmap_pol[CANMAPNOTENUM];
+
+static osThreadId* const canmap_task[CANMAPNOTENUM] = {
+	&ContactorTaskHandle,
+	&ContactorTaskHandle,
+	&ContactorTaskHandle,
+};
+
+/* Mailboxes: sorted on CAN id */
+struct MAILBOXCAN canmap_mbx[CANMAPNUM] = {
+	{.ncan.can.id = 0x00400000U, .paytype = 23, .pnote = &canmap_note[0], .ppol = &canmap_pol[0], .notect = 1}, // GPS_SYNC
+	{.ncan.can.id = 0xE360000CU, .paytype = 36, .pnote = &canmap_note[1], .ppol = &canmap_pol[1], .notect = 1}, // CMD_I
+	{.ncan.can.id = 0xE3800000U, .paytype = 23, .pnote = &canmap_note[2], .ppol = &canmap_pol[2], .notect = 1}, // KEEPALIVE_I
+};
+
+static struct MAILBOXCAN* const canmap_pmbx[CANMAPNUM] = {
+	&canmap_mbx[0],
+	&canmap_mbx[1],
+	&canmap_mbx[2],
+};
+
+static const uint32_t canmap_ids[CANMAPNUM] = {
+	0x00400000U,
+	0xE360000CU,
+	0xE3800000U,
+};
+
+static const uint8_t canmap_direct[] = {
+	1, // CMD_I
+	2, // KEEPALIVE_I
+};
+
+const struct MBXTABLE canmap_tbl = {
+	.pmbxarray = &canmap_pmbx[0],
+	.pidarray  = &canmap_ids[0],
+	.pnote     = &canmap_note[0],
+	.ppol      = &canmap_pol[0],
+	.ptask     = &canmap_task[0],
+	.pdirect   = &canmap_direct[0],
+	.nmbx      = CANMAPNUM,
+	.nnote     = CANMAPNOTENUM,
+	.ndirect   = 2,
+};
+
+/* CAN1 filter banks (canfilter_setup_compile) */
+const struct CANFILTERBANK canmap_filt[CANMAPFILTNUM] = {
+	{0xE380E380U, 0xE380E380U, CAN_FILTERMODE_IDLIST, CAN_FILTERSCALE_16BIT, 1}, // Bank 0
+	{0xE360000CU, 0xE360000CU, CAN_FILTERMODE_IDLIST, CAN_FILTERSCALE_32BIT, 1}, // Bank 1
+	{0x00400040U, 0x00400040U, CAN_FILTERMODE_IDLIST, CAN_FILTERSCALE_16BIT, 0}, // Bank 2
+};
@@ -0,0 +1,27 @@
+/* Generated by canmap_gen from contactor_canmap.def: do not edit ('make canmap') */
+
+#ifndef __CONTACTOR_CANMAP_GEN
+#define __CONTACTOR_CANMAP_GEN
+
+#include "MailboxTask.h"
+#include "canfilter_setup.h"
+
+#define CANMAPNUM      3 // Mailboxes
+#define CANMAPNOTENUM  3 // Notification blocks
+#define CANMAPFILTNUM  3 // CAN1 filter banks
+
+/* Mailbox: index into 'canmap_mbx' */
+#define CANMAP_CMD_I             1
+#define CANMAP_KEEPALIVE_I       2
+#define CANMAP_GPS_SYNC          0
+
+/* CAN id */
+#define CANMAPID_CMD_I          0xE360000CU
+#define CANMAPID_KEEPALIVE_I    0xE3800000U
+#define CANMAPID_GPS_SYNC       0x00400000U
+
+extern struct MAILBOXCAN canmap_mbx[CANMAPNUM];
+extern const struct MBXTABLE canmap_tbl;
+extern const struct CANFILTERBANK canmap_filt[CANMAPFILTNUM];
+
+#endif
@@ -33,9 +33,12 @@ enum CONTACTOR_CMD_CODES
 	UARTWHV3,
 	CAL5V,
 	CAL12V,
+	CANTXLATSTATS,
+	CANLOADSTAT,
 };
 
 */
+#include "contactor_cmd_msg.h"
 #include "adcparams.h"
 #include "CanTask.h"
 #include "can_iface.h"
@@ -46,6 +49,9 @@ enum CONTACTOR_CMD_CODES
 static void loadadc(struct CONTACTORFUNCTION* pcf, double dx, uint8_t idx);
 static void loadhv(struct CONTACTORFUNCTION* pcf, uint8_t idx);
 static void load4(uint8_t *po, uint32_t n);
+static void loadtxlat(struct CONTACTORFUNCTION* pcf);
+static void loadbusload(struct CONTACTORFUNCTION* pcf);
+static uint8_t txlatval(struct CAN_CTLBLOCK* pctl, uint8_t idx, uint8_t sel, uint8_t item, uint32_t* pv);
 
 /* *************************************************************************
  * void contactor_cmd_msg_i(struct CONTACTORFUNCTION* pcf);
@@ -76,15 +82,17 @@ enum CONTACTOR_CMD_CODES
 	UARTWHV3,  // DMOC -
 	CAL5V,     // 5V supply
 	CAL12V,    // CAN raw 12v supply
+	CANTXLATSTATS, // CAN TX latency stats (see 'loadtxlat')
+	CANLOADSTAT,   // CAN bus load and TX error rate (see 'loadbusload')
 };
 
 */
 	int i;
 	double dt1;
-	uint8_t pay0 = pcf->pmbx_cid_cmd_i->ncan.can.cd.uc[0];
+	uint8_t pay0 = pcf->snap_cmd_i.ncan.can.cd.uc[0];
 
 	// Return payload request code
-	pcf->canmsg[CID_CMD_R].can.cd.uc[0] = pcf->pmbx_cid_cmd_i->ncan.can.cd.uc[0];	
+	pcf->canmsg[CID_CMD_R].can.cd.uc[0] = pcf->snap_cmd_i.ncan.can.cd.uc[0];	
 
 	/* Switch on first payload byte response code */
 	switch (pay0)
@@ -127,14 +135,20 @@ enum CONTACTOR_CMD_CODES
 	case UARTWHV2: loadhv(pcf,IDXHV2); break;
 	case UARTWHV3: loadhv(pcf,IDXHV3); break;
 
+	/* CAN TX latency stats: several response msgs, sent here. */
+	case CANTXLATSTATS: loadtxlat(pcf); return;
+
+	/* CAN bus load and error rate: one msg. */
+	case CANLOADSTAT: loadbusload(pcf); break;
+
 	/* Bogus code */
 	default:
 		for (i = 1; i < 7; i++) pcf->canmsg[CID_CMD_R].can.cd.uc[i] = 0;
 		pcf->canmsg[CID_CMD_R].can.dlc = 7; // Number of payload bytes
 		
 	}
-	// Queue CAN msg
-	xQueueSendToBack(CanTxQHandle,&pcf->canmsg[CID_CMD_R],portMAX_DELAY);
+	// Queue CAN msg (direct to CAN driver; dropped & counted if TX pool full)
+	CanTask_put(&pcf->canmsg[CID_CMD_R]);
 
 }
 /* *************************************************************************
@@ -203,4 +217,136 @@ static void loadhv(struct CONTACTORFUNCTION* pcf, uint8_t idx)
 	pcf->canmsg[CID_CMD_R].can.dlc = 7; // Number of payload bytes
 	return;
 }
+/* *************************************************************************
+ * static void loadbusload(struct CONTACTORFUNCTION* pcf);
+ *	@brief	: Load CAN bus load status (can_iface.h CANBUSLOAD) into response msg
+ * *************************************************************************/
+/* Response, dlc = 8:
+     [0] CANLOADSTAT
+     [1]-[2] bus load, last 100 ms (0.1% units, little endian)
+     [3]-[4] bus load, last 1 s
+     [5]-[6] bus load, last 10 s
+     [7] TX errors (TERR) in the last 1 s, 255 = 255 or more
+   CANBUSLOAD not compiled in: all zero. */
+static void loadbusload(struct CONTACTORFUNCTION* pcf)
+{
+	struct CANTXQMSG* pmsg = &pcf->canmsg[CID_CMD_R];
+	int i;
+
+#ifdef CANBUSLOAD
+	struct CANBUSLOADW* pb = &pmsg->pctl->busload;
+	for (i = 0; i < 3; i++)
+	{
+		pmsg->can.cd.uc[1 + 2*i] = (pb->load[i] >> 0);
+		pmsg->can.cd.uc[2 + 2*i] = (pb->load[i] >> 8);
+	}
+	pmsg->can.cd.uc[7] = (pb->err1 > 255) ? 255 : pb->err1;
+#else
+	for (i = 1; i < 8; i++) pmsg->can.cd.uc[i] = 0;
+#endif
+	pmsg->can.dlc = 8;
+	return;
+}
+/* *************************************************************************
+ * static void loadtxlat(struct CONTACTORFUNCTION* pcf);
+ *	@brief	: Start sending CAN TX latency stats (can_iface.h CANTXLATENCY), one value per msg
+ * *************************************************************************/
+/* Request payload:
+     [0] CANTXLATSTATS
+     [1] index into ptxlat[] of the CAN module (order of 'can_iface_txlat_add')
+     [2] select: 0 = put->load histogram, 1 = load->complete histogram, 2 = counts
+   Response, one msg per uint32_t value, dlc = 7:
+     [0] CANTXLATSTATS
+     [1] index
+     [2] (select << 5) | item number
+     [3]-[6] value, little endian
+   Histograms: item n = count in log2 bucket n, CANTXLATHISTSZ items, where
+     [0] < 2^CANTXLATSHIFT DTW ticks, [n] = 2^(n+CANTXLATSHIFT-1) <= ticks < 2^(n+CANTXLATSHIFT)
+     and the last bucket catches all above.  DTW ticks are sysclk (72 MHz).
+   Counts: item 0 CAN id, 1 TX complete, 2 max put->load, 3 max load->complete,
+     4 arbitration lost, 5 TERR, 6 bomb out, 7 abort.
+   Index not registered, or bad select: one msg, [2] = 0xff, dlc = 3.
+
+   The msgs are paced: each is queued with a TX done notification (CNCTBIT02) and 
+   the next is queued when it has gone out, so a page of stats never floods the
+   TX pool. */
+static void loadtxlat(struct CONTACTORFUNCTION* pcf)
+{
+	struct CANTXQMSG* pmsg = &pcf->canmsg[CID_CMD_R];
+	uint32_t v;
+
+	pcf->txpgidx  = pcf->snap_cmd_i.ncan.can.cd.uc[1];
+	pcf->txpgsel  = pcf->snap_cmd_i.ncan.can.cd.uc[2];
+	pcf->txpgitem = 0;
+	pcf->txpgn    = txlatval(pmsg->pctl, pcf->txpgidx, pcf->txpgsel, 0, &v);
+	if (pcf->txpgn == 0)
+	{ // Not registered, bad select, or CANTXLATENCY not compiled in
+		pmsg->can.cd.uc[1] = pcf->txpgidx;
+		pmsg->can.cd.uc[2] = 0xff;
+		pmsg->can.dlc = 3;
+		CanTask_put(pmsg);
+		return;
+	}
+	contactor_cmd_msg_txdone(pcf); // Send first
+	return;
+}
+/* *************************************************************************
+ * void contactor_cmd_msg_txdone(struct CONTACTORFUNCTION* pcf);
+ *	@brief	: Previous paced response msg went out (CNCTBIT02): queue the next, if any
+ * *************************************************************************/
+void contactor_cmd_msg_txdone(struct CONTACTORFUNCTION* pcf)
+{
+	struct CANTXQMSG* pmsg = &pcf->canmsg[CID_CMD_R];
+	uint32_t v;
 
+	if (pcf->txpgitem >= pcf->txpgn) return; // Nothing (more) to send
+
+	txlatval(pmsg->pctl, pcf->txpgidx, pcf->txpgsel, pcf->txpgitem, &v);
+	pmsg->can.cd.uc[0] = CANTXLATSTATS;
+	pmsg->can.cd.uc[1] = pcf->txpgidx;
+	pmsg->can.cd.uc[2] = (pcf->txpgsel << 5) | pcf->txpgitem;
+	load4(&pmsg->can.cd.uc[3], v);
+	pmsg->can.dlc = 7;
+
+	pmsg->pdone = &pcf->txdone; // Only these msgs notify
+	if (CanTask_put(pmsg) == CANPUT_OK)
+		pcf->txpgitem += 1;
+	else
+		pcf->txpgn = 0; // TX pool full: give up
+	pmsg->pdone = NULL;
+	return;
+}
+/* *************************************************************************
+ * static uint8_t txlatval(struct CAN_CTLBLOCK* pctl, uint8_t idx, uint8_t sel, uint8_t item, uint32_t* pv);
+ *	@brief	: Get one CAN TX latency value (see 'loadtxlat')
+ * @return	: number of items for 'sel'; 0 = bad index or select
+ * *************************************************************************/
+static uint8_t txlatval(struct CAN_CTLBLOCK* pctl, uint8_t idx, uint8_t sel, uint8_t item, uint32_t* pv)
+{
+#ifdef CANTXLATENCY
+	struct CANTXLAT* plat;
+
+	if (idx >= pctl->txlatct) return 0;
+	plat = pctl->ptxlat[idx];
+
+	switch (sel)
+	{
+	case 0: if (item < CANTXLATHISTSZ) *pv = plat->qhist[item]; return CANTXLATHISTSZ;
+	case 1: if (item < CANTXLATHISTSZ) *pv = plat->whist[item]; return CANTXLATHISTSZ;
+	case 2:
+		switch (item)
+		{
+		case 0: *pv = plat->id;      break;
+		case 1: *pv = plat->txct;    break;
+		case 2: *pv = plat->qmax;    break;
+		case 3: *pv = plat->wmax;    break;
+		case 4: *pv = plat->alstct;  break;
+		case 5: *pv = plat->terrct;  break;
+		case 6: *pv = plat->bombct;  break;
+		case 7: *pv = plat->abortct; break;
+		}
+		return 8;
+	}
+#endif
+	return 0;
+}
@@ -20,5 +20,8 @@
 void contactor_cmd_msg_i(struct CONTACTORFUNCTION* pcf);
 /*	@brief	: Given the Mailbox pointer (within CONTACTORFUNCTION) handle request
  * *************************************************************************/
+void contactor_cmd_msg_txdone(struct CONTACTORFUNCTION* pcf);
+/*	@brief	: Previous paced response msg went out (CNCTBIT02): queue the next, if any
+ * *************************************************************************/
 
 #endif
@@ -18,6 +18,7 @@
 #include "stm32f1xx_hal_tim.h"
 #include "morse.h"
 #include "canfilter_setup.h"
+#include "contactor_canmap_gen.h"
 
 /* From 'main.c' */
 extern struct CAN_CTLBLOCK* pctl0;	// Pointer to CAN1 control block
@@ -80,10 +81,15 @@ p->keepalive_k = pdMS_TO_TICKS(p->lc.keepalive_t); // keep-alive timeout (timeou
 p->hbct1_k     = pdMS_TO_TICKS(p->lc.hbct1_t);     // Heartbeat ct: ticks between sending msgs hv1:cur1
 p->hbct2_k     = pdMS_TO_TICKS(p->lc.hbct2_t);     // Heartbeat ct: ticks between sending msgs hv2:cur2
 
-	/* Add CAN Mailboxes                         CAN           CAN ID              Notify bit   Paytype */
-	p->pmbx_cid_cmd_i       =  MailboxTask_add(pctl0,p->lc.cid_cmd_i,      NULL,CNCTBIT06,0,36);
-	p->pmbx_cid_keepalive_i =  MailboxTask_add(pctl0,p->lc.cid_keepalive_i,NULL,CNCTBIT07,0,23);
-	p->pmbx_cid_gps_sync    =  MailboxTask_add(pctl0,p->lc.cid_gps_sync,   NULL,CNCTBIT08,0,23);
+	/* CAN Mailboxes: set up at compile time from the CAN map (contactor_canmap.def),
+	   including 'direct' for commands and keep-alive (loaded & notified in the CAN RX ISR) */
+	MailboxTask_add_table(pctl0, &canmap_tbl);
+	p->pmbx_cid_cmd_i       = &canmap_mbx[CANMAP_CMD_I];
+	p->pmbx_cid_keepalive_i = &canmap_mbx[CANMAP_KEEPALIVE_I];
+	p->pmbx_cid_gps_sync    = &canmap_mbx[CANMAP_GPS_SYNC];
+
+	/* Keep-alive timeout: notify this task (CNCTBIT04) each 'ka_k' without a msg */
+	if (MailboxTask_deadline(p->pmbx_cid_keepalive_i, p->ka_k, NULL, CNCTBIT04) == -1) morse_trap(66);
 
 	/* PWM working struct for switching PWM values */
 	p->sConfigOCn.OCMode = TIM_OCMODE_PWM1;
@@ -101,6 +107,7 @@ p->hbct2_k     = pdMS_TO_TICKS(p->lc.hbct2_t);     // Heartbeat ct: ticks betwee
 		p->canmsg[i].pctl = pctl0;   // Control block for CAN module (CAN 1)
 		p->canmsg[i].maxretryct = 8; //
 		p->canmsg[i].bits = 0;       //
+		p->canmsg[i].pdone = NULL;   // No TX done notification
 		p->canmsg[i].can.dlc = 8;    // Default payload size (might be modified when loaded and sent)
 	}
 
@@ -112,6 +119,40 @@ p->hbct2_k     = pdMS_TO_TICKS(p->lc.hbct2_t);     // Heartbeat ct: ticks betwee
 	p->canmsg[CID_HB1  ].can.id  = p->lc.cid_hb1;
 	p->canmsg[CID_HB2  ].can.id  = p->lc.cid_hb2;
 
+	// Heartbeat and polled readings: only the latest value matters. If the bus is
+	// busy a new one replaces a queued one (same CAN id) instead of queuing behind it.
+	p->canmsg[CID_MSG1 ].bits = CANREPLACEBYID;
+	p->canmsg[CID_MSG2 ].bits = CANREPLACEBYID;
+	p->canmsg[CID_HB1  ].bits = CANREPLACEBYID;
+	p->canmsg[CID_HB2  ].bits = CANREPLACEBYID;
+
+#ifdef CONTACTORHBPERIODIC
+	// Heartbeats: periodic from the tick hook, hb2 half a period after hb1.
+	// Payloads are loaded as new readings come in (contactor_msg1, msg2).
+	p->ptxsched_hb1 = can_txsched_add(&p->canmsg[CID_HB1], p->hbct1_k, 0);
+	p->ptxsched_hb2 = can_txsched_add(&p->canmsg[CID_HB2], p->hbct2_k, p->hbct2_k/2);
+	if ((p->ptxsched_hb1 == NULL) || (p->ptxsched_hb2 == NULL)) morse_trap(62);
+#endif
+
+	// TX done notification for paced multi-msg command responses (this task)
+	p->txdone.tskhandle = xTaskGetCurrentTaskHandle();
+	p->txdone.notebit   = CNCTBIT02;
+	p->txpgn = 0;
+
+	// TX latency stats for each CAN id sent (read with CANTXLATSTATS command)
+	for (i = 0; i < NUMCANMSGS; i++)
+	{
+		if (can_iface_txlat_add(pctl0, p->canmsg[i].can.id) == -2) morse_trap(63);
+	}
+
+	// Poll responses: rate limited so a runaway poll loop cannot crowd out the
+	// keep-alive responses.  Over budget poll responses are dropped and counted.
+	if (p->lc.pollrsp_t != 0)
+	{
+		if (can_iface_txrate_add(pctl0, p->lc.cid_msg1, pdMS_TO_TICKS(p->lc.pollrsp_t), p->lc.pollrspburst) == -2) morse_trap(64);
+		if (can_iface_txrate_add(pctl0, p->lc.cid_msg2, pdMS_TO_TICKS(p->lc.pollrsp_t), p->lc.pollrspburst) == -2) morse_trap(64);
+	}
+
 	return;
 }
 /* *************************************************************************
@@ -119,31 +160,16 @@ p->hbct2_k     = pdMS_TO_TICKS(p->lc.hbct2_t);     // Heartbeat ct: ticks betwee
  *	@brief	: Setup CAN hardware filter with CAN addresses to receive
  * @param	: p    = pointer to ContactorTask
  * *************************************************************************/
+/* The filter banks were made at build time from the CAN map (contactor_canmap.def),
+   so CAN msgs without a mailbox never reach the RX FIFO ISR.  Command and
+   keep-alive are safety critical (loss opens the contactors) and go to FIFO 1
+   (FIFO column of the map).  Banks left: 'canfilter_setup_banksleft(1)'. */
 void contactor_func_init_canfilter(struct CONTACTORFUNCTION* p)
 {
-/*	HAL_StatusTypeDef canfilter_setup_add32b_id(uint8_t cannum, CAN_HandleTypeDef *phcan, \
-    uint32_t id,   \
-    uint8_t  fifo );
- @brief	: Add a 32b id, advance bank number & odd/even
- * @param	: cannum = CAN module number 1, 2, or 3
- * @param	: phcan = Pointer to HAL CAN handle (control block)
- * @param	: id    = 32b CAN id
- * @param	: fifo  = fifo: 0 or 1
- * @return	: HAL_ERROR or HAL_OK
-*/
-	HAL_StatusTypeDef ret;
-
-	// CANID_CMD_CNTCTR1I: U8_VAR: Contactor1: I: Command CANID incoming
-	ret = canfilter_setup_add32b_id(1,&hcan,p->lc.cid_cmd_i,0);
-	if (ret == HAL_ERROR) morse_trap(61);	
-
-	// CANID_CMD_CNTCTRKAI:U8',    Contactor1: I KeepAlive and connect command
-	ret = canfilter_setup_add32b_id(1,&hcan,p->lc.cid_keepalive_i,0);
-	if (ret == HAL_ERROR) morse_trap(62);	
-
-	// CANID_HB_TIMESYNC:  U8 : GPS_1: U8 GPS time sync distribution msg-GPS time sync msg
-	ret = canfilter_setup_add32b_id(1,&hcan,p->lc.cid_gps_sync,0);
-	if (ret == HAL_ERROR) morse_trap(63);	
+	int ret;
+
+	ret = canfilter_setup_table(1, &hcan, &canmap_filt[0], CANMAPFILTNUM);
+	if (ret < 0) morse_trap(61);	
 
 	return;
 }
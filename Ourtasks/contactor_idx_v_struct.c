@@ -6,6 +6,7 @@
 *******************************************************************************/
 
 #include "contactor_idx_v_struct.h"
+#include "contactor_canmap_gen.h"
 
 /* Select .c file to load parameters */
 #ifdef DEHPARAMS
@@ -115,6 +115,10 @@ struct CONTACTORLC
 	uint32_t hbct2_t;		// Heartbeat ct: ticks between sending msgs hv2:cur2
 	uint32_t hbct3_t;		// Heartbeat ct: ticks between sending msgs hv3 (if two contactors)
 
+/* CAN TX rate limit for poll response msgs (cid_msg1, cid_msg2), each CAN id. */
+	uint32_t pollrsp_t;     // Min average ms between msgs; 0 = no limit
+	uint32_t pollrspburst;  // Number of msgs allowed back-to-back
+
 /* Calibrations (offset, scale) */
 
 	// High voltage from uart
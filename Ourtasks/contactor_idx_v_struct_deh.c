@@ -45,6 +45,8 @@ void contactor_idx_v_struct_hardcode_params(struct CONTACTORLC* p)
 	p->keepalive_t= 2555; // keep-alive timeout (timeout delay ms)
 	p->hbct1_t    = 1000; // Heartbeat ct: ticks between sending msgs hv1:cur1
 	p->hbct2_t    = 1000; // Heartbeat ct: ticks between sending msgs hv2:cur2
+	p->pollrsp_t  = 10;   // Poll response msgs: min average ms between msgs (each CAN id)
+	p->pollrspburst = 4;  // Poll response msgs: allowed back-to-back
 
 /* PWM durations as percent (0.0- 100.0) */
 	p->fpwmpct1  = 50.0;  // Percent PWM after closure delay at 100% coil #1
@@ -80,9 +82,10 @@ void contactor_idx_v_struct_hardcode_params(struct CONTACTORLC* p)
 	p->cid_keepalive_r= 0xE3C00000; // CANID_CMD_CNTCTRKAR: U8_U8 : Contactor1: R KeepAlive response
 
 	// List of CAN ID's for setting up hw filter for incoming msgs
-	p->cid_cmd_i        = 0xE360000C; // CANID_CMD_CNTCTR1I: U8_VAR: Contactor1: I: Command CANID incoming
-	p->cid_keepalive_i  = 0xE3800000; // CANID_CMD_CNTCTRKAI:U8',    Contactor1: I KeepAlive and connect command
-	p->cid_gps_sync     = 0x00400000; // CANID_HB_TIMESYNC:  U8 : GPS_1: U8 GPS time sync distribution msg-GPS time sync msg
+	// (incoming ids are set in the CAN map: contactor_canmap.def)
+	p->cid_cmd_i        = CANMAPID_CMD_I;       // CANID_CMD_CNTCTR1I: U8_VAR: Contactor1: I: Command CANID incoming
+	p->cid_keepalive_i  = CANMAPID_KEEPALIVE_I; // CANID_CMD_CNTCTRKAI:U8',    Contactor1: I KeepAlive and connect command
+	p->cid_gps_sync     = CANMAPID_GPS_SYNC;    // CANID_HB_TIMESYNC:  U8 : GPS_1: U8 GPS time sync distribution msg-GPS time sync msg
 	p->code_CAN_filt[0] = 0xFFFFFFFC; // CANID_DUMMY: UNDEF: Dummy ID: Lowest priority possible (Not Used)
 	p->code_CAN_filt[1] = 0xFFFFFFFC; // CANID_DUMMY: UNDEF: Dummy ID: Lowest priority possible (Not Used)
 	p->code_CAN_filt[2] = 0xFFFFFFFC; // CANID_DUMMY: UNDEF: Dummy ID: Lowest priority possible (Not Used)
@@ -47,7 +47,8 @@ SENT by contactor function:
       - volts: 5v regulated supply
       ... (many and sundry)
 
- heartbeat (sent in absence of keep-alive msgs)
+ heartbeat (sent in absence of keep-alive msgs; CONTACTORHBPERIODIC:
+            periodic, hbct1_k/hbct2_k: can_txsched.c from the tick hook)
  (5)  "cid_hb1" Same as (2) above
  (6)  "cid_hb2" Same as (3) above
 */
@@ -63,6 +64,7 @@ static void load4(uint8_t *po, uint32_t n);
  *	@brief	: Setup and send responses: battery string voltage & battery current
  * @param	: pcf = Pointer to working struct for Contactor function
  * @param	: w = switch for CID_HB1 (0) or CID_MSG1 CAN ids (1)
+ * NOTE: CONTACTORHBPERIODIC: CID_HB1 only loads the payload; the tick hook sends it.
  * *************************************************************************/
 uint32_t dbgmsg1ctr;
 
@@ -95,8 +97,13 @@ void contactor_msg1(struct CONTACTORFUNCTION* pcf, uint8_t w)
 
 dbgmsg1ctr += 1;
 
-	// Queue CAN msg
-	xQueueSendToBack(CanTxQHandle,&pcf->canmsg[idx2],portMAX_DELAY);
+#ifdef CONTACTORHBPERIODIC
+	if (w == 0) // Heartbeat: latest payload, the tick hook sends it
+		can_txsched_update(pcf->ptxsched_hb1, &pcf->canmsg[idx2].can);
+	else
+#endif
+	// Queue CAN msg (direct to CAN driver; dropped & counted if TX pool full)
+	CanTask_put(&pcf->canmsg[idx2]);
 	return;
 
 }
@@ -104,7 +111,8 @@ dbgmsg1ctr += 1;
  * void contactor_msg2(struct CONTACTORFUNCTION* pcf, uint8_t w);
  *	@brief	: Setup and send responses: voltages: DMOC+, DMOC-
  * @param	: pcf = Pointer to working struct for Contactor function
- * @param	: w = switch for CID_HB1 (0) or CID_MSG1 CAN ids (1)
+ * @param	: w = switch for CID_HB2 (0) or CID_MSG2 CAN ids (1)
+ * NOTE: CONTACTORHBPERIODIC: CID_HB2 only loads the payload; the tick hook sends it.
  * *************************************************************************/
 void contactor_msg2(struct CONTACTORFUNCTION* pcf, uint8_t w)
 {
@@ -122,8 +130,13 @@ dbgmsg1ctr += 1;
 	// Load high voltage 3 as a float into payload
 	hvpayload(pcf, IDXHV3, idx2, 4);
 
-	// Queue CAN msg
-	xQueueSendToBack(CanTxQHandle,&pcf->canmsg[idx2],portMAX_DELAY);
+#ifdef CONTACTORHBPERIODIC
+	if (w == 0) // Heartbeat: latest payload, the tick hook sends it
+		can_txsched_update(pcf->ptxsched_hb2, &pcf->canmsg[idx2].can);
+	else
+#endif
+	// Queue CAN msg (direct to CAN driver; dropped & counted if TX pool full)
+	CanTask_put(&pcf->canmsg[idx2]);
 	return;
 }
 /* *************************************************************************
@@ -159,7 +172,7 @@ void contactor_msg_ka(struct CONTACTORFUNCTION* pcf)
 dbgkactr += 1;
 	/* Return command byte w primary state code */
 	pcf->canmsg[CID_KA_R].can.cd.uc[0]  = 
-     (pcf->pmbx_cid_keepalive_i->ncan.can.cd.uc[0] & 0xf0) |
+     (pcf->snap_keepalive_i.ncan.can.cd.uc[0] & 0xf0) |
      (pcf->state & 0xf);
 
 	/* Fault code */
@@ -171,8 +184,8 @@ dbgkactr += 1;
 
 	pcf->canmsg[CID_KA_R].can.dlc = 3; // Payload size
 
-	// Queue CAN msg
-	xQueueSendToBack(CanTxQHandle,&pcf->canmsg[CID_KA_R],portMAX_DELAY);
+	// Queue CAN msg (direct to CAN driver; dropped & counted if TX pool full)
+	CanTask_put(&pcf->canmsg[CID_KA_R]);
 	return;
 }
 /* *************************************************************************
@@ -60,6 +60,19 @@ QueueHandle_t  xCanTxTaskCreate(uint32_t taskpriority, int32_t queuesize)
 	CanTxQHandle = xQueueCreate(queuesize, sizeof(struct CANTXQMSG));
 	return CanTxQHandle;
 }
+/* *************************************************************************
+ * int CanTask_put(struct CANTXQMSG* ptxq);
+ * @brief	: Queue CAN msg directly in the CAN driver (no CanTxTask queue, no blocking)
+ * @param	: ptxq = pointer to msg plus CAN control block, retry count, bits
+ * @return	: CANPUT_OK, CANPUT_OVERRUN, CANPUT_BOGUSID, CANPUT_NOPCTL (see can_iface.h)
+ * *************************************************************************/
+/* This saves the copy into 'CanTxQHandle', the CanTxTask wakeup, and the second
+   copy.  On overrun the msg is dropped and counted (pctl->can_errors.can_msgovrflow)
+   rather than blocking the calling task. */
+int CanTask_put(struct CANTXQMSG* ptxq)
+{
+	return can_driver_put_done(ptxq->pctl, &ptxq->can, ptxq->maxretryct, ptxq->bits, ptxq->pdone);
+}
 /* *************************************************************************
  * void StartCanTxTask(void const * argument);
  *	@brief	: Task startup
@@ -79,14 +92,13 @@ HAL_GPIO_TogglePin(GPIOD, GPIO_PIN_13); // ORANGE
 		Qret = xQueueReceive(CanTxQHandle,&txq,portMAX_DELAY);
 		if (Qret == pdPASS) // Break loop if not empty
 		{
-			ret = can_driver_put(txq.pctl, &txq.can, txq.maxretryct, txq.bits);
+			ret = can_driver_put_done(txq.pctl, &txq.can, txq.maxretryct, txq.bits, txq.pdone);
 /* ===> Trap errors
- *				: -1 = Buffer overrun (no free slots for the new msg)
- *				: -2 = Bogus CAN id rejected
- *				: -3 = control block pointer NULL */
-			if (ret == -1) morse_trap(91);
-			if (ret == -2) morse_trap(92);
-			if (ret == -3) morse_trap(93);
+ *				: CANPUT_OVERRUN = Buffer overrun: dropped & counted in pctl->can_errors.can_msgovrflow
+ *				: CANPUT_BOGUSID = Bogus CAN id rejected
+ *				: CANPUT_NOPCTL  = control block pointer NULL */
+			if (ret == CANPUT_BOGUSID) morse_trap(92);
+			if (ret == CANPUT_NOPCTL ) morse_trap(93);
 		}
   }
 }
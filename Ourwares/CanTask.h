@@ -20,6 +20,7 @@ struct CANTXQMSG
 {
 	struct CAN_CTLBLOCK* pctl;	// Pointer to control block for this CAN
 	struct CANRCVBUF can;		// CAN msg
+	struct CANTXDONE* pdone;	// TX done notification (can_iface.h); NULL = none
 	uint8_t maxretryct;
 	uint8_t bits;
 };
@@ -32,6 +33,11 @@ QueueHandle_t  xCanTxTaskCreate(uint32_t taskpriority, int32_t queuesize);
  * @param	: queuesize = number of items in Tx queue
  * @return	: QueueHandle_t = queue handle
  * *************************************************************************/
+int CanTask_put(struct CANTXQMSG* ptxq);
+/* @brief	: Queue CAN msg directly in the CAN driver (no CanTxTask queue, no blocking)
+ * @param	: ptxq = pointer to msg plus CAN control block, retry count, bits
+ * @return	: CANPUT_OK, CANPUT_OVERRUN, CANPUT_BOGUSID, CANPUT_NOPCTL (see can_iface.h)
+ * *************************************************************************/
 QueueHandle_t xCanRxTaskCreate(uint32_t taskpriority, int32_t queuesize);
 /* @brief	: Create task; task handle created is global for all to enjoy!
  * @param	: taskpriority = Task priority (just as it says!)
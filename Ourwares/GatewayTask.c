@@ -11,8 +11,8 @@ accesses the circular buffer via 'take' pointer.
 
 The 'MailboxTask' is likely a high FreeRTOS priority task.  This task might run at
 a lower priority since timing is not critical, however delays require that the 
-circular buffer be large enough to avoid overrun since there is no protection for
-buffer overflow (since CAN msgs are added to the circular buffer under interrupt).
+circular buffer be large enough to avoid overrun.  Msgs are added under interrupt; 
+if this task's 'take' is lapped it resyncs and counts lost msgs (ptake[i]->lostct).
 
 This version only handles PC->CAN bus msgs for CAN1 module.  To mix CAN1 and CAN2
 requires implementing the scheme of commandeering the low order bit(s) from the
@@ -28,6 +28,7 @@ as 29b address. [04/06/2019--not implemented]
 #include "stm32f1xx_hal_can.h"
 #include "GatewayTask.h"
 #include "can_iface.h"
+#include "CanTask.h"
 #include "MailboxTask.h"
 #include "getserialbuf.h"
 #include "SerialTaskSend.h"
@@ -66,6 +67,21 @@ osThreadId xGatewayTaskCreate(uint32_t taskpriority)
 
 	return GatewayTaskHandle;
 }
+/* *************************************************************************
+ * static void gateway_put(struct CANTXQMSG* ptxq);
+ * @brief	: Put CAN msg directly into the CAN driver; wait for space, don't drop
+ * @param	: ptxq = pointer to msg plus CAN control block, retry count, bits
+ * *************************************************************************/
+/* Was xQueueSendToBack(CanTxQHandle,...,portMAX_DELAY), which blocked on a full
+   queue rather than lose a msg.  A gateway passes other nodes' traffic, so it keeps
+   that: on a full TX pool it waits a tick and tries again, instead of the drop
+   that CanTask_put callers such as ContactorTask accept. */
+static void gateway_put(struct CANTXQMSG* ptxq)
+{
+	while (CanTask_put(ptxq) == CANPUT_OVERRUN)
+		osDelay(1); // Delay, don't spin.
+	return;
+}
 /* *************************************************************************
  * void StartGatewayTask(void const * argument);
  *	@brief	: Task startup
@@ -97,18 +113,21 @@ void StartGatewayTask(void const * argument)
 	canqtx1.pctl       = pctl0;
 	canqtx1.maxretryct = 8;
 	canqtx1.bits       = 0; // /NART
+	canqtx1.pdone      = NULL;
 
    // CAN2
 	struct CANTXQMSG canqtx2;
 	canqtx2.pctl = pctl1;
 	canqtx2.maxretryct = 8;
 	canqtx2.bits       = 0; // /NART
+	canqtx2.pdone      = NULL;
 
 	// PC -> CAN1 (no PC->CAN2)
 	struct CANTXQMSG pccan1;
 	pccan1.pctl = pctl0;
 	pccan1.maxretryct = 8;
 	pccan1.bits       = 0; // /NART
+	pccan1.pdone      = NULL;
 
 	/* Setup serial output buffers for uarts. */
 	struct SERIALSENDTASKBCB* pbuf2 = getserialbuf(&huart6,128);
@@ -169,7 +188,7 @@ void StartGatewayTask(void const * argument)
 						vSerialTaskSendQueueBuf(&pbuf3); // Place on queue for usart2 sending
 
 					/* === CAN1 -> CAN2 === */
-						xQueueSendToBack(CanTxQHandle,&canqtx2,portMAX_DELAY);
+						gateway_put(&canqtx2);
 					}
 				} while (pncan != NULL);	// Drain the buffer
 			}
@@ -195,7 +214,7 @@ void StartGatewayTask(void const * argument)
 						vSerialTaskSendQueueBuf(&pbuf4); // Place on queue for usart2 sending
 
 					/* === CAN1 -> CAN2 === */
-						xQueueSendToBack(CanTxQHandle,&canqtx1,portMAX_DELAY);
+						gateway_put(&canqtx1);
 					}
 				} while (pncan != NULL);	// Drain the buffer
 			}
@@ -217,7 +236,7 @@ void StartGatewayTask(void const * argument)
 					{
 						/* Place CAN msg on queue for sending to CAN bus */
 						pccan1.can = pcanp->can;
-						xQueueSendToBack(CanTxQHandle,&pccan1,portMAX_DELAY);
+						gateway_put(&pccan1);
 					}
 					else
 					{ // Here, one or more errors. List for the hapless Op to ponder
@@ -226,7 +245,7 @@ void StartGatewayTask(void const * argument)
 
 						/* For test purposes: Place CAN msg on queue for sending to CAN bus */
 						pccan1.can = pcanp->can;
-						xQueueSendToBack(CanTxQHandle,&pccan1,portMAX_DELAY);
+						gateway_put(&pccan1);
 					}
 				}
 			} while ( pcanp != NULL);
@@ -22,10 +22,42 @@ extern struct CONTACTORFUNCTION contactorfunction;
 /* One struct for each CAN module, e.g. CAN 1, 2, 3, ... */
 struct MAILBOXCANNUM mbxcannum[STM32MAXCANNUM] = {0};
 
+/* Static storage: mailboxes, sorted id & mailbox pointer arrays for each CAN
+   module, and the notification blocks (each mailbox's blocks contiguous). */
+static struct MAILBOXCAN mbxpool[MBXNUMMAX];
+static uint16_t mbxpoolct;   // Number of 'mbxpool' in use
+static struct MAILBOXCAN* mbxptrs[STM32MAXCANNUM][MBXNUMMAX];
+static uint32_t mbxids[STM32MAXCANNUM][MBXNUMMAX];
+static struct CANNOTIFYLIST notepool[MBXNOTENUMMAX];
+static struct MBXNOTEPOL notepol[MBXNOTENUMMAX]; // Policy state: 'notepol'[i] goes with 'notepool'[i]
+static uint16_t notepoolct;  // Number of 'notepool' in use
+static uint8_t notefrozen;   // 1 = a block pointer was handed out: 'notepool' must not shift
+
+/* Deadlines: min-heap on 'due' (tick count).  [0] is the next to expire. */
+struct MBXDEADLINE
+{
+	struct MAILBOXCAN* pmbx;
+	uint32_t due;            // Tick count to check the mailbox
+};
+static struct MBXDEADLINE dlheap[MBXDEADLINENUM];
+static uint8_t dlheapct;     // Number of 'dlheap' in use
+
+/* History rings: carved from one static budget at registration */
+static struct MBXHISTENTRY histpool[MBXHISTBUDGET];
+static uint16_t histpoolct;  // Number of 'histpool' in use
+
 osThreadId MailboxTaskHandle; // This wonderful task handle
 
 void StartMailboxTask(void const * argument);
 static struct MAILBOXCAN* loadmbx(struct MAILBOXCANNUM* pmbxnum, struct CANRCVBUFN* pncan);
+static int bsearchid(struct MAILBOXCANNUM* pmbxnum, uint32_t canid);
+static void mbxwrite(struct MAILBOXCAN* pmbx, struct CANRCVBUFN* pncan, uint32_t now);
+static TickType_t dlsweep(void);
+static int notepass(struct MAILBOXCAN* pmbx, struct MBXNOTEPOL* ppol, uint32_t now);
+static struct CANNOTIFYLIST* noteadd(struct MAILBOXCAN* pmbx, osThreadId tskhandle, uint32_t notebit, uint8_t noteskip);
+#ifdef CANRXDIRECT
+static void rxdirect(struct CAN_CTLBLOCK* pctl, struct CANRCVBUFN* pncan, BaseType_t* pwoken);
+#endif
 
 /* *************************************************************************
  * struct MAILBOXCANNUM* MailboxTask_add_CANlist(struct CAN_CTLBLOCK* pctl, uint16_t arraysize);
@@ -37,11 +69,9 @@ static struct MAILBOXCAN* loadmbx(struct MAILBOXCANNUM* pmbxnum, struct CANRCVBU
  * *************************************************************************/
 struct MAILBOXCANNUM* MailboxTask_add_CANlist(struct CAN_CTLBLOCK* pctl, uint16_t arraysize)
 {
-	struct MAILBOXCAN** ppmbxarray; // Pointer to array of pointers to mailboxes
-
 	if (pctl == NULL) morse_trap(21); // Oops
 
-	if (arraysize == 0) morse_trap(22); // Oops
+	if ((arraysize == 0) || (arraysize > MBXNUMMAX)) morse_trap(22); // Oops
 
 taskENTER_CRITICAL();
 
@@ -51,19 +81,21 @@ taskENTER_CRITICAL();
 	/* This needed to find the CAN module in 'StartMailboxTask' */
 	mbxcannum[pctl->canidx].pctl = pctl;
 
-	/* Get memory for the array of mailbox pointers */
-	ppmbxarray = (struct MAILBOXCAN**)calloc(arraysize, sizeof(struct MAILBOXCAN*));
-	if (ppmbxarray == NULL) {taskEXIT_CRITICAL(); morse_trap(23);}
-
 	/* xMailboxTaskCreate needs to be called before this 'add to list' */
 	if (MailboxTaskHandle == NULL) {taskEXIT_CRITICAL(); morse_trap(24);}
 
 	/* Get a circular buffer 'take' pointer for this CAN module. */
 	// The first three notification bits are reserved for CAN modules 
 	mbxcannum[pctl->canidx].ptake = can_iface_mbx_init(pctl, MailboxTaskHandle, (1 << pctl->canidx) );
+#ifdef CANRXFIFO1HIPRI
+	/* FIFO 1 (high priority) ring 'take' pointer */
+	mbxcannum[pctl->canidx].ptake1 = can_iface_mbx_init_hipri(pctl, MailboxTaskHandle, MBXNOTEBITHIPRI(pctl->canidx) );
+	if (mbxcannum[pctl->canidx].ptake1 == NULL) {taskEXIT_CRITICAL(); morse_trap(23);}
+#endif
 
-	/* Save pointer to array of pointers to mailboxes. */
-	mbxcannum[pctl->canidx].pmbxarray = ppmbxarray;
+	/* Static arrays of pointers to mailboxes, and their CAN ids (sorted). */
+	mbxcannum[pctl->canidx].pmbxarray = &mbxptrs[pctl->canidx][0];
+	mbxcannum[pctl->canidx].pidarray  = &mbxids[pctl->canidx][0];
 
 	/* Save number of mailbox pointers */
 	mbxcannum[pctl->canidx].arraysizemax = arraysize; // Max
@@ -75,6 +107,50 @@ taskENTER_CRITICAL();
 taskEXIT_CRITICAL();
 	return &mbxcannum[pctl->canidx];
 }
+/* *************************************************************************
+ * struct MAILBOXCANNUM* MailboxTask_add_table(struct CAN_CTLBLOCK* pctl, const struct MBXTABLE* ptbl);
+ *	@brief	: Use a compile time mailbox list (e.g. generated 'canmap_tbl') for a CAN module
+ * @param	: pctl = Pointer to CAN control block (after 'MailboxTask_add_CANlist')
+ * @param	: ptbl = pointer to table
+ * @return	: Pointer to CAN module mailbox list (traps on error)
+ * *************************************************************************/
+struct MAILBOXCANNUM* MailboxTask_add_table(struct CAN_CTLBLOCK* pctl, const struct MBXTABLE* ptbl)
+{
+	struct MAILBOXCANNUM* pmbxnum;
+	osThreadId tskhandle;
+	int i;
+
+	if ((pctl == NULL) || (ptbl == NULL)) morse_trap(35);
+	if (pctl->canidx >= STM32MAXCANNUM)   morse_trap(35);
+	pmbxnum = &mbxcannum[pctl->canidx];
+	if (pmbxnum->pctl == NULL) morse_trap(28); // 'MailboxTask_add_CANlist' first
+	if ((pmbxnum->arraysizecur != 0) || (pmbxnum->ptbl != NULL)) morse_trap(36); // One list per module
+	if ((ptbl->nnote != 0) && (ptbl->ppol == NULL)) morse_trap(35);
+
+	/* Task handles are not known until the tasks are created. */
+	for (i = 0; i < ptbl->nnote; i++)
+	{
+		tskhandle = NULL;
+		if (ptbl->ptask[i] != NULL) tskhandle = *ptbl->ptask[i];
+		if (tskhandle == NULL) tskhandle = xTaskGetCurrentTaskHandle();
+		ptbl->pnote[i].tskhandle = tskhandle;
+	}
+	for (i = 0; i < ptbl->nmbx; i++)
+		ptbl->pmbxarray[i]->ncan.toa = DTWTIME; // Initial time-of-arrival
+
+taskENTER_CRITICAL(); // MailboxTask must see both arrays and the size together
+	pmbxnum->pmbxarray    = ptbl->pmbxarray;
+	pmbxnum->pidarray     = ptbl->pidarray;
+	pmbxnum->arraysizecur = ptbl->nmbx;
+	pmbxnum->ptbl         = ptbl;
+taskEXIT_CRITICAL();
+
+	for (i = 0; i < ptbl->ndirect; i++)
+	{
+		if (MailboxTask_direct(pctl, ptbl->pmbxarray[ptbl->pdirect[i]]) == -1) morse_trap(37);
+	}
+	return pmbxnum;
+}
 /* *************************************************************************
  *  struct CANNOTIFYLIST* MailboxTask_disable_notifications(struct MAILBOXCAN* pmbx);
  *  struct CANNOTIFYLIST* MailboxTask_enable_notifications (struct MAILBOXCAN* pmbx);
@@ -85,22 +161,19 @@ taskEXIT_CRITICAL();
 static struct CANNOTIFYLIST* noteskip(struct MAILBOXCAN* pmbx, uint8_t skip)
 {
 	osThreadId tskhandle = xTaskGetCurrentTaskHandle();
-	struct CANNOTIFYLIST* pnotetmp;	
-	struct CANNOTIFYLIST* pnotex;	
+	struct CANNOTIFYLIST* pnotetmp = pmbx->pnote; // Ptr to first block
+	struct CANNOTIFYLIST* pnoteend = pnotetmp + pmbx->notect;
 
-	// Traverse linked list to find task
-	pnotetmp = pmbx->pnote;	// Ptr to head of list
-	if (pnotetmp == NULL) return NULL; // No notifications setup!
-	do 
+	// Search this mailbox's blocks for task (NULL 'pnote' has 'notect' zero)
+	for ( ; pnotetmp < pnoteend; pnotetmp++)
 	{
 		if (tskhandle == pnotetmp->tskhandle)
 		{ // Notification for "this" task found
 			pnotetmp->skip = skip; // Update 'skip' flag
+			notefrozen = 1;  // Caller may keep the pointer
 			return pnotetmp; // Ptr to notification struct
 		}
-			pnotex   = pnotetmp;
-			pnotetmp = pnotetmp->pnext;
-	} while (pnotetmp != pnotex);
+	}
 	return NULL; // Here, the current running task not found
 }
 struct CANNOTIFYLIST* MailboxTask_disable_notifications(struct MAILBOXCAN* pmbx)
@@ -111,6 +184,148 @@ struct CANNOTIFYLIST* MailboxTask_enable_notifications(struct MAILBOXCAN* pmbx)
 {
 	return noteskip(pmbx, 0);
 }
+/* *************************************************************************
+ * struct CANNOTIFYLIST* MailboxTask_notify_always     (struct MAILBOXCAN* pmbx);
+ * struct CANNOTIFYLIST* MailboxTask_notify_onchange   (struct MAILBOXCAN* pmbx);
+ * struct CANNOTIFYLIST* MailboxTask_notify_deadband_ff (struct MAILBOXCAN* pmbx, float deadband);
+ * struct CANNOTIFYLIST* MailboxTask_notify_deadband_u32(struct MAILBOXCAN* pmbx, uint32_t deadband);
+ * struct CANNOTIFYLIST* MailboxTask_notify_ratelimit  (struct MAILBOXCAN* pmbx, uint32_t ms);
+ *	@brief	: Set the notification policy of the calling task's block (see MBXNOTExxxx)
+ * @param	: pmbx = pointer to mailbox
+ * @param	: deadband = notify when the reading moved more than this since the last notify
+ * @param	: ms = minimum time between notifications
+ * @return	: Pointer to notification block, for calling task; NULL = task not found
+ * *************************************************************************/
+static struct CANNOTIFYLIST* notepolicy(struct MAILBOXCAN* pmbx, uint8_t policy, union MBXNOTEVAL param)
+{
+	osThreadId tskhandle = xTaskGetCurrentTaskHandle();
+	struct CANNOTIFYLIST* pnotetmp = pmbx->pnote; // Ptr to first block
+	struct CANNOTIFYLIST* pnoteend = pnotetmp + pmbx->notect;
+	struct MBXNOTEPOL* ppol;
+
+	for ( ; pnotetmp < pnoteend; pnotetmp++)
+	{
+		if (tskhandle == pnotetmp->tskhandle)
+		{ // Notification for "this" task found
+			ppol = &pmbx->ppol[pnotetmp - pmbx->pnote]; // Its policy state
+taskENTER_CRITICAL(); // MailboxTask, or RX ISR ('direct'), must see all three together
+			ppol->param  = param;
+			ppol->policy = policy;
+			ppol->primed = 0; // Next msg notifies, and is the reference
+			notefrozen = 1;       // Caller may keep the pointer
+taskEXIT_CRITICAL();
+			return pnotetmp;
+		}
+	}
+	return NULL; // Here, the current running task not found
+}
+struct CANNOTIFYLIST* MailboxTask_notify_always(struct MAILBOXCAN* pmbx)
+{
+	union MBXNOTEVAL v = {.u = 0};
+	return notepolicy(pmbx, MBXNOTEALWAYS, v);
+}
+struct CANNOTIFYLIST* MailboxTask_notify_onchange(struct MAILBOXCAN* pmbx)
+{
+	union MBXNOTEVAL v = {.u = 0};
+	return notepolicy(pmbx, MBXNOTECHANGE, v);
+}
+struct CANNOTIFYLIST* MailboxTask_notify_deadband_ff(struct MAILBOXCAN* pmbx, float deadband)
+{
+	union MBXNOTEVAL v = {.f = deadband};
+	return notepolicy(pmbx, MBXNOTEDBFF, v);
+}
+struct CANNOTIFYLIST* MailboxTask_notify_deadband_u32(struct MAILBOXCAN* pmbx, uint32_t deadband)
+{
+	union MBXNOTEVAL v = {.u = deadband};
+	return notepolicy(pmbx, MBXNOTEDBU32, v);
+}
+struct CANNOTIFYLIST* MailboxTask_notify_ratelimit(struct MAILBOXCAN* pmbx, uint32_t ms)
+{
+	union MBXNOTEVAL v = {.u = pdMS_TO_TICKS(ms)};
+	return notepolicy(pmbx, MBXNOTERATE, v);
+}
+/* *************************************************************************
+ * uint32_t MailboxTask_notify_savect(void);
+ *	@brief	: Wakeups saved: total of all notification blocks' policy 'savect'
+ * @return	: Count
+ * *************************************************************************/
+uint32_t MailboxTask_notify_savect(void)
+{
+	uint32_t ct = 0;
+	int i,j;
+
+	for (i = 0; i < notepoolct; i++)
+		ct += notepol[i].savect;
+	for (i = 0; i < STM32MAXCANNUM; i++)
+	{ // Compile time tables have their own blocks
+		if (mbxcannum[i].ptbl == NULL) continue;
+		for (j = 0; j < mbxcannum[i].ptbl->nnote; j++)
+			ct += mbxcannum[i].ptbl->ppol[j].savect;
+	}
+	return ct;
+}
+/* *************************************************************************
+ * static int notepass(struct MAILBOXCAN* pmbx, struct MBXNOTEPOL* ppol, uint32_t now);
+ *	@brief	: Apply the notification policy to a msg just loaded into the mailbox
+ * @param	: pmbx = pointer to mailbox
+ * @param	: ppol = pointer to the notification block's policy state
+ * @param	: now = FreeRTOS tick count
+ * @return	: 1 = notify; 0 = not this time ('savect' counted)
+ * NOTE: Called by the mailbox writer (MailboxTask, or the RX ISR if 'direct').
+ * *************************************************************************/
+static int notepass(struct MAILBOXCAN* pmbx, struct MBXNOTEPOL* ppol, uint32_t now)
+{
+	union MBXNOTEVAL v;
+	float d;
+	uint32_t ud;
+
+	switch (ppol->policy)
+	{
+	case MBXNOTEALWAYS:
+		return 1;
+
+	case MBXNOTECHANGE:
+		if (pmbx->chg != 0) return 1;
+		break;
+
+	case MBXNOTEDBFF:
+		v.f = pmbx->mbx.u.f[0];
+		d = v.f - ppol->last.f;
+		if (d < 0) d = -d;
+		if ((ppol->primed == 0) || !(d <= ppol->param.f)) // NaN notifies
+		{
+			ppol->last   = v;
+			ppol->primed = 1;
+			return 1;
+		}
+		break;
+
+	case MBXNOTEDBU32:
+		v.u = pmbx->mbx.u.i32[0];
+		ud  = (v.u > ppol->last.u) ? (v.u - ppol->last.u) : (ppol->last.u - v.u);
+		if ((ppol->primed == 0) || (ud > ppol->param.u))
+		{
+			ppol->last   = v;
+			ppol->primed = 1;
+			return 1;
+		}
+		break;
+
+	case MBXNOTERATE:
+		if ((ppol->primed == 0) || ((now - ppol->tlast) >= ppol->param.u))
+		{
+			ppol->tlast  = now;
+			ppol->primed = 1;
+			return 1;
+		}
+		break;
+
+	default:
+		return 1;
+	}
+	ppol->savect += 1; // Wakeup saved
+	return 0;
+}
 
 /* *************************************************************************
  * struct MAILBOXCAN* MailboxTask_add(struct CAN_CTLBLOCK* pctl,\
@@ -135,29 +350,30 @@ struct MAILBOXCAN* MailboxTask_add(struct CAN_CTLBLOCK* pctl,\
 		 uint8_t noteskip,\
 		 uint8_t paytype)
 {
-	int j;
+	int i,j;
 	struct MAILBOXCAN* pmbx;
-	struct CANNOTIFYLIST* pnotex;
-	struct CANNOTIFYLIST* pnotetmp;
 	struct MAILBOXCAN** ppmbx;
+	uint32_t* pid;
 
 	/* Check that the bozo programmer got the prior initializations done correctly. */
 	if (canid == 0)    morse_trap(25); // return NULL;
 	if (pctl  == NULL) morse_trap(26); //return NULL;
 	if (pctl->canidx >= STM32MAXCANNUM) morse_trap(27);       //return NULL;
 	if (mbxcannum[pctl->canidx].pctl == NULL) morse_trap(28); //return NULL;
+	if (mbxcannum[pctl->canidx].ptbl != NULL) morse_trap(38); // Module uses a compile time table
 
 	if (tskhandle == NULL)
 		tskhandle = xTaskGetCurrentTaskHandle();
 
 	/* Pointer to beginning of array of mailbox pointers. */
-	ppmbx = mbxcannum[pctl->canidx].pmbxarray;
+	ppmbx = &mbxptrs[pctl->canidx][0];
 
 taskENTER_CRITICAL();
 
 	/* We are working with the array of pointers to mailboxes. */
-	// Check if this 'canid' has a mailbox
-	for (j = 0; j < mbxcannum[pctl->canidx].arraysizecur; j++)
+	// Check if this 'canid' has a mailbox (binary search of the sorted array)
+	j = bsearchid(&mbxcannum[pctl->canidx], canid);
+	if (j >= 0)
 	{
 		pmbx = *(ppmbx+j);  // Get pointer to a mailbox from array of pointers
 		if (pmbx == NULL) morse_trap(23); // jic|debug
@@ -165,41 +381,13 @@ taskENTER_CRITICAL();
 		{ // Here, CAN id already has a mailbox, so a notification must be wanted by this task
 			if (notebit != 0)
 			{ // Here add a notification to the existing mailbox
+				if (noteadd(pmbx, tskhandle, notebit, noteskip) == NULL)
+					{taskEXIT_CRITICAL(); morse_trap(29);}//return NULL;}
 
-				/* Get a notification block. */
-				pnotex = (struct CANNOTIFYLIST*)calloc(1, sizeof(struct CANNOTIFYLIST));
-				if (pnotex == NULL){taskEXIT_CRITICAL(); morse_trap(29);}//return NULL;}
-
-				/* Check if this mailbox has any notifications */
-				if (pmbx->pnote == NULL)
-				{ // This is the first notification for this mailbox.
-					pmbx->pnote       = pnotex;   // Mailbox points to first notification
-					pnotex->pnext     = pnotex;	// Last on list points to self
-					pnotex->tskhandle = tskhandle;
- 					pnotex->notebit   = notebit;  // Notification bit to use
-					pnotex->skip      = noteskip; // Skip notification flag
-					/* Here, there is no need to sort array on CANID for a binary lookup
-						since a new mailbox was not added. */
-					taskEXIT_CRITICAL();
-					return pmbx;
-				}
-				else
-				{ // Here, one of more notifications.  Add to list.
-					/* Seach end of list */
-					pnotetmp = pmbx->pnote;
-					while (pnotetmp != pnotetmp->pnext) pnotetmp = pnotetmp->pnext;
-
-					/* Add to list and initialize. */
-					pnotetmp->pnext   = pnotex; // End block now points to new block
-					pnotex->pnext     = pnotex; // New block points to self
-					pnotex->tskhandle = tskhandle;
- 					pnotex->notebit   = notebit;  // Notification bit to use
-					pnotex->skip      = noteskip; // Skip notification flag
-					/* Here, there is no need to sort array on CANID for a binary lookup
-						since a new mailbox was not added. */
-					taskEXIT_CRITICAL();
-					return pmbx;
-				}
+				/* Here, there is no need to sort array on CANID for a binary lookup
+					since a new mailbox was not added. */
+				taskEXIT_CRITICAL();
+				return pmbx;
 			}
 			/* Here, no notification bit, but CAN id already has a mailbox!
             Either the canid is wrong, or this call was not necessary. */
@@ -212,51 +400,500 @@ taskENTER_CRITICAL();
 
       Create a mailbox for this canid                         */
 
-	// Point to next available location in array of mailbox pointers.
-   //                 pointer to beginning   + number of entries
-	ppmbx = mbxcannum[pctl->canidx].pmbxarray + mbxcannum[pctl->canidx].arraysizecur;
-
-
+	/* Create one mailbox (static pool) */
+	if (mbxpoolct >= MBXNUMMAX){taskEXIT_CRITICAL();morse_trap(33);}//return NULL;}
+	pmbx = &mbxpool[mbxpoolct];
+	mbxpoolct += 1;
 
-	/* Create one mailbox */
-	pmbx = (struct MAILBOXCAN*)calloc(1, sizeof(struct MAILBOXCAN));
-	if (pmbx == NULL){taskEXIT_CRITICAL();morse_trap(33);}//return NULL;}
-
-	pmbx->ctr          = 0;       // Redundant (calloc set it zero)
-	pmbx->pnote        = NULL;    // Redundant (calloc set it zero)
+	pmbx->ctr          = 0;       // Redundant (static is zero)
+	pmbx->pnote        = NULL;    // Redundant (static is zero)
+	pmbx->ppol         = NULL;    // Redundant (static is zero)
+	pmbx->notect       = 0;       // Redundant (static is zero)
 	pmbx->paytype      = paytype; // Payload layout code
 	pmbx->ncan.can.id  = canid;   // Save CAN id
 	pmbx->ncan.toa     = DTWTIME; // Set current time for initial time-of-arrival
 
 	if (notebit != 0)
 	{ // Here, a notification is requested.  Add first instance of notification  
-		pnotex = (struct CANNOTIFYLIST*)calloc(1, sizeof(struct CANNOTIFYLIST));
-		if (pnotex == NULL){ taskEXIT_CRITICAL();morse_trap(31);}//return NULL;}
-
-		pmbx->pnote       = pnotex;    // Mailbox points to first notification
-		pnotex->pnext     = pnotex;	 // Last on list points to self
-		pnotex->tskhandle = tskhandle; // Task to notify
-		pnotex->notebit   = notebit;   // Notification bit to use
-		pnotex->skip      = noteskip;  // Skip notification flag
+		if (noteadd(pmbx, tskhandle, notebit, noteskip) == NULL)
+			{ taskEXIT_CRITICAL();morse_trap(31);}//return NULL;}
 	} 
 
-	/* Save pointer to mailbox in array of pointers to mailboxes. */
-	*(mbxcannum[pctl->canidx].pmbxarray+mbxcannum[pctl->canidx].arraysizecur) = pmbx;
+	/* Insert pointer to mailbox in array of pointers to mailboxes, keeping the
+      array sorted on CAN id for the binary lookup. */
+	j = -j - 1; // Insert position returned by 'bsearchid'
+	pid = &mbxids[pctl->canidx][0];
+	for (i = mbxcannum[pctl->canidx].arraysizecur; i > j; i--)
+	{
+		*(ppmbx+i) = *(ppmbx+i-1);
+		*(pid+i)   = *(pid+i-1);
+	}
+	*(ppmbx+j) = pmbx;
+	*(pid+j)   = canid;
 
 	/* Advance current size of number of mailboxes for this CAN module. */
 	    mbxcannum[pctl->canidx].arraysizecur += 1;
 	if (mbxcannum[pctl->canidx].arraysizecur 
                              >=
 		 mbxcannum[pctl->canidx].arraysizemax)
-	{ // Here, the next addition will exceed size calloc'ed earlier!
+	{ // Here, the next addition will exceed the size given at init!
 		{taskEXIT_CRITICAL();morse_trap(31);} // Bozo programmer. We gotcha.
 	}
-// TODO: Sort pointers for new Mailbox if later binary lookup on CAN ID.
-
 taskEXIT_CRITICAL();
 	return pmbx;
 }
 
+/* *************************************************************************
+ * static struct CANNOTIFYLIST* noteadd(struct MAILBOXCAN* pmbx, osThreadId tskhandle, uint32_t notebit, uint8_t noteskip);
+ *	@brief	: Add a notification block to a mailbox, after its other blocks
+ * @param	: pmbx = pointer to mailbox
+ * @param	: tskhandle = task to notify
+ * @param	: notebit = notification bit
+ * @param	: noteskip = notify = 0; skip notification = 1;
+ * @return	: Pointer to block; NULL = 'notepool' full
+ * NOTE: Call in a critical section.  The blocks (and their 'notepol' policy
+ *       state) above the insert point move up one, and the mailboxes pointing
+ *       to them are adjusted.  Block pointers
+ *       already handed to tasks can't be: once one has been, a move traps.
+ * *************************************************************************/
+static struct CANNOTIFYLIST* noteadd(struct MAILBOXCAN* pmbx, osThreadId tskhandle, uint32_t notebit, uint8_t noteskip)
+{
+	struct CANNOTIFYLIST* pins;
+	struct MBXNOTEPOL* ppins;
+	int i;
+
+	if (notepoolct >= MBXNOTENUMMAX) return NULL;
+
+	if (pmbx->pnote == NULL)
+		pins = &notepool[notepoolct];        // First block: end of pool
+	else
+		pins = pmbx->pnote + pmbx->notect;   // After this mailbox's last block
+
+	/* Open a slot at 'pins' */
+	if ((pins != &notepool[notepoolct]) && (notefrozen != 0))
+	{ // A task's block pointer would then point at its neighbour's block
+		taskEXIT_CRITICAL(); morse_trap(39);
+	}
+	for (i = notepoolct; &notepool[i] > pins; i--)
+	{
+		notepool[i] = notepool[i - 1];
+		notepol[i]  = notepol[i - 1];
+	}
+	for (i = 0; i < mbxpoolct; i++)
+	{
+		if ((&mbxpool[i] != pmbx) && (mbxpool[i].pnote != NULL) && (mbxpool[i].pnote >= pins))
+		{
+			mbxpool[i].pnote += 1;
+			mbxpool[i].ppol  += 1;
+		}
+	}
+	notepoolct += 1;
+
+	pins->tskhandle = tskhandle; // Task to notify
+	pins->notebit   = notebit;   // Notification bit to use
+	pins->skip      = noteskip;  // Skip notification flag
+
+	ppins = &notepol[pins - &notepool[0]]; // Slot may hold a copy of the one moved up
+	ppins->policy   = MBXNOTEALWAYS;
+	ppins->primed   = 0;
+	ppins->param.u  = 0;
+	ppins->last.u   = 0;
+	ppins->tlast    = 0;
+	ppins->savect   = 0;
+
+	if (pmbx->pnote == NULL)
+	{
+		pmbx->pnote = pins;
+		pmbx->ppol  = ppins;
+	}
+	pmbx->notect += 1;
+	return pins;
+}
+/* *************************************************************************
+ * int MailboxTask_direct(struct CAN_CTLBLOCK* pctl, struct MAILBOXCAN* pmbx);
+ *	@brief	: Mark mailbox 'direct': loaded & notified in the CAN RX ISR (CANRXDIRECT)
+ * @param	: pctl = Pointer to CAN control block the mailbox was added with
+ * @param	: pmbx = pointer to mailbox (from 'MailboxTask_add')
+ * @return	: >= 0 = index into mbxcannum[].direct[]; -1 = table full; 
+ *          :   -2 = CANRXDIRECT not defined (mailbox stays with MailboxTask)
+ * *************************************************************************/
+int MailboxTask_direct(struct CAN_CTLBLOCK* pctl, struct MAILBOXCAN* pmbx)
+{
+#ifdef CANRXDIRECT
+	struct MAILBOXCANNUM* pmbxnum;
+	struct MBXDIRECT* pd;
+	int i;
+
+	if ((pctl == NULL) || (pctl->canidx >= STM32MAXCANNUM) || (pmbx == NULL)) return -1;
+	pmbxnum = &mbxcannum[pctl->canidx];
+
+taskENTER_CRITICAL(); // RX ISR must see a complete entry, and 'direct' set with it
+	for (i = 0; i < pmbxnum->directct; i++)
+	{
+		if (pmbxnum->direct[i].pmbx == pmbx) {taskEXIT_CRITICAL(); return i;}
+	}
+	if (pmbxnum->directct >= MBXDIRECTNUM) {taskEXIT_CRITICAL(); return -1;}
+
+	pd = &pmbxnum->direct[pmbxnum->directct];
+	pd->id     = pmbx->ncan.can.id;
+	pd->pmbx   = pmbx;
+	pd->ct     = 0;
+	pd->dtw    = 0;
+	pd->dtwmax = 0;
+	pmbx->direct = 1;              // MailboxTask skips it from now on
+	pmbxnum->directct += 1;
+	pctl->prxdirect = &rxdirect;
+taskEXIT_CRITICAL();
+	return i;
+#else
+	return -2;
+#endif
+}
+/* *************************************************************************
+ * static void mbxwrite(struct MAILBOXCAN* pmbx, struct CANRCVBUFN* pncan, uint32_t now);
+ *	@brief	: Update mailbox: msg, extracted readings, update count (seqlock writer),
+ *          : and arrival time, inter-arrival EWMA, stale
+ * @param	: pmbx = pointer to mailbox
+ * @param	: pncan = pointer to CAN msg
+ * @param	: now = FreeRTOS tick count
+ * NOTE: One writer per mailbox: MailboxTask, or the RX ISR if 'direct'.
+ * *************************************************************************/
+static void mbxwrite(struct MAILBOXCAN* pmbx, struct CANRCVBUFN* pncan, uint32_t now)
+{
+	uint32_t dt;
+
+	/* Differs from the previous msg (first msg, and back from stale, count as a change) */
+	pmbx->chg = (pmbx->arrct == 0) || (pmbx->stale != 0) ||
+	            (pmbx->ncan.can.dlc    != pncan->can.dlc) ||
+	            (pmbx->ncan.can.cd.ull != pncan->can.cd.ull);
+
+	pmbx->seq += 1; // Odd: update in progress
+	__DMB();        // 'seq' visible before the data changes
+
+	pmbx->ncan = *pncan; // Copy CAN msg to mailbox
+	payload_extract(pmbx);
+	if (pmbx->pnote != NULL)
+		pmbx->ctr += 1; // Count updates
+
+	__DMB();        // Data complete before 'seq' goes even
+	pmbx->seq += 1;
+
+	/* Arrival rate */
+	if (pmbx->arrct != 0)
+	{
+		dt = now - pmbx->tarr;
+		if (dt > pmbx->dtmax) pmbx->dtmax = dt;
+		if (pmbx->arrct == 1)
+			pmbx->dtewma = dt << MBXEWMASHIFT; // First interval
+		else
+			pmbx->dtewma += (int32_t)((dt << MBXEWMASHIFT) - pmbx->dtewma) >> MBXEWMAALPHA;
+	}
+	pmbx->arrct += 1;
+	pmbx->tarr   = now; // Deadline restarts
+	pmbx->stale  = 0;
+
+	/* History ring: 'histseq' first (the slot's old msg is going), entry 'seq' last */
+	if (pmbx->phist != NULL)
+	{
+		uint32_t hs = pmbx->histseq;
+		struct MBXHISTENTRY* ph = pmbx->phist + (hs & pmbx->histmask);
+		pmbx->histseq = hs + 1;
+		__DMB();
+		ph->ncan = *pncan;
+		__DMB();
+		ph->seq  = hs;
+	}
+	return;
+}
+/* *************************************************************************
+ * static void dlsiftdown(int i);
+ * static void dlsiftup(int i);
+ *	@brief	: Restore deadline heap order after dlheap[i].due increased, or was added
+ * *************************************************************************/
+static void dlsiftdown(int i)
+{
+	struct MBXDEADLINE tmp;
+	int c;
+
+	for (;;)
+	{
+		c = 2*i + 1; // Left child
+		if (c >= dlheapct) return;
+		if ((c + 1 < dlheapct) && ((int32_t)(dlheap[c+1].due - dlheap[c].due) < 0))
+			c += 1;  // Right child is earlier
+		if ((int32_t)(dlheap[c].due - dlheap[i].due) >= 0) return;
+		tmp = dlheap[i]; dlheap[i] = dlheap[c]; dlheap[c] = tmp;
+		i = c;
+	}
+}
+static void dlsiftup(int i)
+{
+	struct MBXDEADLINE tmp;
+	int p;
+
+	while (i > 0)
+	{
+		p = (i - 1) / 2; // Parent
+		if ((int32_t)(dlheap[i].due - dlheap[p].due) >= 0) return;
+		tmp = dlheap[i]; dlheap[i] = dlheap[p]; dlheap[p] = tmp;
+		i = p;
+	}
+	return;
+}
+/* *************************************************************************
+ * int MailboxTask_deadline(struct MAILBOXCAN* pmbx, uint32_t deadline, osThreadId tskhandle, uint32_t stalebit);
+ *	@brief	: Set a deadline: notify 'stalebit' when no msg arrived for 'deadline' ticks
+ * @param	: pmbx = pointer to mailbox
+ * @param	: deadline = ticks (> 0)
+ * @param	: tskhandle = Task handle; NULL = use current task
+ * @param	: stalebit = notification bit (repeated each 'deadline' ticks while stale)
+ * @return	: 0 = OK; -1 = deadline table full, bad 'deadline', or mailbox already has one
+ * *************************************************************************/
+int MailboxTask_deadline(struct MAILBOXCAN* pmbx, uint32_t deadline, osThreadId tskhandle, uint32_t stalebit)
+{
+	if ((pmbx == NULL) || (deadline == 0) || ((int32_t)deadline < 0)) return -1;
+	if (tskhandle == NULL)
+		tskhandle = xTaskGetCurrentTaskHandle();
+
+taskENTER_CRITICAL();
+	if ((dlheapct >= MBXDEADLINENUM) || (pmbx->deadline != 0)) {taskEXIT_CRITICAL(); return -1;}
+
+	pmbx->stalehandle = tskhandle;
+	pmbx->stalebit    = stalebit;
+	pmbx->stale       = 0;
+	pmbx->tarr        = xTaskGetTickCount(); // Deadline starts now
+	pmbx->deadline    = deadline;
+
+	dlheap[dlheapct].pmbx = pmbx;
+	dlheap[dlheapct].due  = pmbx->tarr + deadline;
+	dlheapct += 1;
+	dlsiftup(dlheapct - 1);
+taskEXIT_CRITICAL();
+
+	/* MailboxTask: recompute its wait for the earliest deadline */
+	if (MailboxTaskHandle != NULL)
+		xTaskNotify(MailboxTaskHandle, MBXNOTEBITDEADLINE, eSetBits);
+	return 0;
+}
+/* *************************************************************************
+ * static TickType_t dlsweep(void);
+ *	@brief	: Check deadlines that are due: stale, or arrival since (new due)
+ * @return	: Ticks until the next is due; portMAX_DELAY = no deadlines
+ * NOTE: Run by MailboxTask only.  Each mailbox is looked at when its due time is
+ *       reached, not on every pass; an arrival only writes 'tarr'.
+ *       'MailboxTask_deadline' adds to the heap from other tasks, so each step is
+ *       done in a critical section; the stale notification is sent after it.
+ * *************************************************************************/
+static TickType_t dlsweep(void)
+{
+	struct MBXDEADLINE* p = &dlheap[0];
+	struct MAILBOXCAN* pmbx;
+	osThreadId stalehandle;
+	uint32_t stalebit;
+	uint32_t now = xTaskGetTickCount();
+	uint32_t t;
+
+	for (;;)
+	{
+		stalehandle = NULL; stalebit = 0;
+taskENTER_CRITICAL();
+		if (dlheapct == 0)
+		{
+taskEXIT_CRITICAL();
+			return portMAX_DELAY;
+		}
+		if ((int32_t)(now - p->due) < 0)
+		{ // Earliest is not due yet
+			t = p->due - now;
+taskEXIT_CRITICAL();
+			return t;
+		}
+
+		pmbx = p->pmbx;
+		t = pmbx->tarr;
+		if ((int32_t)(now - (t + pmbx->deadline)) < 0)
+		{ // Here, arrival(s) since: move to the new due time
+			p->due = t + pmbx->deadline;
+		}
+		else
+		{ // Here, deadline missed
+			pmbx->stale = 1;
+			if (pmbx->tarr != t)
+			{ // Arrived meanwhile ('direct' mailbox, RX ISR)
+				pmbx->stale = 0;
+				p->due = pmbx->tarr + pmbx->deadline;
+			}
+			else
+			{
+				pmbx->stalect += 1;
+				stalehandle = pmbx->stalehandle;
+				stalebit    = pmbx->stalebit;
+				p->due = now + pmbx->deadline; // Again if still nothing
+			}
+		}
+		dlsiftdown(0);
+taskEXIT_CRITICAL();
+
+		if ((stalehandle != NULL) && (stalebit != 0))
+			xTaskNotify(stalehandle, stalebit, eSetBits);
+	}
+}
+/* *************************************************************************
+ * int MailboxTask_history(struct MAILBOXCAN* pmbx, uint16_t depth);
+ *	@brief	: Give a mailbox a history ring of the last 'depth' msgs
+ * @param	: pmbx = pointer to mailbox
+ * @param	: depth = number of msgs kept (power of two)
+ * @return	: 0 = OK; -1 = bad 'depth', already has one, or MBXHISTBUDGET used up
+ * *************************************************************************/
+int MailboxTask_history(struct MAILBOXCAN* pmbx, uint16_t depth)
+{
+	int i;
+
+	if ((pmbx == NULL) || (depth == 0) || ((depth & (depth - 1)) != 0)) return -1;
+
+taskENTER_CRITICAL(); // Writer (MailboxTask, or RX ISR) sees 'phist' last
+	if ((pmbx->phist != NULL) || ((histpoolct + depth) > MBXHISTBUDGET))
+		{taskEXIT_CRITICAL(); return -1;}
+
+	for (i = 0; i < depth; i++) // No entry matches a seq not yet written
+		histpool[histpoolct + i].seq = (uint32_t)(i - depth);
+	pmbx->histmask = depth - 1;
+	pmbx->histseq  = 0;
+	pmbx->phist    = &histpool[histpoolct];
+	histpoolct    += depth;
+taskEXIT_CRITICAL();
+	return 0;
+}
+/* *************************************************************************
+ * int MailboxTask_history_read(struct MAILBOXCAN* pmbx, uint32_t seqfrom, struct MBXHISTENTRY* pout, int max, uint32_t* pnext);
+ *	@brief	: Copy msgs from the history ring, oldest first, starting at 'seqfrom'
+ * @param	: pmbx = pointer to mailbox (with a history ring)
+ * @param	: seqfrom = sequence number of the first msg wanted (0 = all)
+ * @param	: pout = pointer to array receiving the msgs
+ * @param	: max = size of 'pout' array
+ * @param	: pnext = pointer to 'seqfrom' for the next call
+ * @return	: number of msgs copied; -1 = no history ring
+ * NOTE: No interrupt disable.  The writer advances 'histseq' before it reuses a
+ *       slot, and sets the entry 'seq' after the msg.  After each copy 'histseq'
+ *       is checked: if the slot was reused meanwhile, that msg is lost (left out),
+ *       as it would be if the reader had been later still.
+ * *************************************************************************/
+int MailboxTask_history_read(struct MAILBOXCAN* pmbx, uint32_t seqfrom, struct MBXHISTENTRY* pout, int max, uint32_t* pnext)
+{
+	struct MBXHISTENTRY* ph;
+	uint32_t head;
+	uint32_t s;
+	uint32_t t;
+	int n = 0;
+
+	if (pmbx->phist == NULL) return -1;
+
+	head = pmbx->histseq; // Next seq to be written
+	if ((int32_t)(head - seqfrom) < 0) seqfrom = head; // jic: 'seqfrom' from the future
+	if ((head - seqfrom) > (pmbx->histmask + 1))
+		seqfrom = head - (pmbx->histmask + 1); // Older ones are gone: start at the oldest
+
+	for (s = seqfrom; (s != head) && (n < max); s++)
+	{
+		ph = pmbx->phist + (s & pmbx->histmask);
+		t  = ph->seq;
+		if (t != s)
+		{
+			if ((int32_t)(t - s) < 0) break; // Not written yet (writer preempted)
+			continue; // Overwritten already
+		}
+		__DMB();
+		pout->ncan = ph->ncan;
+		__DMB();
+		if ((pmbx->histseq - s) > (pmbx->histmask + 1)) continue; // Overwritten during the copy
+		pout->seq = s;
+		pout += 1;
+		n    += 1;
+	}
+	*pnext = s;
+	return n;
+}
+/* *************************************************************************
+ * int MailboxTask_snapshot(struct MAILBOXCAN* pmbx, struct MAILBOXSNAP* psnap);
+ *	@brief	: Copy a mailbox's msg and readings, all from the same update
+ * @param	: pmbx = pointer to mailbox
+ * @param	: psnap = pointer to copy
+ * @return	: 0 = OK; -1 = update still in progress after MBXSNAPTRIES ('psnap' not valid)
+ * *************************************************************************/
+int MailboxTask_snapshot(struct MAILBOXCAN* pmbx, struct MAILBOXSNAP* psnap)
+{
+	uint32_t seq;
+	int i;
+
+	for (i = 0; i < MBXSNAPTRIES; i++)
+	{
+		seq = pmbx->seq;
+		if ((seq & 1) != 0) continue; // Writer is in the middle (we preempted it)
+		__DMB();
+
+		psnap->ncan = pmbx->ncan;
+		psnap->mbx  = pmbx->mbx;
+		psnap->ctr  = pmbx->ctr;
+
+		__DMB();
+		if (pmbx->seq == seq)
+		{ // No update during the copy
+			psnap->seq = seq;
+			return 0;
+		}
+	}
+	return -1;
+}
+#ifdef CANRXDIRECT
+/* *************************************************************************
+ * static void rxdirect(struct CAN_CTLBLOCK* pctl, struct CANRCVBUFN* pncan, BaseType_t* pwoken);
+ *	@brief	: CAN RX ISR: load & notify if msg is for a 'direct' mailbox
+ * @param	: pctl = Pointer to CAN control block
+ * @param	: pncan = pointer to msg just put on the ring
+ * @param	: pwoken = pointer to ISR's xHigherPriorityTaskWoken
+ * NOTE: Cost: a compare for each 'direct' mailbox, and for the one that matches, the
+ *       copy, 'payload_extract' (byte copies) and one notify per notification block.
+ * *************************************************************************/
+static void rxdirect(struct CAN_CTLBLOCK* pctl, struct CANRCVBUFN* pncan, BaseType_t* pwoken)
+{
+	struct MAILBOXCANNUM* pmbxnum = &mbxcannum[pctl->canidx];
+	struct MBXDIRECT* pd   = &pmbxnum->direct[0];
+	struct MBXDIRECT* pend = &pmbxnum->direct[pmbxnum->directct];
+	struct MAILBOXCAN* pmbx;
+	struct CANNOTIFYLIST* pnotetmp;	
+	struct CANNOTIFYLIST* pnoteend;
+	struct MBXNOTEPOL* ppol;
+	uint32_t dtw = DTWTIME;
+	uint32_t now;
+
+	for ( ; pd < pend; pd++)
+	{
+		if (pd->id != pncan->can.id) continue;
+
+		/* Same as 'loadmbx', but from the ISR */
+		pmbx = pd->pmbx;
+		now  = xTaskGetTickCountFromISR();
+		mbxwrite(pmbx, pncan, now);
+		pnotetmp = pmbx->pnote;
+		if (pnotetmp != NULL)
+		{
+			pnoteend = pnotetmp + pmbx->notect;
+			ppol     = pmbx->ppol;
+			for ( ; pnotetmp < pnoteend; pnotetmp++, ppol++)
+			{
+				if ((pnotetmp->skip == 0) && (pnotetmp->tskhandle != NULL) && (pnotetmp->notebit != 0) &&
+				    (notepass(pmbx, ppol, now) != 0))
+					xTaskNotifyFromISR(pnotetmp->tskhandle, pnotetmp->notebit, eSetBits, pwoken);
+			}
+		}
+		pd->ct  += 1;
+		pd->dtw  = DTWTIME - dtw;
+		if (pd->dtw > pd->dtwmax) pd->dtwmax = pd->dtw;
+		return;
+	}
+	return;
+}
+#endif
 /* *************************************************************************
  * osThreadId xMailboxTaskCreate(uint32_t taskpriority);
  * @brief	: Create task; task handle created is global for all to enjoy!
@@ -273,6 +910,25 @@ osThreadId xMailboxTaskCreate(uint32_t taskpriority)
 	vTaskPrioritySet( MailboxTaskHandle, taskpriority );
 	return MailboxTaskHandle;
 }
+/* *************************************************************************
+ * static void drainhipri(void);
+ *	@brief	: Load mailboxes from all FIFO 1 (high priority) rings
+ * *************************************************************************/
+static void drainhipri(void)
+{
+#ifdef CANRXFIFO1HIPRI
+	struct CANRCVBUFN* pncan;
+	int i;
+
+	for (i = 0; i < STM32MAXCANNUM; i++)
+	{
+		if (mbxcannum[i].ptake1 == NULL) continue;
+		while ((pncan = can_iface_get_CANmsg(mbxcannum[i].ptake1)) != NULL)
+			loadmbx(&mbxcannum[i], pncan);
+	}
+#endif
+	return;
+}
 /* *************************************************************************
  * void StartMailboxTask(void const * argument);
  *	@brief	: Task startup
@@ -303,14 +959,26 @@ void StartMailboxTask(void const * argument)
 	/* notification bits processed after a 'Wait. */
 	uint32_t noteused = 0;
 
+	/* Ticks until the next mailbox deadline is due */
+	TickType_t dlwait;
+
   /* Infinite MailboxTask loop */
   for(;;)
   {
+		/* Mailbox deadlines: check those due, and get time to the next. */
+		dlwait = dlsweep();
+
 		/* Wait for a CAN module to load its circular buffer. */
 		/* The notification bit identifies the CAN module. */
-		xTaskNotifyWait(noteused, 0, &noteval, portMAX_DELAY);
+		// Bits are cleared on exit, so a msg added after the rings were drained
+		// below leaves its bit set for the next 'Wait'.
+		if (xTaskNotifyWait(0, 0xffffffff, &noteval, dlwait) != pdTRUE)
+			noteval = 0; // Timed out: deadline due
 		noteused = 0;	// Accumulate bits in 'noteval' processed.
 
+		/* High priority (FIFO 1) rings first. */
+		drainhipri();
+
 		/* Step through possible notification bits */
 		for (i = 0; i < STM32MAXCANNUM; i++)
 		{
@@ -322,6 +990,9 @@ void StartMailboxTask(void const * argument)
 if (pmbxnum == NULL) morse_trap(77); // Debug trap
 				do
 				{
+					/* Take any high priority msgs that arrived meanwhile. */
+					drainhipri();
+
 					/* Get a pointer to the circular buffer w CAN msgs. */
 					pncan = can_iface_get_CANmsg(pmbxnum->ptake);
 
@@ -343,29 +1014,55 @@ if (pmbxnum == NULL) morse_trap(77); // Debug trap
 		}
   }
 }
+/* *************************************************************************
+ * static int bsearchid(struct MAILBOXCANNUM* pmbxnum, uint32_t canid);
+ *	@brief	: Binary search of the CAN id array (sorted; same order as 'pmbxarray')
+ * @param	: pmbxnum = pointer to mailbox control block
+ * @param	: canid = CAN id
+ * @return	: >= 0 = index of mailbox with 'canid';
+ *          :  < 0 = not found: -(index where 'canid' would be inserted) - 1
+ * *************************************************************************/
+static int bsearchid(struct MAILBOXCANNUM* pmbxnum, uint32_t canid)
+{
+	const uint32_t* pid = pmbxnum->pidarray;
+	uint32_t id;
+	int lo = 0;
+	int hi = (int)pmbxnum->arraysizecur - 1;
+	int mid;
+
+	while (lo <= hi)
+	{
+		mid = (lo + hi) >> 1;
+		id  = *(pid + mid);
+		if (id == canid) return mid; // Found!
+		if (id <  canid)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return -lo - 1;
+}
 /* *************************************************************************
  * static struct MAILBOXCAN* lookup(struct MAILBOXCANNUM* pmbxnum, struct CANRCVBUFN* pncan);
- *	@brief	: (Bonehead) Lookup CAN ID by a straight pass down the array of mailbox pointers
+ *	@brief	: Lookup CAN ID: binary search of the sorted array of mailbox pointers
  * @param	: pmbxnum = pointer to mailbox control block
  * @param	: pncan = pointer to CAN msg in can_face.c circular buffer
+ * NOTE: 'MailboxTask_add' shifts the array when it inserts.  Mailboxes are added
+ *       by tasks at lower priority than MailboxTask, so a lookup never sees a
+ *       half shifted array.
  * *************************************************************************/
 static struct MAILBOXCAN* lookup(struct MAILBOXCANNUM* pmbxnum, struct CANRCVBUFN* pncan)
 {
-	struct MAILBOXCAN** ppmbx;
-	struct MAILBOXCAN*   pmbx;
+	struct MAILBOXCAN* pmbx;
 	int i;
 
-	ppmbx = pmbxnum->pmbxarray;
-	for (i = 0; i < pmbxnum->arraysizecur; i++)
-	{
-		pmbx = *(ppmbx + i); // Point to mailbox[i]
-		if (pmbx->ncan.can.id == pncan->can.id)
-		{ // Here, found!
-			pmbx->ncan = *pncan; // Copy CAN msg to mailbox
-			return pmbx;
-		}
-	}
-	return NULL;
+	i = bsearchid(pmbxnum, pncan->can.id);
+	if (i < 0) return NULL; // Not in list
+
+	pmbx = *(pmbxnum->pmbxarray + i);
+	if (pmbx->direct != 0) return NULL; // RX ISR already loaded & notified
+
+	return pmbx;
 }
 
 /* ************************************************************************* 
@@ -379,39 +1076,37 @@ uint32_t dbgmbxctr;
 static struct MAILBOXCAN* loadmbx(struct MAILBOXCANNUM* pmbxnum, struct CANRCVBUFN* pncan)
 {
 	struct CANNOTIFYLIST* pnotetmp;	
-	struct CANNOTIFYLIST* pnotex;
-	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	struct CANNOTIFYLIST* pnoteend;
+	struct MBXNOTEPOL* ppol;
+	uint32_t now = xTaskGetTickCount();
 
 	/* Check if received CAN id is in the mailbox CAN id list. */
-	// 'lookup' is a straight loop; use 'lookupq' for binary search (when implemented)
+	// 'lookup' is a binary search: cost ~log2(number of mailboxes)
 	struct MAILBOXCAN* pmbx = lookup(pmbxnum, pncan);
 	if (pmbx == NULL) return NULL; // Return: CAN id not in mailbox list
 
 	/* Here, this CAN msg has a mailbox. */
-	// Extract payload (above 'lookup' copied ncan into mailbox)
-	payload_extract(pmbx);
+	// Copy msg, extract payload, count (readers: 'MailboxTask_snapshot')
+	pnotetmp = pmbx->pnote; // Get ptr to first block
+	mbxwrite(pmbx, pncan, now);
 
 	/* Execute notifications */
-	pnotetmp = pmbx->pnote; // Get ptr to head of linked list
 	if (pnotetmp == NULL) return pmbx; // CANID found, but no notifications
-
-	pmbx->ctr += 1; // Count updates
 	
-	// Traverse linked list making notifications
-	do 
+	// Step through this mailbox's (contiguous) blocks making notifications
+	pnoteend = pnotetmp + pmbx->notect;
+	ppol     = pmbx->ppol; // Policy state: same index as the block
+	for ( ; pnotetmp < pnoteend; pnotetmp++, ppol++)
 	{
-		/* Make a notification if "not skip" and 'taskhandle and 'notebit' were setup */
-		if ((pnotetmp->skip == 0) && (pnotetmp->tskhandle != NULL) && (pnotetmp->notebit != 0))
+		/* Make a notification if "not skip" and 'taskhandle and 'notebit' were setup,
+		   and the block's policy passes this msg (MBXNOTExxxx) */
+		if ((pnotetmp->skip == 0) && (pnotetmp->tskhandle != NULL) && (pnotetmp->notebit != 0) &&
+		    (notepass(pmbx, ppol, now) != 0))
 		{
 dbgmbxctr += 1;
 			xTaskNotify(pnotetmp->tskhandle, pnotetmp->notebit, eSetBits);	
 		}
-
-		/* Step to next item in list. */
-			pnotex   = pnotetmp;
-			pnotetmp = pnotetmp->pnext;
-
-	} while (pnotetmp != pnotex);
+	}
 
 	return pmbx;
 }
@@ -17,21 +17,61 @@
 
 #define STM32MAXCANNUM 1	// F103 only has one CAN module
 
+/* Mailboxes and notifications are static arrays (no calloc). */
+#define MBXNUMMAX      32 // Max number of mailboxes (per CAN module, and total)
+#define MBXNOTENUMMAX  48 // Max number of notifications (all mailboxes)
+#define MBXDIRECTNUM    4 // Max number of 'direct' mailboxes (per CAN module)
+#define MBXSNAPTRIES    8 // 'MailboxTask_snapshot' attempts before giving up
+#define MBXDEADLINENUM  8 // Max number of mailboxes with a deadline (all CAN modules)
+#define MBXHISTBUDGET  32 // History ring entries, all mailboxes (MailboxTask_history)
+#define MBXEWMASHIFT    4 // Inter-arrival EWMA: ticks scaled by 1 << MBXEWMASHIFT
+#define MBXEWMAALPHA    3 // EWMA weight of a new interval: 1/(1 << MBXEWMAALPHA)
+
 /* Notification bit assignments for 'MailboxTask' */
 // The first three notification bits are reserved for CAN modules 
 #define MBXNOTEBITCAN1 (1 << 0)	// Notification bit for CAN1 msgs
 #define MBXNOTEBITCAN2 (1 << 1)	// Notification bit for CAN2 msgs
 #define MBXNOTEBITCAN3 (1 << 2)	// Notification bit for CAN3 msgs
+// The next three are for the CAN module FIFO 1 (high priority) rings (CANRXFIFO1HIPRI)
+#define MBXNOTEBITHIPRI(canidx) (1 << ((canidx) + 3))
+// Deadline added: recompute the wait for the next deadline
+#define MBXNOTEBITDEADLINE (1 << 6)
+
+/* Notification policy: when a msg arrival notifies the task ('policy' below) */
+#define MBXNOTEALWAYS    0 // Every msg (default)
+#define MBXNOTECHANGE    1 // Payload or dlc differs from the previous msg, or mailbox was stale
+#define MBXNOTEDBFF      2 // Reading u.f[0] (FF types) moved more than 'param.f' since last notify
+#define MBXNOTEDBU32     3 // Reading u.i32[0] (U32 types) moved more than 'param.u' since last notify
+#define MBXNOTERATE      4 // At most one notify each 'param.u' ticks
+
+/* Deadband, interval, or last notified reading, of a notification block */
+union MBXNOTEVAL
+{
+	float    f;
+	uint32_t u;
+};
 
-/* Notification block for linked list */
+/* Notification block: one per task notified by a mailbox.  The blocks of a
+   mailbox are contiguous ('pnote'[0] to 'pnote'[notect-1]).  Only what each
+   msg's notify loop reads is here; the policy state is in 'ppol'[] (below). */
 struct CANNOTIFYLIST
 {
-	struct CANNOTIFYLIST* pnext; // Points to next; Last points to self
 	osThreadId tskhandle;        // Task handle (usually 'MailboxTask')
 	uint32_t   notebit;          // Notification bit within task
 	uint8_t skip;                // 0 = notifications enabled; 1 = skip notification
 };
 
+/* Notification policy state: 'ppol'[k] goes with 'pnote'[k] */
+struct MBXNOTEPOL
+{
+	union MBXNOTEVAL param;      // Policy deadband, or interval (ticks)
+	union MBXNOTEVAL last;       // Reading at last notify (deadband policies)
+	uint32_t tlast;              // Tick count at last notify (MBXNOTERATE)
+	uint32_t savect;             // Count: notifications not made because of 'policy'
+	uint8_t policy;              // Notification policy: MBXNOTExxxx
+	uint8_t primed;              // 0 = no notify yet under 'policy' (first msg notifies)
+};
+
 /* Combine variable types for payload readings */
 union MAILBOXVALUES
 {
@@ -51,32 +91,100 @@ struct MAILBOXREADINGS
 	uint8_t pre8[4];
 };
 
+/* History ring entry (MailboxTask_history) */
+struct MBXHISTENTRY
+{
+	volatile uint32_t seq;       // History sequence number of this msg
+	struct CANRCVBUFN ncan;      // CAN msg plus DTW
+};
+
 /* CAN readings mailbox */
 struct MAILBOXCAN
 {
 	struct CANRCVBUFN ncan;      // CAN msg plus DTW and CAN control block pointer (pctl)
 	struct MAILBOXREADINGS mbx;  // Readings extracted from CAN msg
-	struct CANNOTIFYLIST* pnote; // Pointer to notification block; NULL = none 
+	struct CANNOTIFYLIST* pnote; // Pointer to first notification block; NULL = none 
+	struct MBXNOTEPOL* ppol;     // Policy state of each 'pnote' block (same index)
 	uint32_t ctr;                // Update counter (increment each update)
 	uint8_t paytype;             // Code for payload type
+	uint8_t notect;              // Number of notification blocks at 'pnote'
+	uint8_t direct;              // 1 = loaded & notified in the CAN RX ISR (CANRXDIRECT)
+	volatile uint32_t seq;       // Update sequence: odd = update in progress (seqlock)
+
+	/* Arrivals (FreeRTOS ticks) */
+	volatile uint32_t tarr;      // Tick count at last arrival (or when deadline was set)
+	uint32_t arrct;              // Count: arrivals
+	uint32_t dtewma;             // Inter-arrival EWMA (ticks << MBXEWMASHIFT)
+	uint32_t dtmax;              // Max inter-arrival (ticks)
+
+	/* Deadline (MailboxTask_deadline) */
+	uint32_t deadline;           // Stale after this many ticks without an arrival; 0 = none
+	osThreadId stalehandle;      // Task to notify when stale
+	uint32_t stalebit;           // Notification bit for stale
+	uint32_t stalect;            // Count: deadlines missed
+	volatile uint8_t stale;      // 1 = deadline missed, and no arrival since
+	uint8_t chg;                 // 1 = last msg differs from the one before (MBXNOTECHANGE)
+
+	/* History ring (MailboxTask_history); NULL 'phist' = none */
+	struct MBXHISTENTRY* phist;  // Ring: 'histmask' + 1 entries
+	uint32_t histmask;           // Ring size - 1 (size is a power of two)
+	volatile uint32_t histseq;   // Sequence number of the next msg (count of msgs added)
+};
+
+/* Consistent copy of a mailbox (MailboxTask_snapshot) */
+struct MAILBOXSNAP
+{
+	struct CANRCVBUFN ncan;      // CAN msg plus DTW
+	struct MAILBOXREADINGS mbx;  // Readings extracted from CAN msg
+	uint32_t ctr;                // Update counter
+	uint32_t seq;                // Mailbox 'seq' of this copy (even)
+};
+
+/* 'direct' mailbox: the CAN RX ISR loads it and makes the notifications */
+struct MBXDIRECT
+{
+	uint32_t id;             // CAN id
+	struct MAILBOXCAN* pmbx; // Mailbox
+	uint32_t ct;             // Count: msgs dispatched in the ISR
+	uint32_t dtw;            // DTW ticks: last dispatch (copy, extract, notify)
+	uint32_t dtwmax;         // DTW ticks: max dispatch
+};
+
+/* Mailbox list built at compile time (canmap_gen.c output; MailboxTask_add_table) */
+struct MBXTABLE
+{
+	struct MAILBOXCAN* const* pmbxarray; // Mailbox pointers, sorted on CAN id
+	const uint32_t* pidarray;      // CAN ids (same order as 'pmbxarray')
+	struct CANNOTIFYLIST* pnote;   // Notification blocks of all mailboxes, in order
+	struct MBXNOTEPOL* ppol;       // Policy state of each 'pnote' block
+	osThreadId* const* ptask;      // Task handle of each 'pnote' block; NULL = current task
+	const uint8_t* pdirect;        // 'pmbxarray' index of each 'direct' mailbox
+	uint16_t nmbx;                 // Number of mailboxes
+	uint16_t nnote;                // Number of notification blocks
+	uint8_t ndirect;               // Number of 'direct' mailboxes
 };
 
 /* One of these for each CAN module. */
 struct MAILBOXCANNUM
 {
 	struct CAN_CTLBLOCK* pctl;     // CAN control block pointer associated with this mailbox list
-	struct MAILBOXCAN** pmbxarray; // Point to sorted mailbox pointer array[0]
+	struct MAILBOXCAN* const* pmbxarray; // Point to sorted mailbox pointer array[0]
+	const uint32_t* pidarray;      // Point to CAN id array[0] (same order as 'pmbxarray')
+	const struct MBXTABLE* ptbl;   // Compile time table in use; NULL = 'MailboxTask_add' list
 	struct CANTAKEPTR* ptake;      // "Take" pointer for can_iface circular buffer
+	struct CANTAKEPTR* ptake1;     // "Take" pointer for FIFO 1 (high priority) ring; NULL = none
 	uint32_t notebit;              // Notification bit for this CAN module circular buffer
-	uint16_t arraysizemax;         // Mailbox pointer array size that was calloc'd  
+	uint16_t arraysizemax;         // Mailbox pointer array size in use (<= MBXNUMMAX)
 	uint16_t arraysizecur;         // Mailbox pointer array populated count
+	struct MBXDIRECT direct[MBXDIRECTNUM]; // 'direct' mailboxes (searched in the RX ISR)
+	uint8_t directct;              // Number of 'direct' in use
 };
 
 /* *************************************************************************/
 struct MAILBOXCANNUM* MailboxTask_add_CANlist(struct CAN_CTLBLOCK* pctl, uint16_t arraysize);
 /*	@brief	: Add CAN module mailbox list, given CAN control block ptr, and other stuff
  * @param	: pctl = Pointer to CAN control block
- * @param	: arraysize = max number of mailboxes in sorted list
+ * @param	: arraysize = max number of mailboxes in sorted list (<= MBXNUMMAX)
  * @return	: Pointer which probably will not be used; NULL = failed (more important)
  * NOTE: This is normally called in 'main' before the FreeRTOS scheduler starts.
  * *************************************************************************/
@@ -94,6 +202,67 @@ struct MAILBOXCAN* MailboxTask_add(struct CAN_CTLBLOCK* pctl,\
  * @paran	: noteskip = notify = 0; skip notification = 1;
  * @param	: paytype = payload type code (see 'PAYLOAD_TYPE_INSERT.sql' in 'GliderWinchCommons/embed/svn_common/db')
  * @return	: Pointer to mailbox; NULL = failed
+ * NOTE: A notification added to a mailbox that is not the last one given one moves
+ *       the blocks after it.  After a block pointer has been handed out (the
+ *       'notifications' and 'notify' calls below) that traps: morse_trap(39).
+ *       Add all mailboxes and notifications before setting policies.
+ * *************************************************************************/
+struct MAILBOXCANNUM* MailboxTask_add_table(struct CAN_CTLBLOCK* pctl, const struct MBXTABLE* ptbl);
+/*	@brief	: Use a compile time mailbox list (e.g. generated 'canmap_tbl') for a CAN module
+ * @param	: pctl = Pointer to CAN control block (after 'MailboxTask_add_CANlist')
+ * @param	: ptbl = pointer to table
+ * @return	: Pointer to CAN module mailbox list (traps on error)
+ * NOTE: In place of 'MailboxTask_add' for the module: no pool use, no sorting.  Fills
+ *       in the task handles and makes the 'direct' entries.  Notification policies,
+ *       deadlines and history rings are added to the table mailboxes as usual.
+ * *************************************************************************/
+int MailboxTask_direct(struct CAN_CTLBLOCK* pctl, struct MAILBOXCAN* pmbx);
+/*	@brief	: Mark mailbox 'direct': loaded & notified in the CAN RX ISR (CANRXDIRECT)
+ * @param	: pctl = Pointer to CAN control block the mailbox was added with
+ * @param	: pmbx = pointer to mailbox (from 'MailboxTask_add')
+ * @return	: >= 0 = index into mbxcannum[].direct[]; -1 = table full; 
+ *          :   -2 = CANRXDIRECT not defined (mailbox stays with MailboxTask)
+ * NOTE: Each msg costs the RX ISR a compare per 'direct' mailbox; keep it to the ids
+ *       where the MailboxTask pass matters (commands, keep-alive).
+ * *************************************************************************/
+int MailboxTask_snapshot(struct MAILBOXCAN* pmbx, struct MAILBOXSNAP* psnap);
+/*	@brief	: Copy a mailbox's msg and readings, all from the same update
+ * @param	: pmbx = pointer to mailbox
+ * @param	: psnap = pointer to copy
+ * @return	: 0 = OK; -1 = update still in progress after MBXSNAPTRIES ('psnap' not valid)
+ * NOTE: No interrupt disable.  If an update lands during the copy, copy again.  A
+ *       reader at higher priority than the writer (MailboxTask, or the RX ISR for
+ *       'direct' mailboxes) cannot wait for it to finish, hence the -1.
+ * *************************************************************************/
+int MailboxTask_history(struct MAILBOXCAN* pmbx, uint16_t depth);
+/*	@brief	: Give a mailbox a history ring of the last 'depth' msgs
+ * @param	: pmbx = pointer to mailbox
+ * @param	: depth = number of msgs kept (power of two)
+ * @return	: 0 = OK; -1 = bad 'depth', already has one, or MBXHISTBUDGET used up
+ * NOTE: Call at registration (after 'MailboxTask_add').
+ * *************************************************************************/
+int MailboxTask_history_read(struct MAILBOXCAN* pmbx, uint32_t seqfrom, struct MBXHISTENTRY* pout, int max, uint32_t* pnext);
+/*	@brief	: Copy msgs from the history ring, oldest first, starting at 'seqfrom'
+ * @param	: pmbx = pointer to mailbox (with a history ring)
+ * @param	: seqfrom = sequence number of the first msg wanted (0 = all)
+ * @param	: pout = pointer to array receiving the msgs
+ * @param	: max = size of 'pout' array
+ * @param	: pnext = pointer to 'seqfrom' for the next call
+ * @return	: number of msgs copied; -1 = no history ring
+ * NOTE: Msgs overwritten before they were read are lost: their sequence numbers are
+ *       missing from 'pout[].seq' (gap after 'seqfrom').  A consumer can wake at a
+ *       lower rate (e.g. 'MailboxTask_notify_ratelimit') and read the batch.
+ * *************************************************************************/
+int MailboxTask_deadline(struct MAILBOXCAN* pmbx, uint32_t deadline, osThreadId tskhandle, uint32_t stalebit);
+/*	@brief	: Set a deadline: notify 'stalebit' when no msg arrived for 'deadline' ticks
+ * @param	: pmbx = pointer to mailbox
+ * @param	: deadline = ticks (> 0)
+ * @param	: tskhandle = Task handle; NULL = use current task
+ * @param	: stalebit = notification bit (repeated each 'deadline' ticks while stale)
+ * @return	: 0 = OK; -1 = deadline table full, bad 'deadline', or mailbox already has one
+ * NOTE: The deadline starts now.  'pmbx->stale' is set when it is missed and cleared
+ *       by the next arrival.  One sweep in MailboxTask checks all deadlines: only the
+ *       earliest is looked at until it is due (min-heap on due time).
  * *************************************************************************/
 osThreadId xMailboxTaskCreate(uint32_t taskpriority);
 /* @brief	: Create task; task handle created is global for all to enjoy!
@@ -108,6 +277,24 @@ struct CANNOTIFYLIST* MailboxTask_enable_notifications (struct MAILBOXCAN* pmbx)
 /*	@brief	: Disable, enable mailbox notifications
  * @param	: pmbx = pointer to mailbox
  * @return	: Pointer to notification block, for calling task; NULL = task not found
+ *          :  (stays valid: later adds that would move it trap, see 'MailboxTask_add')
+ * *************************************************************************/
+struct CANNOTIFYLIST* MailboxTask_notify_always     (struct MAILBOXCAN* pmbx);
+struct CANNOTIFYLIST* MailboxTask_notify_onchange   (struct MAILBOXCAN* pmbx);
+struct CANNOTIFYLIST* MailboxTask_notify_deadband_ff (struct MAILBOXCAN* pmbx, float deadband);
+struct CANNOTIFYLIST* MailboxTask_notify_deadband_u32(struct MAILBOXCAN* pmbx, uint32_t deadband);
+struct CANNOTIFYLIST* MailboxTask_notify_ratelimit  (struct MAILBOXCAN* pmbx, uint32_t ms);
+uint32_t MailboxTask_notify_savect(void);
+/*	@brief	: Set the notification policy of the calling task's block (see MBXNOTExxxx);
+ *          : savect: total of all blocks' 'savect' (wakeups saved)
+ * @param	: pmbx = pointer to mailbox
+ * @param	: deadband = notify when the reading moved more than this since the last notify
+ * @param	: ms = minimum time between notifications
+ * @return	: Pointer to notification block, for calling task; NULL = task not found
+ *          :  (stays valid: later adds that would move it trap, see 'MailboxTask_add')
+ * NOTE: The mailbox always has the latest msg; a policy only drops wakeups.  With
+ *       'deadband' or 'ratelimit' the last msgs of a burst may not notify until
+ *       the next msg that passes.  Use 'MailboxTask_deadline' to see silence.
  * *************************************************************************/
 
 extern osThreadId MailboxTaskHandle;
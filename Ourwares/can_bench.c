@@ -0,0 +1,120 @@
+/******************************************************************************
+* File Name          : can_bench.c
+* Date First Issued  : 10/17/2026
+* Description        : CAN driver bench: loopback load generator (bench build only)
+*******************************************************************************/
+/*
+Exercises the unmodified CAN driver (can_iface, CanTask, MailboxTask) on the board
+without a bus: bxCAN loopback mode (LBKM) sends each msg to its own RX and ignores
+the missing ACK.  The tick hook offers 'loadpct' % of the bit rate as std id, dlc 8
+msgs, round robin over CANBENCHNID ids, so the three TX mailboxes always have a mix
+of priorities to choose from.
+
+What comes out (main.c SHOW lines, or the CANTXLATSTATS command):
+ - msgs/sec TX complete and RX, each 1 s (canbench.txps, .rxps)
+ - per id (priority) worst case queue wait and mailbox->complete (CANTXLATENCY qmax,
+   wmax and histograms)
+ - RX FIFO overruns (can_errors.can_rx0err/rx1err), TX pool full (canbench.failct)
+ - bus load (CANBUSLOAD), RX ISR drain histogram
+
+Loopback is one node: arbitration against other nodes, ALST and TERR are not
+exercised.
+*/
+#include "can_bench.h"
+#include "DTW_counter.h"
+
+#ifdef CANBENCH
+
+#ifndef CANTXLATENCY
+  #error CANBENCH uses the CANTXLATENCY stats (can_iface.h)
+#endif
+
+struct CANBENCHW canbench;
+
+static uint8_t latidx[CANBENCHNID]; // Index into pctl->ptxlat[] of each bench id
+
+/* *************************************************************************
+ * int can_bench_init(struct CAN_CTLBLOCK* pctl, uint8_t loadpct);
+ * @brief	: Loopback mode, TX latency stats for the bench ids, start offering load
+ * @param	: pctl    = pointer to CAN control block (from can_iface_init)
+ * @param	: loadpct = offered load (% of the bus bit rate)
+ * @return	: 0 = OK; -1 = CAN not in init mode (call before HAL_CAN_Start);
+ *          : -2 = TX latency stats table full or calloc failed
+ * *************************************************************************/
+int can_bench_init(struct CAN_CTLBLOCK* pctl, uint8_t loadpct)
+{
+	CAN_TypeDef* pcan = pctl->phcan->Instance;
+	uint32_t btr;
+	int ret;
+	int i;
+
+	/* BTR can only be written in init mode. */
+	if ((pcan->MSR & CAN_MSR_INAK) == 0) return -1;
+	pcan->BTR |= CAN_BTR_LBKM;
+
+	btr = pcan->BTR;
+	canbench.bitrate = HAL_RCC_GetPCLK1Freq() /
+	   (((btr & 0x3ff) + 1) * (3 + ((btr >> 16) & 0xf) + ((btr >> 20) & 0x7)));
+
+	for (i = 0; i < CANBENCHNID; i++)
+	{
+		ret = can_iface_txlat_add(pctl, CANBENCHID0 + i * CANBENCHIDSTEP);
+		if (ret < 0) return -2;
+		latidx[i] = ret;
+	}
+
+	canbench.txprev  = 0;
+	canbench.rxprev  = pctl->cirptrs.addseq;
+	canbench.loadpct = loadpct;
+	canbench.pctl    = pctl; // Tick hook starts with this
+	return 0;
+}
+/* *************************************************************************
+ * void can_bench_tick(void);
+ * @brief	: Put the offered load for this tick; msgs/sec each 1 s
+ * NOTE: Call from 'vApplicationTickHook' (FreeRTOS tick interrupt)
+ * *************************************************************************/
+void can_bench_tick(void)
+{
+	struct CANBENCHW* pb = &canbench;
+	struct CANRCVBUF can;
+	uint32_t tx;
+	int i;
+
+	if (pb->pctl == NULL) return;
+
+	/* Offered bits this tick; put whole msgs, carry the rest. */
+	pb->credit += ((pb->bitrate / 100) * pb->loadpct) / configTICK_RATE_HZ;
+	can.dlc = 8;
+	while (pb->credit >= CANBENCHFRAMEBITS)
+	{
+		can.id = CANBENCHID0 + pb->idx * CANBENCHIDSTEP;
+		can.cd.ui[0] = pb->seq;
+		can.cd.ui[1] = DTWTIME;
+		if (can_driver_put(pb->pctl, &can, 4, 0) != CANPUT_OK)
+		{ // TX pool full: offered load is above what the driver keeps up with
+			pb->failct += 1;
+			pb->credit  = 0; // Don't build an unbounded backlog
+			break;
+		}
+		pb->credit -= CANBENCHFRAMEBITS;
+		pb->putct  += 1;
+		pb->seq    += 1;
+		pb->idx    += 1; if (pb->idx >= CANBENCHNID) pb->idx = 0;
+	}
+
+	pb->ticks += 1;
+	if (pb->ticks < configTICK_RATE_HZ) return;
+	pb->ticks = 0;
+
+	/* Msgs/sec over the last second */
+	tx = 0;
+	for (i = 0; i < CANBENCHNID; i++)
+		tx += pb->pctl->ptxlat[latidx[i]]->txct;
+	pb->txps   = tx - pb->txprev;
+	pb->txprev = tx;
+	pb->rxps   = pb->pctl->cirptrs.addseq - pb->rxprev;
+	pb->rxprev = pb->pctl->cirptrs.addseq;
+	return;
+}
+#endif
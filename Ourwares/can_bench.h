@@ -0,0 +1,59 @@
+/******************************************************************************
+* File Name          : can_bench.h
+* Date First Issued  : 10/17/2026
+* Description        : CAN driver bench: loopback load generator (bench build only)
+*******************************************************************************/
+
+#ifndef __CAN_BENCH
+#define __CAN_BENCH
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "can_iface.h"
+
+/* Bench build: bxCAN in loopback mode (nothing reaches the bus) and the tick hook
+   offers a configurable load of std id, dlc 8 msgs over CANBENCHNID priorities.
+   NOTE: Do not leave defined in a build that goes on a vehicle.
+   Uncomment to add. */
+//#define CANBENCH
+#define CANBENCHLOAD      50  // Default offered load (% of the bus bit rate)
+#define CANBENCHNID       4   // Number of CAN ids (priorities) offered, round robin
+#define CANBENCHID0       (0x100 << 21) // Highest priority id (CANRCVBUF format)
+#define CANBENCHIDSTEP    (0x100 << 21) // Next lower priority id
+#define CANBENCHFRAMEBITS 135 // Std id, dlc 8, worst case stuff bits, intermission
+
+struct CANBENCHW
+{
+	struct CAN_CTLBLOCK* pctl; // CAN module under test
+	uint32_t bitrate;  // CAN bits per second (from BTR)
+	uint32_t credit;   // Offered bits not yet put (x1000)
+	uint32_t putct;    // Running count: msgs put
+	uint32_t failct;   // Running count: can_driver_put returned an error
+	uint32_t txprev;   // TX complete count at the last 1 s
+	uint32_t rxprev;   // RX ring 'addseq' at the last 1 s
+	uint32_t txps;     // TX msgs/sec (last 1 s)
+	uint32_t rxps;     // RX msgs/sec (last 1 s; loopback returns our own msgs)
+	uint32_t ticks;    // Ticks in the current 1 s
+	uint32_t seq;      // Payload sequence number
+	uint8_t  loadpct;  // Offered load (%); 0 = stop
+	uint8_t  idx;      // Next id (round robin)
+};
+
+/* *************************************************************************/
+int can_bench_init(struct CAN_CTLBLOCK* pctl, uint8_t loadpct);
+/* @brief	: Loopback mode, TX latency stats for the bench ids, start offering load
+ * @param	: pctl    = pointer to CAN control block (from can_iface_init)
+ * @param	: loadpct = offered load (% of the bus bit rate)
+ * @return	: 0 = OK; -1 = CAN not in init mode (call before HAL_CAN_Start);
+ *          : -2 = TX latency stats table full or calloc failed
+ * *************************************************************************/
+void can_bench_tick(void);
+/* @brief	: Put the offered load for this tick; msgs/sec each 1 s
+ * NOTE: Call from 'vApplicationTickHook' (FreeRTOS tick interrupt)
+ * *************************************************************************/
+
+extern struct CANBENCHW canbench;
+
+#endif
@@ -5,6 +5,50 @@
 * Description        : Interface CAN FreeRTOS to STM32CubeMX HAL can driver 
 *******************************************************************************/
 /*
+10/17/2026 - One msg per CAN id in the TX mailboxes.  bxCAN sends equal ids lowest
+  mailbox first, so a refill of a lower mailbox, or a msg requeued after arbitration
+  lost, could go out ahead of an earlier msg with the same id.
+
+10/17/2026 - CANRXDIRECT option: 'prxdirect' called in the RX FIFO drain for each msg.
+
+10/17/2026 - RX FIFO overrun (FOVR) counted in can_errors.can_rx0err/can_rx1err.
+
+10/17/2026 - CANBUSLOAD option: bits of each RX and TX frame rolled into 100 ms,
+  1 s and 10 s bus load windows (tick hook), plus TX errors per second.
+
+10/17/2026 - CANTXRATELIMIT option: per CAN id token bucket in 'can_driver_put'.
+
+10/17/2026 - 'can_driver_put_done': optional task notification (CANTXDONE) from the 
+  TX complete ISR, with the time the msg went out; also when a msg is dropped.
+
+10/17/2026 - CANTXLATENCY option: TX blocks stamped with DTWTIME at put, mailbox
+  load and TX complete; per CAN id log2 latency histograms and error counts.
+
+10/17/2026 - can_driver_put is callable from an ISR (BASEPRI critical sections),
+  e.g. the periodic TX scheduler (can_txsched.c) in the FreeRTOS tick hook.
+
+10/17/2026 - CANREPLACEBYID 'bits': latest value replaces a queued msg with the same id
+  (and the same TX done 'pdone'; otherwise it is queued).  The put searches the
+  CANREPLACENUM 'prep' index of such msgs in the heap, not the whole heap.
+
+10/17/2026 - CANRXFIFO1HIPRI option: FIFO 1 has its own IRQ priority, ring and 
+  notification bit.
+
+10/17/2026 - CANTTCM option: 'toa' from the bxCAN SOF timestamp (TTCM) extended
+  into the DTW timebase, for RX and TX loopback msgs.
+
+10/17/2026 - RX FIFO drain notifies the task once per drain, not once per msg.
+  Control block lookup in the callbacks is indexed by the CAN register base
+  address instead of a linear list search.
+
+10/17/2026 - RX circular buffer is a power-of-two ring with a free running 'add'
+  sequence number.  A 'take' that gets lapped resyncs and counts the lost msgs
+  (CANTAKEPTR.lostct) instead of silently reading overwritten slots.
+
+10/17/2026 - Replace sorted linked list 'pend' with a bounded binary heap.  The 
+  linked list insert walked the list with interrupts disabled; the heap insert is
+  O(log n), e.g. 7 compares with 128 msgs queued, versus up to 128.
+
 01/02/2019 - Hack "can_driver" to inferface with STM32CubeMX FreeRTOS HAL CAN driver
 
 Instead of a common CAN msg block pool for all CAN modules, this version has separate
@@ -20,10 +64,6 @@ This simplifies the issue of disabling of interrupts
 /* The following sends all outgoing CAN msgs back into FreeRTOS CAN receive queue */
 //#define CANMSGLOOPBACKSALL
 
-#ifdef CHEATINGONHAL
-#include "stm32f407.h" 	// **** CHEATING (processor dependent) ****
-#endif
-
 #include <malloc.h>
 #include "stm32f1xx_hal.h"
 #include "stm32f1xx_hal_can.h"
@@ -46,13 +86,19 @@ extern CAN_HandleTypeDef hcan2;
 
 /* subroutine declarations */
 static void loadmbx2(struct CAN_CTLBLOCK* pctl);
-static void moveremove2(struct CAN_CTLBLOCK* pctl);
-
-#define MAXCANMODULES	4	// Max number of CAN modules + 1
+static void moveremove2(struct CAN_CTLBLOCK* pctl, uint8_t k);
+static void requeue2(struct CAN_CTLBLOCK* pctl, uint8_t k);
+static uint8_t mbxlowest(struct CAN_CTLBLOCK* pctl);
+static int idinmbx(struct CAN_CTLBLOCK* pctl, uint32_t id);
+
+/* Index control blocks by CAN register base address: CAN1 0x40006400 -> 1,
+   CAN2 0x40006800 -> 2, (F4) CAN3 0x40003400 -> 5.  Collisions rejected at init. */
+#define CANINSTIDXSZ	8
+#define CANINSTIDX(phcan) ((((uint32_t)(uintptr_t)(phcan)->Instance) >> 10) & (CANINSTIDXSZ-1))
 /* Pointers to control blocks for each CAN module */
-static struct CAN_CTLBLOCK* pctllist[MAXCANMODULES];
-static struct CAN_CTLBLOCK** ppctllist = NULL;	// Pointer to end of active pctllist
+static struct CAN_CTLBLOCK* pctlinst[CANINSTIDXSZ]; // Control block, indexed by CANINSTIDX
 
+#ifndef CHEATINGONHAL
 /* *************************************************************************
  * static void canmsg_compress(struct CANRCVBUF *pcan, CAN_RxHeaderTypeDef *phal, uint8_t *pdat);
  * @brief	: Convert silly HAL expanded format to hardware compressed format
@@ -84,6 +130,116 @@ static void canmsg_compress(struct CANRCVBUF *pcan, CAN_RxHeaderTypeDef *phal, u
 	pcan->cd.uc[7] = *(pdat+7);
 	return;
 }
+#endif
+/* *************************************************************************
+ * static int heap_before(struct CAN_POOLBLOCK* pa, struct CAN_POOLBLOCK* pb);
+ * @brief	: Compare two pending msgs
+ * @return	: not zero = 'pa' goes out before 'pb'
+ * *************************************************************************/
+static int heap_before(struct CAN_POOLBLOCK* pa, struct CAN_POOLBLOCK* pb)
+{
+	if (pa->can.id != pb->can.id) // Pay attention: "value" vs "priority"
+		return (pa->can.id < pb->can.id);
+	/* Same CAN id: earlier enqueue goes first (wrap-around safe) */
+	return ((int32_t)(pa->seq - pb->seq) < 0);
+}
+/* *************************************************************************
+ * static void repadd(struct CAN_CTLBLOCK* pctl, struct CAN_POOLBLOCK* p);
+ * static void repdel(struct CAN_CTLBLOCK* pctl, struct CAN_POOLBLOCK* p);
+ * @brief	: Add/remove a CANREPLACEBYID msg to/from the 'prep' index (interrupts disabled)
+ * *************************************************************************/
+static void repadd(struct CAN_CTLBLOCK* pctl, struct CAN_POOLBLOCK* p)
+{
+	if (pctl->repct >= CANREPLACENUM)
+	{ // Index full: msg stays queued, but a later put won't find it
+		pctl->repfullct += 1;
+		return;
+	}
+	pctl->prep[pctl->repct] = p;
+	pctl->repct += 1;
+	return;
+}
+static void repdel(struct CAN_CTLBLOCK* pctl, struct CAN_POOLBLOCK* p)
+{
+	uint8_t i;
+	for (i = 0; i < pctl->repct; i++)
+	{
+		if (pctl->prep[i] == p)
+		{ // Last one fills the hole
+			pctl->repct -= 1;
+			pctl->prep[i] = pctl->prep[pctl->repct];
+			return;
+		}
+	}
+	return;
+}
+/* *************************************************************************
+ * static void heap_push(struct CAN_CTLBLOCK* pctl, struct CAN_POOLBLOCK* p);
+ * @brief	: Add msg to pending heap (interrupts must be disabled)
+ * @param	: pctl = pointer to control block for this CAN module
+ * @param	: p = pointer to block with msg
+ * *************************************************************************/
+static void heap_push(struct CAN_CTLBLOCK* pctl, struct CAN_POOLBLOCK* p)
+{
+	struct CAN_POOLBLOCK** pph = pctl->ppheap;
+	uint16_t i = pctl->heapct;
+	uint16_t j;
+
+	pctl->heapct += 1;
+	if (pctl->heapct > pctl->heapctmax) pctl->heapctmax = pctl->heapct;
+
+	/* Sift up: move parents down until 'p' fits */
+	while (i > 0)
+	{
+		j = (i - 1) >> 1; // Parent
+		if (heap_before(p, pph[j]) == 0) break;
+		pph[i] = pph[j];
+		i = j;
+	}
+	pph[i] = p;
+
+	if ((p->x.xb[2] & CANREPLACEBYID) != 0)
+		repadd(pctl, p);
+	return;
+}
+/* *************************************************************************
+ * static struct CAN_POOLBLOCK* heap_pop(struct CAN_CTLBLOCK* pctl);
+ * @brief	: Remove highest priority msg from pending heap (interrupts must be disabled)
+ * @param	: pctl = pointer to control block for this CAN module
+ * @return	: pointer to block; NULL = heap empty
+ * *************************************************************************/
+static struct CAN_POOLBLOCK* heap_pop(struct CAN_CTLBLOCK* pctl)
+{
+	struct CAN_POOLBLOCK** pph = pctl->ppheap;
+	struct CAN_POOLBLOCK* ptop;
+	struct CAN_POOLBLOCK* plast;
+	uint16_t i = 0;
+	uint16_t j;
+	uint16_t n;
+
+	if (pctl->heapct == 0) return NULL;
+
+	ptop = pph[0];
+	if ((ptop->x.xb[2] & CANREPLACEBYID) != 0)
+		repdel(pctl, ptop);
+	pctl->heapct -= 1;
+	n = pctl->heapct;
+	if (n == 0) return ptop;
+	plast = pph[n];
+
+	/* Sift down: move the smaller child up until 'plast' fits */
+	for (;;)
+	{
+		j = (i << 1) + 1; // Left child
+		if (j >= n) break;
+		if (((j + 1) < n) && (heap_before(pph[j+1], pph[j]) != 0)) j += 1;
+		if (heap_before(pph[j], plast) == 0) break;
+		pph[i] = pph[j];
+		i = j;
+	}
+	pph[i] = plast;
+	return ptop;
+}
 /******************************************************************************
  * struct CANTAKEPTR* can_iface_add_take(struct CAN_CTLBLOCK*  pctl);
  * @brief 	: Create a 'take' pointer for accessing CAN msgs in the circular buffer
@@ -91,7 +247,7 @@ static void canmsg_compress(struct CANRCVBUF *pcan, CAN_RxHeaderTypeDef *phal, u
  * @return	: pointer to pointer pointing to 'take' location in circular CAN buffer
  * 			:  NULL = Failed 
 *******************************************************************************/
-struct CANTAKEPTR* can_iface_add_take(struct CAN_CTLBLOCK*  pctl)
+static struct CANTAKEPTR* addtake(struct CANCIRBUFPTRS* pcir)
 {
 	struct CANTAKEPTR* p;
 	
@@ -103,15 +259,19 @@ taskENTER_CRITICAL();
 	/* Initialize the pointer to curret add location of the circular buffer. */
    /* Given 'p', the beginning, end, and location CAN msgs are being added
       can be accessed. */
-	p->pcir  = &pctl->cirptrs;
+	p->pcir  = pcir;
 
-	/* Start the 'take' pointer at the position in the circular buffer where
+	/* Start the 'take' at the position in the circular buffer where
       CAN msgs are currently being added. */
-	p->ptake = pctl->cirptrs.pwork;
+	p->takeseq = pcir->addseq;
 
 taskEXIT_CRITICAL();
 	return p;
 }
+struct CANTAKEPTR* can_iface_add_take(struct CAN_CTLBLOCK*  pctl)
+{
+	return addtake(&pctl->cirptrs);
+}
 /******************************************************************************
  * struct CANTAKEPTR* can_iface_mbx_init(struct CAN_CTLBLOCK*  pctl, osThreadId tskhandle, uint32_t notebit);
  * @brief 	: Initialize the mailbox task notification and get a 'take pointer for it.
@@ -135,30 +295,226 @@ struct CANTAKEPTR* can_iface_mbx_init(struct CAN_CTLBLOCK* pctl, osThreadId tskh
 	/* Get a 'take' pointer into the circular buffer */
 	return can_iface_add_take(pctl);
 }
+/******************************************************************************
+ * struct CANTAKEPTR* can_iface_mbx_init_hipri(struct CAN_CTLBLOCK*  pctl, osThreadId tskhandle, uint32_t notebit);
+ * @brief 	: Initialize notification and get a 'take' pointer for the FIFO 1 (high priority) ring
+ * @param	: tskhandle = task handle that will be used for notification; NULL = use current task
+ * @param	: notebit = notification bit
+ * @return	: pointer to pointer pointing to 'take' location in FIFO 1 ring; NULL = failed,
+ *          :   or CANRXFIFO1HIPRI not defined
+*******************************************************************************/
+struct CANTAKEPTR* can_iface_mbx_init_hipri(struct CAN_CTLBLOCK* pctl, osThreadId tskhandle, uint32_t notebit)
+{
+#ifdef CANRXFIFO1HIPRI
+	if (tskhandle == NULL)
+	{ // Here, use the current running Task
+		tskhandle = xTaskGetCurrentTaskHandle();
+	}
+	pctl->tsknote1.tskhandle = tskhandle;
+	pctl->tsknote1.notebit   = notebit;
+
+	return addtake(&pctl->cirptrs1);
+#else
+	return NULL;
+#endif
+}
+/******************************************************************************
+ * int can_iface_txlat_add(struct CAN_CTLBLOCK* pctl, uint32_t id);
+ * @brief 	: Register a CAN id for TX latency stats (CANTXLATENCY)
+ * @param	: pctl = pointer to our CAN control block
+ * @param	: id = CAN id (CANRCVBUF format)
+ * @return	: >= 0 = index into pctl->ptxlat[] (already registered returns its index)
+ *          :   -1 = table full; -2 = calloc failed; -3 = CANTXLATENCY not defined
+*******************************************************************************/
+int can_iface_txlat_add(struct CAN_CTLBLOCK* pctl, uint32_t id)
+{
+#ifdef CANTXLATENCY
+	struct CANTXLAT* plat;
+	int i;
+
+taskENTER_CRITICAL();
+	for (i = 0; i < pctl->txlatct; i++)
+	{
+		if (pctl->ptxlat[i]->id == id){ taskEXIT_CRITICAL(); return i;}
+	}
+	if (pctl->txlatct >= CANTXLATNUM){ taskEXIT_CRITICAL(); return -1;}
+
+	plat = (struct CANTXLAT*)calloc(1, sizeof(struct CANTXLAT));
+	if (plat == NULL){ taskEXIT_CRITICAL(); return -2;}
+	plat->id = id;
+	pctl->ptxlat[pctl->txlatct] = plat;
+	pctl->txlatct += 1;
+taskEXIT_CRITICAL();
+	return i;
+#else
+	return -3;
+#endif
+}
+/******************************************************************************
+ * int can_iface_txrate_add(struct CAN_CTLBLOCK* pctl, uint32_t id, uint32_t interval, uint32_t burst);
+ * @brief 	: Rate limit a CAN id (CANTXRATELIMIT): token bucket
+ * @param	: pctl = pointer to our CAN control block
+ * @param	: id = CAN id (CANRCVBUF format)
+ * @param	: interval = min average FreeRTOS ticks between msgs (> 0)
+ * @param	: burst = number of msgs allowed back-to-back (> 0)
+ * @return	: >= 0 = index into pctl->ptxrate[] (already registered is updated)
+ *          :   -1 = table full or bad interval/burst; -2 = calloc failed;
+ *          :   -3 = CANTXRATELIMIT not defined
+*******************************************************************************/
+int can_iface_txrate_add(struct CAN_CTLBLOCK* pctl, uint32_t id, uint32_t interval, uint32_t burst)
+{
+#ifdef CANTXRATELIMIT
+	struct CANTXRATE* prate = NULL;
+	int i;
+
+	if ((interval == 0) || (burst == 0)) return -1;
+
+taskENTER_CRITICAL();
+	for (i = 0; i < pctl->txratect; i++)
+	{
+		if (pctl->ptxrate[i]->id == id){ prate = pctl->ptxrate[i]; break;}
+	}
+	if (prate == NULL)
+	{
+		if (pctl->txratect >= CANTXRATENUM){ taskEXIT_CRITICAL(); return -1;}
+		prate = (struct CANTXRATE*)calloc(1, sizeof(struct CANTXRATE));
+		if (prate == NULL){ taskEXIT_CRITICAL(); return -2;}
+		prate->id = id;
+		pctl->ptxrate[pctl->txratect] = prate;
+		pctl->txratect += 1;
+	}
+	prate->cost  = interval;
+	prate->cap   = interval * burst;
+	prate->level = prate->cap; // Start full
+	prate->tlast = xTaskGetTickCount();
+taskEXIT_CRITICAL();
+	return i;
+#else
+	return -3;
+#endif
+}
+#ifdef CANTXRATELIMIT
+/******************************************************************************
+ * static int txrate_take(struct CAN_CTLBLOCK* pctl, uint32_t id);
+ * @brief 	: Take one msg worth of credit from the token bucket for a CAN id
+ * @return	: 0 = OK (or id not rate limited); -1 = over budget
+*******************************************************************************/
+static int txrate_take(struct CAN_CTLBLOCK* pctl, uint32_t id)
+{
+	struct CANTXRATE* prate = NULL;
+	UBaseType_t uxsave;
+	uint32_t now;
+	uint32_t dt;
+	int i;
+	int ret = 0;
+
+	for (i = 0; i < pctl->txratect; i++)
+	{
+		if (pctl->ptxrate[i]->id == id){ prate = pctl->ptxrate[i]; break;}
+	}
+	if (prate == NULL) return 0;
+
+	now = xTaskGetTickCountFromISR();
+	uxsave = taskENTER_CRITICAL_FROM_ISR(); // A few instructions
+	dt = now - prate->tlast;
+	prate->tlast = now;
+	if (dt >= prate->cap)
+		prate->level = prate->cap;
+	else
+	{
+		prate->level += dt;
+		if (prate->level > prate->cap) prate->level = prate->cap;
+	}
+	if (prate->level >= prate->cost)
+		prate->level -= prate->cost;
+	else
+	{
+		prate->dropct += 1;
+		pctl->ratedropct += 1;
+		ret = -1;
+	}
+	taskEXIT_CRITICAL_FROM_ISR(uxsave);
+	return ret;
+}
+#endif
+#ifdef CANTXLATENCY
+/******************************************************************************
+ * static struct CANTXLAT* txlatfind(struct CAN_CTLBLOCK* pctl, uint32_t id);
+ * @brief 	: Look up TX latency stats for a CAN id
+ * @return	: pointer to stats; NULL = id not registered
+*******************************************************************************/
+static struct CANTXLAT* txlatfind(struct CAN_CTLBLOCK* pctl, uint32_t id)
+{
+	int i;
+	for (i = 0; i < pctl->txlatct; i++)
+	{
+		if (pctl->ptxlat[i]->id == id) return pctl->ptxlat[i];
+	}
+	return NULL;
+}
+/******************************************************************************
+ * static void txlathist(uint32_t* phist, uint32_t* pmax, uint32_t dtw);
+ * @brief 	: Add a DTW tick duration to a log2 histogram (see CANTXLATSHIFT)
+*******************************************************************************/
+static void txlathist(uint32_t* phist, uint32_t* pmax, uint32_t dtw)
+{
+	uint32_t n = 32 - __CLZ(dtw >> CANTXLATSHIFT);
+	if (n >= CANTXLATHISTSZ) n = CANTXLATHISTSZ - 1;
+	phist[n] += 1;
+	if (dtw > *pmax) *pmax = dtw;
+	return;
+}
+#endif
 /******************************************************************************
  * struct CANRCVBUFN* can_iface_get_CANmsg(struct CANTAKEPTR* p);
  * @brief 	: Get a pointer to the next available CAN msg and step ahead in the circular buffer
  * @brief	: p = pointer to struct with 'take' and 'add' pointers
  * @return	: pointer to CAN msg struct; NULL = no msgs available.
+ * NOTE: If the 'take' was lapped it resyncs to the oldest msg still in the ring and
+ *       adds the skipped msgs to p->lostct.
 *******************************************************************************/
  struct CANRCVBUFN* can_iface_get_CANmsg(struct CANTAKEPTR* p)
 {
-	struct CANRCVBUFN* ptmp = NULL;
-	if (p->pcir->pwork == p->ptake) return ptmp;
-
-	ptmp = p->ptake;
-	p->ptake += 1;
-	if (p->ptake == p->pcir->pend) p->ptake = p->pcir->pbegin;
+	struct CANRCVBUFN* ptmp;
+	uint32_t addseq = p->pcir->addseq;	// One read; ISR may add more
+	uint32_t n      = addseq - p->takeseq;	// Msgs not yet taken (wraps ok)
+
+	if (n == 0) return NULL;
+
+	if (n > p->pcir->mask)
+	{ // Here, 'add' lapped (or is about to lap) us. Resync to oldest slot not
+	  // about to be overwritten and count what was skipped.
+		p->lostct  += n - p->pcir->mask;
+		p->lapct   += 1;
+		p->takeseq  = addseq - p->pcir->mask;
+	}
+	ptmp = &p->pcir->pbegin[p->takeseq & p->pcir->mask];
+	p->takeseq += 1;
 
 	return ptmp;	
 }
+/******************************************************************************
+ * static void cirbuf_add(struct CANCIRBUFPTRS* pcir, struct CANRCVBUFN* pncan);
+ * @brief 	: Add a msg to a RX ring (call from CAN ISRs only)
+ * @param	: pcir = pointer to ring
+ * @param	: pncan = pointer to msg plus time-of-arrival
+*******************************************************************************/
+static void cirbuf_add(struct CANCIRBUFPTRS* pcir, struct CANRCVBUFN* pncan)
+{
+	uint32_t seq = pcir->addseq;
+	pcir->pbegin[seq & pcir->mask] = *pncan; // Copy struct
+	__DMB(); // Slot written before a 'take' can see the new sequence number
+	pcir->addseq = seq + 1;
+	return;
+}
 /******************************************************************************
  * struct CAN_CTLBLOCK* can_iface_init(CAN_HandleTypeDef *phcan, uint8_t canidx, uint16_t numtx, uint16_t numrx);
- * @brief 	: Setup linked list for TX priority sorted buffering
+ * @brief 	: Setup TX pool & priority heap, and RX circular buffer
  * @param	: phcan = Pointer "handle" to HAL control block for CAN module
  * @param	: cannum = CAN module index, CAN1 = 0, CAN2 = 1, CAN3 = 2
  * @param	: numtx = number of CAN msgs for TX buffering
  * @param	: numrx = number of incoming (and loopback) CAN msgs in circular buffer
+ *		:   (rounded up to a power of two)
  * @return	: Pointer to our knows-all control block for this CAN
  *		:  NULL = calloc failed
  *		:  Pointer->ret = pointer to CAN control block for this CAN unit
@@ -174,12 +530,15 @@ struct CAN_CTLBLOCK* can_iface_init(CAN_HandleTypeDef *phcan, uint8_t canidx, ui
 	int i;
 
 	struct CAN_CTLBLOCK*  pctl;
-	struct CAN_CTLBLOCK** ppx;
 
 	struct CAN_POOLBLOCK* plst;
 	struct CAN_POOLBLOCK* ptmp;
 
 	struct CANRCVBUFN* pcann;
+	uint32_t rxsz;
+#if defined(CANTTCM) || defined(CANBUSLOAD)
+	uint32_t btr;
+#endif
 
 taskENTER_CRITICAL();
 	/* Get a control block for this CAN module. */
@@ -192,36 +551,37 @@ taskENTER_CRITICAL();
 	/* Save CAN module index (CAN1 = 0). */
 	pctl->canidx = canidx;
 
-	/* Add new control block to list of control blocks */
-	if (ppctllist != NULL) // Not first time?
-	{ // Yes. Check for duplicates, i.e. check for bozo programmers
-		ppx = &pctllist[0];	// NOTE: don't confuse ppctllist with pctllist
-		while (ppx != ppctllist)
-		{
-			if ( (*ppx)->phcan == phcan)
-			{
-				taskEXIT_CRITICAL();
-				return NULL; // Duplicate
-			}
-			ppx++;;
-		}
-	}
-	else
-	{
-		ppctllist = &pctllist[0];
+#ifdef CANTTCM
+	/* DTW ticks per CAN bit: (BRP+1)*(1 + TS1+1 + TS2+1) PCLK1 cycles per bit.
+      NOTE: 'MX_CAN_Init' must have set the bit timing (BTR) before this call. */
+	btr = phcan->Instance->BTR;
+	pctl->ttcmtpb = ((btr & 0x3ff) + 1) * (3 + ((btr >> 16) & 0xf) + ((btr >> 20) & 0x7)) *
+	                 (SystemCoreClock / HAL_RCC_GetPCLK1Freq());
+#endif
+#ifdef CANBUSLOAD
+	/* CAN bits per second, for bus load. (MX_CAN_Init must have set BTR) */
+	btr = phcan->Instance->BTR;
+	pctl->busload.bitrate = HAL_RCC_GetPCLK1Freq() / 
+	   (((btr & 0x3ff) + 1) * (3 + ((btr >> 16) & 0xf) + ((btr >> 20) & 0x7)));
+#endif
+
+	/* Add new control block to index of control blocks */
+	if (pctlinst[CANINSTIDX(phcan)] != NULL)
+	{ // Duplicate, i.e. check for bozo programmers
+		taskEXIT_CRITICAL();
+		return NULL;
 	}
-	/* Save control block pointer on list, and advance list pointer */
-	*ppctllist = pctl;	
-	ppctllist++;
-	if (ppctllist == &pctllist[MAXCANMODULES]) { taskEXIT_CRITICAL();return NULL;} //JIC too many entries
+	pctlinst[CANINSTIDX(phcan)] = pctl;
 	
 	/* Now that we have control block in memory, we can use it to return errors. 
 	   by setting the error code in pctl->ret. */
+	// A calloc failure from here on returns NULL and takes the (half built) block
+	// back out of the index, so the ISR callbacks can't find it and init can be retried.
 
 	/* Get CAN xmit linked list. */	
-	if (numtx == 0)  {pctl->ret = -1; return pctl;} // Bogus tx buffering count
+	if (numtx == 0)  {pctl->ret = -1; taskEXIT_CRITICAL(); return pctl;} // Bogus tx buffering count
 	ptmp = (struct CAN_POOLBLOCK*)calloc(numtx, sizeof(struct CAN_POOLBLOCK));
-	if (ptmp == NULL){pctl->ret = -2; taskEXIT_CRITICAL(); return NULL;} // Get buff failed
+	if (ptmp == NULL){pctl->ret = -2; pctlinst[CANINSTIDX(phcan)] = NULL; taskEXIT_CRITICAL(); return NULL;} // Get buff failed
 
 	/* Initialize links.  All are in the "free" list. */
 	// Item: the last block is left with NULL in plinknext
@@ -232,15 +592,32 @@ taskENTER_CRITICAL();
 		plst = ptmp++;
 	}
 
+	/* Pending heap: can never hold more than the pool */
+	pctl->ppheap = (struct CAN_POOLBLOCK**)calloc(numtx, sizeof(struct CAN_POOLBLOCK*));
+	if (pctl->ppheap == NULL){pctl->ret = -5; pctlinst[CANINSTIDX(phcan)] = NULL; taskEXIT_CRITICAL(); return NULL;} // Get buff failed
+	pctl->heapsz = numtx;
+	pctl->heapct = 0;
+
 	/* Setup circular buffer for receive CAN msgs */
-	if (numrx == 0)  {pctl->ret = -3; return pctl;} // Bogus rx buffering count
-	pcann = (struct CANRCVBUFN*)calloc(numrx, sizeof(struct CANRCVBUFN));
-	if (pcann == NULL){pctl->ret = -4; taskEXIT_CRITICAL(); return NULL;} // Get buff failed
+	if (numrx == 0)  {pctl->ret = -3; taskEXIT_CRITICAL(); return pctl;} // Bogus rx buffering count
+	rxsz = 2; // Round up to power of two (min 2)
+	while (rxsz < numrx) rxsz <<= 1;
+	pcann = (struct CANRCVBUFN*)calloc(rxsz, sizeof(struct CANRCVBUFN));
+	if (pcann == NULL){pctl->ret = -4; pctlinst[CANINSTIDX(phcan)] = NULL; taskEXIT_CRITICAL(); return NULL;} // Get buff failed
 
-	/* Initialize pointers for "add"ing CAN msgs to the circular buffer */
+	/* Initialize ring for "add"ing CAN msgs */
 	pctl->cirptrs.pbegin = pcann;
-	pctl->cirptrs.pwork  = pcann;
-	pctl->cirptrs.pend   = pcann + numrx;
+	pctl->cirptrs.mask   = rxsz - 1;
+	pctl->cirptrs.addseq = 0;
+
+#ifdef CANRXFIFO1HIPRI
+	/* FIFO 1 (high priority) ring */
+	pcann = (struct CANRCVBUFN*)calloc(CANRX1RINGSZ, sizeof(struct CANRCVBUFN));
+	if (pcann == NULL){pctl->ret = -4; pctlinst[CANINSTIDX(phcan)] = NULL; taskEXIT_CRITICAL(); return NULL;} // Get buff failed
+	pctl->cirptrs1.pbegin = pcann;
+	pctl->cirptrs1.mask   = CANRX1RINGSZ - 1;
+	pctl->cirptrs1.addseq = 0;
+#endif
 
 	/* NOTE: pctl->tsknote gets initialized
       when 'MailboxTask' calls 'can_iface_mbx_init' */
@@ -249,6 +626,33 @@ taskEXIT_CRITICAL();
 
 	return pctl;	// Return pointer to control block
 }
+/* *************************************************************************
+ * static struct CAN_POOLBLOCK* freepop(struct CAN_CTLBLOCK* pctl);
+ * @brief	: Claim a block from the free list without disabling interrupts
+ * @param	: pctl = pointer to control block for this CAN modules
+ * @return	: pointer to block; NULL = free list empty
+ * *************************************************************************/
+/* LDREX/STREX: if anything (ISR, or task switch via PendSV) gets in between, the
+   exception entry/exit clears the exclusive monitor, STREX fails and the pop is
+   retried.  The TX ISRs push onto the free list with plain stores, which is safe
+   since a task cannot preempt an ISR. */
+static struct CAN_POOLBLOCK* freepop(struct CAN_CTLBLOCK* pctl)
+{
+	volatile uint32_t* phead = (volatile uint32_t*)&pctl->frii.plinknext;
+	struct CAN_POOLBLOCK* p;
+
+	do
+	{
+		p = (struct CAN_POOLBLOCK*)(uintptr_t)__LDREXW(phead);
+		if (p == NULL)
+		{
+			__CLREX();
+			return NULL;
+		}
+	} while (__STREXW((uint32_t)(uintptr_t)p->plinknext, phead) != 0);
+
+	return p;
+}
 /******************************************************************************
  * int can_driver_put(struct CAN_CTLBLOCK* pctl,struct CANRCVBUF *pcan,uint8_t maxretryct,uint8_t bits);
  * @brief	: Get a free slot and add CAN msg
@@ -256,48 +660,89 @@ taskEXIT_CRITICAL();
  * @param	: pcan = pointer to msg: id, dlc, data (common_can.h)
  * @param	: maxretryct =  0 = use TERRMAXCOUNT; not zero = use this value.
  * @param	: bits = Use these bits to set some conditions (see .h file)
- * @return	:  0 = OK; 
- *				: -1 = Buffer overrun (no free slots for the new msg)
- *				: -2 = Bogus CAN id rejected
- *				: -3 = control block pointer NULL
+ * @return	: CANPUT_OK      ( 0) = OK; 
+ *				: CANPUT_OVERRUN (-1) = Buffer overrun (no free slots for the new msg)
+ *				: CANPUT_BOGUSID (-2) = Bogus CAN id rejected
+ *				: CANPUT_NOPCTL  (-3) = control block pointer NULL
+ *				: CANPUT_RATELIMIT (-4) = over rate limit for this CAN id (CANTXRATELIMIT)
+ * NOTE: Callable from any task, or an ISR at or below (numerically >=)
+ *       configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY; does not block.
+ ******************************************************************************/
+int can_driver_put(struct CAN_CTLBLOCK* pctl,struct CANRCVBUF *pcan,uint8_t maxretryct,uint8_t bits)
+{
+	return can_driver_put_done(pctl, pcan, maxretryct, bits, NULL);
+}
+/******************************************************************************
+ * int can_driver_put_done(struct CAN_CTLBLOCK* pctl, struct CANRCVBUF *pcan, u8 maxretryct, u8 bits, struct CANTXDONE* pdone);
+ * @brief	: 'can_driver_put' plus notification when the msg has been sent (or dropped)
+ * @param	: pdone = pointer to notification struct (task, bit, toa); NULL = none
+ * @return	: same as 'can_driver_put'
  ******************************************************************************/
 
 extern uint32_t debugTX1c;
 
-int can_driver_put(struct CAN_CTLBLOCK* pctl,struct CANRCVBUF *pcan,uint8_t maxretryct,uint8_t bits)
+int can_driver_put_done(struct CAN_CTLBLOCK* pctl,struct CANRCVBUF *pcan,uint8_t maxretryct,uint8_t bits,struct CANTXDONE* pdone)
 {
-	volatile struct CAN_POOLBLOCK* pnew;
-	volatile struct CAN_POOLBLOCK* pfor; 	// Loop pointer for the 'for’ loop.
+	struct CAN_POOLBLOCK* pnew;
+	uint32_t dtw;
+	uint8_t k;
+	int i;
+	UBaseType_t uxsave;
 
-	if (pctl == NULL) return -3;
+	if (pctl == NULL) return CANPUT_NOPCTL;
 
 	/* Reject CAN msg if CAN id is "bogus". */
 	// If 11b is specified && bits in extended address are present it is bogus
 	if (((pcan->id & CAN_ID_EXT) == 0) && ((pcan->id & CAN_EXTENDED_MASK) != 0))
 	{
 		pctl->bogusct += 1;
-		return -2;
+		return CANPUT_BOGUSID;
 	}
 
-	/* Get a free block from the free list. */
-//	disable_TXints(pctl, save);	// TX interrupt might move a msg to the free list.
-	taskENTER_CRITICAL();
+	/* Replace by id: a msg with the same id still waiting (not in a mailbox) gets
+      the new payload.  The id is unchanged so its place in the heap is too.
+      Only one with the same 'pdone': a different producer waiting for its own
+      TX done notification must not lose it, so that case queues a new msg.
+      Only the (at most CANREPLACENUM) CANREPLACEBYID msgs in the heap are looked at. */
+	if ((bits & CANREPLACEBYID) != 0)
+	{
+		uxsave = taskENTER_CRITICAL_FROM_ISR();
+		for (i = 0; i < pctl->repct; i++)
+		{
+			pnew = pctl->prep[i];
+			if ((pnew->can.id == pcan->id) && (pnew->pdone == pdone))
+			{
+				pnew->can.dlc = pcan->dlc;
+				pnew->can.cd  = pcan->cd;
+				pnew->x.xb[0] = 0;	// New msg: TERR retry count starts over
+				pnew->x.xb[1] = maxretryct;
+				pnew->x.xb[2] = bits;
+				pctl->replacect += 1;
+				taskEXIT_CRITICAL_FROM_ISR(uxsave);
+				return CANPUT_OK;
+			}
+		}
+		taskEXIT_CRITICAL_FROM_ISR(uxsave);
+	}
+
+#ifdef CANTXRATELIMIT
+	/* Over the rate limit for this id: drop (after replace by id had its chance). */
+	if (txrate_take(pctl, pcan->id) != 0)
+		return CANPUT_RATELIMIT;
+#endif
 
-	pnew = pctl->frii.plinknext;
+	/* Get a free block from the free list. */
+	pnew = freepop(pctl);
 	if (pnew == NULL)
 	{ // Here, either no free list blocks OR this TX reached its limit
-//		reenable_TXints(save);
-		taskEXIT_CRITICAL();
 		pctl->can_errors.can_msgovrflow += 1;	// Count overflows
-		return -1;	// Return failure: no space & screwed
+		return CANPUT_OVERRUN;	// Return failure: no space & screwed
 	}	
-	pctl->frii.plinknext = pnew->plinknext;
 
-//	reenable_TXints(save);
+	/* 'pnew' now points to the block that is free (and not linked), so 
+      it can be filled without interrupts disabled. */
 
-	/* 'pnew' now points to the block that is free (and not linked). */
-
-	/* Build struct/block for addition to the pending list. */
+	/* Build struct/block for addition to the pending heap. */
 	// retryct    xb[0]	// Counter for number of retries for TERR errors
 	// maxretryct xb[1]	// Maximum number of TERR retry counts
 	// bits	      xb[2]		// Use these bits to set some conditions (see below)
@@ -307,117 +752,188 @@ int can_driver_put(struct CAN_CTLBLOCK* pctl,struct CANRCVBUF *pcan,uint8_t maxr
 	pnew->x.xb[2] = bits;	// Use these bits to set some conditions (see .h file)
 	pnew->x.xb[3] = 0;	// not used for now
 	pnew->x.xb[0] = 0;	// Retry counter for TERRs
+	pnew->pdone   = pdone;	// TX done notification, or NULL
+#ifdef CANTXLATENCY
+	pnew->plat    = txlatfind(pctl, pcan->id);
+	pnew->dtwput  = DTWTIME;
+#endif
 
-	/* Find location to insert new msg.  Lower value CAN ids are higher priority, 
-           and when the CAN id msg to be inserted has the same CAN id as the 'pfor' one
-           already in the list, then place the new one further down so that msgs with 
-           the same CAN id do not get their order of transmission altered. */
-//	disable_TXints(pctl, save);
+	uxsave = taskENTER_CRITICAL_FROM_ISR();
+	dtw = DTWTIME;
 
-	for (pfor = &pctl->pend; pfor->plinknext != NULL; pfor = pfor->plinknext)
-	{
-		if (pnew->can.id < (pfor->plinknext)->can.id) // Pay attention: "value" vs "priority"
-			break;
-	}
-
-	/* Add new msg to pending list. (TX interrupt is still disabled) */
-	pnew->plinknext = pfor->plinknext; 	// Insert new msg into 
-	pfor->plinknext = pnew;			//   pending list.
+	/* Lower value CAN ids are higher priority.  Msgs with the same CAN id
+      keep their order of arrival by the sequence number. */
+	pnew->seq = pctl->seq++;
+	heap_push(pctl, pnew);
 
-	if (pctl->pxprv == NULL) // Is sending complete?
-	{ // pxprv == NULL means CAN mailbox did not get loaded, so CAN is idle.
+	if (pctl->txbusy < CANTXMBXNUM) // Is a mailbox available?
+	{ // Here, mailbox(s) not loaded, so load the highest priority msg(s)
 		loadmbx2(pctl); // Start sending
 	}
 	else
-	{ // CAN sending is in progress.
-		if ((pctl->pxprv)->plinknext == pnew) // Does pxprv need adjustment?
-		{ // Here yes. We inserted a msg between 'pxprv' and 'pxprv->linknext'
-			pctl->pxprv = pnew;	// Update 'pxprv' so that it still points to msg TX using.
-			pctl->can_errors.can_pxprv_fwd_one += 1;	// Count: Instances that pxprv was adjusted in 'for' loop
-		}
-		/* Check if new msg is higher CAN priority than msg in mailbox */
-#ifdef CHEATINGONHAL
-		if ( (pctl->pend.plinknext)->can.id < (pctl->phcan->Instance->sTxMailBox[0] & ~0x1)  )
-#else
-		if ( (pctl->pend.plinknext)->can.id < (pctl->mbx0 & ~0x1)  ) // Use mailbox shadow id
-#endif
-		{ // Here, new msg has higher CAN priority than msg in mailbox
+	{ // CAN sending is in progress in all mailboxes.
+		/* Find the lowest priority msg in hardware (highest id value) */
+		k = mbxlowest(pctl);
+
+		/* Check if new msg is higher CAN priority than that msg */
+		if (( (pctl->ppheap[0])->can.id < (pctl->mbx[k] & ~0x1)  ) && // Use mailbox shadow id
+			 ((pctl->abortflag & (1 << k)) == 0) && // Abort not already in progress
+			 (idinmbx(pctl, pctl->ppheap[0]->can.id) == 0) ) // Top could be loaded (see 'loadmbx2')
+		{ // Here, new msg has higher CAN priority than a msg in a mailbox
 /* &&&&&&&&&&&&&& BEGIN ABORT MODS &&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&& */
 #ifdef YESABORTCODE
-			pctl->abortflag = 1;	// Set flag for interrupt routine use
-		taskEXIT_CRITICAL(); // ==> NOTE: allow interrupts before setting abort!
-			HAL_CAN_AbortTxRequest(pctl->phcan, CAN_TX_MAILBOX0);
-//		taskEXIT_CRITICAL(); // ==> AFTER! Which fails!
-			return 0;
+			pctl->abortflag |= (1 << k);	// Set flag for interrupt routine use
+			pctl->abortct   += 1;
+			dtw = DTWTIME - dtw;
+			if (dtw > pctl->dtwputmax) pctl->dtwputmax = dtw;
+		taskEXIT_CRITICAL_FROM_ISR(uxsave); // ==> NOTE: allow interrupts before setting abort!
+			HAL_CAN_AbortTxRequest(pctl->phcan, (CAN_TX_MAILBOX0 << k));
+//		taskEXIT_CRITICAL_FROM_ISR(uxsave); // ==> AFTER! Which fails!
+			return CANPUT_OK;
 #endif
 		}
 /* &&&&&&&&&&&&&& END ABORT MODS &&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&& */
 	}
-	taskEXIT_CRITICAL(); // Re-enable interrupts
-	return 0;	// Success!
+	dtw = DTWTIME - dtw;
+	if (dtw > pctl->dtwputmax) pctl->dtwputmax = dtw; // Worst case time ints disabled
+	taskEXIT_CRITICAL_FROM_ISR(uxsave); // Re-enable interrupts
+	return CANPUT_OK;	// Success!
+}
+/*---------------------------------------------------------------------------------------------
+ * static uint8_t mbxlowest(struct CAN_CTLBLOCK* pctl);
+ * @brief	: Find the loaded mailbox with the lowest priority (highest id value)
+ * @return	: mailbox index 0 - 2
+ ----------------------------------------------------------------------------------------------*/
+static uint8_t mbxlowest(struct CAN_CTLBLOCK* pctl)
+{
+	uint8_t i;
+	uint8_t k = 0;
+	uint32_t idmax = 0;
+
+	for (i = 0; i < CANTXMBXHW; i++)
+	{
+		if ((pctl->ptx[i] != NULL) && ((pctl->mbx[i] & ~0x1) >= idmax))
+		{
+			idmax = (pctl->mbx[i] & ~0x1);
+			k = i;
+		}
+	}
+	return k;
+}
+/*---------------------------------------------------------------------------------------------
+ * static int idinmbx(struct CAN_CTLBLOCK* pctl, uint32_t id);
+ * @brief	: Check if a msg with this CAN id is loaded in a mailbox
+ * @return	: 1 = yes; 0 = no
+ ----------------------------------------------------------------------------------------------*/
+static int idinmbx(struct CAN_CTLBLOCK* pctl, uint32_t id)
+{
+	uint8_t i;
+	for (i = 0; i < CANTXMBXHW; i++)
+	{
+		if ((pctl->ptx[i] != NULL) && (pctl->mbx[i] == id)) return 1;
+	}
+	return 0;
 }
 /*---------------------------------------------------------------------------------------------
  * static void loadmbx2(struct CAN_CTLBLOCK* pctl)
- * @brief	: Load mailbox
+ * @brief	: Take highest priority msgs from heap and load empty mailboxes
  ----------------------------------------------------------------------------------------------*/
 static void loadmbx2(struct CAN_CTLBLOCK* pctl)
 {
+#ifndef CHEATINGONHAL
 	uint32_t uidata[2];
 	uint32_t TxMailbox;
 	CAN_TxHeaderTypeDef halmsg;
+#endif
+	struct CAN_POOLBLOCK* p;
+	uint8_t k;
 
-	volatile struct CAN_POOLBLOCK* p = pctl->pend.plinknext;
-
-	if (p == NULL)
+	while (pctl->txbusy < CANTXMBXNUM)
 	{
-		pctl->pxprv = NULL;
-		return; // Return if no more to send
-	}
+		/* bxCAN sends equal ids lowest mailbox first, not in load order.  With one
+         msg per id in the mailboxes, msgs with the same id go out in 'put' order
+         (a requeued msg keeps its 'seq'); the next waits for this one to finish. */
+		if ((pctl->heapct != 0) && (idinmbx(pctl, pctl->ppheap[0]->can.id) != 0))
+			return;
+
+#ifdef CHEATINGONHAL
+		/* Pick an empty mailbox: none of ours in it, and empty in hardware (TMEk) */
+		for (k = 0; k < CANTXMBXHW; k++)
+			if ((pctl->ptx[k] == NULL) && ((pctl->phcan->Instance->TSR & (CAN_TSR_TME0 << k)) != 0)) break;
+		if (k >= CANTXMBXHW)
+			return; // JIC: hardware has no empty mailbox; TX-complete will reload
+#endif
 
-	pctl->pxprv = &pctl->pend;	// Save in a static var
+		p = heap_pop(pctl);
+		if (p == NULL)
+		{
+			return; // Return if no more to send
+		}
 
 #ifdef CHEATINGONHAL
-	/* Load the mailbox with the message.  CAN ID low bit starts xmission. */
-	pctl->phcan->sTxMailBox[0].TDTR = p->can.dlc;	 	// CAN_TDT0R:  mailbox 0 time & length
-	pctl->phcan->sTxMailBox[0].TDLR = p->can.cd.ui[0];	// CAN_TDL0RL: mailbox 0 data low  register
-	pctl->phcan->sTxMailBox[0].TDHR = p->can.cd.ui[1];	// CAN_TDL0RH: mailbox 0 data low  register
-	/* Load CAN ID with TX Request bit set */
-	pctl->phcan->sTxMailBox[0].TIR = (p->can.id | 0x1); 	// CAN_TI0R:   mailbox 0 identifier register
+		/* Load the mailbox with the message.  CAN ID low bit starts xmission. */
+		pctl->phcan->Instance->sTxMailBox[k].TDTR = p->can.dlc & 0xf;	// CAN_TDTxR:  mailbox time & length
+		pctl->phcan->Instance->sTxMailBox[k].TDLR = p->can.cd.ui[0];	// CAN_TDLxR: mailbox data low  register
+		pctl->phcan->Instance->sTxMailBox[k].TDHR = p->can.cd.ui[1];	// CAN_TDHxR: mailbox data high register
+		/* Load CAN ID with TX Request bit set */
+		pctl->phcan->Instance->sTxMailBox[k].TIR = (p->can.id | 0x1); 	// CAN_TIxR:   mailbox identifier register
 #else
-	/* Expand hardware friendly format to HAL format (which gets changed back to hardware friendly) */
-	halmsg.StdId = (p->can.id >> 21);
-	halmsg.ExtId = (p->can.id >>  3);
-	halmsg.IDE   = (p->can.id & CAN_ID_EXT);
-	halmsg.RTR   = (p->can.id & CAN_RTR_REMOTE);
-	halmsg.DLC   = (p->can.dlc & 0xf);
-	uidata[0]   = p->can.cd.ui[0];
-	uidata[1]   = p->can.cd.ui[1];
-	pctl->mbx0  = p->can.id;	// Shadow MBX0 ID
-   HAL_CAN_AddTxMessage(pctl->phcan, &halmsg, (uint8_t*)uidata, &TxMailbox);
+		/* Expand hardware friendly format to HAL format (which gets changed back to hardware friendly) */
+		halmsg.StdId = (p->can.id >> 21);
+		halmsg.ExtId = (p->can.id >>  3);
+		halmsg.IDE   = (p->can.id & CAN_ID_EXT);
+		halmsg.RTR   = (p->can.id & CAN_RTR_REMOTE);
+		halmsg.DLC   = (p->can.dlc & 0xf);
+		uidata[0]   = p->can.cd.ui[0];
+		uidata[1]   = p->can.cd.ui[1];
+		if (HAL_CAN_AddTxMessage(pctl->phcan, &halmsg, (uint8_t*)uidata, &TxMailbox) != HAL_OK)
+		{ // JIC: hardware has no empty mailbox. Msg goes back; TX-complete will reload.
+			heap_push(pctl, p);
+			return;
+		}
+		/* HAL picks the mailbox: CAN_TX_MAILBOX0 = 1, 1 = 2, 2 = 4 */
+		k = (TxMailbox >> 1); if (k > 2) k = 2;
+#endif
+		pctl->mbx[k] = p->can.id;	// Shadow mailbox ID
+		pctl->ptx[k] = p;          // Msg in mailbox k
+		pctl->txbusy += 1;
+#ifdef CANTXLATENCY
+		p->dtwload = DTWTIME; // A requeued msg (arb lost, abort) is re-stamped
 #endif
+	}
 	return;
 }
 /* --------------------------------------------------------------------------------------
-* static void moveremove2(struct CAN_CTLBLOCK* pctl);
-* @brief	: Remove msg from pending list and add to free list
+* static void moveremove2(struct CAN_CTLBLOCK* pctl, uint8_t k);
+* @brief	: Msg in mailbox k is finished: add to free list
   --------------------------------------------------------------------------------------- */
-static void moveremove2(struct CAN_CTLBLOCK* pctl)
+static void moveremove2(struct CAN_CTLBLOCK* pctl, uint8_t k)
 {
-	volatile struct CAN_POOLBLOCK* pmov;
-//	uint32_t save[2];
-
-//	disable_TXints(pctl, save);	// TX or RX(other) interrupts might remove a msg from the free list.
-// Each CAN module has its own linked list and RX0,1 does not use the linked list, so disabling interrupts is not needed.
+	volatile struct CAN_POOLBLOCK* pmov = pctl->ptx[k];
+	if (pmov == NULL) return;
 
-	/* Remove from pending; move to free list. */
-	pmov = pctl->pxprv->plinknext;	// Pts to removed item
-	pctl->pxprv->plinknext = pmov->plinknext;
+// Each CAN module has its own pool and RX0,1 does not use it, so disabling interrupts is not needed.
 
 	// Adding to free list
 	pmov->plinknext = pctl->frii.plinknext; 
 	pctl->frii.plinknext  = pmov;
+	pctl->ptx[k] = NULL;
+	pctl->txbusy -= 1;
+	return;
+}
+/* --------------------------------------------------------------------------------------
+* static void requeue2(struct CAN_CTLBLOCK* pctl, uint8_t k);
+* @brief	: Msg in mailbox k was not sent: return it to the pending heap
+  --------------------------------------------------------------------------------------- */
+static void requeue2(struct CAN_CTLBLOCK* pctl, uint8_t k)
+{
+	struct CAN_POOLBLOCK* p = (struct CAN_POOLBLOCK*)pctl->ptx[k];
+	if (p == NULL) return;
 
-//	reenable_TXints(save);
+	/* 'seq' is unchanged, so it goes back ahead of later msgs with the same id */
+	heap_push(pctl, p);
+	pctl->ptx[k] = NULL;
+	pctl->txbusy -= 1;
 	return;
 }
 
@@ -434,30 +950,299 @@ uint32_t dbgcantxctr;
  * *********************************************************************/
 struct CAN_CTLBLOCK* getpctl(CAN_HandleTypeDef *phcan)
 {
-//if (pctl == pctl1) morse_trap(73);
+	return pctlinst[CANINSTIDX(phcan)];
+}
+
+#ifdef CANTTCM
+/* *********************************************************************
+ * static uint32_t ttcm_toa(struct CAN_CTLBLOCK* pctl, uint32_t t16, struct CANRCVBUF* pcan, uint32_t now);
+ * @brief	: Convert bxCAN 16 bit SOF timestamp to DTW ticks
+ * @param	: pctl = pointer to control block for this CAN module
+ * @param	: t16 = TIME[15:0] from RDTxR or TDTxR (CAN bit times)
+ * @param	: pcan = pointer to msg (for frame length)
+ * @param	: now = DTWTIME after the msg was complete
+ * @return	: DTW tick of the SOF of the msg
+ * *********************************************************************/
+/* The CAN bit clock and the DTW (sysclk) come from the same oscillator, so DTW tick
+   'ttcmanchor' + t16 * 'ttcmtpb' is the SOF time, give or take a multiple of the 
+   CAN timer wrap (65536 bits).  The anchor is started from the first msg, which
+   assumes no interrupt latency, i.e. it can only be late.  After that, any msg that
+   appears to have completed in less than its shortest (no stuff bits) length
+   moves the anchor earlier by the difference.  Msgs must be read within one
+   timer wrap (131 ms at 500K) of their SOF. */
+static uint32_t ttcm_toa(struct CAN_CTLBLOCK* pctl, uint32_t t16, struct CANRCVBUF* pcan, uint32_t now)
+{
+	uint32_t tpb  = pctl->ttcmtpb;
+	uint32_t span = tpb << 16;	// DTW ticks per CAN timer wrap
+	uint32_t dlc  = pcan->dlc & 0xf;
+	uint32_t fmin;	// Shortest frame, SOF through EOF, DTW ticks
+	uint32_t toa;
+	int32_t  lat;	// Apparent latency beyond shortest frame length
+
+	if (dlc > 8) dlc = 8;
+	if ((pcan->id & CAN_RTR_REMOTE) != 0) dlc = 0;
+	fmin = (((pcan->id & CAN_ID_EXT) ? 64 : 44) + (dlc << 3)) * tpb;
+	t16  = (t16 & 0xffff) * tpb;
+
+	if (pctl->ttcmsync != 0)
+	{
+		/* Keep anchor within one wrap before 'now' (DTW wraps are not a multiple of span) */
+		pctl->ttcmanchor += ((now - pctl->ttcmanchor) / span) * span;
+		toa = pctl->ttcmanchor + t16;
+		if ((int32_t)(now - toa) < 0) toa -= span; // SOF was before last CAN timer wrap
+
+		lat = (int32_t)(now - toa - fmin);
+		if (lat < 0)
+		{ // Anchor was late
+			pctl->ttcmanchor += lat;
+			return toa + lat;
+		}
+		if ((uint32_t)lat < (span >> 1))
+			return toa;
+	}
+	/* First msg, or anchor lost (e.g. msg read > 1/2 wrap late): start over */
+	pctl->ttcmsync  += 1;
+	pctl->ttcmanchor = now - fmin - t16;
+	return now - fmin;
+}
+#endif
+#ifdef CANBUSLOAD
+#ifdef CANBUSLOADEXACT
+/* Bit stream state for counting stuff bits */
+struct CANSTUFFW
+{
+	uint32_t crc;   // CRC-15 (CAN polynomial 0x4599)
+	uint32_t last;  // Last bit value (2 = none yet)
+	uint32_t run;   // Number of consecutive bits == 'last'
+	uint32_t stuff; // Count: stuff bits
+};
+/* *********************************************************************
+ * static void stuffbits(struct CANSTUFFW* pw, uint32_t v, uint32_t nbits, uint32_t crc);
+ * @brief	: Add bits (MSB first) to the stream: stuff bit count, and CRC if 'crc' != 0
+ * *********************************************************************/
+static void stuffbits(struct CANSTUFFW* pw, uint32_t v, uint32_t nbits, uint32_t crc)
+{
+	uint32_t b;
+	while (nbits > 0)
+	{
+		nbits -= 1;
+		b = (v >> nbits) & 1;
+		if (crc != 0)
+		{
+			crc = b ^ ((pw->crc >> 14) & 1);
+			pw->crc = (pw->crc << 1) & 0x7fff;
+			if (crc != 0) pw->crc ^= 0x4599;
+			crc = 1;
+		}
+		if (b == pw->last)
+		{
+			pw->run += 1;
+			if (pw->run == 5)
+			{ // Stuff bit: opposite value, starts the next run
+				pw->stuff += 1;
+				pw->last   = b ^ 1;
+				pw->run    = 1;
+			}
+		}
+		else
+		{
+			pw->last = b;
+			pw->run  = 1;
+		}
+	}
+	return;
+}
+#endif
+/* *********************************************************************
+ * static uint32_t framebits(struct CANRCVBUF* pcan);
+ * @brief	: Bits on the bus for a frame: SOF through EOF plus 3 bit intermission
+ * @param	: pcan = pointer to msg
+ * @return	: number of bits, including stuff bits (worst case, or actual)
+ * *********************************************************************/
+static uint32_t framebits(struct CANRCVBUF* pcan)
+{
+	uint32_t dlc = pcan->dlc & 0xf;
+	uint32_t ndata;
+	uint32_t g; // Bits subject to stuffing: SOF through CRC
+
+	ndata = (dlc > 8) ? 8 : dlc;
+	if ((pcan->id & CAN_RTR_REMOTE) != 0) ndata = 0; // Remote: no data field
+	g = ((pcan->id & CAN_ID_EXT) ? 54 : 34) + (ndata << 3);
+
+#ifndef CANBUSLOADEXACT
+	/* Worst case: one stuff bit per four bits after the first */
+	return g + 13 + ((g - 1) >> 2);
+#else
+	struct CANSTUFFW w = {0, 2, 0, 0};
+	uint32_t i;
 
-	struct CAN_CTLBLOCK** ppx = &pctllist[0];
-	while (ppx != ppctllist) // Step through list of pointers 
+	stuffbits(&w, 0, 1, 1);                        // SOF
+	stuffbits(&w, pcan->id >> 21, 11, 1);          // Standard id
+	if ((pcan->id & CAN_ID_EXT) != 0)
+	{
+		stuffbits(&w, 0x3, 2, 1);                   // SRR, IDE
+		stuffbits(&w, (pcan->id >> 3) & 0x3ffff, 18, 1); // Extended id
+		stuffbits(&w, (pcan->id >> 1) & 0x1, 1, 1); // RTR
+		stuffbits(&w, 0, 2, 1);                     // r1, r0
+	}
+	else
 	{
-		if ( (*ppx)->phcan == phcan) break;
-		ppx++;
+		stuffbits(&w, (pcan->id >> 1) & 0x1, 1, 1); // RTR
+		stuffbits(&w, 0, 2, 1);                     // IDE, r0
 	}
-	return *ppx;
+	stuffbits(&w, dlc, 4, 1);                      // DLC
+	for (i = 0; i < ndata; i++)
+		stuffbits(&w, pcan->cd.uc[i], 8, 1);        // Data
+	stuffbits(&w, w.crc, 15, 0);                   // CRC (stuffed, not in CRC)
+
+	return g + 13 + w.stuff;
+#endif
+}
+/* *********************************************************************
+ * static void busloadadd(struct CAN_CTLBLOCK* pctl, uint32_t bits);
+ * @brief	: Add frame bits to the current slot (RX FIFO 1 ISR can preempt the others)
+ * *********************************************************************/
+static void busloadadd(struct CAN_CTLBLOCK* pctl, uint32_t bits)
+{
+	volatile uint32_t* p = &pctl->busload.bits;
+	uint32_t v;
+	do
+	{
+		v = __LDREXW(p) + bits;
+	} while (__STREXW(v, p) != 0);
+	return;
 }
+/* *********************************************************************
+ * static void busloadroll(struct CAN_CTLBLOCK* pctl);
+ * @brief	: End of a slot: update the 100 ms, 1 s and 10 s windows
+ * *********************************************************************/
+static void busloadroll(struct CAN_CTLBLOCK* pctl)
+{
+	struct CANBUSLOADW* pb = &pctl->busload;
+	UBaseType_t uxsave;
+	uint32_t b;
+	uint32_t e;
+
+	if (pb->bitrate == 0) return; // JIC
+
+	uxsave = taskENTER_CRITICAL_FROM_ISR();
+	b = pb->bits;
+	pb->bits = 0;
+	taskEXIT_CRITICAL_FROM_ISR(uxsave);
+
+	/* Bits in a window of 'w' seconds <= bitrate * w, so * 1000 fits in 32 bits
+      for bit rates up to 1M. */
+	pb->sum1 += b - pb->slot1[pb->i1];
+	pb->slot1[pb->i1] = b;
+	pb->load[0] = (b * (1000000 / CANBUSLOADSLOT)) / pb->bitrate;
+	if (pb->load[0] > pb->loadmax) pb->loadmax = pb->load[0];
+	pb->load[1] = (pb->sum1 * 1000) / pb->bitrate;
+
+	pb->i1 += 1;
+	if (pb->i1 >= 10)
+	{ // One second
+		pb->i1 = 0;
+		pb->sum10 += pb->sum1 - pb->slot10[pb->i10];
+		pb->slot10[pb->i10] = pb->sum1;
+		pb->i10 += 1; if (pb->i10 >= 10) pb->i10 = 0;
+		pb->load[2] = (pb->sum10 * 100) / pb->bitrate;
+
+		e = pctl->can_errors.can_txerr;
+		pb->err1 = e - pb->errprev;
+		pb->errprev = e;
+	}
+	return;
+}
+#endif
+/******************************************************************************
+ * void can_iface_busload_tick(void);
+ * @brief 	: Bus load windows (CANBUSLOAD): call from the FreeRTOS tick hook
+*******************************************************************************/
+void can_iface_busload_tick(void)
+{
+#ifdef CANBUSLOAD
+	static uint32_t ticks;
+	int i;
 
-/* Transmission Mailbox 0 complete callback. */
-void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *phcan)
+	ticks += 1;
+	if (ticks < pdMS_TO_TICKS(CANBUSLOADSLOT)) return;
+	ticks = 0;
+
+	for (i = 0; i < CANINSTIDXSZ; i++)
+	{
+		if (pctlinst[i] != NULL) busloadroll(pctlinst[i]);
+	}
+#endif
+	return;
+}
+/* *********************************************************************
+ * static void txdone(volatile struct CAN_POOLBLOCK* p, int8_t status, uint32_t toa, BaseType_t* pwoken);
+ * @brief	: Notify the task that queued the msg (if it asked): msg sent or dropped
+ * @param	: p = pointer to block of msg that is done
+ * @param	: status = 0 sent; -1 dropped
+ * @param	: toa = time the msg went out (sent)
+ * @param	: pwoken = xHigherPriorityTaskWoken for xTaskNotifyFromISR
+ * *********************************************************************/
+static void txdone(volatile struct CAN_POOLBLOCK* p, int8_t status, uint32_t toa, BaseType_t* pwoken)
+{
+	struct CANTXDONE* pdone = p->pdone;
+	if (pdone == NULL) return;
+
+	if (status == 0)
+		pdone->toa = toa;
+	else
+		pdone->dropct += 1;
+	pdone->status  = status;
+	pdone->donect += 1;
+	if (pdone->tskhandle != NULL)
+		xTaskNotifyFromISR(pdone->tskhandle, pdone->notebit, eSetBits, pwoken);
+	return;
+}
+/* *********************************************************************
+ * static void txcomplete(CAN_HandleTypeDef *phcan, uint8_t k);
+ * @brief	: Mailbox k TX complete: loopback, free block, reload mailbox(s)
+ * @param	: phcan = pointer to 'MX CAN handle (control block)
+ * @param	: k = mailbox index 0 - 2
+ * *********************************************************************/
+static void txcomplete(CAN_HandleTypeDef *phcan, uint8_t k)
 {
 	struct CAN_CTLBLOCK* pctl = getpctl(phcan); // Lookup our pointer
 
 	/* Loop back CAN =>TX<= msgs. */
-volatile	struct CAN_POOLBLOCK* p = pctl->pend.plinknext;
+volatile	struct CAN_POOLBLOCK* p = pctl->ptx[k];
 	struct CANRCVBUFN ncan;
-	ncan.pctl = pctl;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if (p == NULL)
+	{ // JIC: nothing was loaded
+		pctl->can_errors.txint_emptylist += 1;
+		loadmbx2(pctl);
+		return;
+	}
 	ncan.can = p->can;
+#ifdef CANTTCM
+	/* TX SOF time */
+  #ifdef CHEATINGONHAL
+	ncan.toa = ttcm_toa(pctl, phcan->Instance->sTxMailBox[k].TDTR >> 16, &ncan.can, DTWTIME);
+  #else
+	ncan.toa = ttcm_toa(pctl, HAL_CAN_GetTxTimestamp(phcan, (CAN_TX_MAILBOX0 << k)), &ncan.can, DTWTIME);
+  #endif
+#else
+	ncan.toa = DTWTIME;
+#endif
 
 if (p->can.id == 0xff000000) dbgcantxctr += 1;
 
+#ifdef CANTXLATENCY
+	if (p->plat != NULL)
+	{
+		uint32_t dtw = DTWTIME;
+		p->plat->txct += 1;
+		txlathist(p->plat->qhist, &p->plat->qmax, p->dtwload - p->dtwput);
+		txlathist(p->plat->whist, &p->plat->wmax, dtw - p->dtwload);
+	}
+#endif
+
 	
 	/* Either loop back all, or msg-by-msg select loopback */
 #ifndef CANMSGLOOPBACKALL
@@ -465,10 +1250,7 @@ if (p->can.id == 0xff000000) dbgcantxctr += 1;
 	if ( (p->x.xb[2] & CANMSGLOOPBACKBIT) != 0)
 #endif
    {
-	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-			*pctl->cirptrs.pwork = ncan;
-			pctl->cirptrs.pwork++;
-			if (pctl->cirptrs.pwork == pctl->cirptrs.pend) pctl->cirptrs.pwork = pctl->cirptrs.pbegin;
+			cirbuf_add(&pctl->cirptrs, &ncan);
 
 			if (pctl->tsknote.tskhandle != NULL)
 			{ // Here, one task will be notified a msg added to circular buffer
@@ -478,45 +1260,132 @@ if (p->can.id == 0xff000000) dbgcantxctr += 1;
 			}
 	}
 
-	moveremove2(pctl);	// remove from pending list, add to free list
-	pctl->abortflag = 0;
-	loadmbx2(pctl);		// Load mailbox 0.  Mailbox should be available/empty.
-//portYIELD_FROM_ISR( xHigherPriorityTaskWoken ); // Trigger scheduler
+	txdone(p, 0, ncan.toa, &xHigherPriorityTaskWoken); // Notify producer, if requested
+#ifdef CANBUSLOAD
+	busloadadd(pctl, framebits(&ncan.can));
+#endif
+
+	moveremove2(pctl, k);	// add to free list
+	pctl->abortflag &= ~(1 << k);
+	loadmbx2(pctl);		// Load empty mailbox(s)
+	portYIELD_FROM_ISR( xHigherPriorityTaskWoken ); // Trigger scheduler
+}
+/* Transmission Mailbox 0, 1, 2 complete callbacks. */
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *phcan)
+{
+	txcomplete(phcan, 0);
+}
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *phcan)
+{
+	txcomplete(phcan, 1);
+}
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *phcan)
+{
+	txcomplete(phcan, 2);
 }
 
-/* Transmission Mailbox 0 Abort callback. */
-void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *phcan)
+/* *********************************************************************
+ * static void txabort(CAN_HandleTypeDef *phcan, uint8_t k);
+ * @brief	: Mailbox k aborted: requeue msg, reload mailbox(s)
+ * *********************************************************************/
+static void txabort(CAN_HandleTypeDef *phcan, uint8_t k)
 {
 #ifdef YESABORTCODE
 	struct CAN_CTLBLOCK* pctl = getpctl(phcan);
-	loadmbx2(pctl);		// Load mailbox 0.  Mailbox should be available/empty.
-	pctl->abortflag = 0;
+  #ifdef CANTXLATENCY
+	if ((pctl->ptx[k] != NULL) && (pctl->ptx[k]->plat != NULL))
+		pctl->ptx[k]->plat->abortct += 1;
+  #endif
+	requeue2(pctl, k);	// Aborted msg goes back on the heap
+	loadmbx2(pctl);		// Load empty mailbox(s), highest priority first
+	pctl->abortflag &= ~(1 << k);
 #endif
 }
+/* Transmission Mailbox 0, 1, 2 Abort callbacks. */
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *phcan)
+{
+	txabort(phcan, 0);
+}
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *phcan)
+{
+	txabort(phcan, 1);
+}
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *phcan)
+{
+	txabort(phcan, 2);
+}
 
 /* Error callback */
 void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *phcan)
 {
 	struct CAN_CTLBLOCK* pctl = getpctl(phcan);
-	if ((phcan->ErrorCode & HAL_CAN_ERROR_TX_ALST0) != 0 )
+	uint32_t alst;
+	uint32_t terr;
+	uint32_t ec;
+	uint8_t k;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+#ifdef CANTXLATENCY
+	struct CANTXLAT* plat;
+#endif
+
+	for (k = 0; k < CANTXMBXHW; k++)
 	{
-		pctl->can_errors.can_tx_alst0_err += 1; // Running ct of arb lost: Mostly for debugging/monitoring
-		if ((pctl->pxprv->plinknext->x.xb[2] & SOFTNART) != 0)
-		{ // Here this msg was not to be re-sent, i.e. NART
-			moveremove2(pctl);	// Remove msg from pending queue
-		}
+		/* HAL error bits for mailbox k: ALST0 0x800, TERR0 0x1000, ALST1 0x2000, ... */
+		alst = (HAL_CAN_ERROR_TX_ALST0 << (k << 1));
+		terr = (HAL_CAN_ERROR_TX_TERR0 << (k << 1));
+		ec = phcan->ErrorCode & (alst | terr);
+		if (ec == 0) continue;
+
+		/* HAL accumulates ErrorCode bits; clear the ones handled here. */
+		phcan->ErrorCode &= ~(alst | terr);
+
+		if (pctl->ptx[k] == NULL) continue; // Mailbox not ours
+#ifdef CANTXLATENCY
+		plat = pctl->ptx[k]->plat; // Stats for this CAN id, or NULL
+#endif
+
+		if ((ec & alst) != 0 )
+		{
+			pctl->can_errors.can_tx_alst0_err += 1; // Running ct of arb lost: Mostly for debugging/monitoring
+#ifdef CANTXLATENCY
+			if (plat != NULL) plat->alstct += 1;
+#endif
+			if ((pctl->ptx[k]->x.xb[2] & SOFTNART) != 0)
+			{ // Here this msg was not to be re-sent, i.e. NART
+				txdone(pctl->ptx[k], -1, 0, &xHigherPriorityTaskWoken);
+				moveremove2(pctl, k);	// Remove msg
+			}
+			else
+			{
+				requeue2(pctl, k);	// Try again, in priority order
+			}
 debugTX1c += 1;
-	}
-	else if ((phcan->ErrorCode & HAL_CAN_ERROR_TX_TERR0) != 0 )
-	{
-		pctl->pxprv->plinknext->x.xb[0] += 1;	// Count errors for this msg
-		if (pctl->pxprv->plinknext->x.xb[0] > pctl->pxprv->plinknext->x.xb[1])
-		{ // Here, too many error, remove from list
-			pctl->can_errors.can_tx_bombed += 1;	// Number of bombouts
-			moveremove2(pctl);	// Remove msg from pending queue
 		}
-	}	
-	loadmbx2(pctl);		// Load mailbox 0.  Mailbox should be available/empty.
+		else
+		{
+			pctl->can_errors.can_txerr += 1;
+#ifdef CANTXLATENCY
+			if (plat != NULL) plat->terrct += 1;
+#endif
+			pctl->ptx[k]->x.xb[0] += 1;	// Count errors for this msg
+			if (pctl->ptx[k]->x.xb[0] > pctl->ptx[k]->x.xb[1])
+			{ // Here, too many error, remove from list
+				pctl->can_errors.can_tx_bombed += 1;	// Number of bombouts
+				txdone(pctl->ptx[k], -1, 0, &xHigherPriorityTaskWoken);
+#ifdef CANTXLATENCY
+				if (plat != NULL) plat->bombct += 1;
+#endif
+				moveremove2(pctl, k);	// Remove msg
+			}
+			else
+			{
+				requeue2(pctl, k);	// Try again, in priority order
+			}
+		}	
+		pctl->abortflag &= ~(1 << k);
+	}
+	loadmbx2(pctl);		// Load empty mailbox(s)
+	portYIELD_FROM_ISR( xHigherPriorityTaskWoken ); // Trigger scheduler
 	return;
 }
 /* *********************************************************************
@@ -529,43 +1398,107 @@ uint32_t dbgcanrxctr;
 
 static void unloadfifo(CAN_HandleTypeDef *phcan, uint32_t RxFifo)
 {
-	struct CANRCVBUFN ncan; // CAN msg plus pctl
-	ncan.toa = DTWTIME;
+	struct CANRCVBUFN ncan; // CAN msg plus time-of-arrival
+	uint32_t n = 0;         // Number of msgs taken from hw FIFO
+	uint32_t dtw = DTWTIME; // Drain start
+#ifdef CANBUSLOAD
+	uint32_t bits = 0;      // Bus bits of msgs in this drain
+#endif
+	ncan.toa = dtw;         // All msgs in this drain, unless CANTTCM
 
-	HAL_StatusTypeDef ret;
 	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	/* FIFO0 & FIFO1 have the same RFxR bit layout: FMP[1:0], FULL, FOVR, RFOM */
+	volatile uint32_t* prfr = (RxFifo == CAN_RX_FIFO0) ? &phcan->Instance->RF0R : &phcan->Instance->RF1R;
+#ifdef CHEATINGONHAL
+	CAN_FIFOMailBox_TypeDef* pfifo = &phcan->Instance->sFIFOMailBox[RxFifo];
+#else
 	CAN_RxHeaderTypeDef header;
 	uint8_t data[8];
+#endif
 
 	struct CAN_CTLBLOCK* pctl = getpctl(phcan); // Lookup pctl given phcan
+	struct CANCIRBUFPTRS* pcir  = &pctl->cirptrs;
+	struct CANRXNOTIFY*   pnote = &pctl->tsknote;
+#ifdef CANRXFIFO1HIPRI
+	if (RxFifo == CAN_RX_FIFO1)
+	{ // FIFO 1 (high priority) has its own ring & notification
+		pcir  = &pctl->cirptrs1;
+		pnote = &pctl->tsknote1;
+	}
+#endif
 
-	do /* Unload hardware RX FIFO */
+	for (;;) /* Unload hardware RX FIFO */
 	{
-// NOTE: this could be done directly and avoid the expand/compress overhead
-// but it would become processor dependent and would cheat on HAL.
-		ret = HAL_CAN_GetRxMessage(pctl->phcan, RxFifo, &header, &data[0]);
-		if (ret == HAL_OK)
-		{
-			/* Setup msg with pctl for our format */
-			ncan.pctl = pctl;
-			canmsg_compress(&ncan.can, &header, &data[0]);
-
-			/* Place on queue for Mailbox task to filter, distribute, notify, etc. */
-			*pctl->cirptrs.pwork = ncan; // Copy struct
-			pctl->cirptrs.pwork++;       // Advance 'add' pointer
-			if (pctl->cirptrs.pwork == pctl->cirptrs.pend) pctl->cirptrs.pwork = pctl->cirptrs.pbegin;
+#ifdef CHEATINGONHAL
+		/* Registers are already in our CANRCVBUF format, so copy directly. */
+		if ((*prfr & CAN_RF0R_FMP0) == 0) break; // FIFO empty
+		ncan.can.id       = pfifo->RIR & ~0x1;   // STID|EXID|IDE|RTR
+		ncan.can.dlc      = pfifo->RDTR & 0xf;   // Drop FMI & TIME
+		ncan.can.cd.ui[0] = pfifo->RDLR;
+		ncan.can.cd.ui[1] = pfifo->RDHR;
+  #ifdef CANTTCM
+		ncan.toa = ttcm_toa(pctl, pfifo->RDTR >> 16, &ncan.can, DTWTIME); // SOF time
+  #endif
+		*prfr = CAN_RF0R_RFOM0; // Release output mailbox (FULL, FOVR are rc_w1: write 0)
+#else
+		if (HAL_CAN_GetRxMessage(pctl->phcan, RxFifo, &header, &data[0]) != HAL_OK)
+			break; // FIFO empty
+		canmsg_compress(&ncan.can, &header, &data[0]);
+  #ifdef CANTTCM
+		ncan.toa = ttcm_toa(pctl, header.Timestamp, &ncan.can, DTWTIME); // SOF time
+  #endif
+#endif
+		/* Place on queue for Mailbox task to filter, distribute, notify, etc. */
+		cirbuf_add(pcir, &ncan);
+		n += 1;
+#ifdef CANRXDIRECT
+		/* Direct dispatch, e.g. MailboxTask 'direct' mailboxes */
+		if (pctl->prxdirect != NULL)
+			(*pctl->prxdirect)(pctl, &ncan, &xHigherPriorityTaskWoken);
+#endif
+#ifdef CANBUSLOAD
+		bits += framebits(&ncan.can);
+#endif
 
 //if (ncan.can.id == 0xe360000c) dbgcanrxctr += 1;
 dbgcanrxctr += 1;
+	} //JIC there is more than one in the hw fifo
+
+	/* FIFO overrun: a msg arrived with all three FIFO mailboxes full and was lost.
+      FOVR is sticky, so this counts overrun episodes seen at drain, not msgs. */
+	if ((*prfr & CAN_RF0R_FOVR0) != 0)
+	{
+		*prfr = CAN_RF0R_FOVR0; // Clear (rc_w1)
+		if (RxFifo == CAN_RX_FIFO0)
+			pctl->can_errors.can_rx0err += 1;
+		else
+			pctl->can_errors.can_rx1err += 1;
+	}
+
+	/* One notification for the whole drain. The task finds how many were added
+      from the ring sequence number ('addseq' - 'takeseq'). */
+	if ((n != 0) && (pnote->tskhandle != NULL))
+	{ // Here, notify one task new msg(s) added to circular buffer
+		xTaskNotifyFromISR(pnote->tskhandle,\
+			pnote->notebit, eSetBits,\
+			&xHigherPriorityTaskWoken );
+	}
+	/* NOTE: With CANRXFIFO1HIPRI the FIFO 1 drain can preempt the FIFO 0 drain, so the
+      debug counts and histogram below are shared and might miss a count. */
+	pctl->rxdrainct += 1;
+	if (n > pctl->rxdrainmax) pctl->rxdrainmax = n;
+#ifdef CANBUSLOAD
+	busloadadd(pctl, bits);
+#endif
+
+	/* ISR duration (excluding entry and HAL IRQ handler dispatch) */
+	dtw = DTWTIME - dtw;
+	pctl->dtwrxisr = dtw;
+	if (dtw > pctl->dtwrxisrmax) pctl->dtwrxisrmax = dtw;
+	n = 32 - __CLZ(dtw); // log2 bucket: 0 = 0 ticks, n = 2^(n-1) <= ticks < 2^n
+	if (n >= CANISRHISTSZ) n = CANISRHISTSZ - 1;
+	pctl->rxisrhist[n] += 1;
 
-			if (pctl->tsknote.tskhandle != NULL)
-			{ // Here, notify one task a new msg added to circular buffer
-				xTaskNotifyFromISR(pctl->tsknote.tskhandle,\
-					pctl->tsknote.notebit, eSetBits,\
-					&xHigherPriorityTaskWoken );
-			}
-		}
-	} while (ret == HAL_OK); //JIC there is more than one in the hw fifo
 	portYIELD_FROM_ISR( xHigherPriorityTaskWoken ); // Trigger scheduler
 }
 /* Rx FIFO 0 message pending callback. */
@@ -576,6 +1509,21 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *phcan)
 }
 /* Rx FIFO 1 message pending callback. */
 void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *phcan)
+{
+#ifndef CANRXFIFO1HIPRI
+	unloadfifo(phcan, CAN_RX_FIFO1);
+#endif
+	/* With CANRXFIFO1HIPRI, FIFO 1 is drained only by 'can_iface_rx1_IRQHandler',
+      at its own priority, even if 'HAL_CAN_IRQHandler' (called from the TX or
+      RX0 IRQ) sees FIFO 1 pending. */
+	return;
+}
+/* *********************************************************************
+ * void can_iface_rx1_IRQHandler(CAN_HandleTypeDef *phcan);
+ * @brief 	: CAN1_RX1_IRQn handler for CANRXFIFO1HIPRI: drain FIFO 1 (only)
+ * @param	: phcan = pointer to 'MX CAN handle (control block)
+ * *********************************************************************/
+void can_iface_rx1_IRQHandler(CAN_HandleTypeDef *phcan)
 {
 	unloadfifo(phcan, CAN_RX_FIFO1);
 	return;
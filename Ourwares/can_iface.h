@@ -7,8 +7,10 @@
 /* 
 'iface is a hack of 'driver'.
 
-Implements the sorted linked list buffer for presenting the highest priority CAN msg
-at all times.
+Implements a bounded binary heap for presenting the highest priority CAN msg
+at all times.  Insert and remove are O(log n), so the time interrupts are
+disabled does not grow (much) with the number of msgs queued.  Msgs with the
+same CAN id keep their order of arrival via an enqueue sequence number.
 */
 
 #ifndef __CAN_IFACE
@@ -16,6 +18,74 @@ at all times.
 
 #define LDR_RESET	8
 
+/* Number of bxCAN TX mailboxes kept loaded at one time (1 - 3).
+   1 = mailbox 0 only: one frame at a time, reload after each TX-complete.
+   3 = up to three frames in hardware; the bxCAN sends the lowest id first
+       (TransmitFifoPriority = DISABLE), so frames go out back-to-back.
+   Only one msg per CAN id is loaded at a time (equal ids go lowest mailbox
+   first, which need not be 'put' order), so a run of one id is reloaded
+   from the TX-complete ISR. */
+#define CANTXMBXNUM 3
+#define CANTXMBXHW  3	// Number of TX mailboxes in bxCAN hardware
+
+/* F103 bxCAN register-level fast path.  RX FIFO and TX mailbox registers
+   (RIR/RDTR/RDLR/RDHR, TIR/TDTR/TDLR/TDHR) are already in the 'struct CANRCVBUF'
+   layout, so they are copied directly, skipping the HAL expand/compress.
+   Comment out to go through HAL_CAN_GetRxMessage/HAL_CAN_AddTxMessage. */
+#define CHEATINGONHAL
+
+/* The options below (CANTTCM through CANBUSLOAD) are off here; a board turns on
+   the ones it uses in its Makefile C_DEFS (-DCANRXDIRECT ...), so every file
+   that includes this header sees the same set. */
+
+/* bxCAN time triggered communication mode (TTCM) hardware timestamps.
+   The bxCAN timer counts CAN bit times; it is captured at SOF into RDTxR/TDTxR
+   TIME[15:0].  The 16 bit capture is converted to DTW ticks, so 'toa' is the SOF
+   time of each msg rather than the time 'unloadfifo' got around to it.  Also
+   applies to TX loopback msgs (TX SOF time).  'MX_CAN_Init' sets MCR:TTCM. 
+   Comment out to use DTWTIME at the start of the FIFO drain. */
+//#define CANTTCM
+
+/* FIFO 1 reserved for high priority CAN ids (the 'psafe' ids of 'canfilter_setup_compile').
+   FIFO 1 is drained by its own IRQ (CAN1_RX1_IRQn) at a higher NVIC priority than the
+   other CAN interrupts, into its own ring with its own task notification bit, and
+   'MailboxTask' takes from it ahead of the FIFO 0 ring.
+   Not defined: both FIFOs feed one ring. */
+//#define CANRXFIFO1HIPRI
+#define CANRX1NVICPRI  5  // NVIC priority; not below configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+#define CANRX1RINGSZ   8  // FIFO 1 ring size (power of two)
+
+/* RX ISR direct dispatch.  The FIFO drain calls 'prxdirect' (when set) for each msg,
+   after it is put on the ring, so a handler (MailboxTask 'direct' mailboxes) can
+   load and notify from the ISR instead of waiting for a task to take it. */
+//#define CANRXDIRECT
+
+/* TX latency stats per CAN id.  Each TX block is stamped with DTWTIME at 'can_driver_put',
+   at mailbox load and at TX complete.  Ids registered with 'can_iface_txlat_add' get
+   log2 histograms of put->load (queue wait) and load->complete (arbitration plus frame),
+   and the arbitration lost, TERR, bomb out and abort counts for that id. */
+//#define CANTXLATENCY
+#define CANTXLATNUM    8  // Max number of CAN ids with TX latency stats (per CAN module)
+#define CANTXLATHISTSZ 20 // Number of log2 buckets (last bucket catches all above)
+#define CANTXLATSHIFT  6  // [0] < 2^6 DTW ticks; [n] = 2^(n+5) <= ticks < 2^(n+6)
+
+/* TX rate limit per CAN id (token bucket).  Ids registered with 'can_iface_txrate_add'
+   get at most 'burst' msgs back-to-back and one per 'interval' ticks on average.
+   A CANREPLACEBYID msg that finds one queued still coalesces (no extra bus time);
+   otherwise an over budget msg is dropped and counted (CANPUT_RATELIMIT). */
+//#define CANTXRATELIMIT
+#define CANTXRATENUM   8  // Max number of rate limited CAN ids (per CAN module)
+
+/* Bus load estimate: bits of each RX (through the filters) and TX complete frame,
+   rolled up by the FreeRTOS tick hook (can_iface_busload_tick) into 100 ms, 1 s and
+   10 s windows.  Frame bits: worst case stuff bits, or with CANBUSLOADEXACT the
+   actual stuff bits (CRC computed; ~1300 cycles per frame in the ISRs).
+   NOTE: frames rejected by the hardware filters are not seen, so with filters
+   set up (canfilter_setup_compile) other nodes' traffic is not counted. */
+//#define CANBUSLOAD
+//#define CANBUSLOADEXACT
+#define CANBUSLOADSLOT  100 // Slot duration (ms): shortest window (10 slots = 1 s)
+
 #ifndef NULL 
 #define NULL	0
 #endif
@@ -27,12 +97,11 @@ at all times.
 #include "FreeRTOS.h"
 #include "task.h"
 
-/* Received CAN msg plus CAN module identification */
-// This allows "someone" to associate the msg with the CAN module
+/* Received CAN msg plus time-of-arrival */
+// The CAN module is implied by the ring (one ring per CAN module) the msg came from
 struct CANRCVBUFN
 {
 	struct CANRCVBUF can;	   // Our standard CAN msg
-	struct CAN_CTLBLOCK* pctl;	// Pointer to control block for this CAN
 	uint32_t toa;              // Time-Of-Arrival: CAN msg arrival
 };
 
@@ -43,19 +112,24 @@ struct CANRXNOTIFY
 
 };
 
-/* Circular buffer pointers for incoming CAN.  CAN module specific. */
+/* Circular buffer (ring) for incoming CAN.  CAN module specific. */
+// Ring size is a power of two; slot = (seq & mask).  'addseq' counts every msg added
+// and never wraps back to the start of the buffer, so a 'take' can tell it was lapped.
+// NOTE: all writers (RX FIFO ISRs, TX loopback ISR) must run at the same NVIC priority.
 struct CANCIRBUFPTRS
 {
-	struct CANRCVBUFN* pbegin;
-	struct CANRCVBUFN* pend;
-	struct CANRCVBUFN* pwork;
+	struct CANRCVBUFN* pbegin; // Start of ring
+	uint32_t mask;             // Ring size - 1
+	volatile uint32_t addseq;  // Sequence number of next msg to be added
 };
 
 /* Task pointers for taking CAN msgs from circular buffer. */
 struct CANTAKEPTR
 {
 	struct CANCIRBUFPTRS* pcir;
-	struct CANRCVBUFN* ptake;
+	uint32_t takeseq;  // Sequence number of next msg to take
+	uint32_t lostct;   // Count: msgs overwritten before this 'take' got to them
+	uint32_t lapct;    // Count: times this 'take' was lapped and resync'd
 };
 
 
@@ -91,13 +165,96 @@ union CAN_X
 #define	SOFTNART	0x01     // 1 = No retries (including arbitration); 0 = retries
 #define NOCANSEND	0x02     // 1 = Do not send to the CAN bus
 #define CANMSGLOOPBACKBIT 0x04  // 1 = Loopback: copy of outgoing msg appears in incoming
+#define CANREPLACEBYID 0x08     // 1 = Replace by id: overwrite payload of a queued msg with same id & bit
+
+/* Max CANREPLACEBYID msgs waiting in the heap that a later put can replace (per CAN
+   module).  The put searches only these, so the time it holds interrupts off does
+   not grow with the queue; past this many a CANREPLACEBYID msg is queued as usual. */
+#define CANREPLACENUM 8
+
+/* Number of log2 buckets in RX ISR DTW tick histogram (last bucket catches all above) */
+#define CANISRHISTSZ 16
+
+/* 'can_driver_put' return codes */
+#define CANPUT_OK        0  // Msg queued
+#define CANPUT_OVERRUN  -1  // Buffer overrun (no free slots for the new msg)
+#define CANPUT_BOGUSID  -2  // Bogus CAN id rejected
+#define CANPUT_NOPCTL   -3  // Control block pointer NULL
+#define CANPUT_RATELIMIT -4 // Over the rate limit for this CAN id: dropped
+
+#ifdef CANTXLATENCY
+/* TX latency stats for one CAN id.  Histogram bucket: see CANTXLATSHIFT. */
+struct CANTXLAT
+{
+	uint32_t id;                    // CAN id (CANRCVBUF format)
+	uint32_t qhist[CANTXLATHISTSZ]; // DTW ticks: 'can_driver_put' to (last) mailbox load
+	uint32_t whist[CANTXLATHISTSZ]; // DTW ticks: mailbox load to TX complete
+	uint32_t qmax;    // Max DTW ticks put to load
+	uint32_t wmax;    // Max DTW ticks load to complete
+	uint32_t txct;    // Count: TX complete
+	uint32_t alstct;  // Count: arbitration lost
+	uint32_t terrct;  // Count: transmit errors
+	uint32_t bombct;  // Count: removed after too many TERRs
+	uint32_t abortct; // Count: aborted for a higher priority msg
+};
+#endif
+
+#ifdef CANTXRATELIMIT
+/* Token bucket for one CAN id.  Credit is in FreeRTOS ticks; a msg costs 'cost'. */
+struct CANTXRATE
+{
+	uint32_t id;     // CAN id (CANRCVBUF format)
+	uint32_t cost;   // Ticks of credit per msg (min average interval)
+	uint32_t cap;    // Max credit (burst * cost)
+	uint32_t level;  // Credit now
+	uint32_t tlast;  // Tick count when 'level' was last updated
+	uint32_t dropct; // Count: msgs dropped, over budget
+};
+#endif
+
+#ifdef CANBUSLOAD
+/* Bus load: 100 ms slots -> 1 s and 10 s sliding windows */
+struct CANBUSLOADW
+{
+	volatile uint32_t bits; // Bits in the current slot (ISRs add)
+	uint32_t slot1[10];     // Bits: each of the last ten 100 ms slots
+	uint32_t slot10[10];    // Bits: each of the last ten 1 s
+	uint32_t sum1;          // Bits: last 1 s (sum of slot1[])
+	uint32_t sum10;         // Bits: last 10 s (sum of slot10[])
+	uint32_t bitrate;       // CAN bits per second (from BTR)
+	uint32_t errprev;       // can_errors.can_txerr at the last 1 s boundary
+	uint32_t err1;          // TX errors (TERR) in the last 1 s
+	uint16_t load[3];       // Bus load, 0.1% units: [0] 100 ms, [1] 1 s, [2] 10 s
+	uint16_t loadmax;       // Max 100 ms bus load (0.1%)
+	uint8_t  i1;            // Index: next slot1[]
+	uint8_t  i10;           // Index: next slot10[]
+};
+#endif
+
+/* Optional notification to the task that queued a msg, when the msg has left
+   (or was dropped).  Set 'CANTXQMSG.pdone', or use 'can_driver_put_done'. */
+struct CANTXDONE
+{
+	osThreadId tskhandle;     // Task to notify
+	uint32_t notebit;         // Notification bit (eSetBits)
+	volatile uint32_t toa;    // Last msg sent: TX SOF (CANTTCM), else DTWTIME at TX complete
+	volatile uint32_t donect; // Running count: msgs completed (sent or dropped)
+	volatile uint32_t dropct; // Running count: msgs dropped (NART arb lost, too many TERRs)
+	volatile int8_t status;   // Last msg: 0 = sent; -1 = dropped
+};
 
 struct CAN_POOLBLOCK	// Used for common CAN TX/RX linked lists
 {
-volatile struct CAN_POOLBLOCK* volatile plinknext;	// Linked list pointer (low value id -> high value)
+volatile struct CAN_POOLBLOCK* volatile plinknext;	// Free list link pointer
 	 struct CANRCVBUF can;		// Msg queued
 	 union  CAN_X x;			// Extra goodies that are different for TX and RX
-
+	 uint32_t seq;          // Enqueue sequence: keeps FIFO order for same CAN id
+	 struct CANTXDONE* pdone; // TX done notification; NULL = none
+#ifdef CANTXLATENCY
+	 struct CANTXLAT* plat; // Stats for this CAN id; NULL = id not registered
+	 uint32_t dtwput;       // DTWTIME: 'can_driver_put'
+	 uint32_t dtwload;      // DTWTIME: (last) mailbox load
+#endif
 };
 
 /* Here: everything you wanted to know about a CAN module (i.e. CAN1, CAN2, CAN3) */
@@ -107,18 +264,64 @@ struct CAN_CTLBLOCK
 
 	struct CAN_POOLBLOCK  frii;	// Always present block, i.e. list pointer head
 
-	uint32_t mbx0;	// CAN id last loaded into Mailbox 0
+	uint32_t mbx[CANTXMBXHW];	// Shadow CAN id last loaded into Mailbox 0, 1, 2
+
+	/* Pending msgs: binary min-heap ordered on (CAN id, seq) */
+	struct CAN_POOLBLOCK** ppheap; // Heap array[0] is the highest priority msg
+	uint16_t heapct;               // Number of msgs in heap
+	uint16_t heapsz;               // Heap array size (= numtx)
+	uint16_t heapctmax;            // Max number of msgs in heap (queue depth high water)
+	uint32_t seq;                  // Running enqueue sequence number
 
-volatile struct CAN_POOLBLOCK  pend;		// Always present block, i.e. list pointer head
-volatile struct CAN_POOLBLOCK* volatile pxprv;	// pxprv->plinknext points to msg being sent.  pxprv is NULL if TX is idle.
+volatile struct CAN_POOLBLOCK* volatile ptx[CANTXMBXHW];	// Msg loaded in mailbox 0, 1, 2.  NULL = mailbox empty
+	uint8_t txbusy;	// Number of mailboxes loaded. 0 = TX is idle.
 
-	uint32_t abortflag;	// 1 = ABRQ0 bit in TSR was set.
+	uint32_t dtwputmax;	// Max DTW ticks 'can_driver_put' held interrupts disabled
+	uint32_t dtwrxisr;	// DTW ticks: last 'unloadfifo' (RX FIFO drain) duration
+	uint32_t dtwrxisrmax;	// DTW ticks: max 'unloadfifo' duration
+	uint32_t rxisrhist[CANISRHISTSZ]; // 'unloadfifo' duration histogram: [n] = 2^(n-1) <= ticks < 2^n
+	uint32_t rxdrainct;	// Count: FIFO drains (one task notification per drain)
+	uint32_t rxdrainmax;	// Max msgs taken from hw FIFO in one drain
+
+#ifdef CANTTCM
+	uint32_t ttcmtpb;	// DTW ticks per CAN bit time
+	uint32_t ttcmanchor;	// DTW tick when CAN timer was zero (mod 65536 bit times)
+	uint32_t ttcmsync;	// Count: anchor (re)initializations
+#endif
+
+	uint32_t abortflag;	// Bit n = ABRQn bit in TSR was set for mailbox n.
+	uint32_t abortct;	// Count: aborts requested (higher priority msg arrived)
+	uint32_t replacect;	// Count: CANREPLACEBYID msgs that overwrote a queued msg
+	struct CAN_POOLBLOCK* prep[CANREPLACENUM]; // CANREPLACEBYID msgs in the heap
+	uint8_t repct;		// Number of 'prep' in use
+	uint32_t repfullct;	// Count: CANREPLACEBYID msgs queued with 'prep' full (not replaceable)
+
+#ifdef CANTXLATENCY
+	struct CANTXLAT* ptxlat[CANTXLATNUM]; // TX latency stats, registered CAN ids
+	uint8_t txlatct;                      // Number of CAN ids registered
+#endif
+#ifdef CANTXRATELIMIT
+	struct CANTXRATE* ptxrate[CANTXRATENUM]; // TX rate limits, registered CAN ids
+	uint8_t txratect;                        // Number of CAN ids registered
+	uint32_t ratedropct;                     // Count: msgs dropped, all ids
+#endif
 
 	/* Circular buffer for incoming CAN msgs.  One per CAN module */
 	struct CANCIRBUFPTRS cirptrs; // struct with circular buffer "add" pointers
 	struct CANRXNOTIFY tsknote;   // Task Handle and notification bit for 'MailboxTask'
+#ifdef CANRXDIRECT
+	/* Called in the RX ISR for each msg; NULL = none */
+	void (*prxdirect)(struct CAN_CTLBLOCK* pctl, struct CANRCVBUFN* pncan, BaseType_t* pwoken);
+#endif
+#ifdef CANRXFIFO1HIPRI
+	struct CANCIRBUFPTRS cirptrs1; // FIFO 1 (high priority) ring
+	struct CANRXNOTIFY tsknote1;   // Task Handle and notification bit for FIFO 1 ring
+#endif
 
 	struct CANWINCHPODCOMMONERRORS can_errors;	// A group of error counts
+#ifdef CANBUSLOAD
+	struct CANBUSLOADW busload;	// Bus load and TX error rate
+#endif
 	uint32_t	bogusct;	// Count of bogus CAN IDs rejected
 	s8 	ret;		   // Return code from routine call
 
@@ -127,11 +330,12 @@ volatile struct CAN_POOLBLOCK* volatile pxprv;	// pxprv->plinknext points to msg
 
 /******************************************************************************/
 struct CAN_CTLBLOCK* can_iface_init(CAN_HandleTypeDef *phcan, uint8_t canidx, uint16_t numtx, uint16_t numrx);
-/* @brief 	: Setup linked list for TX priority sorted buffering
+/* @brief 	: Setup TX pool & priority heap, and RX circular buffer
  * @param	: phcan = Pointer "handle" to HAL control block for CAN module
  * @param	: cannum = CAN module index, CAN1 = 0, CAN2 = 1, CAN3 = 2
  * @param	: numtx = number of CAN msgs for TX buffering
  * @param	: numrx = number of incoming (and loopback) CAN msgs in circular buffer
+ *		:   (rounded up to a power of two)
  * @return	: Pointer to our knows-all control block for this CAN
  *		:  NULL = calloc failed
  *		:  Pointer->ret = pointer to CAN control block for this CAN unit
@@ -142,10 +346,22 @@ int can_driver_put(struct CAN_CTLBLOCK* pctl, struct CANRCVBUF *pcan, u8 maxretr
  * @param	: pcan = pointer to msg: id, dlc, data (common_can.h)
  * @param	: maxretryct =  0 = use TERRMAXCOUNT; not zero = use this value.
  * @param	: bits = Use these bits to set some conditions (see .h file)
- * @return	:  0 = OK; 
- *				: -1 = Buffer overrun (no free slots for the new msg)
- *				: -2 = Bogus CAN id rejected
- *				: -3 = control block pointer NULL
+ * @return	: CANPUT_OK      ( 0) = OK; 
+ *				: CANPUT_OVERRUN (-1) = Buffer overrun (no free slots for the new msg)
+ *				: CANPUT_BOGUSID (-2) = Bogus CAN id rejected
+ *				: CANPUT_NOPCTL  (-3) = control block pointer NULL
+ *				: CANPUT_RATELIMIT (-4) = over rate limit for this CAN id (CANTXRATELIMIT)
+ * NOTE: Callable from any task, or an ISR at or below (numerically >=)
+ *       configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY; does not block.
+ ******************************************************************************/
+int can_driver_put_done(struct CAN_CTLBLOCK* pctl, struct CANRCVBUF *pcan, u8 maxretryct, u8 bits, struct CANTXDONE* pdone);
+/* @brief	: 'can_driver_put' plus notification when the msg has been sent (or dropped)
+ * @param	: pdone = pointer to notification struct (task, bit, toa); NULL = none
+ * @return	: same as 'can_driver_put'
+ * NOTE: The notification is from the TX complete (or error) ISR: pdone->toa is the time
+ *       the msg went out, pdone->status 0 = sent, -1 = dropped.  A CANREPLACEBYID msg
+ *       only overwrites a queued msg with the same 'pdone' (e.g. both NULL), so each
+ *       producer still gets its notification; with a different 'pdone' it is queued.
  ******************************************************************************/
 struct CANTAKEPTR* can_iface_add_take(struct CAN_CTLBLOCK*  pctl);
 /* @brief 	: Create a 'take' pointer for accessing CAN msgs in the circular buffer
@@ -159,10 +375,45 @@ struct CANTAKEPTR* can_iface_mbx_init(struct CAN_CTLBLOCK*  pctl, osThreadId tsk
  * @param	: notebit = notification bit if notifications used
  * @return	: pointer to pointer pointing to 'take' location in circular CAN buffer 
 *******************************************************************************/
+struct CANTAKEPTR* can_iface_mbx_init_hipri(struct CAN_CTLBLOCK*  pctl, osThreadId tskhandle, uint32_t notebit);
+/* @brief 	: Initialize notification and get a 'take' pointer for the FIFO 1 (high priority) ring
+ * @param	: tskhandle = task handle that will be used for notification; NULL = use current task
+ * @param	: notebit = notification bit
+ * @return	: pointer to pointer pointing to 'take' location in FIFO 1 ring; NULL = failed,
+ *          :   or CANRXFIFO1HIPRI not defined
+*******************************************************************************/
+void can_iface_rx1_IRQHandler(CAN_HandleTypeDef *phcan);
+/* @brief 	: CAN1_RX1_IRQn handler for CANRXFIFO1HIPRI: drain FIFO 1 (only)
+ * @param	: phcan = pointer to 'MX CAN handle (control block)
+*******************************************************************************/
+int can_iface_txlat_add(struct CAN_CTLBLOCK* pctl, uint32_t id);
+/* @brief 	: Register a CAN id for TX latency stats (CANTXLATENCY)
+ * @param	: pctl = pointer to our CAN control block
+ * @param	: id = CAN id (CANRCVBUF format)
+ * @return	: >= 0 = index into pctl->ptxlat[] (already registered returns its index)
+ *          :   -1 = table full; -2 = calloc failed; -3 = CANTXLATENCY not defined
+ * NOTE: Call during initialization, before msgs with this id are queued.
+*******************************************************************************/
+void can_iface_busload_tick(void);
+/* @brief 	: Bus load windows (CANBUSLOAD): call from the FreeRTOS tick hook
+*******************************************************************************/
+int can_iface_txrate_add(struct CAN_CTLBLOCK* pctl, uint32_t id, uint32_t interval, uint32_t burst);
+/* @brief 	: Rate limit a CAN id (CANTXRATELIMIT): token bucket
+ * @param	: pctl = pointer to our CAN control block
+ * @param	: id = CAN id (CANRCVBUF format)
+ * @param	: interval = min average FreeRTOS ticks between msgs (> 0)
+ * @param	: burst = number of msgs allowed back-to-back (> 0)
+ * @return	: >= 0 = index into pctl->ptxrate[] (already registered is updated)
+ *          :   -1 = table full or bad interval/burst; -2 = calloc failed;
+ *          :   -3 = CANTXRATELIMIT not defined
+ * NOTE: Call during initialization.  The bucket starts full.
+*******************************************************************************/
 struct CANRCVBUFN* can_iface_get_CANmsg(struct CANTAKEPTR* p);
 /* @brief 	: Get a pointer to the next available CAN msg and step ahead in the circular buffer
  * @brief	: p = pointer to struct with 'take' and 'add' pointers
  * @return	: pointer to CAN msg struct; NULL = no msgs available.
+ * NOTE: If the 'take' was lapped it resyncs to the oldest msg still in the ring and
+ *       adds the skipped msgs to p->lostct.
 *******************************************************************************/
 
 #endif 
@@ -0,0 +1,127 @@
+/******************************************************************************
+* File Name          : can_txsched.c
+* Date First Issued  : 10/17/2026
+* Description        : Periodic CAN msgs: table driven from the FreeRTOS tick
+*******************************************************************************/
+/*
+Each table entry has a period, a phase offset and a "latest payload" slot.  The
+owning task only updates the payload (can_txsched_update); the FreeRTOS tick hook
+(can_txsched_tick) puts each msg into the CAN driver when it is due, so a periodic
+msg costs no task wakeup, and msgs with different phases never queue together.
+
+The due times are aligned to multiples of the period, plus the phase, so two
+entries with the same period keep their stagger regardless of when they were added.
+
+Jitter: DTWTIME is recorded at each put and the min/max interval between puts is
+kept per entry (dtwmax - dtwmin).  This is the enqueue timing; the time the msg
+reaches the bus also depends on bus traffic.  DTW wraps in ~59 secs (72 MHz), so
+the min/max is meaningful for periods shorter than that.
+*/
+#include "can_txsched.h"
+#include "DTW_counter.h"
+
+struct CANTXSCHED cantxschedtbl[CANTXSCHEDNUM];
+uint8_t cantxschedct = 0; // Number of entries in use
+
+/* *************************************************************************
+ * struct CANTXSCHED* can_txsched_add(struct CANTXQMSG* pmsg, uint32_t period, uint32_t phase);
+ * @brief	: Add a periodic CAN msg to the table
+ * @param	: pmsg   = pointer to msg: control block, CAN id, dlc, retry ct, bits (copied)
+ * @param	: period = ticks between msgs (> 0)
+ * @param	: phase  = ticks offset from the start of the schedule (stagger msgs)
+ * @return	: pointer to table entry; NULL = table full or period zero
+ * *************************************************************************/
+struct CANTXSCHED* can_txsched_add(struct CANTXQMSG* pmsg, uint32_t period, uint32_t phase)
+{
+	struct CANTXSCHED* p;
+	TickType_t now;
+
+	if (period == 0) return NULL;
+
+taskENTER_CRITICAL();
+	if (cantxschedct >= CANTXSCHEDNUM){ taskEXIT_CRITICAL(); return NULL;}
+
+	p = &cantxschedtbl[cantxschedct];
+	p->msg    = *pmsg;
+	p->period = period;
+	p->phase  = phase % period;
+	now = xTaskGetTickCount();
+	p->due    = ((now / period) + 1) * period + p->phase; // Next aligned slot
+	p->sentct = 0;
+	p->failct = 0;
+	p->skipct = 0;
+	p->valid  = 0;
+	can_txsched_jitter_reset(p);
+
+	cantxschedct += 1; // Entry complete before the tick hook sees it
+taskEXIT_CRITICAL();
+	return p;
+}
+/* *************************************************************************
+ * void can_txsched_update(struct CANTXSCHED* p, struct CANRCVBUF* pcan);
+ * @brief	: Load latest payload: the next period sends it
+ * @param	: p    = pointer to table entry (from 'can_txsched_add')
+ * @param	: pcan = pointer to CAN msg (id, dlc, payload copied)
+ * *************************************************************************/
+void can_txsched_update(struct CANTXSCHED* p, struct CANRCVBUF* pcan)
+{
+	if (p == NULL) return;
+
+taskENTER_CRITICAL(); // Tick hook must not send a half updated payload
+	p->msg.can = *pcan;
+	p->valid   = 1;
+taskEXIT_CRITICAL();
+	return;
+}
+/* *************************************************************************
+ * void can_txsched_jitter_reset(struct CANTXSCHED* p);
+ * @brief	: Restart the min/max interval (jitter) measurement of an entry
+ * @param	: p    = pointer to table entry
+ * *************************************************************************/
+void can_txsched_jitter_reset(struct CANTXSCHED* p)
+{
+	p->dtwmin = 0xffffffff;
+	p->dtwmax = 0;
+	return;
+}
+/* *************************************************************************
+ * void can_txsched_tick(void);
+ * @brief	: Put msgs that are due into the CAN driver
+ * NOTE: Call from 'vApplicationTickHook' (FreeRTOS tick interrupt)
+ * *************************************************************************/
+void can_txsched_tick(void)
+{
+	struct CANTXSCHED* p    = &cantxschedtbl[0];
+	struct CANTXSCHED* pend = &cantxschedtbl[cantxschedct];
+	TickType_t now = xTaskGetTickCountFromISR();
+	uint32_t dtw;
+
+	for ( ; p < pend; p++)
+	{
+		if ((int32_t)(now - p->due) < 0) continue; // Not due
+
+		p->due += p->period;
+		if ((int32_t)(now - p->due) >= 0)
+		{ // More than a period behind: skip rather than send a burst
+			p->skipct += 1;
+			p->due = now + p->period;
+		}
+		if (p->valid == 0) continue; // No payload loaded yet
+
+		dtw = DTWTIME;
+		if (can_driver_put_done(p->msg.pctl, &p->msg.can, p->msg.maxretryct, p->msg.bits, p->msg.pdone) != CANPUT_OK)
+		{
+			p->failct += 1;
+			continue;
+		}
+		if (p->sentct != 0)
+		{ // Interval between this put and the previous
+			p->dtwprev = dtw - p->dtwprev;
+			if (p->dtwprev < p->dtwmin) p->dtwmin = p->dtwprev;
+			if (p->dtwprev > p->dtwmax) p->dtwmax = p->dtwprev;
+		}
+		p->dtwprev = dtw;
+		p->sentct += 1;
+	}
+	return;
+}
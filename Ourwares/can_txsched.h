@@ -0,0 +1,61 @@
+/******************************************************************************
+* File Name          : can_txsched.h
+* Date First Issued  : 10/17/2026
+* Description        : Periodic CAN msgs: table driven from the FreeRTOS tick
+*******************************************************************************/
+
+#ifndef __CAN_TXSCHED
+#define __CAN_TXSCHED
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "CanTask.h"
+#include "can_iface.h"
+
+#define CANTXSCHEDNUM  8  // Max number of periodic msgs in the table
+
+/* One periodic CAN msg */
+struct CANTXSCHED
+{
+	struct CANTXQMSG msg; // Latest payload, CAN control block, retry ct, bits
+	uint32_t period;      // Period (FreeRTOS ticks)
+	uint32_t phase;       // Phase offset (ticks) from the start of the schedule
+	uint32_t due;         // Tick count when next msg is due
+	uint32_t dtwprev;     // DTWTIME at last put
+	uint32_t dtwmin;      // Min DTW ticks between puts (jitter = dtwmax - dtwmin)
+	uint32_t dtwmax;      // Max DTW ticks between puts
+	uint32_t sentct;      // Running count: msgs put into the CAN driver
+	uint32_t failct;      // Running count: can_driver_put returned an error
+	uint32_t skipct;      // Running count: periods skipped (tick fell behind 'due')
+	uint8_t  valid;       // 0 = payload not loaded yet (nothing sent)
+};
+
+/* *************************************************************************/
+struct CANTXSCHED* can_txsched_add(struct CANTXQMSG* pmsg, uint32_t period, uint32_t phase);
+/* @brief	: Add a periodic CAN msg to the table
+ * @param	: pmsg   = pointer to msg: control block, CAN id, dlc, retry ct, bits (copied)
+ * @param	: period = ticks between msgs (> 0)
+ * @param	: phase  = ticks offset from the start of the schedule (stagger msgs)
+ * @return	: pointer to table entry; NULL = table full or period zero
+ * NOTE: Nothing is sent until the first 'can_txsched_update'.
+ * *************************************************************************/
+void can_txsched_update(struct CANTXSCHED* p, struct CANRCVBUF* pcan);
+/* @brief	: Load latest payload: the next period sends it
+ * @param	: p    = pointer to table entry (from 'can_txsched_add')
+ * @param	: pcan = pointer to CAN msg (id, dlc, payload copied)
+ * *************************************************************************/
+void can_txsched_tick(void);
+/* @brief	: Put msgs that are due into the CAN driver
+ * NOTE: Call from 'vApplicationTickHook' (FreeRTOS tick interrupt)
+ * *************************************************************************/
+void can_txsched_jitter_reset(struct CANTXSCHED* p);
+/* @brief	: Restart the min/max interval (jitter) measurement of an entry
+ * @param	: p    = pointer to table entry
+ * *************************************************************************/
+
+extern struct CANTXSCHED cantxschedtbl[CANTXSCHEDNUM];
+extern uint8_t cantxschedct; // Number of entries in use
+
+#endif
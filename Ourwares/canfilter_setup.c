@@ -1,8 +1,16 @@
 /******************************************************************************
 * File Name          : canfilter_setup.c
 * Date First Issued  : 01/10/2019
-* Description        : CAN FreeRTOS/ST HAL: Hardware filtering. (32b only)
+* Description        : CAN FreeRTOS/ST HAL: Hardware filtering.
 *******************************************************************************/
+/*
+10/17/2026 - Add 'canfilter_setup_compile': pack a set of CAN ids into the fewest
+  filter banks (16b list for 11b ids, mask mode for aligned runs, 32b list for
+  29b ids), with safety critical ids going to FIFO 1.
+10/17/2026 - Add 'canfilter_setup_table': load banks precomputed on the host
+  (canmap_gen.c runs 'canfilter_setup_compile' at build time).
+*/
+#include <string.h>
 #include "canfilter_setup.h"
 
 #include "CanTask.h"
@@ -14,8 +22,21 @@ struct CANFILTERW
 	uint8_t banknum;         // Filter bank number: next available (pair 32b words)
 	uint8_t odd;             // Filter bank 32b reg pair, next : 0 = even, 1 = odd					
 	uint8_t oto_sw;          // OTO setup switch for struct
+	int8_t banksleft;        // Banks not used by 'canfilter_setup_compile'
+};
+
+/* Accumulates entries for one filter bank in 'canfilter_setup_compile' */
+struct CANFILTERACC
+{
+	uint32_t v[4];           // 16b: up to four values (or two value:mask pairs); 32b: two
+	uint8_t  n;              // Number of words loaded
+	uint8_t  nmax;           // Words per bank: 4 (16b list), 2 (16b mask, 32b list), 1 (32b mask)
+	uint8_t  mode;           // CAN_FILTERMODE_IDLIST or CAN_FILTERMODE_IDMASK
+	uint8_t  scale;          // CAN_FILTERSCALE_16BIT or CAN_FILTERSCALE_32BIT
 };
 
+static uint32_t canfiltwk[CANFILTERMAXIDS]; // Sorted ids for one FIFO
+
 static struct CANFILTERW canfilt1 = {0};
 static struct CANFILTERW canfilt2 = {0};
 static struct CANFILTERW canfilt3 = {0};
@@ -202,3 +223,411 @@ HAL_StatusTypeDef canfilter_setup_add32b_id(uint8_t cannum, CAN_HandleTypeDef *p
 	return ret;
 }
 
+
+/* *************************************************************************
+ * static struct CANFILTERW* getcanfilt(uint8_t cannum, CAN_HandleTypeDef *phcan);
+ * @brief	: Filter working struct for CAN module, with 'first' setup made
+ * @param	: cannum = CAN module number 1, 2, or 3
+ * @param	: phcan = Pointer to HAL CAN handle (control block)
+ * @return	: pointer to struct; NULL = bad cannum
+ * *************************************************************************/
+static struct CANFILTERW* getcanfilt(uint8_t cannum, CAN_HandleTypeDef *phcan)
+{
+	struct CANFILTERW* p;
+
+	switch(cannum)
+	{
+	case 1:	p = &canfilt1; break; // CAN 1
+	case 2: 	p = &canfilt2; break; // CAN 2
+	case 3:	p = &canfilt3; break; // CAN 3
+	default:		return NULL;
+	}
+	/* Make sure the first setup was made */
+	if ((p->oto_sw == 0) && (phcan != NULL))
+	{ // If not setup, use default for CAN2 bank demarcation
+		if (canfilter_setup_first(cannum, phcan, 14) == HAL_ERROR) return NULL;
+	}
+	return p;
+}
+/* *************************************************************************
+ * static void bankrange(struct CANFILTERW* p, uint8_t cannum, uint8_t* pbeg, uint8_t* pend);
+ * @brief	: Filter banks available to a CAN module
+ * @param	: p = pointer to filter working struct
+ * @param	: cannum = CAN module number 1, 2, or 3
+ * @param	: pbeg = first bank number; pend = first bank number not available
+ * *************************************************************************/
+static void bankrange(struct CANFILTERW* p, uint8_t cannum, uint8_t* pbeg, uint8_t* pend)
+{
+	if (cannum == 2)
+	{ // CAN2: from demarcation to end
+		*pbeg = p->filt.SlaveStartFilterBank;
+		*pend = CANFILTERNBANKS;
+	}
+	else
+	{ // CAN1 (CAN3): from zero to demarcation (F103: demarcation beyond last bank)
+		*pbeg = 0;
+		*pend = (p->filt.SlaveStartFilterBank < CANFILTERNBANKS) ? 
+			p->filt.SlaveStartFilterBank : CANFILTERNBANKS;
+	}
+	return;
+}
+/* *************************************************************************
+ * static int banksoff(struct CANFILTERW* p, CAN_HandleTypeDef *phcan, uint8_t bankend);
+ * @brief	: Turn off banks from 'p->banknum' to 'bankend', e.g. 'first' accept-all,
+ *          : or earlier 'add's
+ * @return	: >= 0 = number of filter banks left; -4 = HAL error
+ * *************************************************************************/
+static int banksoff(struct CANFILTERW* p, CAN_HandleTypeDef *phcan, uint8_t bankend)
+{
+	int n;
+
+	p->banksleft = bankend - p->banknum;
+	for (n = p->banknum; n < bankend; n++)
+	{
+		p->filt.FilterBank       = n;
+		p->filt.FilterActivation = DISABLE;
+		if (HAL_CAN_ConfigFilter(phcan, &p->filt) != HAL_OK) return -4;
+	}
+	p->filt.FilterActivation = ENABLE;
+
+	return p->banksleft;
+}
+/* *************************************************************************
+ * static int bankflush(struct CANFILTERW* p, CAN_HandleTypeDef *phcan, struct CANFILTERACC* pa, uint8_t fifo, uint8_t bankend);
+ * @brief	: Store accumulated entries in the next filter bank
+ * @param	: p = pointer to filter working struct
+ * @param	: phcan = Pointer to HAL CAN handle (control block)
+ * @param	: pa = pointer to accumulated entries for one bank
+ * @param	: fifo = fifo: 0 or 1
+ * @param	: bankend = first bank number not available to this CAN module
+ * @return	: 0 = OK; -3 = out of banks; -4 = HAL error
+ * *************************************************************************/
+static int bankflush(struct CANFILTERW* p, CAN_HandleTypeDef *phcan, struct CANFILTERACC* pa, uint8_t fifo, uint8_t bankend)
+{
+	if (pa->n == 0) return 0;	// Nothing accumulated
+	if (p->banknum >= bankend) return -3;
+
+	/* Unused list slots repeat an id; unused mask pair repeats the first pair */
+	while (pa->n < pa->nmax)
+	{
+		pa->v[pa->n] = pa->v[pa->n - ((pa->mode == CAN_FILTERMODE_IDMASK) ? 2 : 1)];
+		pa->n += 1;
+	}
+
+	p->filt.FilterBank  = p->banknum;
+	p->filt.FilterMode  = pa->mode;
+	p->filt.FilterScale = pa->scale;
+	if (pa->scale == CAN_FILTERSCALE_16BIT)
+	{ // FR1 = MaskIdLow:IdLow, FR2 = MaskIdHigh:IdHigh (mask mode: mask:id in each)
+		p->filt.FilterIdLow      = pa->v[0];
+		p->filt.FilterMaskIdLow  = pa->v[1];
+		p->filt.FilterIdHigh     = pa->v[2];
+		p->filt.FilterMaskIdHigh = pa->v[3];
+	}
+	else
+	{ // FR1 = IdHigh:IdLow, FR2 = MaskIdHigh:MaskIdLow (id:mask, or 2nd id)
+		p->filt.FilterIdHigh     = (pa->v[0] >> 16) & 0xffff;
+		p->filt.FilterIdLow      = (pa->v[0] >>  0) & 0xffff;
+		p->filt.FilterMaskIdHigh = (pa->v[1] >> 16) & 0xffff;
+		p->filt.FilterMaskIdLow  = (pa->v[1] >>  0) & 0xffff;
+	}
+	p->filt.FilterFIFOAssignment = fifo & 0x1;
+	p->filt.FilterActivation     = ENABLE;
+	if (HAL_CAN_ConfigFilter(phcan, &p->filt) != HAL_OK) return -4;
+
+	p->banknum += 1;
+	pa->n = 0;
+	return 0;
+}
+/* *************************************************************************
+ * static int runlen(uint32_t* pk, int n, int i, uint8_t shift, uint32_t lenmax);
+ * @brief	: Largest aligned power-of-two block of consecutive ids starting at pk[i]
+ * @param	: pk = pointer to sorted, unique ids
+ * @param	: n = number of ids
+ * @param	: i = index of starting id
+ * @param	: shift = id bit position of the key that steps by one (21: STID, 3: EXID:STID)
+ * @param	: lenmax = largest block size allowed
+ * @return	: block size (1, 2, 4, ...)
+ * *************************************************************************/
+static int runlen(uint32_t* pk, int n, int i, uint8_t shift, uint32_t lenmax)
+{
+	uint32_t len = 1;
+	while (((len << 1) <= lenmax) &&                                    // Block not too large
+	       (((pk[i] >> shift) & ((len << 1) - 1)) == 0) &&               // Start aligned to block
+	       ((i + (int)(len << 1)) <= n) &&                               // Enough ids left
+	       (pk[i + (len << 1) - 1] == pk[i] + (((len << 1) - 1) << shift))) // All ids present
+	{
+		len <<= 1;
+	}
+	return len;
+}
+/* *************************************************************************
+ * static int compile1(struct CANFILTERW* p, CAN_HandleTypeDef *phcan, uint32_t* pk, int n, uint8_t fifo, uint8_t bankend);
+ * @brief	: Pack sorted, unique ids into filter banks for one FIFO
+ * @return	: 0 = OK; -3 = out of banks; -4 = HAL error
+ * *************************************************************************/
+/* Key for aligned runs: 11b data frames use STID; 29b data frames use the 29b id.
+   Runs of four or more take a mask entry, which is fewer banks than list mode.
+   RTR ids are only put in list mode. */
+#define STDDATA(id) (((id) & (CAN_ID_EXT | CAN_RTR_REMOTE)) == 0)
+#define EXTDATA(id) (((id) & (CAN_ID_EXT | CAN_RTR_REMOTE)) == CAN_ID_EXT)
+#define ID16(id)    ((((id) >> 16) & 0xffe0) | (((id) & CAN_RTR_REMOTE) << 3)) // STID:RTR:IDE(0):EXID(0)
+
+static int compile1(struct CANFILTERW* p, CAN_HandleTypeDef *phcan, uint32_t* pk, int n, uint8_t fifo, uint8_t bankend)
+{
+	struct CANFILTERACC l16 = {{0}, 0, 4, CAN_FILTERMODE_IDLIST, CAN_FILTERSCALE_16BIT};
+	struct CANFILTERACC m16 = {{0}, 0, 4, CAN_FILTERMODE_IDMASK, CAN_FILTERSCALE_16BIT};
+	struct CANFILTERACC l32 = {{0}, 0, 2, CAN_FILTERMODE_IDLIST, CAN_FILTERSCALE_32BIT};
+	struct CANFILTERACC m32 = {{0}, 0, 2, CAN_FILTERMODE_IDMASK, CAN_FILTERSCALE_32BIT};
+	int i, len, ret;
+	uint32_t id;
+
+	/* 'pk' is sorted on the CANRCVBUF id, i.e. on STID then EXID, so a run of 
+      consecutive 11b or 29b ids is adjacent in 'pk'.  Ids in a run differ only
+      in the key, so they are all the same type (11b/29b data) as the first. */
+	for (i = 0; i < n; i += len)
+	{
+		id  = pk[i];
+		len = 1;
+		if (STDDATA(id))
+		{
+			len = runlen(pk, n, i, 21, 2048); // Run on STID
+			if (len >= 4)
+			{ // Mask entry: STID low bits don't care; RTR, IDE, EXID[17:15] must match
+				m16.v[m16.n++] = ID16(id);
+				m16.v[m16.n++] = ((~((uint32_t)len - 1) << 5) & 0xffe0) | 0x1f;
+				if (m16.n >= m16.nmax) { ret = bankflush(p, phcan, &m16, fifo, bankend); if (ret < 0) return ret; }
+			}
+			else
+			{ // List entry (one id; the rest of a short run come around again)
+				len = 1;
+				l16.v[l16.n++] = ID16(id);
+				if (l16.n >= l16.nmax) { ret = bankflush(p, phcan, &l16, fifo, bankend); if (ret < 0) return ret; }
+			}
+		}
+		else if (EXTDATA(id))
+		{
+			len = runlen(pk, n, i, 3, CANFILTERMAXIDS); // Run on 29b id
+			if (len >= 4)
+			{ // Mask entry: low id bits don't care; IDE, RTR must match
+				m32.v[m32.n++] = id & ~0x1;
+				m32.v[m32.n++] = (~((uint32_t)len - 1) << 3) | 0x6;
+				ret = bankflush(p, phcan, &m32, fifo, bankend); if (ret < 0) return ret;
+			}
+			else
+			{
+				len = 1;
+				l32.v[l32.n++] = id & ~0x1;
+				if (l32.n >= l32.nmax) { ret = bankflush(p, phcan, &l32, fifo, bankend); if (ret < 0) return ret; }
+			}
+		}
+		else
+		{ // RTR: list mode only
+			len = 1;
+			if ((id & CAN_ID_EXT) == 0)
+			{
+				l16.v[l16.n++] = ID16(id);
+				if (l16.n >= l16.nmax) { ret = bankflush(p, phcan, &l16, fifo, bankend); if (ret < 0) return ret; }
+			}
+			else
+			{
+				l32.v[l32.n++] = id & ~0x1;
+				if (l32.n >= l32.nmax) { ret = bankflush(p, phcan, &l32, fifo, bankend); if (ret < 0) return ret; }
+			}
+		}
+	}
+	/* A lone 11b list id fits in the unused half of a partly filled 16b mask bank */
+	if ((l16.n == 1) && (m16.n == 2))
+	{
+		m16.v[2] = l16.v[0];
+		m16.v[3] = 0xffff;
+		m16.n = 4;
+		l16.n = 0;
+	}
+	ret = bankflush(p, phcan, &l16, fifo, bankend); if (ret < 0) return ret;
+	ret = bankflush(p, phcan, &m16, fifo, bankend); if (ret < 0) return ret;
+	ret = bankflush(p, phcan, &l32, fifo, bankend); if (ret < 0) return ret;
+	return 0;
+}
+/* *************************************************************************
+ * static int sortids(uint32_t* pid, uint16_t nid, uint32_t* pex, uint16_t nex);
+ * @brief	: Copy ids (less those in an exclude list) to 'canfiltwk', sort, drop duplicates
+ * @param	: pid = pointer to ids; nid = number of ids
+ * @param	: pex = pointer to ids to exclude; NULL = none; nex = number of ids to exclude
+ * @return	: number of ids in 'canfiltwk'; -2 = too many
+ * *************************************************************************/
+static int sortids(uint32_t* pid, uint16_t nid, uint32_t* pex, uint16_t nex)
+{
+	int i, j, n = 0;
+	uint32_t id;
+
+	for (i = 0; i < nid; i++)
+	{
+		id = pid[i] & ~0x1; // Drop TXRQ bit position
+		for (j = 0; j < nex; j++) if ((pex[j] & ~0x1) == id) break;
+		if ((pex != NULL) && (j < nex)) continue; // Excluded
+
+		/* Insertion sort, skipping duplicates */
+		for (j = n; (j > 0) && (canfiltwk[j-1] > id); j--);
+		if ((j > 0) && (canfiltwk[j-1] == id)) continue; // Duplicate
+		if (n >= CANFILTERMAXIDS) return -2;
+		memmove(&canfiltwk[j+1], &canfiltwk[j], (n - j) * sizeof(uint32_t));
+		canfiltwk[j] = id;
+		n += 1;
+	}
+	return n;
+}
+/* *************************************************************************
+ * int canfilter_setup_compile(uint8_t cannum, CAN_HandleTypeDef *phcan, \
+    uint32_t* pid,   \
+    uint16_t  nid,   \
+    uint32_t* psafe, \
+    uint16_t  nsafe );
+ * @brief	: Replace the filter banks for a CAN module with the fewest banks that pass 
+ *          : exactly the given ids: 16b list mode for 11b ids (four per bank),
+ *          : mask mode for aligned runs of ids, 32b list mode for 29b ids (two per bank)
+ * @param	: cannum = CAN module number 1, 2, or 3
+ * @param	: phcan = Pointer to HAL CAN handle (control block)
+ * @param	: pid   = pointer to array of CAN ids (CANRCVBUF format) to pass to FIFO 0
+ * @param	: nid   = number of CAN ids in 'pid' array
+ * @param	: psafe = pointer to array of (safety critical) CAN ids to pass to FIFO 1; NULL = none
+ * @param	: nsafe = number of CAN ids in 'psafe' array
+ * @return	: >= 0 = number of filter banks left for this CAN module
+ *          :   -1 = bad cannum or phcan; -2 = too many ids; -3 = not enough banks;
+ *          :   -4 = HAL_CAN_ConfigFilter returned error
+ * NOTE: An id in both lists goes to FIFO 1.  No ids at all leaves 'first' (accept all).
+ * *************************************************************************/
+int canfilter_setup_compile(uint8_t cannum, CAN_HandleTypeDef *phcan, \
+    uint32_t* pid,   \
+    uint16_t  nid,   \
+    uint32_t* psafe, \
+    uint16_t  nsafe )
+{
+	struct CANFILTERW* p;
+	uint8_t bankbeg, bankend;
+	int n, ret;
+
+	if (phcan == NULL) return -1;
+	p = getcanfilt(cannum, phcan);
+	if (p == NULL) return -1;
+	if (psafe == NULL) nsafe = 0;
+	if (pid   == NULL) nid   = 0;
+
+	/* Banks for this CAN module */
+	bankrange(p, cannum, &bankbeg, &bankend);
+	if ((nid + nsafe) == 0)
+	{ // Here, leave 'first' accept-all in place
+		p->banksleft = bankend - bankbeg - 1;
+		return p->banksleft;
+	}
+
+	p->banknum = bankbeg;
+	p->odd     = 0;
+
+	/* FIFO 1: safety critical ids */
+	n = sortids(psafe, nsafe, NULL, 0);
+	if (n < 0) return n;
+	ret = compile1(p, phcan, &canfiltwk[0], n, 1, bankend);
+	if (ret < 0) return ret;
+
+	/* FIFO 0: the rest */
+	n = sortids(pid, nid, psafe, nsafe);
+	if (n < 0) return n;
+	ret = compile1(p, phcan, &canfiltwk[0], n, 0, bankend);
+	if (ret < 0) return ret;
+
+	return banksoff(p, phcan, bankend);
+}
+/* *************************************************************************
+ * int canfilter_setup_table(uint8_t cannum, CAN_HandleTypeDef *phcan, \
+    const struct CANFILTERBANK* pbank, \
+    uint8_t nbank );
+ * @brief	: Replace the filter banks for a CAN module with precomputed banks
+ * @param	: cannum = CAN module number 1, 2, or 3
+ * @param	: phcan = Pointer to HAL CAN handle (control block)
+ * @param	: pbank = pointer to banks (e.g. generated 'canmap_filt')
+ * @param	: nbank = number of banks
+ * @return	: same as 'canfilter_setup_compile'
+ * NOTE: No sorting or packing: the words were made by 'canfilter_setup_compile'
+ *       on the host (canmap_gen.c).  No banks at all leaves 'first' (accept all).
+ * *************************************************************************/
+int canfilter_setup_table(uint8_t cannum, CAN_HandleTypeDef *phcan, \
+    const struct CANFILTERBANK* pbank, \
+    uint8_t nbank )
+{
+	struct CANFILTERW* p;
+	uint8_t bankbeg, bankend;
+	int i;
+
+	if ((phcan == NULL) || (pbank == NULL)) return -1;
+	p = getcanfilt(cannum, phcan);
+	if (p == NULL) return -1;
+
+	bankrange(p, cannum, &bankbeg, &bankend);
+	if (nbank == 0)
+	{ // Here, leave 'first' accept-all in place
+		p->banksleft = bankend - bankbeg - 1;
+		return p->banksleft;
+	}
+	if (nbank > (bankend - bankbeg)) return -3;
+
+	for (i = 0; i < nbank; i++, pbank++)
+	{
+		p->filt.FilterBank           = bankbeg + i;
+		p->filt.FilterMode           = pbank->mode;
+		p->filt.FilterScale          = pbank->scale;
+		p->filt.FilterIdHigh         = (pbank->fr1 >> 16) & 0xffff;
+		p->filt.FilterIdLow          = (pbank->fr1 >>  0) & 0xffff;
+		p->filt.FilterMaskIdHigh     = (pbank->fr2 >> 16) & 0xffff;
+		p->filt.FilterMaskIdLow      = (pbank->fr2 >>  0) & 0xffff;
+		p->filt.FilterFIFOAssignment = pbank->fifo & 0x1;
+		p->filt.FilterActivation     = ENABLE;
+		if (HAL_CAN_ConfigFilter(phcan, &p->filt) != HAL_OK) return -4;
+	}
+	p->banknum = bankbeg + nbank;
+	p->odd     = 0;
+
+	return banksoff(p, phcan, bankend);
+}
+/* *************************************************************************
+ * int canfilter_setup_mbx(uint8_t cannum, CAN_HandleTypeDef *phcan, \
+    struct MAILBOXCANNUM* pmbxnum, \
+    uint32_t* psafe, \
+    uint16_t  nsafe );
+ * @brief	: 'canfilter_setup_compile' with the CAN ids of the mailboxes registered for a CAN module
+ * @param	: cannum = CAN module number 1, 2, or 3
+ * @param	: phcan = Pointer to HAL CAN handle (control block)
+ * @param	: pmbxnum = pointer to mailbox list for this CAN module, e.g. &mbxcannum[0]
+ * @param	: psafe = pointer to array of (safety critical) CAN ids to pass to FIFO 1; NULL = none
+ * @param	: nsafe = number of CAN ids in 'psafe' array
+ * @return	: same as 'canfilter_setup_compile'
+ * NOTE: Call after the last 'MailboxTask_add' for the CAN module.
+ * *************************************************************************/
+int canfilter_setup_mbx(uint8_t cannum, CAN_HandleTypeDef *phcan, \
+    struct MAILBOXCANNUM* pmbxnum, \
+    uint32_t* psafe, \
+    uint16_t  nsafe )
+{
+	uint32_t ids[CANFILTERMAXIDS];
+	int i;
+
+	if ((pmbxnum == NULL) || (pmbxnum->pmbxarray == NULL)) return -1;
+	if (pmbxnum->arraysizecur > CANFILTERMAXIDS) return -2;
+
+	for (i = 0; i < pmbxnum->arraysizecur; i++)
+		ids[i] = pmbxnum->pmbxarray[i]->ncan.can.id;
+
+	return canfilter_setup_compile(cannum, phcan, &ids[0], pmbxnum->arraysizecur, psafe, nsafe);
+}
+/* *************************************************************************
+ * int canfilter_setup_banksleft(uint8_t cannum);
+ * @brief	: Number of filter banks not used, from last 'canfilter_setup_compile'
+ * @param	: cannum = CAN module number 1, 2, or 3
+ * @return	: number of banks left; -1 = bad cannum
+ * *************************************************************************/
+int canfilter_setup_banksleft(uint8_t cannum)
+{
+	struct CANFILTERW* p = getcanfilt(cannum, NULL);
+	if (p == NULL) return -1;
+	return p->banksleft;
+}
@@ -10,6 +10,20 @@
 #include "stm32f1xx_hal.h"
 #include "stm32f1xx_hal_can.h"
 #include "FreeRTOS.h"
+#include "MailboxTask.h"
+
+#define CANFILTERNBANKS  14  // Number of filter banks: F103 14; F105/F107 (and F4) 28
+#define CANFILTERMAXIDS  32  // Max number of CAN ids handled by 'canfilter_setup_compile'
+
+/* One filter bank, register words precomputed ('canfilter_setup_table') */
+struct CANFILTERBANK
+{
+	uint32_t fr1;    // FilterIdHigh:FilterIdLow
+	uint32_t fr2;    // FilterMaskIdHigh:FilterMaskIdLow
+	uint8_t  mode;   // CAN_FILTERMODE_IDLIST or CAN_FILTERMODE_IDMASK
+	uint8_t  scale;  // CAN_FILTERSCALE_16BIT or CAN_FILTERSCALE_32BIT
+	uint8_t  fifo;   // FIFO: 0 or 1
+};
 
 /* *************************************************************************/
 HAL_StatusTypeDef canfilter_setup_first(uint8_t cannum, CAN_HandleTypeDef *phcan, uint8_t slavebankdmarc);
@@ -42,5 +56,54 @@ HAL_StatusTypeDef canfilter_setup_add32b_id(uint8_t cannum, CAN_HandleTypeDef *p
  * @param	: fifo  = fifo: 0 or 1
  * @return	: HAL_ERROR or HAL_OK
  * *************************************************************************/
+int canfilter_setup_compile(uint8_t cannum, CAN_HandleTypeDef *phcan, \
+    uint32_t* pid,   \
+    uint16_t  nid,   \
+    uint32_t* psafe, \
+    uint16_t  nsafe );
+/* @brief	: Replace the filter banks for a CAN module with the fewest banks that pass 
+ *          : exactly the given ids: 16b list mode for 11b ids (four per bank),
+ *          : mask mode for aligned runs of ids, 32b list mode for 29b ids (two per bank)
+ * @param	: cannum = CAN module number 1, 2, or 3
+ * @param	: phcan = Pointer to HAL CAN handle (control block)
+ * @param	: pid   = pointer to array of CAN ids (CANRCVBUF format) to pass to FIFO 0
+ * @param	: nid   = number of CAN ids in 'pid' array
+ * @param	: psafe = pointer to array of (safety critical) CAN ids to pass to FIFO 1; NULL = none
+ * @param	: nsafe = number of CAN ids in 'psafe' array
+ * @return	: >= 0 = number of filter banks left for this CAN module
+ *          :   -1 = bad cannum or phcan; -2 = too many ids; -3 = not enough banks;
+ *          :   -4 = HAL_CAN_ConfigFilter returned error
+ * NOTE: An id in both lists goes to FIFO 1.  No ids at all leaves 'first' (accept all).
+ * *************************************************************************/
+int canfilter_setup_mbx(uint8_t cannum, CAN_HandleTypeDef *phcan, \
+    struct MAILBOXCANNUM* pmbxnum, \
+    uint32_t* psafe, \
+    uint16_t  nsafe );
+/* @brief	: 'canfilter_setup_compile' with the CAN ids of the mailboxes registered for a CAN module
+ * @param	: cannum = CAN module number 1, 2, or 3
+ * @param	: phcan = Pointer to HAL CAN handle (control block)
+ * @param	: pmbxnum = pointer to mailbox list for this CAN module, e.g. &mbxcannum[0]
+ * @param	: psafe = pointer to array of (safety critical) CAN ids to pass to FIFO 1; NULL = none
+ * @param	: nsafe = number of CAN ids in 'psafe' array
+ * @return	: same as 'canfilter_setup_compile'
+ * NOTE: Call after the last 'MailboxTask_add' for the CAN module.
+ * *************************************************************************/
+int canfilter_setup_table(uint8_t cannum, CAN_HandleTypeDef *phcan, \
+    const struct CANFILTERBANK* pbank, \
+    uint8_t nbank );
+/* @brief	: Replace the filter banks for a CAN module with precomputed banks
+ * @param	: cannum = CAN module number 1, 2, or 3
+ * @param	: phcan = Pointer to HAL CAN handle (control block)
+ * @param	: pbank = pointer to banks (e.g. generated 'canmap_filt')
+ * @param	: nbank = number of banks
+ * @return	: same as 'canfilter_setup_compile'
+ * NOTE: No sorting or packing: the words were made by 'canfilter_setup_compile'
+ *       on the host (canmap_gen.c).  No banks at all leaves 'first' (accept all).
+ * *************************************************************************/
+int canfilter_setup_banksleft(uint8_t cannum);
+/* @brief	: Number of filter banks not used, from last 'canfilter_setup_compile'
+ * @param	: cannum = CAN module number 1, 2, or 3
+ * @return	: number of banks left; -1 = bad cannum
+ * *************************************************************************/
 
 #endif
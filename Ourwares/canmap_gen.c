@@ -0,0 +1,350 @@
+/******************************************************************************
+* File Name          : canmap_gen.c
+* Date First Issued  : 10/17/2026
+* Description        : Host build step: CAN map (.def) to mailbox & filter tables
+*******************************************************************************/
+/*
+Not part of the target build: the Makefile compiles this with the host gcc, linked
+with canfilter_setup.c, and runs it ('make canmap').
+
+The CAN map (e.g. Ourtasks/contactor_canmap.def) is the one place the incoming CAN
+ids are listed, with their paytype, FIFO, task and notification bit.  From it this
+writes C the target only has to link:
+ - mailboxes, initialized (CAN id, paytype, notification blocks)
+ - the mailbox pointer and CAN id arrays, sorted on CAN id (MailboxTask bsearch)
+ - the 'direct' list and a 'struct MBXTABLE' for 'MailboxTask_add_table'
+ - CAN1 filter bank words for 'canfilter_setup_table'
+so startup has no pool allocation, insertion sort, or filter packing.
+
+The filter banks come from running the target's own 'canfilter_setup_compile' with
+HAL_CAN_ConfigFilter replaced by a stub that records what would have been stored.
+
+Build:
+  gcc <target -D & -I> -DCANMAPFILE=\"contactor_canmap.def\" \
+      -DCANMAPGEN=\"contactor_canmap_gen\" canmap_gen.c canfilter_setup.c -o canmap_gen
+Run:
+  canmap_gen h > contactor_canmap_gen.h
+  canmap_gen c > contactor_canmap_gen.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "canfilter_setup.h"
+
+#ifndef CANMAPFILE
+  #error Define CANMAPFILE: the CAN map file name, as a string (see Build above)
+#endif
+#ifndef CANMAPGEN
+  #error Define CANMAPGEN: the generated file base name, as a string (see Build above)
+#endif
+
+/* One CANMAP line */
+struct CANMAPLINE
+{
+	const char* name;  // Symbol suffix
+	uint32_t id;       // CAN id
+	uint8_t  paytype;  // Payload type code
+	uint8_t  fifo;     // 0; 1 = safety critical
+	const char* task;  // Task handle variable name; "NULL" = current task
+	const char* bit;   // Notification bit (as written)
+	uint8_t  direct;   // 1 = loaded in the RX ISR
+};
+
+/* Mailbox: one per CAN id */
+struct CANMAPMBX
+{
+	uint32_t id;
+	uint16_t line;     // First 'map' line (sorted)
+	uint16_t note;     // First notification block
+	uint16_t notect;   // Number of notification blocks
+};
+
+#define CANMAPINCLUDE(f) f,
+#define CANMAP(name,id,paytype,fifo,task,bit,direct)
+static const char* incl[] = {
+#include CANMAPFILE
+NULL};
+#undef CANMAPINCLUDE
+#undef CANMAP
+
+#define CANMAPINCLUDE(f)
+#define CANMAP(name,id,paytype,fifo,task,bit,direct) {#name,id,paytype,fifo,#task,#bit,direct},
+static const struct CANMAPLINE map[] = {
+#include CANMAPFILE
+{NULL,0,0,0,NULL,NULL,0}};
+#undef CANMAPINCLUDE
+#undef CANMAP
+
+#define NMAP ((int)(sizeof(map)/sizeof(map[0])) - 1)
+
+static int sorted[NMAP + 1];      // 'map' index, sorted on CAN id (stable)
+static struct CANMAPMBX mbx[NMAP + 1];
+static int nmbx;
+
+/* Filter banks recorded by the HAL_CAN_ConfigFilter stub */
+static struct CANFILTERBANK bank[CANFILTERNBANKS];
+static uint8_t bankon[CANFILTERNBANKS];
+static int nbank;
+
+/* *************************************************************************
+ * HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, CAN_FilterTypeDef *pf);
+ * @brief	: Stub: record the bank instead of storing it in hardware
+ * *************************************************************************/
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, CAN_FilterTypeDef *pf)
+{
+	uint32_t n = pf->FilterBank;
+
+	if (n >= CANFILTERNBANKS) return HAL_ERROR;
+	bank[n].fr1   = ((pf->FilterIdHigh     & 0xffff) << 16) | (pf->FilterIdLow     & 0xffff);
+	bank[n].fr2   = ((pf->FilterMaskIdHigh & 0xffff) << 16) | (pf->FilterMaskIdLow & 0xffff);
+	bank[n].mode  = pf->FilterMode;
+	bank[n].scale = pf->FilterScale;
+	bank[n].fifo  = pf->FilterFIFOAssignment;
+	bankon[n]     = (pf->FilterActivation == ENABLE);
+	return HAL_OK;
+}
+/* *************************************************************************
+ * static int cmpid(const void* a, const void* b);
+ * @brief	: qsort: CAN id, then file order (notifications keep .def order)
+ * *************************************************************************/
+static int cmpid(const void* a, const void* b)
+{
+	int ia = *(const int*)a;
+	int ib = *(const int*)b;
+
+	if (map[ia].id < map[ib].id) return -1;
+	if (map[ia].id > map[ib].id) return  1;
+	return ia - ib;
+}
+/* *************************************************************************
+ * static void bail(const char* msg, const char* name);
+ * @brief	: Error exit (make stops)
+ * *************************************************************************/
+static void bail(const char* msg, const char* name)
+{
+	fprintf(stderr, "canmap_gen: %s: %s %s\n", CANMAPFILE, msg, (name != NULL) ? name : "");
+	exit(1);
+}
+/* *************************************************************************
+ * static void build(void);
+ * @brief	: Sort, group lines into mailboxes, compile the filter banks
+ * *************************************************************************/
+static void build(void)
+{
+	CAN_HandleTypeDef hcan;
+	uint32_t ids[NMAP + 1];
+	uint32_t safe[NMAP + 1];
+	int nsafe = 0;
+	const struct CANMAPLINE* p;
+	const struct CANMAPLINE* q;
+	int i, ret;
+
+	if (NMAP == 0) bail("no CANMAP lines", NULL);
+
+	for (i = 0; i < NMAP; i++) sorted[i] = i;
+	qsort(&sorted[0], NMAP, sizeof(int), cmpid);
+
+	for (i = 0; i < NMAP; i++)
+	{
+		p = &map[sorted[i]];
+		if (p->id == 0) bail("CAN id zero", p->name);
+		if (p->fifo > 1) bail("FIFO not 0 or 1", p->name);
+		if ((nmbx > 0) && (mbx[nmbx-1].id == p->id))
+		{ // Another subscriber to the same id: same mailbox
+			q = &map[mbx[nmbx-1].line];
+			if ((q->paytype != p->paytype) || (q->fifo != p->fifo) || (q->direct != p->direct))
+				bail("paytype, FIFO or direct differ for the same CAN id", p->name);
+			mbx[nmbx-1].notect += 1;
+			continue;
+		}
+		mbx[nmbx].id     = p->id;
+		mbx[nmbx].line   = sorted[i];
+		mbx[nmbx].note   = i;
+		mbx[nmbx].notect = 1;
+		ids[nmbx] = p->id;
+		if (p->fifo != 0) safe[nsafe++] = p->id;
+		nmbx += 1;
+	}
+
+	/* The target's own packing, into the stub. */
+	memset(&hcan, 0, sizeof(hcan));
+	if (canfilter_setup_first(1, &hcan, CANFILTERNBANKS) != HAL_OK) bail("canfilter_setup_first failed", NULL);
+	ret = canfilter_setup_compile(1, &hcan, &ids[0], nmbx, &safe[0], nsafe);
+	if (ret == -2) bail("more CAN ids than CANFILTERMAXIDS", NULL);
+	if (ret == -3) bail("not enough filter banks", NULL);
+	if (ret <  0)  bail("canfilter_setup_compile failed", NULL);
+
+	while ((nbank < CANFILTERNBANKS) && (bankon[nbank] != 0)) nbank += 1;
+	for (i = nbank; i < CANFILTERNBANKS; i++)
+		if (bankon[i] != 0) bail("filter banks not contiguous", NULL);
+	return;
+}
+/* *************************************************************************
+ * static void guard(char* pout);
+ * @brief	: Include guard from the generated file base name
+ * *************************************************************************/
+static void guard(char* pout)
+{
+	const char* s = CANMAPGEN;
+
+	*pout++ = '_'; *pout++ = '_';
+	for ( ; *s != 0; s++)
+		*pout++ = isalnum((unsigned char)*s) ? toupper((unsigned char)*s) : '_';
+	*pout = 0;
+	return;
+}
+/* *************************************************************************
+ * static int mbxof(uint32_t id);
+ * @brief	: Mailbox index of a CAN id
+ * *************************************************************************/
+static int mbxof(uint32_t id)
+{
+	int k;
+
+	for (k = 0; k < nmbx; k++)
+		if (mbx[k].id == id) break;
+	return k;
+}
+/* *************************************************************************
+ * static void emith(void);
+ * @brief	: Write the header
+ * *************************************************************************/
+static void emith(void)
+{
+	char g[128];
+	int i;
+
+	guard(&g[0]);
+	printf("/* Generated by canmap_gen from %s: do not edit ('make canmap') */\n\n", CANMAPFILE);
+	printf("#ifndef %s\n#define %s\n\n", g, g);
+	printf("#include \"MailboxTask.h\"\n#include \"canfilter_setup.h\"\n\n");
+	printf("#define CANMAPNUM     %2d // Mailboxes\n", nmbx);
+	printf("#define CANMAPNOTENUM %2d // Notification blocks\n", NMAP);
+	printf("#define CANMAPFILTNUM %2d // CAN1 filter banks\n\n", nbank);
+
+	printf("/* Mailbox: index into 'canmap_mbx' */\n");
+	for (i = 0; i < NMAP; i++)
+		printf("#define CANMAP_%-16s %2d\n", map[i].name, mbxof(map[i].id));
+
+	printf("\n/* CAN id */\n");
+	for (i = 0; i < NMAP; i++)
+		printf("#define CANMAPID_%-14s 0x%08XU\n", map[i].name, map[i].id);
+
+	printf("\nextern struct MAILBOXCAN canmap_mbx[CANMAPNUM];\n");
+	printf("extern const struct MBXTABLE canmap_tbl;\n");
+	printf("extern const struct CANFILTERBANK canmap_filt[CANMAPFILTNUM];\n\n");
+	printf("#endif\n");
+	return;
+}
+/* *************************************************************************
+ * static void emitc(void);
+ * @brief	: Write the tables
+ * *************************************************************************/
+static void emitc(void)
+{
+	const struct CANMAPLINE* p;
+	int i, ndirect = 0;
+
+	printf("/* Generated by canmap_gen from %s: do not edit ('make canmap') */\n\n", CANMAPFILE);
+	for (i = 0; incl[i] != NULL; i++)
+		printf("#include \"%s\"\n", incl[i]);
+	printf("#include \"%s.h\"\n\n", CANMAPGEN);
+
+	printf("/* Notification blocks: grouped by mailbox (task handles filled in at startup) */\n");
+	printf("static struct CANNOTIFYLIST canmap_note[CANMAPNOTENUM] = {\n");
+	for (i = 0; i < NMAP; i++)
+	{
+		p = &map[sorted[i]];
+		printf("\t{.notebit = %s}, // %s\n", p->bit, p->name);
+	}
+	printf("};\n\n");
+
+	printf("/* Notification policy state, same index (zero: MBXNOTEALWAYS) */\n");
+	printf("static struct MBXNOTEPOL canmap_pol[CANMAPNOTENUM];\n\n");
+
+	printf("static osThreadId* const canmap_task[CANMAPNOTENUM] = {\n");
+	for (i = 0; i < NMAP; i++)
+	{
+		p = &map[sorted[i]];
+		if (strcmp(p->task, "NULL") == 0)
+			printf("\tNULL,\n");
+		else
+			printf("\t&%s,\n", p->task);
+	}
+	printf("};\n\n");
+
+	printf("/* Mailboxes: sorted on CAN id */\n");
+	printf("struct MAILBOXCAN canmap_mbx[CANMAPNUM] = {\n");
+	for (i = 0; i < nmbx; i++)
+	{
+		p = &map[mbx[i].line];
+		printf("\t{.ncan.can.id = 0x%08XU, .paytype = %2u, .pnote = &canmap_note[%u], .ppol = &canmap_pol[%u], .notect = %u}, // %s\n",
+			p->id, p->paytype, mbx[i].note, mbx[i].note, mbx[i].notect, p->name);
+	}
+	printf("};\n\n");
+
+	printf("static struct MAILBOXCAN* const canmap_pmbx[CANMAPNUM] = {\n");
+	for (i = 0; i < nmbx; i++)
+		printf("\t&canmap_mbx[%d],\n", i);
+	printf("};\n\n");
+
+	printf("static const uint32_t canmap_ids[CANMAPNUM] = {\n");
+	for (i = 0; i < nmbx; i++)
+		printf("\t0x%08XU,\n", mbx[i].id);
+	printf("};\n\n");
+
+	printf("static const uint8_t canmap_direct[] = {\n");
+	for (i = 0; i < nmbx; i++)
+	{
+		p = &map[mbx[i].line];
+		if (p->direct == 0) continue;
+		printf("\t%d, // %s\n", i, p->name);
+		ndirect += 1;
+	}
+	if (ndirect == 0) printf("\t0 // None\n");
+	printf("};\n\n");
+
+	printf("const struct MBXTABLE canmap_tbl = {\n");
+	printf("\t.pmbxarray = &canmap_pmbx[0],\n");
+	printf("\t.pidarray  = &canmap_ids[0],\n");
+	printf("\t.pnote     = &canmap_note[0],\n");
+	printf("\t.ppol      = &canmap_pol[0],\n");
+	printf("\t.ptask     = &canmap_task[0],\n");
+	printf("\t.pdirect   = &canmap_direct[0],\n");
+	printf("\t.nmbx      = CANMAPNUM,\n");
+	printf("\t.nnote     = CANMAPNOTENUM,\n");
+	printf("\t.ndirect   = %d,\n", ndirect);
+	printf("};\n\n");
+
+	printf("/* CAN1 filter banks (canfilter_setup_compile) */\n");
+	printf("const struct CANFILTERBANK canmap_filt[CANMAPFILTNUM] = {\n");
+	for (i = 0; i < nbank; i++)
+	{
+		printf("\t{0x%08XU, 0x%08XU, %s, %s, %u}, // Bank %d\n",
+			bank[i].fr1, bank[i].fr2,
+			(bank[i].mode  == CAN_FILTERMODE_IDLIST) ? "CAN_FILTERMODE_IDLIST" : "CAN_FILTERMODE_IDMASK",
+			(bank[i].scale == CAN_FILTERSCALE_32BIT) ? "CAN_FILTERSCALE_32BIT" : "CAN_FILTERSCALE_16BIT",
+			bank[i].fifo, i);
+	}
+	printf("};\n");
+	return;
+}
+/* *************************************************************************
+ * int main(int argc, char** argv);
+ * @brief	: canmap_gen h | c  (output to stdout)
+ * *************************************************************************/
+int main(int argc, char** argv)
+{
+	if ((argc != 2) || ((strcmp(argv[1], "h") != 0) && (strcmp(argv[1], "c") != 0)))
+	{
+		fprintf(stderr, "usage: canmap_gen h|c\n");
+		return 1;
+	}
+	build();
+	if (argv[1][0] == 'h')
+		emith();
+	else
+		emitc();
+	return 0;
+}
@@ -4,6 +4,7 @@
 * Description        : Extract payload from CAN msg
 *******************************************************************************/
 
+#include <string.h>
 #include "payload_extract.h"
 
 /* Definitions of payload type generated from database. */
@@ -28,8 +29,132 @@ the eight byte union--
 F34F	3/4 float
 HF    1/2 float
 LAT_LON_HT
+
+Layouts are data: 'paydesc' has one descriptor per paytype code giving the min
+dlc, the number of leading U8 fields, and the offset, length and type of the
+reading(s).  'payload_extract' (every msg, MailboxTask) calls the line's 'copy',
+one of a few fixed size copies, one per dlcmin/npre/off/len shape (byte loops
+driven by the descriptor measured 2-3x the old switch).  A new layout is a table
+line; a new shape is also a 'cp_' routine.  'payload_decode' works from the
+descriptor fields, and the host test holds the two to agreeing.  Paytypes not in
+the table get the eight payload bytes, as the old 'default' did.
 */
+#include "DTW_counter.h"
+
+/* Copies: cd.uc[] to 'pre8' (pN: N leading U8s) and to the union (wN: four bytes
+   at [N]; ww: all eight), plus the update count.  Each checks its own min dlc,
+   the line's 'dlcmin', so a short msg updates nothing (see NOTE above). */
+static void cp_p1(struct MAILBOXCAN* p)
+{
+	if (p->ncan.can.dlc < 1) return;
+	p->mbx.pre8[0] = p->ncan.can.cd.uc[0]; // Not counted
+}
+static void cp_w0(struct MAILBOXCAN* p)
+{
+	if (p->ncan.can.dlc < 4) return;
+	memcpy(&p->mbx.u, &p->ncan.can.cd.uc[0], 4);
+	p->ctr += 1;
+}
+static void cp_w1(struct MAILBOXCAN* p)
+{
+	if (p->ncan.can.dlc < 5) return;
+	memcpy(&p->mbx.u, &p->ncan.can.cd.uc[1], 4);
+	p->ctr += 1;
+}
+static void cp_w2(struct MAILBOXCAN* p)
+{
+	if (p->ncan.can.dlc < 6) return;
+	memcpy(&p->mbx.u, &p->ncan.can.cd.uc[2], 4);
+	p->ctr += 1;
+}
+static void cp_p1w1(struct MAILBOXCAN* p)
+{
+	if (p->ncan.can.dlc < 5) return;
+	p->mbx.pre8[0] = p->ncan.can.cd.uc[0];
+	memcpy(&p->mbx.u, &p->ncan.can.cd.uc[1], 4);
+	p->ctr += 1;
+}
+static void cp_p2w2(struct MAILBOXCAN* p)
+{
+	if (p->ncan.can.dlc < 6) return;
+	memcpy(&p->mbx.pre8[0], &p->ncan.can.cd.uc[0], 2);
+	memcpy(&p->mbx.u, &p->ncan.can.cd.uc[2], 4);
+	p->ctr += 1;
+}
+static void cp_p3w3(struct MAILBOXCAN* p)
+{
+	if (p->ncan.can.dlc < 7) return;
+	memcpy(&p->mbx.pre8[0], &p->ncan.can.cd.uc[0], 3);
+	memcpy(&p->mbx.u, &p->ncan.can.cd.uc[3], 4);
+	p->ctr += 1;
+}
+static void cp_ww(struct MAILBOXCAN* p)
+{
+	if (p->ncan.can.dlc < 8) return;
+	memcpy(&p->mbx.u, &p->ncan.can.cd.uc[0], 8);
+	p->ctr += 1;
+}
+static void cp_raw(struct MAILBOXCAN* p)
+{ // Any dlc
+	memcpy(&p->mbx.u, &p->ncan.can.cd.uc[0], 8);
+	p->ctr += 1;
+}
+
+/* Table line:          dlcmin npre off len type      copy */
+#define PAYD(dlcmin,npre,off,len,type,copy) {dlcmin,npre,off,len,type,1.0f,copy}
+#define PAYRAW PAYD(0, 0, 0, 8, PAYTRAW, cp_raw)
+
+static const struct PAYDESC paydesc[PAYTYPEMAX] =
+{
+	[0 ... PAYTYPEMAX-1] = PAYRAW, // (gcc range) Codes without a line below
+	[U8]           = PAYD(1, 1, 0, 0, PAYTNONE, cp_p1),
+	[U8_VAR]       = PAYD(1, 1, 0, 0, PAYTNONE, cp_p1),
+	[FF]           = PAYD(4, 0, 0, 4, PAYTFF,   cp_w0),
+	[U32]          = PAYD(4, 0, 0, 4, PAYTU32,  cp_w0),
+	[S32]          = PAYD(4, 0, 0, 4, PAYTS32,  cp_w0),
+	[xFF]          = PAYD(5, 0, 1, 4, PAYTFF,   cp_w1),   // [1]-[4]
+	[xxFF]         = PAYD(6, 0, 2, 4, PAYTFF,   cp_w2),   // [2]-[5]
+	[xxU32]        = PAYD(6, 0, 2, 4, PAYTU32,  cp_w2),
+	[xxS32]        = PAYD(6, 0, 2, 4, PAYTS32,  cp_w2),
+	[U8_FF]        = PAYD(5, 1, 1, 4, PAYTFF,   cp_p1w1), // [0], [1]-[4]
+	[U8_U32]       = PAYD(5, 1, 1, 4, PAYTU32,  cp_p1w1),
+	[U8_S32]       = PAYD(5, 1, 1, 4, PAYTS32,  cp_p1w1),
+	[UNIXTIME]     = PAYD(5, 1, 1, 4, PAYTU32,  cp_p1w1),
+	[U8_U8_FF]     = PAYD(6, 2, 2, 4, PAYTFF,   cp_p2w2), // [0]-[1], [2]-[5]
+	[U8_U8_U32]    = PAYD(6, 2, 2, 4, PAYTU32,  cp_p2w2),
+	[U8_U8_S32]    = PAYD(6, 2, 2, 4, PAYTS32,  cp_p2w2),
+	[U8_U8_U8_U32] = PAYD(7, 3, 3, 4, PAYTU32,  cp_p3w3), // [0]-[2], [3]-[6]
+	[FF_FF]        = PAYD(8, 0, 0, 8, PAYTFF,   cp_ww),   // Two four byte readings
+	[U32_U32]      = PAYD(8, 0, 0, 8, PAYTU32,  cp_ww),
+	[S32_S32]      = PAYD(8, 0, 0, 8, PAYTS32,  cp_ww),
+};
+
+/* UNDEF, and paytypes not in the table: [0]-[7], any dlc */
+static const struct PAYDESC payraw = PAYRAW;
+
+#ifdef PAYLOADBENCH
+static const uint8_t paybenchtypes[] =
+{
+	U8, U8_VAR, FF, U32, S32, xFF, xxFF, xxU32, xxS32, U8_FF, U8_U32, U8_S32, UNIXTIME,
+	U8_U8_FF, U8_U8_U32, U8_U8_S32, U8_U8_U8_U32, FF_FF, U32_U32, S32_S32, UNDEF,
+};
+#define PAYLOADBENCHNUM (sizeof(paybenchtypes)/sizeof(paybenchtypes[0]))
+struct PAYLOADBENCHW payloadbench[PAYLOADBENCHNUM];
+uint8_t payloadbenchct;
+#endif
 
+
+/* *************************************************************************
+ * const struct PAYDESC* payload_desc(uint8_t paytype);
+ *	@brief	: Layout descriptor of a paytype
+ * @param	: paytype = payload type code (gen_db.h)
+ * @return	: pointer to descriptor (paytypes not in the table: eight raw bytes)
+ * *************************************************************************/
+const struct PAYDESC* payload_desc(uint8_t paytype)
+{
+	if (paytype >= PAYTYPEMAX) return &payraw;
+	return &paydesc[paytype];
+}
 /* ************************************************************************* 
  * void payload_extract(struct MAILBOXCAN* pmbx);
  *	@brief	: Lookup CAN ID and load mailbox with extract payload reading(s)
@@ -37,109 +162,90 @@ LAT_LON_HT
  * *************************************************************************/
 void payload_extract(struct MAILBOXCAN* pmbx)
 {
-	switch (pmbx->paytype)
-	{
-	case U8:
-	case U8_VAR:
-		if (pmbx->ncan.can.dlc >= 1)
+	(*payload_desc(pmbx->paytype)->copy)(pmbx);
+	return;
+}
+/* *************************************************************************
+ * int payload_decode(struct CANRCVBUF* pcan, uint8_t paytype, struct PAYLOADOUT* pout);
+ *	@brief	: Decode all fields of a CAN msg payload into a typed struct
+ * @param	: pcan = pointer to CAN msg
+ * @param	: paytype = payload type code (gen_db.h)
+ * @param	: pout = pointer to output
+ * @return	: 0 = OK; -1 = dlc too short for the layout ('pout' not loaded)
+ * *************************************************************************/
+int payload_decode(struct CANRCVBUF* pcan, uint8_t paytype, struct PAYLOADOUT* pout)
+{
+	const struct PAYDESC* pd = payload_desc(paytype);
+	uint8_t* ps = &pcan->cd.uc[0];
+	union MBXNOTEVAL v;
+	int i;
+
+	if (pcan->dlc < pd->dlcmin) return -1;
+
+	pout->npre = pd->npre;
+	pout->type = pd->type;
+	pout->nval = pd->len >> 2; // Four byte readings
+	for (i = 0; i < pd->npre; i++)
+		pout->pre8[i] = *(ps + i);
+
+	ps += pd->off;
+	for (i = 0; i < pout->nval; i++, ps += 4)
+	{ // Payload is little endian, and not necessarily aligned
+		v.u = *(ps + 0) | (*(ps + 1) << 8) | (*(ps + 2) << 16) | ((uint32_t)*(ps + 3) << 24);
+		pout->v[i] = v;
+		switch (pd->type)
 		{
-			pmbx->mbx.pre8[0] = pmbx->ncan.can.cd.uc[0];
-		}
-		break;		
-	case FF:
-	case U32:
-	case S32:
-		if (pmbx->ncan.can.dlc >= 4)
-		{ // Place 1st four bytes of payload in union
-			pmbx->mbx.u.i32[0] = pmbx->ncan.can.cd.ui[0];
-			pmbx->ctr +=1 ;
-		}
-		break;	
-	case xFF:
-		if (pmbx->ncan.can.dlc >= 5)
-		{ // Place [1]-[4] of payload in union 
-			pmbx->mbx.u.i8[0] = pmbx->ncan.can.cd.uc[1];
-			pmbx->mbx.u.i8[1] = pmbx->ncan.can.cd.uc[2];
-			pmbx->mbx.u.i8[2] = pmbx->ncan.can.cd.uc[3];
-			pmbx->mbx.u.i8[3] = pmbx->ncan.can.cd.uc[4];
-			pmbx->ctr +=1 ;
-		}
-		break;	
-	case xxFF:
-	case xxU32:
-	case xxS32:
-		if (pmbx->ncan.can.dlc >= 6)
-		{ // Place [2]-[5] of payload in union 
-			pmbx->mbx.u.i8[0] = pmbx->ncan.can.cd.uc[2];
-			pmbx->mbx.u.i8[1] = pmbx->ncan.can.cd.uc[3];
-			pmbx->mbx.u.i8[2] = pmbx->ncan.can.cd.uc[4];
-			pmbx->mbx.u.i8[3] = pmbx->ncan.can.cd.uc[5];
-			pmbx->ctr +=1 ;
-		}
-		break;
-	case U8_FF:
-	case U8_U32:
-	case U8_S32:
-	case UNIXTIME:
-		if (pmbx->ncan.can.dlc >= 5)
-		{ 
-			pmbx->mbx.pre8[0] = pmbx->ncan.can.cd.uc[0];
-			// Place [2]-[5] of payload in union 
-			pmbx->mbx.u.i8[0] = pmbx->ncan.can.cd.uc[1];
-			pmbx->mbx.u.i8[1] = pmbx->ncan.can.cd.uc[2];
-			pmbx->mbx.u.i8[2] = pmbx->ncan.can.cd.uc[3];
-			pmbx->mbx.u.i8[3] = pmbx->ncan.can.cd.uc[4];
-			pmbx->ctr +=1 ;		
-		}
-		break;	
-	case U8_U8_FF:
-	case U8_U8_U32:
-	case U8_U8_S32:
-		if (pmbx->ncan.can.dlc >= 6)
-		{ 
-			pmbx->mbx.pre8[0] = pmbx->ncan.can.cd.uc[0];
-			pmbx->mbx.pre8[1] = pmbx->ncan.can.cd.uc[1];
-			// Place [2]-[5] of payload in union 
-			pmbx->mbx.u.i8[0] = pmbx->ncan.can.cd.uc[2];
-			pmbx->mbx.u.i8[1] = pmbx->ncan.can.cd.uc[3];
-			pmbx->mbx.u.i8[2] = pmbx->ncan.can.cd.uc[4];
-			pmbx->mbx.u.i8[3] = pmbx->ncan.can.cd.uc[5];
-			pmbx->ctr +=1 ;		
+		case PAYTFF:  pout->f[i] = v.f * pd->scale; break;
+		case PAYTS32: pout->f[i] = (float)(int32_t)v.u * pd->scale; break;
+		default:      pout->f[i] = (float)v.u * pd->scale; break;
 		}
-		break;
-	case U8_U8_U8_U32:
-		if (pmbx->ncan.can.dlc >= 7)
-		{ 
-			pmbx->mbx.pre8[0] = pmbx->ncan.can.cd.uc[0];
-			pmbx->mbx.pre8[1] = pmbx->ncan.can.cd.uc[1];
-			pmbx->mbx.pre8[2] = pmbx->ncan.can.cd.uc[2];
-			// Place [2]-[5] of payload in union 
-			pmbx->mbx.u.i8[0] = pmbx->ncan.can.cd.uc[3];
-			pmbx->mbx.u.i8[1] = pmbx->ncan.can.cd.uc[4];
-			pmbx->mbx.u.i8[2] = pmbx->ncan.can.cd.uc[5];
-			pmbx->mbx.u.i8[3] = pmbx->ncan.can.cd.uc[6];
-			pmbx->ctr +=1 ;		
-		}
-		break;
-	case FF_FF:		// Two four byte readings
-	case U32_U32:
-	case S32_S32:
-		if (pmbx->ncan.can.dlc >= 8)
-		{ // Place [0]-[7] of payload in union 
-			pmbx->mbx.u.i64 = pmbx->ncan.can.cd.ull;
-			pmbx->ctr +=1 ;
-		}
-		break;	
-
-	// Payload type not implemented
-	case UNDEF:
-	default: 
-		{ // Place [0]-[7] of payload in union 
-			pmbx->mbx.u.i64 = pmbx->ncan.can.cd.ull;
-			pmbx->ctr +=1 ;
-		}
-		break;	
 	}
+	return 0;
+}
+/* *************************************************************************
+ * int payload_bench(void);
+ *	@brief	: Time 'payload_extract' & 'payload_decode' for each paytype (PAYLOADBENCH)
+ * @return	: Number of entries in 'payloadbench'; 0 = PAYLOADBENCH not defined
+ * NOTE: Call after DTW_counter_init.  Times include one DTW read (a few cycles).
+ * *************************************************************************/
+int payload_bench(void)
+{
+#ifdef PAYLOADBENCH
+	static struct MAILBOXCAN mbx; // Not a registered mailbox: nothing notified
+	struct PAYLOADOUT out;
+	struct PAYLOADBENCHW* pb;
+	uint32_t t0, dt, sum, sum2;
+	unsigned int i;
+	int j;
 
-	return;
+	mbx.ncan.can.dlc    = 8;
+	mbx.ncan.can.cd.ull = 0x3f8000003f800000ULL; // Bytes are floats 1.0 at [0] & [4]
+
+	for (i = 0; i < PAYLOADBENCHNUM; i++)
+	{
+		pb = &payloadbench[i];
+		pb->paytype = paybenchtypes[i];
+		mbx.paytype = paybenchtypes[i];
+		pb->max = 0;
+		sum = 0; sum2 = 0;
+		for (j = 0; j < PAYLOADBENCHREPS; j++)
+		{
+			t0 = DTWTIME;
+			payload_extract(&mbx);
+			dt = DTWTIME - t0;
+			sum += dt;
+			if (dt > pb->max) pb->max = dt;
+
+			t0 = DTWTIME;
+			payload_decode(&mbx.ncan.can, mbx.paytype, &out);
+			sum2 += DTWTIME - t0;
+		}
+		pb->extract = sum  / PAYLOADBENCHREPS;
+		pb->decode  = sum2 / PAYLOADBENCHREPS;
+	}
+	payloadbenchct = PAYLOADBENCHNUM;
+	return PAYLOADBENCHNUM;
+#else
+	return 0;
+#endif
 }
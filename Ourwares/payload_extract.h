@@ -10,11 +10,77 @@
 #include "can_iface.h"
 #include "MailboxTask.h"
 
+/* Size of the descriptor table: paytype codes (gen_db.h) are indices below this. */
+#define PAYTYPEMAX  64
+
+/* Bench: time 'payload_extract' & 'payload_decode' for each paytype at startup
+   (DTW cycles).  Uncomment to add. */
+//#define PAYLOADBENCH
+#define PAYLOADBENCHREPS 64 // Calls timed per paytype
+
+/* Reading type of a payload layout */
+#define PAYTNONE  0 // No reading (leading U8 fields only)
+#define PAYTFF    1 // float
+#define PAYTU32   2 // uint32_t
+#define PAYTS32   3 // int32_t
+#define PAYTRAW   4 // Eight bytes, layout unknown (UNDEF, or not in the table)
+
+/* Payload layout descriptor: one per paytype code */
+struct PAYDESC
+{
+	uint8_t dlcmin;   // Min dlc: shorter msgs are not extracted (0 = any)
+	uint8_t npre;     // Leading U8 fields: payload [0]..[npre-1] to 'pre8'
+	uint8_t off;      // Payload byte offset of the reading(s)
+	uint8_t len;      // Bytes of reading(s) to the union (0, 4, 8)
+	uint8_t type;     // Reading type: PAYTxxxx
+	float   scale;    // 'payload_decode' float output = reading * scale
+	void (*copy)(struct MAILBOXCAN* pmbx); // 'payload_extract': fixed copy for dlcmin/npre/off/len
+};
+
+/* Output of 'payload_decode' */
+struct PAYLOADOUT
+{
+	uint8_t pre8[4];  // Leading U8 fields
+	uint8_t npre;     // Number of 'pre8'
+	uint8_t nval;     // Number of readings in 'v' and 'f'
+	uint8_t type;     // Reading type: PAYTxxxx
+	union MBXNOTEVAL v[2]; // Readings as sent (.f float; .u uint32_t or int32_t)
+	float f[2];       // Readings as float, times the layout 'scale'
+};
+
+/* Bench results: DTW cycles per call */
+struct PAYLOADBENCHW
+{
+	uint8_t  paytype;
+	uint32_t extract; // 'payload_extract': mean
+	uint32_t decode;  // 'payload_decode': mean
+	uint32_t max;     // 'payload_extract': max
+};
+
 /* *************************************************************************/
 void payload_extract(struct MAILBOXCAN* pmbx);
 /*	@brief	: Lookup CAN ID and load mailbox with extract payload reading(s)
  * @param	: pmbx  = pointer to mailbox
  * *************************************************************************/
+int payload_decode(struct CANRCVBUF* pcan, uint8_t paytype, struct PAYLOADOUT* pout);
+/*	@brief	: Decode all fields of a CAN msg payload into a typed struct
+ * @param	: pcan = pointer to CAN msg
+ * @param	: paytype = payload type code (gen_db.h)
+ * @param	: pout = pointer to output
+ * @return	: 0 = OK; -1 = dlc too short for the layout ('pout' not loaded)
+ * *************************************************************************/
+const struct PAYDESC* payload_desc(uint8_t paytype);
+/*	@brief	: Layout descriptor of a paytype
+ * @param	: paytype = payload type code (gen_db.h)
+ * @return	: pointer to descriptor (paytypes not in the table: eight raw bytes)
+ * *************************************************************************/
+int payload_bench(void);
+/*	@brief	: Time 'payload_extract' & 'payload_decode' for each paytype (PAYLOADBENCH)
+ * @return	: Number of entries in 'payloadbench'; 0 = PAYLOADBENCH not defined
+ * NOTE: Call after DTW_counter_init.  Results in 'payloadbench[]', 'payloadbenchct'.
+ * *************************************************************************/
 
-#endif
+extern struct PAYLOADBENCHW payloadbench[];
+extern uint8_t payloadbenchct; // Number of 'payloadbench' loaded
 
+#endif
@@ -62,6 +62,8 @@
 #include "CanTask.h"
 #include "can_iface.h"
 #include "canfilter_setup.h"
+#include "can_txsched.h"
+#include "can_bench.h"
 #include "getserialbuf.h"
 #include "stackwatermark.h"
 #include "yprintf.h"
@@ -76,6 +78,7 @@
 #include "gateway_PCtoCAN.h"
 #include "morse.h"
 #include "MailboxTask.h"
+#include "payload_extract.h"
 #include "GatewayTask.h"
 #include "ContactorTask.h"
 
@@ -271,6 +274,16 @@ int main(void)
 	Cret = canfilter_setup_first(1, &hcan, 15); // CAN1
 	if (Cret == HAL_ERROR) morse_trap(9);
 
+#ifdef CANBENCH
+	/* Bench build: CAN1 loopback with offered load (can_bench.h). */
+	if (can_bench_init(pctl0, CANBENCHLOAD) < 0) morse_trap(78);
+#endif
+
+#ifdef PAYLOADBENCH
+	/* Bench build: decode cost of each paytype (payload_extract.h). */
+	payload_bench();
+#endif
+
 	/* Remove "accept all" CAN msgs and add specific id & mask, or id here. */
 	// See canfilter_setup.h
 
@@ -488,6 +501,12 @@ static void MX_CAN_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN CAN_Init 2 */
+#ifdef CANTTCM
+	/* Time triggered mode: SOF timestamps in RDTxR/TDTxR (see can_iface.h).
+	   HAL_CAN_Init leaves the CAN in init mode, where MCR is writable. */
+	hcan.Init.TimeTriggeredMode = ENABLE;
+	SET_BIT(hcan.Instance->MCR, CAN_MCR_TTCM);
+#endif
 
   /* USER CODE END CAN_Init 2 */
 
@@ -1007,6 +1026,95 @@ yprintf(&pbuf1,"iprechgendv: %i hv[IDXHV3].hvc: %i\n\r",pcf->iprechgendv,pcf->hv
 
 #endif
 
+#define SHOWCANRXRINGLOSS
+#ifdef  SHOWCANRXRINGLOSS
+if (mbxcannum[0].ptake != NULL)
+{
+yprintf(&pbuf1,"CAN1 rx ring: size %i added %u lost %u lapped %u\n\r",pctl0->cirptrs.mask+1,
+	pctl0->cirptrs.addseq, mbxcannum[0].ptake->lostct, mbxcannum[0].ptake->lapct);
+}
+yprintf(&pbuf1,"CAN1 filter banks left: %i\n\r",canfilter_setup_banksleft(1));
+yprintf(&pbuf1,"CAN1 tx queue max: %i replaced: %u overflow: %u\n\r",pctl0->heapctmax,
+	pctl0->replacect, pctl0->can_errors.can_msgovrflow);
+#ifdef CANTXRATELIMIT
+yprintf(&pbuf1,"CAN1 tx rate limit drops: %u\n\r",pctl0->ratedropct);
+#endif
+yprintf(&pbuf1,"CAN1 rx fifo overruns: fifo0 %u fifo1 %u\n\r",
+	pctl0->can_errors.can_rx0err, pctl0->can_errors.can_rx1err);
+#ifdef CANBENCH
+yprintf(&pbuf1,"CAN1 bench: load %u%% put %u fail %u tx/s %u rx/s %u\n\r",
+	canbench.loadpct, canbench.putct, canbench.failct, canbench.txps, canbench.rxps);
+#endif
+#ifdef CANBUSLOAD
+yprintf(&pbuf1,"CAN1 bus load (0.1%%): 100ms %4u 1s %4u 10s %4u max %4u tx err/s %u\n\r",
+	pctl0->busload.load[0],pctl0->busload.load[1],pctl0->busload.load[2],
+	pctl0->busload.loadmax,pctl0->busload.err1);
+#endif
+#endif
+
+#define SHOWCANRXISRHISTOGRAM
+#ifdef  SHOWCANRXISRHISTOGRAM
+yprintf(&pbuf1,"CAN1 rx drains: %u max msgs/drain: %u isr max ticks: %u\n\rlog2 ticks:",
+	pctl0->rxdrainct, pctl0->rxdrainmax, pctl0->dtwrxisrmax);
+for (i = 0; i < CANISRHISTSZ; i++) yprintf(&pbuf1," %u",pctl0->rxisrhist[i]);
+yprintf(&pbuf1,"\n\r");
+#endif
+
+#define SHOWCANTXSCHEDJITTER
+#ifdef  SHOWCANTXSCHEDJITTER
+for (i = 0; i < cantxschedct; i++)
+{ // Interval min/max between puts (DTW ticks) since last time shown
+	struct CANTXSCHED* psch = &cantxschedtbl[i];
+	yprintf(&pbuf1,"txsched %08X period %u sent %u fail %u skip %u min %u max %u jitter %u\n\r",
+		psch->msg.can.id, psch->period, psch->sentct, psch->failct, psch->skipct,
+		psch->dtwmin, psch->dtwmax, (psch->dtwmax - psch->dtwmin));
+	can_txsched_jitter_reset(psch);
+}
+#endif
+
+#define SHOWCANTXLATENCY
+#if defined(SHOWCANTXLATENCY) && defined(CANTXLATENCY)
+for (i = 0; i < pctl0->txlatct; i++)
+{ // Per CAN id: put->load (q) and load->complete (w) log2 histograms
+	struct CANTXLAT* plat = pctl0->ptxlat[i];
+	int j;
+	yprintf(&pbuf1,"txlat %08X tx %u qmax %u wmax %u alst %u terr %u bomb %u abort %u\n\r q:",
+		plat->id, plat->txct, plat->qmax, plat->wmax, plat->alstct, plat->terrct,
+		plat->bombct, plat->abortct);
+	for (j = 0; j < CANTXLATHISTSZ; j++) yprintf(&pbuf1," %u",plat->qhist[j]);
+	yprintf(&pbuf1,"\n\r w:");
+	for (j = 0; j < CANTXLATHISTSZ; j++) yprintf(&pbuf1," %u",plat->whist[j]);
+	yprintf(&pbuf1,"\n\r");
+}
+#endif
+
+#define SHOWMBXDIRECT
+#if defined(SHOWMBXDIRECT) && defined(CANRXDIRECT)
+for (i = 0; i < mbxcannum[0].directct; i++)
+{ // Mailboxes loaded & notified in the CAN RX ISR: count, DTW ticks last & max
+	struct MBXDIRECT* pd = &mbxcannum[0].direct[i];
+	yprintf(&pbuf1,"mbx direct %08X ct %u dtw %u max %u\n\r",pd->id, pd->ct, pd->dtw, pd->dtwmax);
+}
+#endif
+
+#define SHOWMBXRATES
+#ifdef SHOWMBXRATES
+for (i = 0; i < mbxcannum[0].arraysizecur; i++)
+{ // Mailbox arrivals: count, inter-arrival EWMA & max (ticks), deadlines missed
+	struct MAILBOXCAN* pm = mbxcannum[0].pmbxarray[i];
+	yprintf(&pbuf1,"mbx %08X arr %u dt %u max %u stale %u\n\r",mbxcannum[0].pidarray[i], pm->arrct, pm->dtewma >> MBXEWMASHIFT, pm->dtmax, pm->stalect);
+}
+yprintf(&pbuf1,"mbx notify saved %u\n\r", MailboxTask_notify_savect()); // Wakeups dropped by policies
+#endif
+
+#ifdef PAYLOADBENCH
+for (i = 0; i < payloadbenchct; i++)
+{ // DTW cycles per call for each paytype: extract mean & max, decode mean
+	yprintf(&pbuf1,"paytype %2u extract %3u max %3u decode %3u\n\r",payloadbench[i].paytype,
+		payloadbench[i].extract, payloadbench[i].max, payloadbench[i].decode);
+}
+#endif
+
 #ifdef SHOWCANMSGCOUNTSATVARIOUSPOINTS
 extern uint32_t dbgcantxctr;
 extern uint32_t dbgcanrxctr;
@@ -52,7 +52,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 /* USER CODE BEGIN Includes */
-
+#include "can_iface.h"
 /* USER CODE END Includes */
 extern DMA_HandleTypeDef hdma_adc1;
 
@@ -249,6 +249,10 @@ void HAL_CAN_MspInit(CAN_HandleTypeDef* hcan)
     HAL_NVIC_SetPriority(CAN1_RX1_IRQn, 6, 0);
     HAL_NVIC_EnableIRQ(CAN1_RX1_IRQn);
   /* USER CODE BEGIN CAN1_MspInit 1 */
+#ifdef CANRXFIFO1HIPRI
+    /* FIFO 1 (high priority CAN ids) preempts the other CAN interrupts */
+    HAL_NVIC_SetPriority(CAN1_RX1_IRQn, CANRX1NVICPRI, 0);
+#endif
 
   /* USER CODE END CAN1_MspInit 1 */
   }
@@ -39,6 +39,7 @@
 #include "cmsis_os.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "can_iface.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -256,6 +257,12 @@ void USB_LP_CAN1_RX0_IRQHandler(void)
 void CAN1_RX1_IRQHandler(void)
 {
   /* USER CODE BEGIN CAN1_RX1_IRQn 0 */
+#ifdef CANRXFIFO1HIPRI
+	/* FIFO 1 only, at its own priority. 'HAL_CAN_IRQHandler' would also service
+	   TX and FIFO 0 at this priority. */
+	can_iface_rx1_IRQHandler(&hcan);
+	return;
+#endif
 
   /* USER CODE END CAN1_RX1_IRQn 0 */
   HAL_CAN_IRQHandler(&hcan);
@@ -0,0 +1,351 @@
+/******************************************************************************
+* File Name          : bench_can_bus.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host benchmark: can_iface nodes on the bxCAN bus model
+*******************************************************************************/
+/*
+Times are bus model time (DTW ticks at 72 MHz), not host time:
+  1) frames/s with the TX queue full: measured vs. the bit rate / frame length,
+     and idle bits between frames (mailbox reload gaps)
+  2) queueing delay per CAN id ('can_driver_put' to end of frame) for periodic
+     streams from two nodes at 30/60/90% offered load
+  3) RX FIFO overruns at a receiver whose FIFO IRQ runs 'rxdelay' late, for
+     jittered streams at a range of offered loads
+  4) ContactorTask keep-alive response ('contactor_msg_ka') to end of frame,
+     with other traffic above and below its id: put straight into the driver
+     (CanTask_put) vs. the old CanTxTask queue, where the put waits for the
+     task hop.  CanTxTask and ContactorTask are both priority 1, so the hop is
+     either KAHOPUS (ContactorTask blocks next: two task switches and the
+     queue copy in and out; assumed, not measured) or, when ContactorTask
+     runs on, anything up to the next 1 ms tick (time slicing).
+  5) RX FIFO drain ('unloadfifo') ISR duration, one notification per msg (old)
+     vs. one per drain: the frames each drain finds (measured on the model,
+     receiver IRQ 'rxdelay' late) times DTW tick costs estimated from the
+     instruction counts (ISR*; no target here to time it).  Printed as the
+     'rxisrhist' log2 buckets the target build keeps.
+
+Usage: bench_can_bus                 all of the above
+       bench_can_bus load delay_us   3) at one point (load in %)
+*/
+#include <string.h>
+#include <stdlib.h>
+#include "hostrtos.h"
+#include "bxcan_model.h"
+#include "can_iface.c"
+
+#define STD(id)  ((uint32_t)(id) << 21)
+#define DTWUS    72 // DTW ticks per us
+#define SIMTICKS (SystemCoreClock / 2) // 0.5 s of bus time per run
+#define KAHOPUS  10 // CanTxTask hop (us) when ContactorTask blocks right after
+
+/* 5) Drain ISR costs, DTW ticks (72 MHz, flash wait states): estimates */
+#define ISRFIXOLD  30 // Entry to exit: setup, getpctl list search (one module), FOVR check
+#define ISRFIXNEW  44 // Same, indexed getpctl, plus drain counts and log2 histogram
+#define ISRMSG     36 // Per msg: FIFO mailbox reads, RFOM, ring add
+#define ISRNOTE1  120 // xTaskNotifyFromISR that readies the waiting task
+#define ISRNOTE2   50 // xTaskNotifyFromISR with the task already ready
+
+static struct CAN_CTLBLOCK* pctl[HOSTCANNUM];
+static struct CANTAKEPTR* ptake[HOSTCANNUM];
+
+/* Periodic msgs from one node */
+struct STREAM
+{
+	int      node;
+	uint32_t id;
+	uint32_t period;  // DTW ticks
+	uint32_t jitter;  // DTW ticks: next put is 'period' +/- up to this
+	uint32_t next;    // DTW time of next put
+	uint32_t hopmin;  // DTW ticks: task hop, put this much after 'next'...
+	uint32_t hopmax;  // ...to this much
+	uint32_t hop;     // Task hop of the next put
+	/* Results */
+	uint32_t ct;      // Msgs received
+	uint32_t max;     // Worst delay (DTW ticks)
+	uint64_t sum;
+	uint32_t drop;    // Puts refused (pool full)
+};
+
+static uint32_t lcg = 12345;
+static uint32_t rnd(uint32_t n)
+{
+	lcg = (lcg * 1664525u) + 1013904223u;
+	return (n == 0) ? 0 : ((lcg >> 8) % n);
+}
+static void bus(int nodect, uint32_t btr)
+{
+	int n;
+	bxcan_model_init(nodect, btr, CAN_MCR_NART);
+	for (n = 0; n < nodect; n++)
+	{
+		pctlinst[CANINSTIDX(&hostcan[n])] = NULL;
+		pctl[n] = can_iface_init(&hostcan[n], n, 64, 64);
+		ptake[n] = can_iface_mbx_init(pctl[n], hosttask(n), 0x1);
+		bxcan_model_acceptall(n, CAN_FILTER_FIFO0);
+	}
+}
+/* Payload carries the put time, less any task hop (the time the sender ran) */
+static void put(int n, uint32_t id, struct STREAM* ps)
+{
+	struct CANRCVBUF can;
+	can.id  = id;
+	can.dlc = 8;
+	can.cd.ui[0] = hostdtw - ((ps != NULL) ? ps->hop : 0);
+	can.cd.ui[1] = rnd(0xFFFFFFFF);
+	if ((can_driver_put(pctl[n], &can, 0, 0) != CANPUT_OK) && (ps != NULL))
+		ps->drop += 1;
+}
+/* Msgs received by 'node': delay per stream */
+static void take(int node, struct STREAM* ps, int nst)
+{
+	struct CANRCVBUFN* pn;
+	uint32_t d;
+	int i;
+	while ((pn = can_iface_get_CANmsg(ptake[node])) != NULL)
+	{
+		for (i = 0; i < nst; i++)
+			if (ps[i].id == pn->can.id) break;
+		if (i == nst) continue;
+		d = pn->toa - pn->can.cd.ui[0];
+		ps[i].ct += 1;
+		ps[i].sum += d;
+		if (d > ps[i].max) ps[i].max = d;
+	}
+}
+static void hopnext(struct STREAM* ps)
+{
+	ps->hop = (ps->hopmax > ps->hopmin) ? (ps->hopmin + rnd(ps->hopmax - ps->hopmin + 1)) : ps->hopmin;
+}
+/* Run streams for 'ticks' of bus time; 'rxnode' takes the msgs */
+static void offer(struct STREAM* ps, int nst, int rxnode, uint32_t ticks)
+{
+	uint32_t end = hostdtw + ticks;
+	uint32_t next;
+	int i;
+
+	for (i = 0; i < nst; i++)
+	{
+		ps[i].next = hostdtw + rnd(ps[i].period);
+		hopnext(&ps[i]);
+	}
+	while ((int32_t)(end - hostdtw) > 0)
+	{
+		next = end;
+		for (i = 0; i < nst; i++)
+		{
+			while ((int32_t)(hostdtw - (ps[i].next + ps[i].hop)) >= 0)
+			{
+				put(ps[i].node, ps[i].id, &ps[i]);
+				ps[i].next += ps[i].period - ps[i].jitter + rnd(2 * ps[i].jitter + 1);
+				hopnext(&ps[i]);
+			}
+			if ((int32_t)(ps[i].next + ps[i].hop - next) < 0) next = ps[i].next + ps[i].hop;
+		}
+		if (bxcan_model_step() == 0)
+			bxcan_model_idle(next - hostdtw);
+		take(rxnode, ps, nst);
+	}
+	bxcan_model_run(1000);
+	take(rxnode, ps, nst);
+}
+/* *************************************************************************
+ * 1) Line rate
+ * *************************************************************************/
+static void bench_rate(uint32_t btr, const char* name)
+{
+	uint32_t t0, bits, elapsed, i, n = 60;
+	double fps;
+
+	bus(2, btr);
+	t0 = hostdtw;
+	for (i = 0; i < n; i++)
+		put(0, STD(0x100 + (i & 7)), NULL);
+	bxcan_model_run(1000);
+	elapsed = (hostdtw - t0) / bxcan_model_tpb();
+	bits = 0;
+	for (i = 0; (i < bxlogct) && (i < BXLOGSZ); i++)
+		bits += bxcan_model_framebits(bxlog[i].tir, bxlog[i].tdtr, bxlog[i].tdlr, bxlog[i].tdhr);
+	fps = (double)n * SystemCoreClock / (hostdtw - t0);
+	printf("%-5s %3u frames dlc 8: %7.0f frames/s, %5.1f bits/frame, %u idle bits\n",
+		name, n, fps, (double)bits / n, elapsed - bits);
+}
+/* *************************************************************************
+ * 2) Queueing delay per CAN id
+ * *************************************************************************/
+static void bench_delay(uint32_t load)
+{
+	struct STREAM st[8];
+	uint32_t fbits = 130; // ~ std dlc 8, stuffed
+	uint32_t wsum = 0;
+	int i;
+
+	bus(3, HOSTCANBTR500K);
+	/* Ids 0x100.. (highest priority first) alternate nodes 0 & 1; rate ~ (8 - i) */
+	for (i = 0; i < 8; i++) wsum += 8 - i;
+	memset(st, 0, sizeof(st));
+	for (i = 0; i < 8; i++)
+	{
+		st[i].node = i & 1;
+		st[i].id = STD(0x100 + (i << 4));
+		st[i].period = (uint64_t)fbits * bxcan_model_tpb() * wsum * 100 / ((8 - i) * load);
+	}
+	offer(st, 8, 2, SIMTICKS);
+	printf("load %2u%%: id  period(us)  ct    mean(us)  max(us)  drop\n", load);
+	for (i = 0; i < 8; i++)
+		printf("        %03X  %8u  %5u  %8.1f  %7.1f  %u\n", st[i].id >> 21, st[i].period / DTWUS,
+			st[i].ct, (st[i].ct != 0) ? (double)st[i].sum / st[i].ct / DTWUS : 0.0,
+			(double)st[i].max / DTWUS, st[i].drop);
+}
+/* *************************************************************************
+ * 3) RX FIFO overruns
+ * *************************************************************************/
+static void bench_rxovr(uint32_t load, uint32_t delayus)
+{
+	struct STREAM st[2];
+	uint32_t fbits = 130;
+	int i;
+
+	bus(3, HOSTCANBTR500K);
+	bxnode[2].rxdelay = delayus * DTWUS;
+	memset(st, 0, sizeof(st));
+	for (i = 0; i < 2; i++)
+	{
+		st[i].node = i;
+		st[i].id = STD(0x200 + i);
+		st[i].period = (uint64_t)fbits * bxcan_model_tpb() * 2 * 100 / load;
+		st[i].jitter = st[i].period / 2; // Bursty
+	}
+	offer(st, 2, 2, SIMTICKS);
+	printf("load %3u%% rxdelay %5u us: %6u in FIFO, %5u lost, %5u FOVR (rx0err)\n", load, delayus,
+		bxnode[2].rxct[0], bxnode[2].rxlost[0], pctl[2]->can_errors.can_rx0err);
+}
+
+/* *************************************************************************
+ * 4) Keep-alive response: CanTask_put vs. the CanTxTask queue
+ * *************************************************************************/
+/* KA response (CANID_CMD_CNTCTRKAR, std id 0x71E, dlc 8 here) every 2 ms from
+   node 0; node 1 offers 'load' with four ids above it and four below */
+static void kaone(uint32_t load, uint32_t hopmin, uint32_t hopmax, double* pmean, double* pmax)
+{
+	static const uint16_t ids[8] = {0x100, 0x200, 0x300, 0x400, 0x720, 0x740, 0x780, 0x7F0};
+	struct STREAM st[9];
+	uint32_t fbits = 130;
+	int i;
+
+	bus(3, HOSTCANBTR500K);
+	memset(st, 0, sizeof(st));
+	for (i = 0; i < 8; i++)
+	{
+		st[i].node = 1;
+		st[i].id = STD(ids[i]);
+		st[i].period = (uint64_t)fbits * bxcan_model_tpb() * 8 * 100 / load;
+		st[i].jitter = st[i].period / 2;
+	}
+	st[8].node = 0;
+	st[8].id = STD(0x71E);
+	st[8].period = 2000 * DTWUS;
+	st[8].hopmin = hopmin;
+	st[8].hopmax = hopmax;
+	offer(st, 9, 2, SIMTICKS);
+	*pmean = (st[8].ct != 0) ? (double)st[8].sum / st[8].ct / DTWUS : 0.0;
+	*pmax  = (double)st[8].max / DTWUS;
+}
+static void bench_ka(uint32_t load)
+{
+	double m[3], x[3];
+
+	kaone(load, 0, 0, &m[0], &x[0]);                                  // CanTask_put
+	kaone(load, KAHOPUS * DTWUS, KAHOPUS * DTWUS, &m[1], &x[1]);      // Queue: hop at block
+	kaone(load, KAHOPUS * DTWUS, (1000 + KAHOPUS) * DTWUS, &m[2], &x[2]); // Queue: hop at tick
+	printf("load %2u%%:  %6.1f %6.1f    %6.1f %6.1f    %6.1f %6.1f\n", load,
+		m[0], x[0], m[1], x[1], m[2], x[2]);
+}
+
+/* *************************************************************************
+ * 5) RX FIFO drain ISR duration: notify per msg vs. per drain
+ * *************************************************************************/
+static void isrhist(uint32_t* phist, uint32_t ticks, uint32_t ct)
+{
+	uint32_t n = 32 - __builtin_clz(ticks | 1); // As 'unloadfifo': 2^(n-1) <= ticks < 2^n
+	if (n >= CANISRHISTSZ) n = CANISRHISTSZ - 1;
+	phist[n] += ct;
+}
+static void bench_rxisr(uint32_t load, uint32_t delayus)
+{
+	struct STREAM st[2];
+	uint32_t fbits = 130;
+	uint32_t hold[CANISRHISTSZ], hnew[CANISRHISTSZ];
+	uint32_t told, tnew, ct, drains = 0;
+	uint64_t sold = 0, snew = 0;
+	int i, k;
+
+	bus(3, HOSTCANBTR500K);
+	bxnode[2].rxdelay = delayus * DTWUS;
+	memset(st, 0, sizeof(st));
+	for (i = 0; i < 2; i++)
+	{
+		st[i].node = i;
+		st[i].id = STD(0x200 + i);
+		st[i].period = (uint64_t)fbits * bxcan_model_tpb() * 2 * 100 / load;
+		st[i].jitter = st[i].period / 2;
+	}
+	offer(st, 2, 2, SIMTICKS);
+	memset(hold, 0, sizeof(hold));
+	memset(hnew, 0, sizeof(hnew));
+	for (k = 1; k <= HOSTCANFIFOSZ; k++)
+	{
+		ct = bxnode[2].rxdepth[0][k];
+		told = ISRFIXOLD + (k * ISRMSG) + ISRNOTE1 + ((k - 1) * ISRNOTE2);
+		tnew = ISRFIXNEW + (k * ISRMSG) + ISRNOTE1;
+		isrhist(hold, told, ct);
+		isrhist(hnew, tnew, ct);
+		sold += (uint64_t)told * ct;
+		snew += (uint64_t)tnew * ct;
+		drains += ct;
+	}
+	printf("load %2u%% rxdelay %4u us: drains %5u by frames 1/2/3: %5u %4u %4u  mean ticks %5.1f %5.1f\n",
+		load, delayus, drains, bxnode[2].rxdepth[0][1], bxnode[2].rxdepth[0][2], bxnode[2].rxdepth[0][3],
+		(double)sold / drains, (double)snew / drains);
+	printf("  rxisrhist old:");
+	for (i = 6; i < 10; i++) printf(" [%u]%u", i, hold[i]);
+	printf("\n  rxisrhist new:");
+	for (i = 6; i < 10; i++) printf(" [%u]%u", i, hnew[i]);
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	static const uint32_t loads[] = {25, 50, 75, 90, 100};
+	static const uint32_t delays[] = {100, 500, 1000};
+	unsigned i, j;
+
+	if (argc == 3)
+	{
+		bench_rxovr(atoi(argv[1]), atoi(argv[2]));
+		return 0;
+	}
+	printf("--- frames/s, TX queue full\n");
+	bench_rate(HOSTCANBTR500K, "500K");
+	bench_rate(HOSTCANBTR1M,   "1M");
+	printf("--- queueing delay, put to end of frame, 500K\n");
+	bench_delay(30);
+	bench_delay(60);
+	bench_delay(90);
+	printf("--- RX FIFO overruns, 500K, two jittered senders\n");
+	for (j = 0; j < sizeof(delays) / sizeof(delays[0]); j++)
+		for (i = 0; i < sizeof(loads) / sizeof(loads[0]); i++)
+			bench_rxovr(loads[i], delays[j]);
+	printf("--- KA response to end of frame (us), 500K: mean max\n");
+	printf("           CanTask_put      queue, hop %2u us  queue, hop to tick\n", KAHOPUS);
+	bench_ka(30);
+	bench_ka(60);
+	bench_ka(90);
+	printf("--- RX FIFO drain ISR, DTW ticks (estimated costs): notify per msg (old) vs. per drain\n");
+	for (j = 0; j < sizeof(delays) / sizeof(delays[0]); j++)
+	{
+		bench_rxisr(50, delays[j]);
+		bench_rxisr(90, delays[j]);
+	}
+	return 0;
+}
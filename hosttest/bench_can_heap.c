@@ -0,0 +1,136 @@
+/******************************************************************************
+* File Name          : bench_can_heap.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host benchmark: TX heap vs. the old sorted pending list
+*******************************************************************************/
+/*
+Host time (ns per msg: one put plus one take), so only the ratios carry over
+to the target.  Bursts of 8/32/128 msgs are queued, then all taken in priority
+order, as 'can_driver_put' and 'loadmbx2' do.
+  - old: walk the sorted 'pend' list to insert; take the head
+  - new: heap_push / heap_pop
+Two id mixes: random ids, and each new msg the lowest priority queued (the old
+list walks all of it; the heap's sift-up stops at once).
+
+Usage: bench_can_heap
+*/
+#include <string.h>
+#include "hostrtos.h"
+#include "hostcan.h"
+#include "can_iface.c"
+
+#define QMAX  128
+#define REPS  4194304 // Msgs timed per case (a multiple of each burst)
+
+static struct CAN_POOLBLOCK blk[QMAX];
+static struct CAN_POOLBLOCK* pheap[QMAX];
+static struct CAN_POOLBLOCK pend; // Old list head
+static uint32_t ids[1024];
+static int worst; // 1 = each new msg has the highest id value queued
+static volatile uintptr_t sink;
+
+static uint32_t lcg = 12345;
+static uint32_t rnd(void)
+{
+	lcg = (lcg * 1664525u) + 1013904223u;
+	return lcg;
+}
+/* The old 'can_driver_put' insert: lower value CAN ids are higher priority,
+   same id goes after those already in the list */
+static __attribute__((noinline)) void listput(struct CAN_POOLBLOCK* pnew)
+{
+	volatile struct CAN_POOLBLOCK* pfor;
+	for (pfor = &pend; pfor->plinknext != NULL; pfor = pfor->plinknext)
+	{
+		if (pnew->can.id < (pfor->plinknext)->can.id) // Pay attention: "value" vs "priority"
+			break;
+	}
+	pnew->plinknext = pfor->plinknext;
+	pfor->plinknext = pnew;
+}
+static __attribute__((noinline)) struct CAN_POOLBLOCK* listtake(void)
+{
+	struct CAN_POOLBLOCK* p = (struct CAN_POOLBLOCK*)pend.plinknext;
+	pend.plinknext = p->plinknext;
+	return p;
+}
+static __attribute__((noinline)) void heapput(struct CAN_CTLBLOCK* pctl, struct CAN_POOLBLOCK* p)
+{
+	p->seq = pctl->seq++;
+	heap_push(pctl, p);
+}
+static __attribute__((noinline)) struct CAN_POOLBLOCK* heaptake(struct CAN_CTLBLOCK* pctl)
+{
+	return heap_pop(pctl);
+}
+static uint32_t nextid(int i)
+{
+	if (worst != 0) return (uint32_t)(i + 1) << 3; // Rising
+	return ids[i & 1023];
+}
+static double timelist(int n)
+{
+	uint64_t t0;
+	int i, j, k = 0;
+
+	memset(&pend, 0, sizeof(pend));
+	t0 = hostns();
+	for (i = 0; i < REPS; i += n)
+	{
+		for (j = 0; j < n; j++)
+		{
+			blk[j].can.id = nextid(k++);
+			listput(&blk[j]);
+		}
+		for (j = 0; j < n; j++)
+			sink = (uintptr_t)listtake();
+	}
+	return (double)(hostns() - t0) / REPS;
+}
+static double timeheap(int n)
+{
+	struct CAN_CTLBLOCK ctl;
+	uint64_t t0;
+	int i, j, k = 0;
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.ppheap = pheap;
+	ctl.heapsz = QMAX;
+	for (j = 0; j < n; j++)
+		blk[j].x.xb[2] = 0;
+	t0 = hostns();
+	for (i = 0; i < REPS; i += n)
+	{
+		for (j = 0; j < n; j++)
+		{
+			blk[j].can.id = nextid(k++);
+			heapput(&ctl, &blk[j]);
+		}
+		for (j = 0; j < n; j++)
+			sink = (uintptr_t)heaptake(&ctl);
+	}
+	return (double)(hostns() - t0) / REPS;
+}
+
+int main(void)
+{
+	int n, i;
+
+	for (i = 0; i < 1024; i++)
+		ids[i] = (rnd() & 0x7ff) << 21;
+	printf("--- TX pending queue, ns per msg (put + take): old sorted list vs. heap\n");
+	printf("burst    random:list  heap    lowest pri:list  heap\n");
+	for (n = 8; n <= QMAX; n *= 4)
+	{
+		double rl, rh, wl, wh;
+		worst = 0;
+		rl = timelist(n);
+		rh = timeheap(n);
+		worst = 1;
+		wl = timelist(n);
+		wh = timeheap(n);
+		printf("%4d     %10.1f %6.1f   %14.1f %6.1f\n", n, rl, rh, wl, wh);
+	}
+	return 0;
+}
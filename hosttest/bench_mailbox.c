@@ -0,0 +1,184 @@
+/******************************************************************************
+* File Name          : bench_mailbox.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host benchmark: MailboxTask CAN id lookup, payload extract
+*******************************************************************************/
+/*
+Host time (ns per call), so only the ratios carry over to the target:
+  1) 'lookup' (binary search of the sorted id array) vs. the old straight pass
+     down the mailbox pointers, for 8 - 256 mailboxes, with all hits, and with
+     all misses (ids no mailbox has: most traffic on a busy bus).
+  2) 'payload_extract' (descriptor table) vs. the old paytype switch, per
+     paytype, dlc 8.  Both are calls, as on the target (MailboxTask calls into
+     payload_extract.c).
+
+Usage: bench_mailbox
+*/
+#include <string.h>
+#include <stdlib.h>
+#include "hostrtos.h"
+#include "hostcan.h"
+#include "can_iface.c"
+#include "payload_extract.c"
+#include "MailboxTask.c"
+#include "payload_switch.c"
+
+#define LOOKMAX  256
+#define LOOKREPS 4000000 // Lookups timed per case
+#define PAYREPS  500000  // Extracts per run; best of PAYRUNS runs per paytype
+#define PAYRUNS  8
+
+static struct MAILBOXCAN pool[LOOKMAX];
+static struct MAILBOXCAN* ptrs[LOOKMAX];
+static uint32_t ids[LOOKMAX];
+static uint32_t qhit[1024];  // Queries: ids with a mailbox
+static uint32_t qmiss[1024]; // Queries: ids without
+static volatile uintptr_t sink;
+
+static uint32_t lcg = 12345;
+static uint32_t rnd(void)
+{
+	lcg = (lcg * 1664525u) + 1013904223u;
+	return lcg;
+}
+static int idcmp(const void* a, const void* b)
+{
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+/* The old 'lookup': straight pass down the array of mailbox pointers */
+static __attribute__((noinline)) struct MAILBOXCAN* linlookup(struct MAILBOXCANNUM* pmbxnum, struct CANRCVBUFN* pncan)
+{
+	struct MAILBOXCAN* pmbx;
+	int i;
+	for (i = 0; i < pmbxnum->arraysizecur; i++)
+	{
+		pmbx = *(pmbxnum->pmbxarray + i);
+		if (pmbx->ncan.can.id == pncan->can.id)
+			return pmbx;
+	}
+	return NULL;
+}
+static __attribute__((noinline)) struct MAILBOXCAN* binlookup(struct MAILBOXCANNUM* pmbxnum, struct CANRCVBUFN* pncan)
+{
+	return lookup(pmbxnum, pncan);
+}
+/* ns per call over the query set */
+static double timeit(struct MAILBOXCAN* (*pf)(struct MAILBOXCANNUM*, struct CANRCVBUFN*),
+	struct MAILBOXCANNUM* pnum, const uint32_t* pq)
+{
+	struct CANRCVBUFN ncan;
+	uint64_t t0;
+	uintptr_t x = 0;
+	int i;
+
+	memset(&ncan, 0, sizeof(ncan));
+	t0 = hostns();
+	for (i = 0; i < LOOKREPS; i++)
+	{
+		ncan.can.id = pq[i & 1023];
+		x += (uintptr_t)(*pf)(pnum, &ncan);
+	}
+	sink = x;
+	return (double)(hostns() - t0) / LOOKREPS;
+}
+/* *************************************************************************
+ * 1) CAN id lookup
+ * *************************************************************************/
+static void bench_lookup(int n)
+{
+	struct MAILBOXCANNUM num;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{ // Distinct std ids, sorted
+		do ids[i] = (rnd() & 0x7ff) << 21;
+		while (bsearch(&ids[i], ids, i, sizeof(ids[0]), idcmp) != NULL);
+		qsort(ids, i + 1, sizeof(ids[0]), idcmp);
+	}
+	memset(&num, 0, sizeof(num));
+	for (i = 0; i < n; i++)
+	{
+		memset(&pool[i], 0, sizeof(pool[i]));
+		pool[i].ncan.can.id = ids[i];
+		ptrs[i] = &pool[i];
+	}
+	num.pmbxarray = ptrs;
+	num.pidarray = ids;
+	num.arraysizecur = n;
+	for (i = 0; i < 1024; i++)
+	{
+		qhit[i] = ids[rnd() % n];
+		do qmiss[i] = ((rnd() & 0x1fffffff) << 3) | 0x4; // Ext: never a std id
+		while (bsearchid(&num, qmiss[i]) >= 0);
+	}
+	printf("%4d   %6.1f  %6.1f    %6.1f  %6.1f\n", n,
+		timeit(binlookup, &num, qhit),  timeit(linlookup, &num, qhit),
+		timeit(binlookup, &num, qmiss), timeit(linlookup, &num, qmiss));
+}
+
+/* *************************************************************************
+ * 2) Payload extract
+ * *************************************************************************/
+static __attribute__((noinline)) void tblextract(struct MAILBOXCAN* pmbx)
+{
+	payload_extract(pmbx);
+}
+static __attribute__((noinline)) void swextract(struct MAILBOXCAN* pmbx)
+{
+	payload_extract_switch(pmbx);
+}
+static double timeextract(void (*pf)(struct MAILBOXCAN*), struct MAILBOXCAN* pmbx)
+{
+	uint64_t t0, dt, best = ~0ULL;
+	int i, r;
+
+	for (r = 0; r < PAYRUNS; r++)
+	{ // Best run: the least disturbed by the host
+		t0 = hostns();
+		for (i = 0; i < PAYREPS; i++)
+		{ // New payload each call, all eight bytes in one store
+			pmbx->ncan.can.cd.ull = (uint64_t)i * 0x0101010101010101ULL;
+			(*pf)(pmbx);
+		}
+		dt = hostns() - t0;
+		if (dt < best) best = dt;
+	}
+	sink = pmbx->ctr;
+	return (double)best / PAYREPS;
+}
+static void bench_extract(void)
+{
+	static const struct {uint8_t code; const char* name;} types[] =
+	{
+		{U8, "U8"}, {FF, "FF"}, {U32, "U32"}, {xFF, "xFF"}, {xxU32, "xxU32"},
+		{U8_FF, "U8_FF"}, {U8_U8_U32, "U8_U8_U32"}, {U8_U8_U8_U32, "U8_U8_U8_U32"},
+		{FF_FF, "FF_FF"}, {UNDEF, "UNDEF"},
+	};
+	static struct MAILBOXCAN mbx;
+	unsigned i;
+
+	mbx.ncan.can.dlc    = 8;
+	mbx.ncan.can.cd.ull = 0x3f8000003f800000ULL;
+	for (i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+	{
+		mbx.paytype = types[i].code;
+		printf("%-13s %6.2f  %6.2f\n", types[i].name,
+			timeextract(tblextract, &mbx), timeextract(swextract, &mbx));
+	}
+}
+
+int main(void)
+{
+	int n;
+
+	printf("--- CAN id lookup, ns per call: binary ('lookup') vs. straight pass\n");
+	printf("mbxs   hit:bin  hit:lin   miss:bin miss:lin\n");
+	for (n = 8; n <= LOOKMAX; n *= 2)
+		bench_lookup(n);
+	printf("--- payload_extract, ns per call, dlc 8: table vs. old switch\n");
+	printf("paytype        table  switch\n");
+	bench_extract();
+	return 0;
+}
@@ -0,0 +1,652 @@
+/******************************************************************************
+* File Name          : bxcan_model.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host tests: bxCAN peripheral & multi-node bus model
+*******************************************************************************/
+/*
+See bxcan_model.h for what is (and is not) modeled.
+*/
+#include <string.h>
+#include "bxcan_model.h"
+
+/* Driver callbacks (can_iface.c).  Weak, so tests without the CAN driver link. */
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *phcan) __attribute__((weak));
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *phcan) __attribute__((weak));
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *phcan) __attribute__((weak));
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *phcan) __attribute__((weak));
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *phcan) __attribute__((weak));
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *phcan) __attribute__((weak));
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *phcan) __attribute__((weak));
+
+static void (* const txokcb[3])(CAN_HandleTypeDef*) =
+	{HAL_CAN_TxMailbox0CompleteCallback, HAL_CAN_TxMailbox1CompleteCallback, HAL_CAN_TxMailbox2CompleteCallback};
+static void (* const abortcb[3])(CAN_HandleTypeDef*) =
+	{HAL_CAN_TxMailbox0AbortCallback, HAL_CAN_TxMailbox1AbortCallback, HAL_CAN_TxMailbox2AbortCallback};
+
+struct BXCANNODE bxnode[HOSTCANNUM];
+int      bxnodect;
+struct BXLOG bxlog[BXLOGSZ];
+uint32_t bxlogct;
+uint32_t bxbitclk;
+uint32_t bxidle;
+
+static uint32_t bxtpb;    // DTW ticks per bit
+static uint32_t bxidlerem; // Idle DTW ticks not yet a whole bit
+static uint32_t bxreqseq; // TXRQ order stamps
+
+#define BXFILTBANKS 14 // F103
+#define BXBITSMAX  160 // SOF..CRC, unstuffed: 1+32+6+64+15 max
+#define BXERRBITS   17 // Error flag 6, delimiter 8, intermission 3
+
+/* TSR flags for mailbox k */
+#define TSRK(f,k) ((f) << ((k) << 3))
+#define TMEK(k)   (CAN_TSR_TME0 << (k))
+
+/* Frame bits SOF..CRC, unstuffed */
+struct BXBITS
+{
+	uint8_t b[BXBITSMAX];
+	int n;   // Number of bits
+	int arb; // Bits through the end of the arbitration field
+};
+/* Mailbox offered for arbitration */
+struct BXTX
+{
+	struct BXBITS bits;
+	uint32_t tir;
+	uint32_t tdtr;
+	uint32_t tdlr;
+	uint32_t tdhr;
+	int node;
+	int k;
+	int fate; // 0 = still in; 1 = ALST; 2 = TERR
+};
+
+/* *************************************************************************
+ * Frame bits
+ * *************************************************************************/
+static void putbits(struct BXBITS* p, uint32_t v, int nb)
+{
+	while (nb-- > 0)
+		p->b[p->n++] = (v >> nb) & 1;
+}
+static void mkbits(struct BXBITS* p, uint32_t tir, uint32_t tdtr, uint32_t tdlr, uint32_t tdhr)
+{
+	uint32_t rtr = (tir & CAN_TI0R_RTR) ? 1 : 0;
+	uint32_t dlc = tdtr & CAN_TDT0R_DLC;
+	uint32_t nbyte = (rtr != 0) ? 0 : ((dlc > 8) ? 8 : dlc);
+	uint32_t crc = 0;
+	uint32_t i;
+
+	p->n = 0;
+	putbits(p, 0, 1);          // SOF
+	putbits(p, tir >> 21, 11); // ID[28:18] or ID[10:0]
+	if ((tir & CAN_TI0R_IDE) != 0)
+	{
+		putbits(p, 1, 1);                   // SRR
+		putbits(p, 1, 1);                   // IDE
+		putbits(p, (tir >> 3) & 0x3FFFF, 18); // ID[17:0]
+		putbits(p, rtr, 1);
+		p->arb = p->n;
+		putbits(p, 0, 2);                   // r1, r0
+	}
+	else
+	{
+		putbits(p, rtr, 1);
+		putbits(p, 0, 1);                   // IDE
+		p->arb = p->n;
+		putbits(p, 0, 1);                   // r0
+	}
+	putbits(p, dlc, 4);
+	for (i = 0; i < nbyte; i++)
+		putbits(p, ((i < 4) ? (tdlr >> (i << 3)) : (tdhr >> ((i - 4) << 3))) & 0xFF, 8);
+
+	/* CRC-15: x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1 */
+	for (i = 0; i < (uint32_t)p->n; i++)
+	{
+		uint32_t nxt = p->b[i] ^ ((crc >> 14) & 1);
+		crc = (crc << 1) & 0x7FFF;
+		if (nxt != 0) crc ^= 0x4599;
+	}
+	putbits(p, crc, 15);
+}
+/* Stuff bits added to the first 'n' bits */
+static uint32_t stuffct(const struct BXBITS* p, int n)
+{
+	uint32_t ct = 0;
+	int run = 0;
+	int last = -1;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (p->b[i] == last)
+			run += 1;
+		else
+		{
+			last = p->b[i];
+			run = 1;
+		}
+		if (run == 5)
+		{ // Complement bit inserted; it starts the next run
+			ct += 1;
+			last = !last;
+			run = 1;
+		}
+	}
+	return ct;
+}
+/* *************************************************************************
+ * uint32_t bxcan_model_framebits(uint32_t tir, uint32_t tdtr, uint32_t tdlr, uint32_t tdhr);
+ * @brief	: Bits on the bus: SOF to EOF stuffed, plus 3 bit intermission
+ * *************************************************************************/
+uint32_t bxcan_model_framebits(uint32_t tir, uint32_t tdtr, uint32_t tdlr, uint32_t tdhr)
+{
+	struct BXBITS bits;
+	mkbits(&bits, tir, tdtr, tdlr, tdhr);
+	/* CRC delimiter 1, ACK slot & delimiter 2, EOF 7, intermission 3 */
+	return bits.n + stuffct(&bits, bits.n) + 13;
+}
+uint32_t bxcan_model_tpb(void)
+{
+	return bxtpb;
+}
+/* *************************************************************************
+ * Filters
+ * *************************************************************************/
+/* 16 bit filter format: STID[10:0] RTR IDE EXID[17:15] */
+static uint32_t rir16(uint32_t rir)
+{
+	return ((rir >> 21) << 5) | (((rir >> 1) & 1) << 4) | (((rir >> 2) & 1) << 3) | ((rir >> 18) & 7);
+}
+/* Filter in bank that passes the id: 0 - 3; -1 = none */
+static int bankhit(uint32_t fr1, uint32_t fr2, int scale32, int list, uint32_t rir)
+{
+	uint32_t id = rir & ~0x1;
+	uint32_t v = rir16(rir);
+
+	if (scale32 != 0)
+	{
+		if (list == 0) return ((((id ^ fr1) & fr2) & ~0x1) == 0) ? 0 : -1;
+		if (id == (fr1 & ~0x1)) return 0;
+		if (id == (fr2 & ~0x1)) return 1;
+		return -1;
+	}
+	if (list == 0)
+	{ // Two 16 bit id/mask pairs: mask in the upper half
+		if (((v ^ fr1) & (fr1 >> 16) & 0xFFFF) == 0) return 0;
+		if (((v ^ fr2) & (fr2 >> 16) & 0xFFFF) == 0) return 1;
+		return -1;
+	}
+	if (v == (fr1 & 0xFFFF)) return 0;
+	if (v == (fr1 >> 16))    return 1;
+	if (v == (fr2 & 0xFFFF)) return 2;
+	if (v == (fr2 >> 16))    return 3;
+	return -1;
+}
+/* *************************************************************************
+ * int bxcan_model_filter(int node, uint32_t rir, uint32_t* pfmi);
+ * @brief	: Filter banks of 'node' applied to a frame id
+ * @return	: FIFO 0 or 1; -1 = rejected
+ * *************************************************************************/
+int bxcan_model_filter(int node, uint32_t rir, uint32_t* pfmi)
+{
+	CAN_TypeDef* pcan = hostcan[node].Instance;
+	uint32_t fmi[2] = {0, 0}; // Next filter number, per FIFO (all banks, active or not)
+	uint32_t bit;
+	int b, f, h, scale32, list, score;
+	int best = -1;
+	int bestscore = -1;
+
+	for (b = 0; b < BXFILTBANKS; b++)
+	{
+		bit = (1 << b);
+		f = ((pcan->FFA1R & bit) != 0);
+		scale32 = ((pcan->FS1R & bit) != 0);
+		list = ((pcan->FM1R & bit) != 0);
+		if ((pcan->FA1R & bit) != 0)
+		{
+			h = bankhit(pcan->sFilterRegister[b].FR1, pcan->sFilterRegister[b].FR2, scale32, list, rir);
+			score = (scale32 << 1) | list; // 32 bit over 16 bit, then list over mask
+			if ((h >= 0) && (score > bestscore))
+			{ // Lower bank wins a tie: only a higher score replaces
+				best = f;
+				bestscore = score;
+				*pfmi = fmi[f] + h;
+			}
+		}
+		fmi[f] += (scale32 != 0) ? (list ? 2 : 1) : (list ? 4 : 2);
+	}
+	return best;
+}
+/* *************************************************************************
+ * void bxcan_model_acceptall(int node, uint32_t fifo);
+ * @brief	: Bank 0: pass all to 'fifo' (32 bit mask 0), via HAL_CAN_ConfigFilter
+ * *************************************************************************/
+void bxcan_model_acceptall(int node, uint32_t fifo)
+{
+	CAN_FilterTypeDef f;
+	memset(&f, 0, sizeof(f));
+	f.FilterBank = 0;
+	f.FilterMode = CAN_FILTERMODE_IDMASK;
+	f.FilterScale = CAN_FILTERSCALE_32BIT;
+	f.FilterFIFOAssignment = fifo;
+	f.FilterActivation = CAN_FILTER_ENABLE;
+	HAL_CAN_ConfigFilter(&hostcan[node], &f);
+}
+/* *************************************************************************
+ * void bxcan_model_init(int nodect, uint32_t btr, uint32_t mcr);
+ * @brief	: Reset nodes 0 - (nodect-1): registers, model state, log
+ * *************************************************************************/
+void bxcan_model_init(int nodect, uint32_t btr, uint32_t mcr)
+{
+	uint32_t brp = (btr & CAN_BTR_BRP) + 1;
+	uint32_t tq  = 1 + (((btr & CAN_BTR_TS1) >> CAN_BTR_TS1_Pos) + 1) + (((btr & CAN_BTR_TS2) >> CAN_BTR_TS2_Pos) + 1);
+	int n;
+
+	for (n = 0; n < nodect; n++)
+	{
+		hostcan_reset(n, btr);
+		hostcan[n].Instance->MCR = mcr;
+	}
+	memset(bxnode, 0, sizeof(bxnode));
+	bxnodect = nodect;
+	bxlogct  = 0;
+	bxbitclk = 0;
+	bxidle   = 0;
+	bxidlerem = 0;
+	bxreqseq = 0;
+	bxtpb = SystemCoreClock / (HOSTPCLK1 / (brp * tq));
+}
+/* *************************************************************************
+ * Interrupts
+ * *************************************************************************/
+/* HAL_CAN_IRQHandler, TX part: TSR read once, then mailbox 0, 1, 2 */
+static void txirq(int node)
+{
+	CAN_HandleTypeDef* phcan = &hostcan[node];
+	uint32_t tsr = phcan->Instance->TSR;
+	uint32_t errorcode = 0;
+	int k;
+
+	for (k = 0; k < 3; k++)
+	{
+		if ((tsr & TSRK(CAN_TSR_RQCP0, k)) == 0) continue;
+		/* Writing RQCP clears RQCP, TXOK, ALST, TERR */
+		phcan->Instance->TSR &= ~TSRK(CAN_TSR_RQCP0 | CAN_TSR_TXOK0 | CAN_TSR_ALST0 | CAN_TSR_TERR0, k);
+		if ((tsr & TSRK(CAN_TSR_TXOK0, k)) != 0)
+			txokcb[k](phcan);
+		else if ((tsr & TSRK(CAN_TSR_ALST0, k)) != 0)
+			errorcode |= (HAL_CAN_ERROR_TX_ALST0 << (k << 1));
+		else if ((tsr & TSRK(CAN_TSR_TERR0, k)) != 0)
+			errorcode |= (HAL_CAN_ERROR_TX_TERR0 << (k << 1));
+		else
+			abortcb[k](phcan);
+	}
+	if (errorcode != 0)
+	{
+		phcan->ErrorCode |= errorcode;
+		HAL_CAN_ErrorCallback(phcan);
+	}
+}
+/* IRQs that are due */
+static void irqs(void)
+{
+	struct BXCANNODE* pn;
+	int n, i;
+
+	for (n = 0; n < bxnodect; n++)
+	{
+		pn = &bxnode[n];
+		for (i = 0; i < 3; i++)
+		{
+			if ((pn->irqpend[i] == 0) || ((int32_t)(hostdtw - pn->irqdue[i]) < 0)) continue;
+			pn->irqpend[i] = 0;
+			if (i == BXIRQTX)
+			{
+				txirq(n);
+				continue;
+			}
+			pn->rxdepth[i][pn->fifo[i].n] += 1; // One drain on the target
+			if (hostcan_drain(n, i, &pn->fifo[i]) < 0)
+			{ // Driver left the FIFO as it was: drop it, don't spin
+				pn->stuck += 1;
+				pn->fifo[i].n = 0;
+				pn->fifo[i].fovr = 0;
+			}
+		}
+	}
+}
+/* Earliest pending IRQ: 0 = none */
+static int irqnext(uint32_t* pdue)
+{
+	int n, i;
+	int hit = 0;
+
+	for (n = 0; n < bxnodect; n++)
+		for (i = 0; i < 3; i++)
+			if ((bxnode[n].irqpend[i] != 0) && ((hit == 0) || ((int32_t)(bxnode[n].irqdue[i] - *pdue) < 0)))
+			{
+				*pdue = bxnode[n].irqdue[i];
+				hit = 1;
+			}
+	return hit;
+}
+/* Raise an IRQ; one already pending covers it */
+static void irqpost(int node, int i, uint32_t delay)
+{
+	struct BXCANNODE* pn = &bxnode[node];
+	if (pn->irqpend[i] != 0) return;
+	if ((i == BXIRQTX) && (delay == 0))
+	{
+		txirq(node);
+		return;
+	}
+	pn->irqpend[i] = 1;
+	pn->irqdue[i]  = hostdtw + delay;
+}
+/* Mailbox k of 'node' done: TXRQ off, mailbox empty, 'flags' (RQCP...) set */
+static void mbxdone(int node, int k, uint32_t flags)
+{
+	CAN_TypeDef* pcan = hostcan[node].Instance;
+	pcan->sTxMailBox[k].TIR &= ~CAN_TI0R_TXRQ;
+	pcan->TSR = (pcan->TSR & ~TSRK(CAN_TSR_ABRQ0, k)) | TSRK(flags, k) | TMEK(k);
+	bxnode[node].reqseq[k] = 0;
+}
+/* Abort requests: done at bus idle, i.e. before the next arbitration */
+static void aborts(void)
+{
+	CAN_TypeDef* pcan;
+	int n, k, hit;
+
+	for (n = 0; n < bxnodect; n++)
+	{
+		pcan = hostcan[n].Instance;
+		hit = 0;
+		for (k = 0; k < 3; k++)
+		{
+			if ((pcan->TSR & TSRK(CAN_TSR_ABRQ0, k)) == 0) continue;
+			if ((pcan->sTxMailBox[k].TIR & CAN_TI0R_TXRQ) != 0)
+			{
+				mbxdone(n, k, CAN_TSR_RQCP0);
+				bxnode[n].abrt += 1;
+				hit = 1;
+			}
+			else
+				pcan->TSR &= ~TSRK(CAN_TSR_ABRQ0, k); // Empty mailbox: no effect
+		}
+		if (hit != 0) irqpost(n, BXIRQTX, bxnode[n].txdelay);
+	}
+}
+/* Frame into a node's FIFO */
+static void rxput(int node, uint32_t tir, uint32_t tdtr, uint32_t tdlr, uint32_t tdhr, uint32_t sof)
+{
+	struct BXCANNODE* pn = &bxnode[node];
+	struct HOSTCANFIFO* pq;
+	CAN_FIFOMailBox_TypeDef m;
+	uint32_t fmi = 0;
+	int f = bxcan_model_filter(node, tir, &fmi);
+
+	if (f < 0)
+	{
+		pn->filtrej += 1;
+		return;
+	}
+	m.RIR  = tir & ~CAN_TI0R_TXRQ;
+	m.RDTR = (tdtr & CAN_TDT0R_DLC) | (fmi << CAN_RDT0R_FMI_Pos) | ((sof & 0xFFFF) << CAN_RDT0R_TIME_Pos);
+	m.RDLR = tdlr;
+	m.RDHR = tdhr;
+
+	pq = &pn->fifo[f];
+	pn->rxct[f] += 1;
+	if (pq->n < HOSTCANFIFOSZ)
+		pq->f[pq->n++] = m;
+	else
+	{ // Overrun: FIFO locked, the new one is lost; else it overwrites the newest
+		pq->fovr = CAN_RF0R_FOVR0;
+		pn->rxlost[f] += 1;
+		if ((hostcan[node].Instance->MCR & CAN_MCR_RFLM) == 0)
+			pq->f[HOSTCANFIFOSZ - 1] = m;
+	}
+	irqpost(node, f, pn->rxdelay);
+}
+static void logadd(struct BXTX* pt, int node, int ok)
+{
+	struct BXLOG* pl;
+	if (bxlogct < BXLOGSZ)
+	{
+		pl = &bxlog[bxlogct];
+		pl->dtw  = hostdtw;
+		pl->tir  = pt->tir & ~CAN_TI0R_TXRQ;
+		pl->tdtr = pt->tdtr;
+		pl->tdlr = pt->tdlr;
+		pl->tdhr = pt->tdhr;
+		pl->node = node;
+		pl->mbx  = pt->k;
+		pl->ok   = ok;
+	}
+	bxlogct += 1;
+}
+/* *************************************************************************
+ * int bxcan_model_step(void);
+ * @brief	: Run due IRQs, then one frame on the bus (if any pending)
+ * @return	: 1 = frame (or error frame); 0 = bus idle
+ * *************************************************************************/
+int bxcan_model_step(void)
+{
+	struct BXTX tx[HOSTCANNUM + 1];
+	struct BXTX* pt;
+	CAN_TypeDef* pcan;
+	uint32_t id, best, bits, sof, nart;
+	int n, k, kb, ct, pos, bus, in, err, win, nsend;
+
+	irqs();
+	aborts();
+
+	/* Each node offers one pending mailbox */
+	ct = 0;
+	for (n = 0; n < bxnodect; n++)
+	{
+		pcan = hostcan[n].Instance;
+		kb = -1;
+		best = 0;
+		for (k = 0; k < 3; k++)
+		{
+			if ((pcan->sTxMailBox[k].TIR & CAN_TI0R_TXRQ) == 0) continue;
+			pcan->TSR &= ~TMEK(k); // Pending: not empty until done ('mbxdone')
+			if (bxnode[n].reqseq[k] == 0) bxnode[n].reqseq[k] = ++bxreqseq;
+			id = ((pcan->MCR & CAN_MCR_TXFP) != 0) ? bxnode[n].reqseq[k] : (pcan->sTxMailBox[k].TIR & ~CAN_TI0R_TXRQ);
+			if ((kb < 0) || (id < best))
+			{ // Equal: the lower mailbox number stays
+				kb = k;
+				best = id;
+			}
+		}
+		if (kb < 0) continue;
+		pt = &tx[ct++];
+		pt->node = n;
+		pt->k    = kb;
+		pt->tir  = pcan->sTxMailBox[kb].TIR;
+		pt->tdtr = pcan->sTxMailBox[kb].TDTR;
+		pt->tdlr = pcan->sTxMailBox[kb].TDLR;
+		pt->tdhr = pcan->sTxMailBox[kb].TDHR;
+		pt->fate = 0;
+		mkbits(&pt->bits, pt->tir, pt->tdtr, pt->tdlr, pt->tdhr);
+		if (bxnode[n].alstinj != 0)
+		{ // Loses to a frame from outside the model
+			bxnode[n].alstinj -= 1;
+			pt->fate = 1;
+		}
+	}
+	if (ct == 0) return 0; // Bus idle
+
+	/* Wired AND, bit by bit.  Identical streams end together. */
+	err = 0;
+	for (pos = 0; pos < BXBITSMAX; pos++)
+	{
+		bus = 1;
+		in = 0;
+		for (n = 0; n < ct; n++)
+		{
+			if ((tx[n].fate != 0) || (pos >= tx[n].bits.n)) continue;
+			bus &= tx[n].bits.b[pos];
+			in += 1;
+		}
+		if (in == 0) break;
+		for (n = 0; n < ct; n++)
+		{
+			if ((tx[n].fate != 0) || (pos >= tx[n].bits.n)) continue;
+			if ((tx[n].bits.b[pos] == 1) && (bus == 0))
+			{ // Sent recessive, read dominant
+				if (pos < tx[n].bits.arb)
+					tx[n].fate = 1;
+				else
+				{ // Same id, different control/data: bit error
+					tx[n].fate = 2;
+					err = pos;
+				}
+			}
+		}
+	}
+	win = -1;
+	for (n = 0; n < ct; n++)
+		if (tx[n].fate == 0) {win = n; break;}
+
+	sof = bxbitclk;
+	for (n = 0; n < ct; n++)
+	{ // TTCM: every mailbox that started a frame captures the SOF time
+		pcan = hostcan[tx[n].node].Instance;
+		if ((pcan->MCR & CAN_MCR_TTCM) == 0) continue;
+		pcan->sTxMailBox[tx[n].k].TDTR = (pcan->sTxMailBox[tx[n].k].TDTR & ~CAN_TDT0R_TIME) |
+		                                 ((sof & 0xFFFF) << CAN_TDT0R_TIME_Pos);
+	}
+	if (win < 0)
+	{ // Everyone lost to an outside frame: std id 0, no data
+		struct BXTX x;
+		memset(&x, 0, sizeof(x));
+		bits = bxcan_model_framebits(0, 0, 0, 0);
+		hostdtw  += bits * bxtpb;
+		bxbitclk += bits;
+		logadd(&x, -1, 1);
+	}
+	else
+	{
+		/* Errors: collision (above), injected, or no other node to ACK */
+		nsend = 0;
+		for (n = 0; n < ct; n++)
+		{
+			if (tx[n].fate != 0) continue;
+			if (bxnode[tx[n].node].terrinj != 0)
+			{
+				bxnode[tx[n].node].terrinj -= 1;
+				err = -1;
+			}
+			nsend += 1;
+		}
+		if ((err == 0) && (nsend >= bxnodect)) err = -1; // ACK error
+		pt = &tx[win];
+		if (err > 0)
+			bits = err + stuffct(&pt->bits, err) + BXERRBITS;
+		else if (err < 0)
+			bits = pt->bits.n + stuffct(&pt->bits, pt->bits.n) + 2 + BXERRBITS; // At ACK slot
+		else
+			bits = bxcan_model_framebits(pt->tir, pt->tdtr, pt->tdlr, pt->tdhr);
+		hostdtw  += bits * bxtpb;
+		bxbitclk += bits;
+		for (n = 0; n < ct; n++)
+		{
+			if (tx[n].fate != 0) continue;
+			if (err != 0) tx[n].fate = 2;
+		}
+		logadd(pt, pt->node, (err == 0));
+	}
+
+	/* Mailbox results: NART ends the request on loss or error; else retry */
+	for (n = 0; n < ct; n++)
+	{
+		pt = &tx[n];
+		pcan = hostcan[pt->node].Instance;
+		nart = ((pcan->MCR & CAN_MCR_NART) != 0) ? CAN_TSR_RQCP0 : 0;
+		if (pt->fate == 0)
+		{
+			bxnode[pt->node].txok += 1;
+			mbxdone(pt->node, pt->k, CAN_TSR_RQCP0 | CAN_TSR_TXOK0);
+		}
+		else if (pt->fate == 1)
+		{
+			bxnode[pt->node].alst += 1;
+			if (nart != 0)
+				mbxdone(pt->node, pt->k, CAN_TSR_RQCP0 | CAN_TSR_ALST0);
+			else
+				pcan->TSR |= TSRK(CAN_TSR_ALST0, pt->k);
+		}
+		else
+		{
+			bxnode[pt->node].terr += 1;
+			if (nart != 0)
+				mbxdone(pt->node, pt->k, CAN_TSR_RQCP0 | CAN_TSR_TERR0);
+			else
+				pcan->TSR |= TSRK(CAN_TSR_TERR0, pt->k);
+		}
+	}
+	for (n = 0; n < ct; n++)
+		irqpost(tx[n].node, BXIRQTX, bxnode[tx[n].node].txdelay);
+
+	/* Receivers: every node that did not send it */
+	if ((win >= 0) && (err == 0))
+	{
+		pt = &tx[win];
+		for (n = 0; n < bxnodect; n++)
+		{
+			for (k = 0; k < ct; k++)
+				if ((tx[k].node == n) && (tx[k].fate == 0)) break;
+			if (k < ct) continue;
+			rxput(n, pt->tir, pt->tdtr, pt->tdlr, pt->tdhr, sof);
+		}
+	}
+	irqs();
+	return 1;
+}
+/* *************************************************************************
+ * void bxcan_model_idle(uint32_t ticks);
+ * @brief	: Advance time with the bus idle; IRQs that come due run
+ * *************************************************************************/
+void bxcan_model_idle(uint32_t ticks)
+{
+	uint32_t end = hostdtw + ticks;
+	uint32_t due;
+
+	while ((irqnext(&due) != 0) && ((int32_t)(due - end) <= 0))
+	{
+		if ((int32_t)(due - hostdtw) > 0) hostdtw = due;
+		irqs();
+	}
+	hostdtw = end;
+	bxbitclk += (bxidlerem + ticks) / bxtpb; // Timer stays in step with DTW
+	bxidlerem = (bxidlerem + ticks) % bxtpb;
+	bxidle   += ticks / bxtpb;
+}
+/* *************************************************************************
+ * int bxcan_model_run(int max);
+ * @brief	: Step until the bus is idle and no IRQ is pending
+ * @return	: number of bus events
+ * *************************************************************************/
+int bxcan_model_run(int max)
+{
+	uint32_t due;
+	int ct = 0;
+
+	while (ct < max)
+	{
+		if (bxcan_model_step() != 0)
+		{
+			ct += 1;
+			continue;
+		}
+		/* Bus idle: wait for the next pending IRQ (it might load a mailbox) */
+		if (irqnext(&due) == 0) return ct;
+		bxcan_model_idle(((int32_t)(due - hostdtw) > 0) ? (due - hostdtw) : 0);
+	}
+	return ct;
+}
@@ -0,0 +1,124 @@
+/******************************************************************************
+* File Name          : bxcan_model.h
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host tests: bxCAN peripheral & multi-node bus model
+*******************************************************************************/
+/*
+Each node is one 'hostcan' module (CAN_TypeDef in plain memory) run by the
+unmodified driver.  The model plays the bxCAN hardware and the bus between them:
+
+TX:  a mailbox is pending while its TIxR TXRQ bit is set.  Each node offers one
+     mailbox: the lowest identifier (TXFP = 0; equal ids, lowest mailbox number),
+     or the oldest request (TXFP = 1).  Arbitration is bit by bit (wired AND) over
+     the unstuffed SOF..CRC bits, so std/ext, RTR and SRR/IDE come out as they do
+     on the bus.  Losers in the arbitration field get ALST; nodes sending the same
+     id with different DLC/data collide in the control/data field and all get TERR.
+     A frame nobody else is there to ACK gets TERR (ACK error).
+     NART (MCR) set: every loss or error ends the request (RQCP) as MX_CAN_Init
+     sets it up; NART clear: the mailbox stays pending (hardware retry).
+     ABRQ (HAL_CAN_AbortTxRequest) takes effect at the next bus idle.
+IRQ: TSR flags are set and the HAL_CAN_IRQHandler dispatch is copied: per mailbox
+     TXOK -> complete callback, else ALST/TERR -> ErrorCode & HAL_CAN_ErrorCallback,
+     else abort callback.  The TX IRQ runs 'txdelay' DTW ticks after a mailbox
+     completes, so with a long one the bxCAN goes on with its other mailboxes
+     first, as it does when the ISR is held off.
+RX:  the frame goes to every other node through its filter banks (FA1R, FS1R, FM1R,
+     FFA1R, FxR1/2; 32 bit over 16 bit, list over mask, then lowest bank), into a
+     3 deep FIFO (RFLM clear: a 4th overwrites the newest; set: it is lost; both set
+     FOVR).  The FIFO IRQ runs 'rxdelay' DTW ticks after a frame arrives.
+Time: 'hostdtw' (72 MHz) advances by the stuffed frame length plus intermission;
+     RDTxR TIME is the bit count at SOF, and with MCR TTCM so is TDTxR TIME of
+     the mailboxes that started the frame.
+
+Injection: 'alstinj' makes a node lose its next n arbitrations (to a frame from
+outside the model, which takes the bus if no modeled node is left); 'terrinj' puts
+a bus error on its next n frames.  Not modeled: error counters/passive/bus-off,
+error frames from receivers, silent/loopback modes, overload frames.
+*/
+
+#ifndef __BXCAN_MODEL
+#define __BXCAN_MODEL
+
+#include "hostcan.h"
+
+#define BXLOGSZ 1024 // Bus log: frames & errors, oldest first
+#define BXIRQTX 2    // 'irqdue', 'irqpend' index of the TX IRQ
+
+/* Per node model state */
+struct BXCANNODE
+{
+	struct HOSTCANFIFO fifo[2];
+	uint32_t irqdue[3];  // DTW time the pending IRQ runs: FIFO 0, FIFO 1, TX (BXIRQTX)
+	uint8_t  irqpend[3]; // 1 = IRQ pending
+	uint32_t reqseq[3];  // TXRQ order (TXFP)
+	uint32_t rxdelay;    // FIFO IRQ latency (DTW ticks)
+	uint32_t txdelay;    // TX IRQ latency (DTW ticks)
+	uint32_t alstinj;    // Injected: lose the next n arbitrations
+	uint32_t terrinj;    // Injected: bus error on the next n frames
+	/* Counts */
+	uint32_t txok;
+	uint32_t alst;
+	uint32_t terr;
+	uint32_t abrt;
+	uint32_t rxct[2];    // Frames into FIFO
+	uint32_t rxlost[2];  // Frames lost (overrun)
+	uint32_t rxdepth[2][HOSTCANFIFOSZ + 1]; // FIFO IRQs by frames held when it ran
+	uint32_t filtrej;    // Frames no filter passed
+	uint32_t stuck;      // FIFO IRQ returned without releasing (hostcan_drain -1)
+};
+
+/* One bus event */
+struct BXLOG
+{
+	uint32_t dtw;  // Time at end of frame
+	uint32_t tir;  // TIxR (TXRQ dropped)
+	uint32_t tdtr;
+	uint32_t tdlr;
+	uint32_t tdhr;
+	int8_t   node; // Sender; -1 = outside the model
+	uint8_t  mbx;  // Mailbox 0 - 2
+	uint8_t  ok;   // 1 = sent; 0 = error frame
+};
+
+extern struct BXCANNODE bxnode[HOSTCANNUM];
+extern int      bxnodect;
+extern struct BXLOG bxlog[BXLOGSZ];
+extern uint32_t bxlogct;  // Number of bus events (log keeps the first BXLOGSZ)
+extern uint32_t bxbitclk; // Bits since init (bxCAN timer)
+extern uint32_t bxidle;   // Bits the bus was idle while 'bxcan_model_idle' advanced time
+
+/******************************************************************************/
+void bxcan_model_init(int nodect, uint32_t btr, uint32_t mcr);
+/* @brief	: Reset nodes 0 - (nodect-1): registers, model state, log
+ * @param	: nodect = number of nodes on the bus, 1 - HOSTCANNUM
+ * @param	: btr = bit timing register (HOSTCANBTR500K, HOSTCANBTR1M)
+ * @param	: mcr = e.g. CAN_MCR_NART (as MX_CAN_Init), CAN_MCR_TXFP, CAN_MCR_RFLM
+*******************************************************************************/
+void bxcan_model_acceptall(int node, uint32_t fifo);
+/* @brief	: Bank 0: pass all to 'fifo' (32 bit mask 0), via HAL_CAN_ConfigFilter
+*******************************************************************************/
+uint32_t bxcan_model_tpb(void);
+/* @brief	: DTW ticks per bit
+*******************************************************************************/
+uint32_t bxcan_model_framebits(uint32_t tir, uint32_t tdtr, uint32_t tdlr, uint32_t tdhr);
+/* @brief	: Bits on the bus: SOF to EOF stuffed, plus 3 bit intermission
+*******************************************************************************/
+int bxcan_model_step(void);
+/* @brief	: Run due IRQs, then one frame on the bus (if any pending)
+ * @return	: 1 = frame (or error frame); 0 = bus idle
+*******************************************************************************/
+int bxcan_model_run(int max);
+/* @brief	: Step until the bus is idle and no IRQ is pending
+ * @param	: max = limit on steps
+ * @return	: number of bus events
+*******************************************************************************/
+void bxcan_model_idle(uint32_t ticks);
+/* @brief	: Advance time with the bus idle; IRQs that come due run
+*******************************************************************************/
+int bxcan_model_filter(int node, uint32_t rir, uint32_t* pfmi);
+/* @brief	: Filter banks of 'node' applied to a frame id
+ * @return	: FIFO 0 or 1; -1 = rejected
+*******************************************************************************/
+
+#endif
@@ -0,0 +1,169 @@
+/******************************************************************************
+* File Name          : hostcan.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host tests: bxCAN register blocks & HAL CAN stand-ins
+*******************************************************************************/
+#include <string.h>
+#include "hostcan.h"
+#include "can_iface.h"
+
+/* FIFO IRQ entry points (can_iface.c).  Weak, so tests without the CAN driver link. */
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *phcan) __attribute__((weak));
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *phcan) __attribute__((weak));
+void can_iface_rx1_IRQHandler(CAN_HandleTypeDef *phcan) __attribute__((weak));
+
+struct HOSTCANREGS hostcanregs[HOSTCANNUM] __attribute__((aligned(8192)));
+CAN_HandleTypeDef  hostcan[HOSTCANNUM];
+uint32_t hostabortreq[HOSTCANNUM];
+
+/* Referenced by the drivers (debugging) */
+uint32_t debugTX1c;
+uint32_t SystemCoreClock = 72000000;
+
+/* *************************************************************************
+ * CAN_HandleTypeDef* hostcan_reset(int n, uint32_t btr);
+ * @brief	: Zero registers of CAN module 'n', set BTR; handle points to them
+ * *************************************************************************/
+CAN_HandleTypeDef* hostcan_reset(int n, uint32_t btr)
+{
+	memset(&hostcanregs[n], 0, sizeof(struct HOSTCANREGS));
+	memset(&hostcan[n], 0, sizeof(CAN_HandleTypeDef));
+	hostcanregs[n].r.BTR = btr;
+	hostcanregs[n].r.TSR = CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2;
+	hostcan[n].Instance = &hostcanregs[n].r;
+	hostcan[n].State = HAL_CAN_STATE_READY;
+	hostabortreq[n] = 0;
+	return &hostcan[n];
+}
+/* RX FIFO IRQ, as the vector table routes it */
+static void fifoirq(int n, int fifo)
+{
+	if (fifo == CAN_RX_FIFO0)
+		HAL_CAN_RxFifo0MsgPendingCallback(&hostcan[n]);
+	else
+#ifdef CANRXFIFO1HIPRI
+		can_iface_rx1_IRQHandler(&hostcan[n]);
+#else
+		HAL_CAN_RxFifo1MsgPendingCallback(&hostcan[n]);
+#endif
+}
+/* *************************************************************************
+ * int hostcan_drain(int n, int fifo, struct HOSTCANFIFO* pq);
+ * @brief	: Run the RX FIFO IRQ until 'pq' is empty and its overrun flag cleared
+ * @return	: number of frames released by the driver (RFOM written); -1 = stuck
+ * *************************************************************************/
+int hostcan_drain(int n, int fifo, struct HOSTCANFIFO* pq)
+{
+	CAN_TypeDef* pcan = hostcan[n].Instance;
+	volatile uint32_t* prfr = (fifo == CAN_RX_FIFO0) ? &pcan->RF0R : &pcan->RF1R;
+	int ct = 0;
+	int i;
+
+	/* RFxR: FMP[1:0], FULL, FOVR, RFOM have the same place for both FIFOs */
+	while ((pq->n != 0) || (pq->fovr != 0))
+	{
+		if (pq->n != 0) pcan->sFIFOMailBox[fifo] = pq->f[0]; // Output mailbox: oldest
+		*prfr = pq->n | ((pq->n == HOSTCANFIFOSZ) ? CAN_RF0R_FULL0 : 0) | pq->fovr;
+		fifoirq(n, fifo);
+		if ((*prfr == CAN_RF0R_RFOM0) && (pq->n != 0))
+		{ // Released
+			for (i = 1; i < pq->n; i++) pq->f[i-1] = pq->f[i];
+			pq->n -= 1;
+			ct += 1;
+		}
+		else if (*prfr == CAN_RF0R_FOVR0)
+			pq->fovr = 0; // Overrun flag cleared
+		else
+			return -1;    // Nothing (IRQ would fire forever), or some other write
+	}
+	return ct; // RFxR: the driver's last write
+}
+/* *************************************************************************
+ * int hostcan_rx(int n, int fifo, const CAN_FIFOMailBox_TypeDef* pf, int ct);
+ * @brief	: Frames arrive at a RX FIFO while its IRQ is held off, then the IRQ runs
+ * @return	: number of frames released by the driver (RFOM written); -1 = stuck
+ * *************************************************************************/
+int hostcan_rx(int n, int fifo, const CAN_FIFOMailBox_TypeDef* pf, int ct)
+{
+	CAN_TypeDef* pcan = hostcan[n].Instance;
+	volatile uint32_t* prfr = (fifo == CAN_RX_FIFO0) ? &pcan->RF0R : &pcan->RF1R;
+	struct HOSTCANFIFO q;
+	int i;
+
+	/* FIFO locked mode: the first three are kept, later ones lost */
+	q.n = (ct > HOSTCANFIFOSZ) ? HOSTCANFIFOSZ : ct;
+	q.fovr = (ct > HOSTCANFIFOSZ) ? CAN_RF0R_FOVR0 : 0;
+	for (i = 0; i < q.n; i++) q.f[i] = pf[i];
+	i = hostcan_drain(n, fifo, &q);
+
+	/* Empty FIFO: the IRQ (e.g. shared with TX) must leave it alone */
+	if (ct == 0)
+	{
+		*prfr = 0;
+		fifoirq(n, fifo);
+		if (*prfr != 0) return -1;
+	}
+	return i;
+}
+/* *************************************************************************
+ * HAL stand-ins
+ * *************************************************************************/
+static int canidx(CAN_HandleTypeDef *phcan)
+{
+	return (int)(phcan - &hostcan[0]);
+}
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *phcan, uint32_t TxMailboxes)
+{
+	/* ABRQ0 bit 7, ABRQ1 bit 15, ABRQ2 bit 23: TxMailboxes 1, 2, 4 */
+	if ((TxMailboxes & CAN_TX_MAILBOX0) != 0) phcan->Instance->TSR |= CAN_TSR_ABRQ0;
+	if ((TxMailboxes & CAN_TX_MAILBOX1) != 0) phcan->Instance->TSR |= CAN_TSR_ABRQ1;
+	if ((TxMailboxes & CAN_TX_MAILBOX2) != 0) phcan->Instance->TSR |= CAN_TSR_ABRQ2;
+	hostabortreq[canidx(phcan)] += 1;
+	return HAL_OK;
+}
+/* Same register writes as the HAL (single CAN: banks in the module's own registers) */
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *phcan, CAN_FilterTypeDef *pf)
+{
+	CAN_TypeDef* pcan = phcan->Instance;
+	uint32_t bit = (uint32_t)1 << (pf->FilterBank & 0x1F);
+
+	if ((phcan->State != HAL_CAN_STATE_READY) && (phcan->State != HAL_CAN_STATE_LISTENING))
+	{
+		phcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+		return HAL_ERROR;
+	}
+	pcan->FMR |= CAN_FMR_FINIT;
+	pcan->FA1R &= ~bit;
+	if (pf->FilterScale == CAN_FILTERSCALE_16BIT)
+	{
+		pcan->FS1R &= ~bit;
+		pcan->sFilterRegister[pf->FilterBank].FR1 = ((pf->FilterMaskIdLow  & 0xFFFF) << 16) | (pf->FilterIdLow  & 0xFFFF);
+		pcan->sFilterRegister[pf->FilterBank].FR2 = ((pf->FilterMaskIdHigh & 0xFFFF) << 16) | (pf->FilterIdHigh & 0xFFFF);
+	}
+	if (pf->FilterScale == CAN_FILTERSCALE_32BIT)
+	{
+		pcan->FS1R |= bit;
+		pcan->sFilterRegister[pf->FilterBank].FR1 = ((pf->FilterIdHigh     & 0xFFFF) << 16) | (pf->FilterIdLow     & 0xFFFF);
+		pcan->sFilterRegister[pf->FilterBank].FR2 = ((pf->FilterMaskIdHigh & 0xFFFF) << 16) | (pf->FilterMaskIdLow & 0xFFFF);
+	}
+	if (pf->FilterMode == CAN_FILTERMODE_IDMASK)
+		pcan->FM1R &= ~bit;
+	else
+		pcan->FM1R |= bit;
+	if (pf->FilterFIFOAssignment == CAN_FILTER_FIFO0)
+		pcan->FFA1R &= ~bit;
+	else
+		pcan->FFA1R |= bit;
+	if (pf->FilterActivation == CAN_FILTER_ENABLE)
+		pcan->FA1R |= bit;
+	pcan->FMR &= ~CAN_FMR_FINIT;
+	return HAL_OK;
+}
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+	return HOSTPCLK1;
+}
+void DTW_counter_init(void)
+{
+}
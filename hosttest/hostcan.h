@@ -0,0 +1,79 @@
+/******************************************************************************
+* File Name          : hostcan.h
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host tests: bxCAN register blocks & HAL CAN stand-ins
+*******************************************************************************/
+/*
+Each CAN "module" is a CAN_TypeDef in plain memory, padded to 1024 bytes in an array
+aligned to 8192, so 'CANINSTIDX' (register base address bits 12:10) gives each one
+its own control block slot, as CAN1/CAN2 do on the target.
+
+RX FIFO: plain memory can't see the RFOM write as it happens, so 'hostcan_rx' runs
+the FIFO IRQ and looks afterwards.  The drain's store of RFOM alone leaves FMP
+reading 0, so the drain takes one frame and returns; the RFxR then reads back as
+exactly RFOM = released, and the next frame is shown and the IRQ called again, as
+the level triggered FMP interrupt would.  FOVR stays set until the drain writes
+FOVR alone.  A drain that never releases spins in its loop (the tests run under
+alarm()).
+*/
+
+#ifndef __HOSTCAN
+#define __HOSTCAN
+
+#include "hostshim.h"
+#include "stm32f1xx_hal.h"
+
+#define HOSTCANNUM 3
+
+/* 500K: PCLK1 36 MHz, BRP+1 = 4, 1 + TS1+1 (14) + TS2+1 (3) = 18 tq per bit */
+#define HOSTCANBTR500K ((3 << 0) | (13 << 16) | (2 << 20))
+#define HOSTCANBTR1M   ((1 << 0) | (13 << 16) | (2 << 20)) // BRP+1 = 2
+#define HOSTPCLK1      36000000
+
+struct HOSTCANREGS
+{
+	CAN_TypeDef r;
+	uint8_t pad[1024 - sizeof(CAN_TypeDef)];
+};
+
+extern struct HOSTCANREGS hostcanregs[HOSTCANNUM];
+extern CAN_HandleTypeDef  hostcan[HOSTCANNUM];
+extern uint32_t hostabortreq[HOSTCANNUM]; // Count: HAL_CAN_AbortTxRequest calls
+
+#define HOSTCANFIFOSZ 3 // bxCAN RX FIFO depth
+
+/* RX FIFO contents not yet released by the driver */
+struct HOSTCANFIFO
+{
+	CAN_FIFOMailBox_TypeDef f[HOSTCANFIFOSZ]; // [0] = output mailbox (oldest)
+	int      n;    // Number of frames held
+	uint32_t fovr; // CAN_RF0R_FOVR0 = overrun, until the drain clears it
+};
+
+/******************************************************************************/
+CAN_HandleTypeDef* hostcan_reset(int n, uint32_t btr);
+/* @brief	: Zero registers of CAN module 'n', set BTR; handle points to them
+ * @param	: n = 0 - (HOSTCANNUM-1)
+ * @param	: btr = bit timing register
+ * @return	: HAL handle
+*******************************************************************************/
+int hostcan_rx(int n, int fifo, const CAN_FIFOMailBox_TypeDef* pf, int ct);
+/* @brief	: Frames arrive at a RX FIFO while its IRQ is held off, then the IRQ runs
+ * @param	: n = CAN module
+ * @param	: fifo = CAN_RX_FIFO0 or CAN_RX_FIFO1
+ * @param	: pf = frames (RIR, RDTR, RDLR, RDHR as the bxCAN shows them)
+ * @param	: ct = number of frames; past HOSTCANFIFOSZ are lost and set FOVR
+ * @return	: number of frames released by the driver (RFOM written)
+ *		:  -1 = IRQ returned with the FIFO not empty and not released
+*******************************************************************************/
+int hostcan_drain(int n, int fifo, struct HOSTCANFIFO* pq);
+/* @brief	: Run the RX FIFO IRQ until 'pq' is empty and its overrun flag cleared
+ * @param	: n = CAN module
+ * @param	: fifo = CAN_RX_FIFO0 or CAN_RX_FIFO1
+ * @param	: pq = frames held by the FIFO; released ones are removed
+ * @return	: number of frames released by the driver (RFOM written)
+ *		:  -1 = IRQ returned with the FIFO not empty and not released
+*******************************************************************************/
+
+#endif
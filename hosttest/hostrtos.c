@@ -0,0 +1,181 @@
+/******************************************************************************
+* File Name          : hostrtos.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host tests: FreeRTOS & morse_trap stand-ins, check macros
+*******************************************************************************/
+/*
+Only what the drivers under test call: critical sections (one recursive mutex, so
+the two-thread tests see the same exclusion an ISR would), task notifications
+(recorded per handle), tick count, task create/priority (no-ops), and 'morse_trap'.
+*/
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "hostrtos.h"
+#include "cmsis_os.h"
+#include "morse.h"
+
+int hostcheckct;
+int hostfailct;
+
+jmp_buf hosttrapjmp;
+volatile int hosttraparm;
+volatile int hosttrapcode = -1;
+
+volatile uint32_t hostdtw;
+volatile TickType_t hosttick;
+TaskHandle_t hostcurtask;
+
+#define HOSTTASKNUM 8
+static int hosttasks[HOSTTASKNUM]; // Handles are addresses in here
+static uint32_t notebits[HOSTTASKNUM];
+static uint32_t notect[HOSTTASKNUM];
+
+static pthread_mutex_t critmutex;
+static pthread_once_t critonce = PTHREAD_ONCE_INIT;
+static __thread int critdepth;
+
+/* *************************************************************************
+ * Check counts
+ * *************************************************************************/
+int hostreport(const char* name)
+{
+	printf("%s: %d checks, %d failed\n", name, hostcheckct, hostfailct);
+	return (hostfailct != 0);
+}
+uint64_t hostns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000u) + ts.tv_nsec;
+}
+/* *************************************************************************
+ * Critical sections
+ * *************************************************************************/
+static void critinit(void)
+{
+	pthread_mutexattr_t a;
+	pthread_mutexattr_init(&a);
+	pthread_mutexattr_settype(&a, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&critmutex, &a);
+}
+void hostcrit_enter(void)
+{
+	pthread_once(&critonce, critinit);
+	pthread_mutex_lock(&critmutex);
+	critdepth += 1;
+}
+void hostcrit_exit(void)
+{
+	critdepth -= 1;
+	pthread_mutex_unlock(&critmutex);
+}
+UBaseType_t hostcrit_enter_isr(void)
+{
+	hostcrit_enter();
+	return 0;
+}
+void hostcrit_exit_isr(UBaseType_t x)
+{
+	(void)x;
+	hostcrit_exit();
+}
+int hostcrit_depth(void)
+{
+	return critdepth;
+}
+void hostcrit_reset(void)
+{
+	while (critdepth > 0) hostcrit_exit();
+}
+void hostyield(void)
+{
+}
+void vPortEnterCritical(void) {hostcrit_enter();}
+void vPortExitCritical(void)  {hostcrit_exit();}
+/* *************************************************************************
+ * Tasks & notifications
+ * *************************************************************************/
+TaskHandle_t hosttask(int n)
+{
+	return (TaskHandle_t)&hosttasks[n];
+}
+static int taskidx(TaskHandle_t h)
+{
+	int i;
+	for (i = 0; i < HOSTTASKNUM; i++)
+		if (h == (TaskHandle_t)&hosttasks[i]) return i;
+	fprintf(stderr,"notify: unknown task handle %p\n", (void*)h);
+	abort();
+}
+uint32_t hostnotes(TaskHandle_t h)
+{
+	int i = taskidx(h);
+	uint32_t x;
+	hostcrit_enter();
+	x = notebits[i]; notebits[i] = 0;
+	hostcrit_exit();
+	return x;
+}
+uint32_t hostnotect(TaskHandle_t h)
+{
+	return notect[taskidx(h)];
+}
+BaseType_t xTaskGenericNotify( TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, uint32_t *pulPreviousNotificationValue )
+{
+	int i = taskidx(xTaskToNotify);
+	hostcrit_enter();
+	if (pulPreviousNotificationValue != NULL) *pulPreviousNotificationValue = notebits[i];
+	if (eAction == eSetBits) notebits[i] |= ulValue;
+	else if (eAction != eNoAction) notebits[i] = ulValue;
+	notect[i] += 1;
+	hostcrit_exit();
+	return pdPASS;
+}
+BaseType_t xTaskGenericNotifyFromISR( TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, uint32_t *pulPreviousNotificationValue, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	if (pxHigherPriorityTaskWoken != NULL) *pxHigherPriorityTaskWoken = pdTRUE;
+	return xTaskGenericNotify(xTaskToNotify, ulValue, eAction, pulPreviousNotificationValue);
+}
+BaseType_t xTaskNotifyWait( uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t *pulNotificationValue, TickType_t xTicksToWait )
+{
+	(void)ulBitsToClearOnEntry; (void)ulBitsToClearOnExit; (void)xTicksToWait;
+	if (pulNotificationValue != NULL) *pulNotificationValue = hostnotes(hostcurtask);
+	return pdTRUE;
+}
+TaskHandle_t xTaskGetCurrentTaskHandle( void )
+{
+	return hostcurtask;
+}
+TickType_t xTaskGetTickCount( void )
+{
+	return hosttick;
+}
+TickType_t xTaskGetTickCountFromISR( void )
+{
+	return hosttick;
+}
+osThreadId osThreadCreate (const osThreadDef_t *thread_def, void *argument)
+{
+	(void)thread_def; (void)argument;
+	return hosttask(HOSTTASKNUM - 1);
+}
+void vTaskPrioritySet( TaskHandle_t xTask, UBaseType_t uxNewPriority )
+{
+	(void)xTask; (void)uxNewPriority;
+}
+/* *************************************************************************
+ * Debugging trap
+ * *************************************************************************/
+void morse_trap(uint16_t x)
+{
+	hosttrapcode = x;
+	if (hosttraparm != 0)
+	{
+		hosttraparm = 0;
+		longjmp(hosttrapjmp, 1);
+	}
+	fprintf(stderr,"morse_trap(%u)\n", x);
+	abort();
+}
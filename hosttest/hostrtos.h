@@ -0,0 +1,64 @@
+/******************************************************************************
+* File Name          : hostrtos.h
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host tests: FreeRTOS & morse_trap stand-ins, check macros
+*******************************************************************************/
+
+#ifndef __HOSTRTOS
+#define __HOSTRTOS
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "hostshim.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Check: count and report a failure, keep going */
+extern int hostcheckct;
+extern int hostfailct;
+#define CHECK(x) do{hostcheckct += 1; if (!(x)){hostfailct += 1; \
+	fprintf(stderr,"%s:%d: CHECK failed: %s\n",__FILE__,__LINE__,#x);}}while(0)
+
+/* 'morse_trap' with a trap expected: returns to the setjmp with the trap code */
+extern jmp_buf hosttrapjmp;
+extern volatile int hosttraparm;  // 1 = longjmp on the next trap; 0 = abort()
+extern volatile int hosttrapcode; // Last trap code; -1 = none
+#define HOSTTRAP(stmt) (hosttrapcode = -1, hosttraparm = 1, \
+	((setjmp(hosttrapjmp) == 0) ? ((stmt), hostcrit_reset(), hosttraparm = 0, -1) : \
+	                               (hostcrit_reset(), hosttrapcode)))
+
+/* Seconds before a hung test is killed (SIGALRM) */
+#define HOSTTIMEOUT 60
+
+/* FreeRTOS */
+extern volatile TickType_t hosttick;  // xTaskGetTickCount
+extern TaskHandle_t hostcurtask;      // xTaskGetCurrentTaskHandle
+
+/******************************************************************************/
+int hostreport(const char* name);
+/* @brief	: Print the check counts
+ * @param	: name = test program name
+ * @return	: 0 = all passed; 1 = failures (exit code)
+*******************************************************************************/
+TaskHandle_t hosttask(int n);
+/* @brief	: Handle for a host 'task' (notification target only)
+ * @param	: n = 0 - 7
+*******************************************************************************/
+uint32_t hostnotes(TaskHandle_t h);
+/* @brief	: Notification bits sent to 'h' since the last call (eSetBits), and clear
+*******************************************************************************/
+uint32_t hostnotect(TaskHandle_t h);
+/* @brief	: Running count of notifications sent to 'h'
+*******************************************************************************/
+void hostcrit_reset(void);
+/* @brief	: Release critical section nesting left behind by a trap (longjmp)
+*******************************************************************************/
+int hostcrit_depth(void);
+/* @brief	: Critical section nesting of this thread (0 = not in one)
+*******************************************************************************/
+uint64_t hostns(void);
+/* @brief	: Monotonic nanoseconds (benchmarks)
+*******************************************************************************/
+
+#endif
@@ -0,0 +1,109 @@
+/******************************************************************************
+* File Name          : hostshim.h
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host build of target sources: Cortex-M intrinsics, port, DTW
+*******************************************************************************/
+/*
+Included ahead of the source under test.  The tests #include the .c file itself, so
+its static routines and data can be reached.
+
+The include guards of the Cortex-M only headers (CMSIS instruction and core register
+access, the FreeRTOS ARM_CM3 port, the DTW counter) are claimed here, and host
+versions supplied:
+  - critical sections: one recursive pthread mutex (hostrtos.c)
+  - LDREX/STREX: plain load; the store always succeeds
+  - DTWTIME: 'hostdtw', which the tests (and the bus model) advance
+
+Link with -no-pie.  The drivers pass pointers through uint32_t (LDREX/STREX on the
+free list), which holds for static data and small heap blocks below 4 GB.
+*/
+
+#ifndef __HOSTSHIM
+#define __HOSTSHIM
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ----- CMSIS: core_cmInstr.h, core_cmFunc.h ----- */
+#define __CORE_CMINSTR_H
+#define __CORE_CMFUNC_H
+
+static inline void __NOP(void) {}
+static inline void __DMB(void) {__sync_synchronize();}
+static inline void __DSB(void) {__sync_synchronize();}
+static inline void __ISB(void) {__sync_synchronize();}
+static inline uint32_t __CLZ(uint32_t x) {return (x == 0) ? 32 : (uint32_t)__builtin_clz(x);}
+static inline uint32_t __RBIT(uint32_t x)
+{
+	uint32_t r = 0; int i;
+	for (i = 0; i < 32; i++) {r = (r << 1) | (x & 1); x >>= 1;}
+	return r;
+}
+static inline uint32_t __LDREXW(volatile uint32_t* p) {return *p;}
+static inline uint32_t __STREXW(uint32_t v, volatile uint32_t* p) {*p = v; return 0;}
+static inline void __CLREX(void) {}
+static inline void __enable_irq(void) {}
+static inline void __disable_irq(void) {}
+static inline uint32_t __get_PRIMASK(void) {return 0;}
+static inline void __set_PRIMASK(uint32_t x) {(void)x;}
+static inline uint32_t __get_BASEPRI(void) {return 0;}
+static inline void __set_BASEPRI(uint32_t x) {(void)x;}
+static inline uint32_t __get_IPSR(void) {return 0;}
+
+/* ----- FreeRTOS port: portmacro.h ----- */
+#define PORTMACRO_H
+
+#define portCHAR		char
+#define portFLOAT		float
+#define portDOUBLE		double
+#define portLONG		long
+#define portSHORT		short
+#define portSTACK_TYPE	uint32_t
+#define portBASE_TYPE	long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+#define portMAX_DELAY ( TickType_t ) 0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC 1
+
+#define portSTACK_GROWTH			( -1 )
+#define portTICK_PERIOD_MS			( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT			8
+
+void hostyield(void);
+void hostcrit_enter(void);
+void hostcrit_exit(void);
+UBaseType_t hostcrit_enter_isr(void);
+void hostcrit_exit_isr(UBaseType_t x);
+
+#define portYIELD()                          hostyield()
+#define portEND_SWITCHING_ISR( xSwitchRequired ) if( xSwitchRequired != pdFALSE ) portYIELD()
+#define portYIELD_FROM_ISR( x )              portEND_SWITCHING_ISR( x )
+#define portSET_INTERRUPT_MASK_FROM_ISR()    hostcrit_enter_isr()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x) hostcrit_exit_isr(x)
+#define portDISABLE_INTERRUPTS()
+#define portENABLE_INTERRUPTS()
+#define portENTER_CRITICAL()                 hostcrit_enter()
+#define portEXIT_CRITICAL()                  hostcrit_exit()
+
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
+
+#define portRECORD_READY_PRIORITY( uxPriority, uxReadyPriorities ) ( uxReadyPriorities ) |= ( 1UL << ( uxPriority ) )
+#define portRESET_READY_PRIORITY( uxPriority, uxReadyPriorities ) ( uxReadyPriorities ) &= ~( 1UL << ( uxPriority ) )
+#define portGET_HIGHEST_PRIORITY( uxTopPriority, uxReadyPriorities ) uxTopPriority = ( 31UL - __CLZ( ( uxReadyPriorities ) ) )
+#define portASSERT_IF_INTERRUPT_PRIORITY_INVALID()
+#define portNOP()
+#define portINLINE	__inline
+#define portFORCE_INLINE inline __attribute__(( always_inline))
+
+/* ----- DTW_counter.h ----- */
+#define __DTW_COUNTER
+extern volatile uint32_t hostdtw;
+#define DTWTIME (hostdtw)
+void DTW_counter_init(void);
+
+#endif
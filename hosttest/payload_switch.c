@@ -0,0 +1,127 @@
+/******************************************************************************
+* File Name          : payload_switch.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host tests: 'payload_extract' as it was (paytype switch)
+*******************************************************************************/
+/*
+The paytype switch that the 'paydesc' descriptor table replaced, copied unchanged
+but for the name (and noinline: it was a call from MailboxTask, so the benchmark
+must not fold it into its caller), as the reference for the parity test and the
+benchmark.
+#include after payload_extract.c (gen_db.h codes, MAILBOXCAN).
+*/
+
+/* ************************************************************************* 
+ * static void payload_extract_switch(struct MAILBOXCAN* pmbx);
+ *	@brief	: Lookup CAN ID and load mailbox with extract payload reading(s)
+ * @param	: pmbx  = pointer to mailbox
+ * *************************************************************************/
+static __attribute__((noinline)) void payload_extract_switch(struct MAILBOXCAN* pmbx)
+{
+	switch (pmbx->paytype)
+	{
+	case U8:
+	case U8_VAR:
+		if (pmbx->ncan.can.dlc >= 1)
+		{
+			pmbx->mbx.pre8[0] = pmbx->ncan.can.cd.uc[0];
+		}
+		break;		
+	case FF:
+	case U32:
+	case S32:
+		if (pmbx->ncan.can.dlc >= 4)
+		{ // Place 1st four bytes of payload in union
+			pmbx->mbx.u.i32[0] = pmbx->ncan.can.cd.ui[0];
+			pmbx->ctr +=1 ;
+		}
+		break;	
+	case xFF:
+		if (pmbx->ncan.can.dlc >= 5)
+		{ // Place [1]-[4] of payload in union 
+			pmbx->mbx.u.i8[0] = pmbx->ncan.can.cd.uc[1];
+			pmbx->mbx.u.i8[1] = pmbx->ncan.can.cd.uc[2];
+			pmbx->mbx.u.i8[2] = pmbx->ncan.can.cd.uc[3];
+			pmbx->mbx.u.i8[3] = pmbx->ncan.can.cd.uc[4];
+			pmbx->ctr +=1 ;
+		}
+		break;	
+	case xxFF:
+	case xxU32:
+	case xxS32:
+		if (pmbx->ncan.can.dlc >= 6)
+		{ // Place [2]-[5] of payload in union 
+			pmbx->mbx.u.i8[0] = pmbx->ncan.can.cd.uc[2];
+			pmbx->mbx.u.i8[1] = pmbx->ncan.can.cd.uc[3];
+			pmbx->mbx.u.i8[2] = pmbx->ncan.can.cd.uc[4];
+			pmbx->mbx.u.i8[3] = pmbx->ncan.can.cd.uc[5];
+			pmbx->ctr +=1 ;
+		}
+		break;
+	case U8_FF:
+	case U8_U32:
+	case U8_S32:
+	case UNIXTIME:
+		if (pmbx->ncan.can.dlc >= 5)
+		{ 
+			pmbx->mbx.pre8[0] = pmbx->ncan.can.cd.uc[0];
+			// Place [2]-[5] of payload in union 
+			pmbx->mbx.u.i8[0] = pmbx->ncan.can.cd.uc[1];
+			pmbx->mbx.u.i8[1] = pmbx->ncan.can.cd.uc[2];
+			pmbx->mbx.u.i8[2] = pmbx->ncan.can.cd.uc[3];
+			pmbx->mbx.u.i8[3] = pmbx->ncan.can.cd.uc[4];
+			pmbx->ctr +=1 ;		
+		}
+		break;	
+	case U8_U8_FF:
+	case U8_U8_U32:
+	case U8_U8_S32:
+		if (pmbx->ncan.can.dlc >= 6)
+		{ 
+			pmbx->mbx.pre8[0] = pmbx->ncan.can.cd.uc[0];
+			pmbx->mbx.pre8[1] = pmbx->ncan.can.cd.uc[1];
+			// Place [2]-[5] of payload in union 
+			pmbx->mbx.u.i8[0] = pmbx->ncan.can.cd.uc[2];
+			pmbx->mbx.u.i8[1] = pmbx->ncan.can.cd.uc[3];
+			pmbx->mbx.u.i8[2] = pmbx->ncan.can.cd.uc[4];
+			pmbx->mbx.u.i8[3] = pmbx->ncan.can.cd.uc[5];
+			pmbx->ctr +=1 ;		
+		}
+		break;
+	case U8_U8_U8_U32:
+		if (pmbx->ncan.can.dlc >= 7)
+		{ 
+			pmbx->mbx.pre8[0] = pmbx->ncan.can.cd.uc[0];
+			pmbx->mbx.pre8[1] = pmbx->ncan.can.cd.uc[1];
+			pmbx->mbx.pre8[2] = pmbx->ncan.can.cd.uc[2];
+			// Place [2]-[5] of payload in union 
+			pmbx->mbx.u.i8[0] = pmbx->ncan.can.cd.uc[3];
+			pmbx->mbx.u.i8[1] = pmbx->ncan.can.cd.uc[4];
+			pmbx->mbx.u.i8[2] = pmbx->ncan.can.cd.uc[5];
+			pmbx->mbx.u.i8[3] = pmbx->ncan.can.cd.uc[6];
+			pmbx->ctr +=1 ;		
+		}
+		break;
+	case FF_FF:		// Two four byte readings
+	case U32_U32:
+	case S32_S32:
+		if (pmbx->ncan.can.dlc >= 8)
+		{ // Place [0]-[7] of payload in union 
+			pmbx->mbx.u.i64 = pmbx->ncan.can.cd.ull;
+			pmbx->ctr +=1 ;
+		}
+		break;	
+
+	// Payload type not implemented
+	case UNDEF:
+	default: 
+		{ // Place [0]-[7] of payload in union 
+			pmbx->mbx.u.i64 = pmbx->ncan.can.cd.ull;
+			pmbx->ctr +=1 ;
+		}
+		break;	
+	}
+
+	return;
+}
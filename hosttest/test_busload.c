@@ -0,0 +1,194 @@
+/******************************************************************************
+* File Name          : test_busload.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host test: CAN bus load frame bits and 100 ms/1 s/10 s windows
+*******************************************************************************/
+/*
+The driver built with CANBUSLOADEXACT (actual stuff bits, CRC computed):
+  - frame bits equal the bxcan_model's stuffed length: known frames (std, ext,
+    RTR, dlc > 8, all zeros) and random ones
+  - on the bus model, the bits each node adds (RX drain, TX complete) are the
+    model's lengths of the frames it received or sent
+  - windows: 'can_iface_busload_tick' ends a slot every CANBUSLOADSLOT ticks;
+    100 ms, 1 s and 10 s loads and the max as slots and seconds roll over and
+    old traffic leaves each window; TX errors per second
+(test_can_bus covers the worst case estimate, the default.)
+*/
+#include <string.h>
+#include <unistd.h>
+#include "hostrtos.h"
+#include "bxcan_model.h"
+#ifndef CANBUSLOAD
+  #define CANBUSLOAD
+#endif
+#define CANBUSLOADEXACT
+#include "can_iface.c"
+
+#define STD(id)  ((uint32_t)(id) << 21)
+#define EXT(id)  (((uint32_t)(id) << 3) | CAN_ID_EXT)
+#define RTR      CAN_RTR_REMOTE
+
+static struct CAN_CTLBLOCK* pctl[2];
+
+static uint32_t lcg = 3;
+static uint32_t rnd(void)
+{
+	lcg = (lcg * 1664525u) + 1013904223u;
+	return lcg;
+}
+static void rndcan(struct CANRCVBUF* pcan)
+{
+	pcan->id = rnd() & ~0x1;
+	if ((pcan->id & CAN_ID_EXT) == 0) pcan->id &= 0xffe00002;
+	pcan->dlc = rnd() >> 28;
+	pcan->cd.ui[0] = rnd();
+	pcan->cd.ui[1] = (rnd() & 0x100) ? 0 : rnd(); // Some with long runs of zeros
+}
+static uint32_t modelbits(struct CANRCVBUF* pcan)
+{
+	return bxcan_model_framebits(pcan->id, pcan->dlc, pcan->cd.ui[0], pcan->cd.ui[1]);
+}
+static void bus(int nodect)
+{
+	int n;
+	bxcan_model_init(nodect, HOSTCANBTR500K, CAN_MCR_NART);
+	for (n = 0; n < nodect; n++)
+	{
+		pctlinst[CANINSTIDX(&hostcan[n])] = NULL;
+		pctl[n] = can_iface_init(&hostcan[n], n, 16, 16);
+		can_iface_mbx_init(pctl[n], hosttask(n), 0x1);
+		bxcan_model_acceptall(n, CAN_FILTER_FIFO0);
+	}
+}
+/* *************************************************************************
+ * Frame bits
+ * *************************************************************************/
+static void test_framebits(void)
+{
+	struct CANRCVBUF can;
+	int i, bad = 0;
+
+	memset(&can, 0, sizeof(can));
+	CHECK(framebits(&can) == 53); // Std id 0, no data: 6 stuff bits
+	CHECK(framebits(&can) == modelbits(&can));
+	can.id = EXT(0x15555555); can.dlc = 8; can.cd.ull = 0xAAAAAAAAAAAAAAAAULL;
+	CHECK(framebits(&can) == modelbits(&can));
+	can.id |= RTR;                // No data field
+	CHECK(framebits(&can) == modelbits(&can));
+	can.id = STD(0x7ff); can.dlc = 15; can.cd.ull = 0; // dlc > 8: eight bytes
+	CHECK(framebits(&can) == modelbits(&can));
+	CHECK(framebits(&can) > (34 + 64 + 13));
+
+	for (i = 0; i < 100000; i++)
+	{
+		rndcan(&can);
+		if (framebits(&can) != modelbits(&can)) bad += 1;
+	}
+	CHECK(bad == 0);
+}
+/* *************************************************************************
+ * Bits counted on the bus model: RX drain and TX complete
+ * *************************************************************************/
+static void test_busbits(void)
+{
+	struct CANRCVBUF can;
+	uint32_t sum = 0;
+	int i, k;
+
+	bus(2);
+	for (k = 0; k < 20; k++)
+	{
+		for (i = 0; i < 10; i++)
+		{
+			rndcan(&can);
+			CHECK(can_driver_put(pctl[0], &can, 0, 0) == CANPUT_OK);
+			sum += modelbits(&can);
+		}
+		bxcan_model_run(100);
+	}
+	CHECK(bxnode[1].rxct[0] == 200);
+	CHECK(pctl[0]->busload.bits == sum); // Sent
+	CHECK(pctl[1]->busload.bits == sum); // Received
+}
+/* *************************************************************************
+ * Windows
+ * *************************************************************************/
+/* End the slot with 'bits' in it: ticks until the roll; returns ticks taken */
+static int slot(uint32_t bits)
+{
+	uint8_t i1 = pctl[0]->busload.i1;
+	int ct = 0;
+
+	pctl[0]->busload.bits = bits;
+	while ((pctl[0]->busload.i1 == i1) && (ct < 1000))
+	{
+		can_iface_busload_tick();
+		ct += 1;
+	}
+	return ct;
+}
+static void test_windows(void)
+{
+	struct CANBUSLOADW* pb;
+	int i, bad = 0;
+
+	bus(1);
+	pb = &pctl[0]->busload;
+	CHECK(pb->bitrate == 500000);
+	slot(0); // In step with the tick hook's slot count
+	memset(pb, 0, sizeof(*pb));
+	pb->bitrate = 500000;
+
+	/* 5000 bits a slot: 10% of 100 ms.  The 1 s window fills a tenth a slot. */
+	for (i = 1; i <= 10; i++)
+	{
+		if (slot(5000) != pdMS_TO_TICKS(CANBUSLOADSLOT)) bad += 1;
+		if ((pb->load[0] != 100) || (pb->load[1] != (10 * i)) || (pb->bits != 0)) bad += 1;
+		if (pb->load[2] != ((i < 10) ? 0 : 10)) bad += 1; // 10 s: at each 1 s
+	}
+	CHECK(bad == 0);
+	CHECK((pb->i1 == 0) && (pb->i10 == 1) && (pb->sum1 == 50000) && (pb->sum10 == 50000));
+	for (i = 0; i < 90; i++)
+		slot(5000);
+	CHECK((pb->load[1] == 100) && (pb->load[2] == 100) && (pb->i10 == 0));
+	CHECK(pb->loadmax == 100);
+
+	/* A 50% slot: then nine quiet slots still in the 1 s window, the tenth not */
+	pctl[0]->can_errors.can_txerr += 3;
+	slot(25000);
+	CHECK((pb->load[0] == 500) && (pb->loadmax == 500));
+	CHECK(pb->load[1] == (((45000 + 25000) * 1000) / 500000));
+	for (i = 0; i < 9; i++)
+		slot(0);
+	CHECK((pb->load[0] == 0) && (pb->load[1] == 50));
+	CHECK(pb->load[2] == (((9 * 50000 + 25000) * 100) / 500000));
+	CHECK(pb->err1 == 3);
+	slot(0);
+	CHECK(pb->load[1] == 0);
+
+	/* Ten quiet seconds empty the 10 s window; the max stays */
+	for (i = 0; i < 99; i++)
+		slot(0);
+	CHECK((pb->load[2] == 0) && (pb->sum10 == 0) && (pb->err1 == 0));
+	CHECK(pb->loadmax == 500);
+
+	/* Full bus at 1M: the largest sums (x1000) still fit */
+	bus(1);
+	pb = &pctl[0]->busload;
+	slot(0);
+	memset(pb, 0, sizeof(*pb));
+	pb->bitrate = 1000000;
+	for (i = 0; i < 100; i++)
+		slot(100000);
+	CHECK((pb->load[0] == 1000) && (pb->load[1] == 1000) && (pb->load[2] == 1000));
+}
+
+int main(void)
+{
+	alarm(HOSTTIMEOUT);
+	test_framebits();
+	test_busbits();
+	test_windows();
+	return hostreport("test_busload");
+}
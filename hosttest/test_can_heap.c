@@ -0,0 +1,233 @@
+/******************************************************************************
+* File Name          : test_can_heap.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host test: can_iface TX heap order, full pool, init failures
+*******************************************************************************/
+/*
+  - heap_push/heap_pop give (CAN id, seq) order: lowest id first, same id in the
+    order queued, including across the 'seq' wrap.  Random push/pop mix checked
+    against a sorted reference.
+  - can_driver_put with the pool used up: CANPUT_OVERRUN, counted, heap no deeper
+    than 'heapsz'; a TX complete frees a block and the next put goes in.
+  - can_iface_init with each calloc failing: NULL, 'ret' set (-2, -5, -4), the
+    control block index slot released, and a retry succeeds.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <malloc.h>
+#include "hostrtos.h"
+#include "hostcan.h"
+
+/* calloc failure injection for can_iface_init */
+static int callocnum;        // calloc calls so far
+static int callocfail;       // Fail this call number (1 = first); 0 = none
+static void* pcalloc1;       // First calloc (control block) of the last init
+static void* test_calloc(size_t n, size_t sz)
+{
+	void* p;
+	callocnum += 1;
+	if (callocnum == callocfail) return NULL;
+	p = calloc(n, sz);
+	if (callocnum == 1) pcalloc1 = p;
+	return p;
+}
+#define calloc test_calloc
+#include "can_iface.c"
+#undef calloc
+
+/* Sorted reference of what is in the heap */
+#define REFSZ 256
+static struct CAN_POOLBLOCK* ref[REFSZ];
+static int refct;
+
+static void refadd(struct CAN_POOLBLOCK* p)
+{
+	int i = refct++;
+	while ((i > 0) && (heap_before(p, ref[i-1]) != 0))
+	{
+		ref[i] = ref[i-1];
+		i -= 1;
+	}
+	ref[i] = p;
+}
+static struct CAN_POOLBLOCK* refpop(void)
+{
+	struct CAN_POOLBLOCK* p = ref[0];
+	refct -= 1;
+	memmove(&ref[0], &ref[1], refct * sizeof(ref[0]));
+	return p;
+}
+static struct CAN_CTLBLOCK* newpctl(int n, uint16_t numtx)
+{
+	pctlinst[CANINSTIDX(hostcan_reset(n, HOSTCANBTR500K))] = NULL;
+	callocnum = 0; callocfail = 0;
+	return can_iface_init(&hostcan[n], n, numtx, 16);
+}
+/* *************************************************************************
+ * (id, seq) order
+ * *************************************************************************/
+static void test_order(uint32_t seq0)
+{
+	static struct CAN_POOLBLOCK blk[REFSZ];
+	struct CAN_POOLBLOCK* pfree[REFSZ]; // Blocks not in the heap
+	struct CAN_CTLBLOCK* pctl = newpctl(0, REFSZ);
+	struct CAN_POOLBLOCK* p;
+	struct CAN_POOLBLOCK* q;
+	int i, nfree;
+	int err = 0;
+
+	for (nfree = 0; nfree < REFSZ; nfree++) pfree[nfree] = &blk[nfree];
+	pctl->seq = seq0;
+	refct = 0;
+	srand(seq0);
+	for (i = 0; i < 20000; i++)
+	{
+		if ((nfree > 0) && ((refct == 0) || ((rand() % 3) != 0)))
+		{ // Push: few ids, so lots of equal ids with different seq
+			p = pfree[--nfree];
+			p->can.id = ((rand() % 6) << 21);
+			p->seq = pctl->seq++;
+			heap_push(pctl, p);
+			refadd(p);
+		}
+		else
+		{ // Pop: must be the lowest (id, seq)
+			q = heap_pop(pctl);
+			p = refpop();
+			if (q != p) err += 1;
+			pfree[nfree++] = p;
+		}
+		if (pctl->heapct != refct) err += 1;
+	}
+	while (refct > 0)
+	{
+		q = heap_pop(pctl);
+		p = refpop();
+		if (q != p) err += 1;
+	}
+	CHECK(err == 0);
+	CHECK(heap_pop(pctl) == NULL);
+	CHECK(pctl->heapctmax <= pctl->heapsz);
+}
+/* Same id: FIFO across the 'seq' wrap, whatever order they were pushed in */
+static void test_samewrap(void)
+{
+	static const uint8_t pushorder[6] = {3, 0, 5, 1, 4, 2};
+	static struct CAN_POOLBLOCK blk[7];
+	struct CAN_CTLBLOCK* pctl = newpctl(0, 8);
+	int i;
+
+	for (i = 0; i < 6; i++)
+	{
+		blk[i].can.id = (0x123 << 21);
+		blk[i].seq = 0xfffffffd + i; // fffffffd, fe, ff, 0, 1, 2
+	}
+	blk[6].can.id = (0x122 << 21); blk[6].seq = 3;
+	for (i = 0; i < 6; i++)
+		heap_push(pctl, &blk[pushorder[i]]);
+	heap_push(pctl, &blk[6]);
+
+	CHECK(heap_pop(pctl) == &blk[6]);
+	for (i = 0; i < 6; i++)
+		CHECK(heap_pop(pctl) == &blk[i]);
+	CHECK(pctl->heapct == 0);
+}
+/* *************************************************************************
+ * Pool used up
+ * *************************************************************************/
+static void test_full(void)
+{
+	struct CAN_CTLBLOCK* pctl = newpctl(0, 8);
+	CAN_TypeDef* pcan = hostcan[0].Instance;
+	struct CANRCVBUF can;
+	int i;
+
+	memset(&can, 0, sizeof(can));
+	can.dlc = 8;
+	for (i = 0; i < 8; i++)
+	{
+		can.id = ((0x200 - i) << 21); // Each higher priority than the last
+		can.cd.ui[0] = i;
+		CHECK(can_driver_put(pctl, &can, 0, 0) == CANPUT_OK);
+	}
+	/* First three went to mailboxes; the rest wait in the heap */
+	CHECK(pctl->txbusy == CANTXMBXNUM);
+	CHECK(pctl->heapct == (8 - CANTXMBXNUM));
+	/* All mailboxes busy & a higher priority msg: abort the lowest priority mailbox */
+	CHECK(pctl->abortct == 1);
+	CHECK(hostabortreq[0] == 1);
+	CHECK((pcan->TSR & CAN_TSR_ABRQ0) != 0);
+
+	can.id = (0x100 << 21);
+	CHECK(can_driver_put(pctl, &can, 0, 0) == CANPUT_OVERRUN);
+	CHECK(pctl->can_errors.can_msgovrflow == 1);
+	CHECK(pctl->heapct <= pctl->heapsz);
+	CHECK(pctl->heapctmax <= pctl->heapsz);
+
+	/* Mailbox 1 sent: its block is free again and the heap top goes in */
+	pcan->TSR |= CAN_TSR_RQCP1 | CAN_TSR_TXOK1;
+	HAL_CAN_TxMailbox1CompleteCallback(&hostcan[0]);
+	CHECK(pctl->txbusy == CANTXMBXNUM);
+	CHECK(pctl->heapct == (8 - CANTXMBXNUM - 1));
+	CHECK(pcan->sTxMailBox[1].TIR == (((0x200 - 7) << 21) | 0x1));
+	CHECK(pcan->sTxMailBox[1].TDLR == 7);
+	CHECK(can_driver_put(pctl, &can, 0, 0) == CANPUT_OK);
+	CHECK(can_driver_put(pctl, &can, 0, 0) == CANPUT_OVERRUN);
+	CHECK(pctl->can_errors.can_msgovrflow == 2);
+}
+/* *************************************************************************
+ * can_iface_init calloc failures
+ * *************************************************************************/
+static void test_initfail(void)
+{
+	/* calloc order: control block, pool, heap, RX ring, FIFO 1 ring */
+	static const int8_t retexp[] = {0, 0, -2, -5, -4, -4};
+	struct CAN_CTLBLOCK* pctl;
+	CAN_HandleTypeDef* phcan;
+	int n;
+
+	for (n = 1; n <= 5; n++)
+	{
+		phcan = hostcan_reset(1, HOSTCANBTR500K);
+		pctlinst[CANINSTIDX(phcan)] = NULL;
+		callocnum = 0; callocfail = n; pcalloc1 = NULL;
+		CHECK(can_iface_init(phcan, 1, 8, 16) == NULL);
+		if (n > 1)
+		{
+			CHECK(pcalloc1 != NULL);
+			if (pcalloc1 != NULL) CHECK(((struct CAN_CTLBLOCK*)pcalloc1)->ret == retexp[n]);
+		}
+		CHECK(getpctl(phcan) == NULL);
+		CHECK(hostcrit_depth() == 0);
+
+		/* Retry goes through */
+		callocnum = 0; callocfail = 0;
+		pctl = can_iface_init(phcan, 1, 8, 16);
+		CHECK(pctl != NULL);
+		CHECK(getpctl(phcan) == pctl);
+		if (pctl != NULL) CHECK(pctl->ret == 0);
+	}
+	/* Bad counts: control block returned with 'ret' set */
+	phcan = hostcan_reset(1, HOSTCANBTR500K);
+	pctlinst[CANINSTIDX(phcan)] = NULL;
+	pctl = can_iface_init(phcan, 1, 0, 16);
+	CHECK((pctl != NULL) && (pctl->ret == -1));
+	CHECK(hostcrit_depth() == 0);
+	pctlinst[CANINSTIDX(phcan)] = NULL;
+	pctl = can_iface_init(phcan, 1, 8, 0);
+	CHECK((pctl != NULL) && (pctl->ret == -3));
+	CHECK(hostcrit_depth() == 0);
+}
+
+int main(void)
+{
+	alarm(HOSTTIMEOUT);
+	test_order(0);
+	test_order(0xffffff00); // 'seq' wraps part way through
+	test_samewrap();
+	test_full();
+	test_initfail();
+	return hostreport("test_can_heap");
+}
@@ -0,0 +1,220 @@
+/******************************************************************************
+* File Name          : test_can_regs.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host test: can_iface CHEATINGONHAL register packing
+*******************************************************************************/
+/*
+The CHEATINGONHAL path copies 'struct CANRCVBUF' straight to and from the bxCAN
+mailbox registers.  Checked here against the register field definitions in
+stm32f103xb.h (not against the driver's own shifts):
+  - TX: TIxR STID/EXID/IDE/RTR/TXRQ, TDTxR DLC only, TDLxR/TDHxR byte order,
+    mailbox selection (free in the driver and TMEk set), bogus std id rejected
+  - RX: RIxR to 'id' (reserved bit 0 dropped), RDTxR to 'dlc' (FMI & TIME dropped),
+    RDLxR/RDHxR, RFOM release after each frame, FOVR counted and cleared,
+    FIFO 1 only from its own IRQ (CANRXFIFO1HIPRI)
+*/
+#include <string.h>
+#include <unistd.h>
+#include "hostrtos.h"
+#include "hostcan.h"
+#include "can_iface.c"
+
+#ifndef CHEATINGONHAL
+  #error test_can_regs: CHEATINGONHAL not defined in can_iface.h
+#endif
+
+#define STDID 0x5A3     // 11 bits
+#define EXTID 0x1ABCDEF5 // 29 bits
+
+static struct CAN_CTLBLOCK* newpctl(void)
+{
+	CAN_HandleTypeDef* phcan = hostcan_reset(0, HOSTCANBTR500K);
+	pctlinst[CANINSTIDX(phcan)] = NULL;
+	return can_iface_init(phcan, 0, 8, 16);
+}
+/* CANRCVBUF id from the fields */
+static uint32_t stdid(uint32_t id, int rtr)
+{
+	return (id << 21) | (rtr ? CAN_RTR_REMOTE : 0);
+}
+static uint32_t extid(uint32_t id, int rtr)
+{
+	return (id << 3) | CAN_ID_EXT | (rtr ? CAN_RTR_REMOTE : 0);
+}
+/* *************************************************************************
+ * TX: mailbox registers
+ * *************************************************************************/
+static void txcase(uint32_t id, int ext, int rtr, uint32_t dlc)
+{
+	struct CAN_CTLBLOCK* pctl = newpctl();
+	CAN_TxMailBox_TypeDef* pm = &hostcan[0].Instance->sTxMailBox[0];
+	struct CANRCVBUF can;
+	uint32_t tir;
+	int i;
+
+	can.id  = ext ? extid(id, rtr) : stdid(id, rtr);
+	can.dlc = dlc;
+	for (i = 0; i < 8; i++) can.cd.uc[i] = 0x11 * (i + 1);
+	CHECK(can_driver_put(pctl, &can, 0, 0) == CANPUT_OK);
+
+	tir = pm->TIR;
+	CHECK((tir & CAN_TI0R_TXRQ) != 0);
+	CHECK(((tir & CAN_TI0R_IDE) != 0) == (ext != 0));
+	CHECK(((tir & CAN_TI0R_RTR) != 0) == (rtr != 0));
+	if (ext)
+	{ // 29 bit id: STID holds EXID[28:18], EXID holds EXID[17:0]
+		CHECK((((tir & CAN_TI0R_STID) >> CAN_TI0R_STID_Pos) << 18 |
+		        ((tir & CAN_TI0R_EXID) >> CAN_TI0R_EXID_Pos)) == id);
+	}
+	else
+	{
+		CHECK(((tir & CAN_TI0R_STID) >> CAN_TI0R_STID_Pos) == id);
+		CHECK((tir & CAN_TI0R_EXID) == 0);
+	}
+	/* DLC only: no TGT, no stray bits from an oversize 'dlc' */
+	CHECK(pm->TDTR == (dlc & CAN_TDT0R_DLC));
+	CHECK(((pm->TDLR & CAN_TDL0R_DATA0) >> CAN_TDL0R_DATA0_Pos) == 0x11);
+	CHECK(((pm->TDLR & CAN_TDL0R_DATA1) >> CAN_TDL0R_DATA1_Pos) == 0x22);
+	CHECK(((pm->TDLR & CAN_TDL0R_DATA3) >> CAN_TDL0R_DATA3_Pos) == 0x44);
+	CHECK(((pm->TDHR & CAN_TDH0R_DATA4) >> CAN_TDH0R_DATA4_Pos) == 0x55);
+	CHECK(((pm->TDHR & CAN_TDH0R_DATA7) >> CAN_TDH0R_DATA7_Pos) == 0x88);
+	CHECK(pctl->mbx[0] == can.id);
+	CHECK(pctl->txbusy == 1);
+}
+static void test_tx(void)
+{
+	struct CAN_CTLBLOCK* pctl;
+	CAN_TypeDef* pcan;
+	struct CANRCVBUF can;
+	int i;
+
+	txcase(STDID, 0, 0, 8);
+	txcase(STDID, 0, 1, 0);
+	txcase(EXTID, 1, 0, 3);
+	txcase(EXTID, 1, 1, 8);
+	txcase(0x7FF, 0, 0, 0x18); // 'dlc' upper bits not passed on
+	txcase(0,     1, 0, 1);
+
+	/* Free mailboxes are taken 0, 1, 2 */
+	pctl = newpctl();
+	pcan = hostcan[0].Instance;
+	memset(&can, 0, sizeof(can));
+	for (i = 0; i < 3; i++)
+	{
+		can.id = stdid(0x100 + i, 0);
+		CHECK(can_driver_put(pctl, &can, 0, 0) == CANPUT_OK);
+		CHECK(pcan->sTxMailBox[i].TIR == (can.id | CAN_TI0R_TXRQ));
+	}
+	/* Mailbox 1 done: the next msg goes to mailbox 1 */
+	HAL_CAN_TxMailbox1CompleteCallback(&hostcan[0]);
+	can.id = stdid(0x200, 0);
+	CHECK(can_driver_put(pctl, &can, 0, 0) == CANPUT_OK);
+	CHECK(pcan->sTxMailBox[1].TIR == (can.id | CAN_TI0R_TXRQ));
+
+	/* Free in the driver, but not empty in hardware (TME0 clear): not written */
+	pctl = newpctl();
+	pcan = hostcan[0].Instance;
+	pcan->TSR &= ~(CAN_TSR_TME0 | CAN_TSR_TME2);
+	can.id = stdid(0x300, 0);
+	CHECK(can_driver_put(pctl, &can, 0, 0) == CANPUT_OK);
+	CHECK((pcan->sTxMailBox[0].TIR == 0) && (pcan->sTxMailBox[1].TIR == (can.id | CAN_TI0R_TXRQ)));
+	CHECK((pctl->ptx[0] == NULL) && (pctl->mbx[1] == can.id));
+	/* None empty in hardware: the msg waits in the heap */
+	can.id = stdid(0x301, 0);
+	CHECK(can_driver_put(pctl, &can, 0, 0) == CANPUT_OK);
+	CHECK((pcan->sTxMailBox[0].TIR == 0) && (pcan->sTxMailBox[2].TIR == 0));
+	CHECK((pctl->txbusy == 1) && (pctl->heapct == 1));
+	/* Mailbox 0 empties; the next TX complete loads it */
+	pcan->TSR |= CAN_TSR_TME0;
+	HAL_CAN_TxMailbox1CompleteCallback(&hostcan[0]);
+	CHECK(pcan->sTxMailBox[0].TIR == (can.id | CAN_TI0R_TXRQ));
+	CHECK((pctl->txbusy == 1) && (pctl->heapct == 0) && (pctl->mbx[0] == can.id));
+
+	/* Std id with bits in the extended part: rejected, nothing loaded */
+	pctl = newpctl();
+	pcan = hostcan[0].Instance;
+	can.id = stdid(STDID, 0) | (1 << 3);
+	CHECK(can_driver_put(pctl, &can, 0, 0) == CANPUT_BOGUSID);
+	CHECK(pctl->bogusct == 1);
+	CHECK(pcan->sTxMailBox[0].TIR == 0);
+	CHECK(pctl->txbusy == 0);
+}
+/* *************************************************************************
+ * RX: FIFO mailbox registers
+ * *************************************************************************/
+static CAN_FIFOMailBox_TypeDef rxframe(uint32_t rir, uint32_t dlc, uint32_t fmi, uint32_t t16, uint32_t seed)
+{
+	CAN_FIFOMailBox_TypeDef f;
+	f.RIR  = rir;
+	f.RDTR = (dlc << CAN_RDT0R_DLC_Pos) | (fmi << CAN_RDT0R_FMI_Pos) | (t16 << CAN_RDT0R_TIME_Pos);
+	f.RDLR = seed;
+	f.RDHR = ~seed;
+	return f;
+}
+static void test_rx(void)
+{
+	struct CAN_CTLBLOCK* pctl = newpctl();
+	CAN_TypeDef* pcan = hostcan[0].Instance;
+	struct CANTAKEPTR* ptake = can_iface_mbx_init(pctl, hosttask(0), 0x1);
+	struct CANTAKEPTR* ptake1 = can_iface_mbx_init_hipri(pctl, hosttask(1), 0x2);
+	struct CANRCVBUFN* pn;
+	CAN_FIFOMailBox_TypeDef f[5];
+	int i;
+
+	/* Std data, std RTR, ext data (ext RTR on FIFO 1 below); reserved RIR bit 0 set on one */
+	f[0] = rxframe((STDID << CAN_RI0R_STID_Pos) | 0x1, 8, 3, 0xABCD, 0x03020100);
+	f[1] = rxframe((STDID << CAN_RI0R_STID_Pos) | CAN_RI0R_RTR, 2, 0, 0, 0);
+	f[2] = rxframe(((uint32_t)EXTID << CAN_RI0R_EXID_Pos) | CAN_RI0R_IDE, 5, 0x7f, 0xffff, 0x12345678);
+	CHECK(hostcan_rx(0, CAN_RX_FIFO0, f, 3) == 3);
+	pn = can_iface_get_CANmsg(ptake);
+	CHECK((pn != NULL) && (pn->can.id == stdid(STDID, 0)) && (pn->can.dlc == 8) &&
+	      (pn->can.cd.ui[0] == 0x03020100) && (pn->can.cd.ui[1] == ~0x03020100u) &&
+	      (pn->can.cd.uc[0] == 0x00) && (pn->can.cd.uc[3] == 0x03));
+	pn = can_iface_get_CANmsg(ptake);
+	CHECK((pn != NULL) && (pn->can.id == stdid(STDID, 1)) && (pn->can.dlc == 2));
+	pn = can_iface_get_CANmsg(ptake);
+	CHECK((pn != NULL) && (pn->can.id == extid(EXTID, 0)) && (pn->can.dlc == 5) &&
+	      (pn->can.cd.ui[0] == 0x12345678));
+	CHECK(can_iface_get_CANmsg(ptake) == NULL);
+	CHECK((hostnotes(hosttask(0)) & 0x1) != 0);
+	CHECK(pctl->can_errors.can_rx0err == 0);
+
+	/* Ext RTR on FIFO 1: its own IRQ, its own ring */
+	f[0] = rxframe(((uint32_t)EXTID << CAN_RI1R_EXID_Pos) | CAN_RI1R_IDE | CAN_RI1R_RTR, 0, 1, 0, 0);
+	CHECK(hostcan_rx(0, CAN_RX_FIFO1, f, 1) == 1);
+	pn = can_iface_get_CANmsg(ptake1);
+	CHECK((pn != NULL) && (pn->can.id == extid(EXTID, 1)) && (pn->can.dlc == 0));
+	CHECK(can_iface_get_CANmsg(ptake) == NULL);
+	CHECK(hostnotes(hosttask(1)) == 0x2);
+
+	/* FIFO 1 pending seen from the shared (HAL) IRQ: left for its own IRQ */
+	pcan->RF1R = 1;
+	HAL_CAN_RxFifo1MsgPendingCallback(&hostcan[0]);
+	CHECK(pcan->RF1R == 1);
+	pcan->RF1R = 0;
+
+	/* Five arrive with the IRQ held off: three kept, overrun counted & cleared */
+	for (i = 0; i < 5; i++) f[i] = rxframe(((0x100 + i) << CAN_RI0R_STID_Pos), 1, 0, 0, i);
+	CHECK(hostcan_rx(0, CAN_RX_FIFO0, f, 5) == 3);
+	CHECK(pctl->can_errors.can_rx0err == 1);
+	CHECK(pcan->RF0R == CAN_RF0R_FOVR0); // Last write: FOVR clear (rc_w1) only
+	for (i = 0; i < 3; i++)
+	{
+		pn = can_iface_get_CANmsg(ptake);
+		CHECK((pn != NULL) && (pn->can.id == stdid(0x100 + i, 0)));
+	}
+	CHECK(can_iface_get_CANmsg(ptake) == NULL);
+
+	/* IRQ with the FIFO empty: no register writes, nothing added */
+	CHECK(hostcan_rx(0, CAN_RX_FIFO0, f, 0) == 0);
+	CHECK(can_iface_get_CANmsg(ptake) == NULL);
+}
+
+int main(void)
+{
+	alarm(HOSTTIMEOUT); // A drain that never releases its FIFO spins forever
+	test_tx();
+	test_rx();
+	return hostreport("test_can_regs");
+}
@@ -0,0 +1,227 @@
+/******************************************************************************
+* File Name          : test_canfilter.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host test: canfilter_setup_compile bank packing
+*******************************************************************************/
+/*
+Id sets compiled into CAN1's 14 banks, then the bank registers checked two ways:
+the words themselves for small cases, and what the bxcan_model filter (bank
+scan of FA1R/FS1R/FM1R/FFA1R, FR1/FR2) passes: every id in the set to its FIFO,
+and nothing else among all 11b data & RTR ids and 29b ids around the set.
+  - 16b list mode: four 11b ids a bank; a partly filled bank repeats an id
+  - mask mode: aligned runs of four or more 11b (16b mask) or 29b (32b mask)
+    ids; an unaligned run goes to the list
+  - banks left: 'first' kept with no ids, counts down to 0, then -3; more than
+    CANFILTERMAXIDS ids is -2
+  - 29b ids mixed with 11b ids, and FIFO 1 (safety critical) ids
+*/
+#include <string.h>
+#include <unistd.h>
+#include "hostrtos.h"
+#include "hostcan.h"
+#include "bxcan_model.h"
+#include "canfilter_setup.c"
+
+#define STD(id)  ((uint32_t)(id) << 21)
+#define EXT(id)  (((uint32_t)(id) << 3) | CAN_ID_EXT)
+#define RTR      CAN_RTR_REMOTE
+
+static CAN_TypeDef* pregs;
+
+/* Fresh CAN1 registers and filter working struct, then compile */
+static int compile(uint32_t* pid, int nid, uint32_t* psafe, int nsafe)
+{
+	hostcan_reset(0, HOSTCANBTR500K);
+	pregs = hostcan[0].Instance;
+	memset(&canfilt1, 0, sizeof(canfilt1));
+	canfilter_setup_first(1, &hostcan[0], 14);
+	return canfilter_setup_compile(1, &hostcan[0], pid, nid, psafe, nsafe);
+}
+static int active(void)
+{
+	return __builtin_popcount(pregs->FA1R & ((1 << CANFILTERNBANKS) - 1));
+}
+/* Bank 'b' active with this mode, scale and FIFO */
+static int bankis(int b, int list, int scale32, int fifo)
+{
+	uint32_t bit = (1 << b);
+	return ((pregs->FA1R & bit) != 0) && (((pregs->FM1R & bit) != 0) == list) &&
+	       (((pregs->FS1R & bit) != 0) == scale32) && (((pregs->FFA1R & bit) != 0) == fifo);
+}
+static int inset(uint32_t id, uint32_t* p, int n)
+{
+	while (n-- > 0) if ((*p++ & ~0x1) == id) return 1;
+	return 0;
+}
+/* Expected FIFO for an id: safe list first; -1 = reject */
+static int want(uint32_t id, uint32_t* pid, int nid, uint32_t* psafe, int nsafe)
+{
+	if (inset(id, psafe, nsafe)) return 1;
+	if (inset(id, pid, nid)) return 0;
+	return -1;
+}
+/* bxcan_model acceptance vs. the set: all 11b ids (data & RTR), and 29b ids at
+   and around each 29b id in the set (data & RTR) plus the 29b ids that share an
+   11b id's top bits.  Returns the number of ids that went wrong. */
+static int sweep(uint32_t* pid, int nid, uint32_t* psafe, int nsafe)
+{
+	uint32_t fmi, id, x;
+	int i, k, bad = 0;
+	uint32_t* pl;
+	int nl;
+
+	for (x = 0; x < 2048; x++)
+	{
+		for (k = 0; k < 2; k++)
+		{
+			id = STD(x) | (k ? RTR : 0);
+			if (bxcan_model_filter(0, id, &fmi) != want(id, pid, nid, psafe, nsafe)) bad += 1;
+		}
+	}
+	for (nl = 0; nl < 2; nl++)
+	{
+		pl = (nl == 0) ? pid : psafe;
+		for (i = 0; i < ((nl == 0) ? nid : nsafe); i++)
+		{
+			for (x = 0; x < 2 * 64; x++)
+			{
+				if ((pl[i] & CAN_ID_EXT) != 0)
+					id = (pl[i] & ~0x7) + (((x >> 1) - 32) << 3); // +/- 32 around it
+				else
+					id = (pl[i] & 0xffe00000) | ((x >> 1) << 3) | CAN_ID_EXT; // Same STID
+				id = (id & ~(uint32_t)RTR) | ((x & 1) ? RTR : 0) | CAN_ID_EXT;
+				if (bxcan_model_filter(0, id, &fmi) != want(id, pid, nid, psafe, nsafe)) bad += 1;
+			}
+		}
+	}
+	return bad;
+}
+/* *************************************************************************
+ * 16b list mode
+ * *************************************************************************/
+static void test_list16(void)
+{
+	uint32_t ids[] = {STD(0x305), STD(0x011), STD(0x7ff), STD(0x200), STD(0x123), STD(0x000)};
+
+	/* Four: one bank, sorted, each 16b word STID:RTR:IDE:EXID[17:15] */
+	CHECK(compile(ids, 4, NULL, 0) == 13);
+	CHECK((active() == 1) && bankis(0, 1, 0, 0));
+	CHECK(pregs->sFilterRegister[0].FR1 == ((0x200u << 5) << 16 | (0x011u << 5)));
+	CHECK(pregs->sFilterRegister[0].FR2 == ((0x7ffu << 5) << 16 | (0x305u << 5)));
+	CHECK(sweep(ids, 4, NULL, 0) == 0);
+
+	/* Six: two banks; the second's unused slots repeat its last id */
+	CHECK(compile(ids, 6, NULL, 0) == 12);
+	CHECK((active() == 2) && bankis(0, 1, 0, 0) && bankis(1, 1, 0, 0));
+	CHECK(pregs->sFilterRegister[1].FR1 == ((0x7ffu << 5) << 16 | (0x305u << 5)));
+	CHECK(pregs->sFilterRegister[1].FR2 == ((0x7ffu << 5) << 16 | (0x7ffu << 5)));
+	CHECK(sweep(ids, 6, NULL, 0) == 0);
+
+	/* RTR and data frames of one id are different entries */
+	uint32_t rtr[] = {STD(0x123) | RTR, STD(0x124)};
+	CHECK(compile(rtr, 2, NULL, 0) == 13);
+	CHECK(sweep(rtr, 2, NULL, 0) == 0);
+}
+/* *************************************************************************
+ * Mask mode ranges
+ * *************************************************************************/
+static void test_mask(void)
+{
+	uint32_t ids[16];
+	int i, n = 0;
+
+	/* 0x100-0x107 and 0x200-0x203: one 16b mask bank, two pairs */
+	for (i = 0; i < 8; i++) ids[n++] = STD(0x100 + i);
+	for (i = 0; i < 4; i++) ids[n++] = STD(0x200 + i);
+	CHECK(compile(ids, n, NULL, 0) == 13);
+	CHECK((active() == 1) && bankis(0, 0, 0, 0));
+	CHECK(pregs->sFilterRegister[0].FR1 == ((0xff1fu << 16) | (0x100u << 5)));
+	CHECK(pregs->sFilterRegister[0].FR2 == ((0xff9fu << 16) | (0x200u << 5)));
+	CHECK(sweep(ids, n, NULL, 0) == 0);
+
+	/* Plus one lone id: it takes the second half of a one-pair mask bank */
+	n = 0;
+	for (i = 0; i < 4; i++) ids[n++] = STD(0x040 + i);
+	ids[n++] = STD(0x555);
+	CHECK(compile(ids, n, NULL, 0) == 13);
+	CHECK((active() == 1) && bankis(0, 0, 0, 0));
+	CHECK(sweep(ids, n, NULL, 0) == 0);
+
+	/* Unaligned run 0x101-0x104: no aligned block of four, so list mode */
+	n = 0;
+	for (i = 0; i < 4; i++) ids[n++] = STD(0x101 + i);
+	CHECK(compile(ids, n, NULL, 0) == 13);
+	CHECK((active() == 1) && bankis(0, 1, 0, 0));
+	CHECK(sweep(ids, n, NULL, 0) == 0);
+
+	/* 29b run of eight: one 32b mask bank (IDE, RTR must match) */
+	n = 0;
+	for (i = 0; i < 8; i++) ids[n++] = EXT(0x1ABCDE0 + i);
+	CHECK(compile(ids, n, NULL, 0) == 13);
+	CHECK((active() == 1) && bankis(0, 0, 1, 0));
+	CHECK(pregs->sFilterRegister[0].FR1 == EXT(0x1ABCDE0));
+	CHECK(pregs->sFilterRegister[0].FR2 == ((~7u << 3) | 0x6));
+	CHECK(sweep(ids, n, NULL, 0) == 0);
+}
+/* *************************************************************************
+ * Banks left
+ * *************************************************************************/
+static void test_banksleft(void)
+{
+	uint32_t ids[CANFILTERMAXIDS + 1];
+	int i;
+
+	CHECK(compile(NULL, 0, NULL, 0) == 13); // 'first' accept-all stays
+	CHECK((active() == 1) && bankis(0, 0, 1, 0) && (pregs->sFilterRegister[0].FR2 == 0));
+
+	/* 29b ids, none adjacent: two a bank */
+	for (i = 0; i < CANFILTERMAXIDS + 1; i++)
+		ids[i] = EXT(0x100000 + (i * 16));
+	for (i = 1; i <= 28; i++)
+	{
+		CHECK(compile(ids, i, NULL, 0) == (14 - ((i + 1) / 2)));
+		CHECK(canfilter_setup_banksleft(1) == (14 - ((i + 1) / 2)));
+		CHECK(active() == ((i + 1) / 2));
+	}
+	CHECK(sweep(ids, 28, NULL, 0) == 0);
+	CHECK(compile(ids, 29, NULL, 0) == -3);
+	CHECK(compile(ids, CANFILTERMAXIDS + 1, NULL, 0) == -2);
+
+	/* Duplicates (and the TXRQ bit) don't take a slot */
+	ids[1] = ids[0] | 0x1;
+	ids[2] = ids[0];
+	CHECK(compile(ids, 3, NULL, 0) == 13);
+	CHECK(canfilter_setup_banksleft(4) == -1);
+}
+/* *************************************************************************
+ * 29b mixed with 11b; FIFO 1
+ * *************************************************************************/
+static void test_mixed(void)
+{
+	uint32_t ids[] = {STD(0x400), EXT(0x10000000), STD(0x401), EXT(0x1FFFFFFF), STD(0x0F0) | RTR,
+	                  STD(0x100), STD(0x101), STD(0x102), STD(0x103), EXT(0x12345), STD(0x050)};
+	uint32_t safe[] = {STD(0x050), EXT(0x12345), STD(0x020)};
+	int nid = sizeof(ids) / sizeof(ids[0]);
+	int nsafe = sizeof(safe) / sizeof(safe[0]);
+	int left;
+
+	/* EXT(0x10000000) has the STID bits of STD(0x400): neither passes as the other */
+	left = compile(ids, nid, safe, nsafe);
+	CHECK((left >= 0) && (left == (14 - active())));
+	CHECK(sweep(ids, nid, safe, nsafe) == 0);
+
+	/* FIFO 1 banks come first; the 29b safe id is a 32b list bank */
+	CHECK(bankis(0, 1, 0, 1) && bankis(1, 1, 1, 1));
+	CHECK(active() == 5); // FIFO 1: 16b list, 32b list; FIFO 0: 16b list, 16b mask, 32b list
+}
+
+int main(void)
+{
+	alarm(HOSTTIMEOUT);
+	test_list16();
+	test_mask();
+	test_banksleft();
+	test_mixed();
+	return hostreport("test_canfilter");
+}
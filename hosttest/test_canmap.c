@@ -0,0 +1,221 @@
+/******************************************************************************
+* File Name          : test_canmap.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host test: generated CAN map tables vs. the runtime build
+*******************************************************************************/
+/*
+The contactor CAN map (Ourtasks/contactor_canmap.def) set up both ways:
+  - generated: 'canmap_tbl' and 'canmap_filt' (contactor_canmap_gen.c, from
+    canmap_gen), loaded with 'MailboxTask_add_table' and 'canfilter_setup_table'
+  - runtime: each map line a 'MailboxTask_add', in .def order, then
+    'canfilter_setup_mbx' with the FIFO 1 ids as the safe list
+(one CAN module on the F103: MailboxTask is reset between the two)
+and the results compared:
+  - the sorted CAN id array and mailbox pointer array: same ids, same order;
+    each mailbox's paytype
+  - each mailbox's subscribers (notification blocks): count, and task handle
+    and bit of each, in .def order; its policy state at the same index
+  - the 'direct' mailboxes
+  - the filter banks: 'canmap_filt' words against the banks the runtime
+    compile stored, and the CAN1 filter registers after each way
+'make canmapcheck' (part of 'all' and 'hosttest') catches generated files older
+than the .def; this catches a generator that no longer agrees with the runtime.
+*/
+#include <string.h>
+#include <unistd.h>
+#include "hostrtos.h"
+#include "hostcan.h"
+#include "can_iface.c"
+#include "payload_extract.c"
+#include "MailboxTask.c"
+#include "canfilter_setup.c"
+#include "contactor_canmap_gen.c"
+
+osThreadId ContactorTaskHandle;
+
+/* Runtime: one 'MailboxTask_add' per map line */
+#define MAPMAX 32
+static uint32_t safe[MAPMAX];        // FIFO 1 ids
+static int nsafe;
+static struct MAILBOXCAN* direct[MAPMAX];
+static int ndirect;
+static int nline;
+
+static void addline(struct CAN_CTLBLOCK* pctl, uint32_t id, osThreadId task, uint32_t bit,
+	uint8_t paytype, uint8_t fifo, uint8_t isdirect)
+{
+	struct MAILBOXCAN* pmbx;
+	int i;
+
+	pmbx = MailboxTask_add(pctl, id, task, bit, 0, paytype);
+	CHECK(pmbx != NULL);
+	nline += 1;
+	if (fifo != 0)
+	{
+		for (i = 0; (i < nsafe) && (safe[i] != id); i++);
+		if (i == nsafe) safe[nsafe++] = id;
+	}
+	if (isdirect != 0)
+	{
+		for (i = 0; (i < ndirect) && (direct[i] != pmbx); i++);
+		if (i == ndirect) direct[ndirect++] = pmbx;
+	}
+}
+static void addall(struct CAN_CTLBLOCK* pctl)
+{
+#define CANMAPINCLUDE(f)
+#define CANMAP(name,id,paytype,fifo,task,bit,isdirect) addline(pctl,id,task,bit,paytype,fifo,isdirect);
+#include "contactor_canmap.def"
+#undef CANMAPINCLUDE
+#undef CANMAP
+}
+
+/* CAN1 filter registers */
+struct FILTREGS
+{
+	uint32_t fr1[CANFILTERNBANKS];
+	uint32_t fr2[CANFILTERNBANKS];
+	uint32_t fa1r, fm1r, fs1r, ffa1r;
+};
+static void filtregs(struct FILTREGS* pr)
+{
+	CAN_TypeDef* pregs = hostcan[0].Instance;
+	int i;
+
+	memset(pr, 0, sizeof(*pr));
+	pr->fa1r  = pregs->FA1R;
+	pr->fm1r  = pregs->FM1R  & pr->fa1r; // Inactive banks: don't care
+	pr->fs1r  = pregs->FS1R  & pr->fa1r;
+	pr->ffa1r = pregs->FFA1R & pr->fa1r;
+	for (i = 0; i < CANFILTERNBANKS; i++)
+	{
+		if ((pr->fa1r & (1 << i)) == 0) continue;
+		pr->fr1[i] = pregs->sFilterRegister[i].FR1;
+		pr->fr2[i] = pregs->sFilterRegister[i].FR2;
+	}
+}
+static struct CAN_CTLBLOCK* mbxreset(void)
+{
+	memset(mbxpool, 0, sizeof(mbxpool)); mbxpoolct = 0;
+	memset(notepool, 0, sizeof(notepool)); notepoolct = 0;
+	memset(notepol, 0, sizeof(notepol));
+	memset(mbxcannum, 0, sizeof(mbxcannum));
+	notefrozen = 0;
+	pctlinst[CANINSTIDX(hostcan_reset(0, HOSTCANBTR500K))] = NULL;
+	return can_iface_init(&hostcan[0], 0, 16, 16);
+}
+static void filtfirst(void)
+{
+	hostcan_reset(0, HOSTCANBTR500K);
+	memset(&canfilt1, 0, sizeof(canfilt1));
+	canfilter_setup_first(1, &hostcan[0], CANFILTERNBANKS);
+}
+
+/* *************************************************************************
+ * Mailboxes, subscribers, 'direct'
+ * *************************************************************************/
+static void test_mailboxes(void)
+{
+	struct MAILBOXCANNUM* prun = &mbxcannum[0];
+	struct MAILBOXCANNUM gen;
+	struct MAILBOXCANNUM* pgen = &gen;
+	struct CAN_CTLBLOCK* pctl;
+	struct MAILBOXCAN* pr;
+	struct MAILBOXCAN* pg;
+	int i, k, badid = 0, badmbx = 0, badnote = 0, baddirect = 0;
+
+	ContactorTaskHandle = hosttask(5);
+	hostcurtask = hosttask(6); // NULL in the map: the task doing the adds
+	CHECK(xMailboxTaskCreate(0) != NULL);
+
+	/* Generated: the lists point into contactor_canmap_gen.c, kept after the reset */
+	pctl = mbxreset();
+	CHECK(MailboxTask_add_CANlist(pctl, MBXNUMMAX) != NULL);
+	CHECK(MailboxTask_add_table(pctl, &canmap_tbl) == &mbxcannum[0]);
+	memcpy(&gen, &mbxcannum[0], sizeof(gen));
+
+	/* Runtime */
+	pctl = mbxreset();
+	CHECK(MailboxTask_add_CANlist(pctl, MBXNUMMAX) != NULL);
+	addall(pctl);
+	CHECK(mbxpoolct == CANMAPNUM);
+
+	/* Sorted lookup arrays */
+	CHECK(nline == CANMAPNOTENUM);
+	CHECK((prun->arraysizecur == CANMAPNUM) && (pgen->arraysizecur == CANMAPNUM));
+	for (i = 0; i < CANMAPNUM; i++)
+	{
+		if (prun->pidarray[i] != pgen->pidarray[i]) badid += 1;
+		if ((i > 0) && (pgen->pidarray[i-1] >= pgen->pidarray[i])) badid += 1;
+		pr = prun->pmbxarray[i];
+		pg = pgen->pmbxarray[i];
+		if ((pr->ncan.can.id != pg->ncan.can.id) || (pg->ncan.can.id != pgen->pidarray[i])) badmbx += 1;
+		if (pr->paytype != pg->paytype) badmbx += 1;
+
+		/* Subscribers */
+		if ((pr->notect != pg->notect) || (pg->pnote == NULL) || (pg->ppol == NULL)) {badnote += 1; continue;}
+		if ((pg->ppol - canmap_tbl.ppol) != (pg->pnote - canmap_tbl.pnote)) badnote += 1;
+		for (k = 0; k < pg->notect; k++)
+		{
+			if (pr->pnote[k].tskhandle != pg->pnote[k].tskhandle) badnote += 1;
+			if (pr->pnote[k].notebit   != pg->pnote[k].notebit)   badnote += 1;
+			if (pr->pnote[k].skip      != pg->pnote[k].skip)      badnote += 1;
+			if (pr->ppol[k].policy     != pg->ppol[k].policy)     badnote += 1;
+		}
+	}
+	CHECK(badid == 0);
+	CHECK(badmbx == 0);
+	CHECK(badnote == 0);
+
+	/* 'direct': the same mailboxes, by sorted index */
+	CHECK(canmap_tbl.ndirect == ndirect);
+	for (i = 0; i < canmap_tbl.ndirect; i++)
+	{
+		for (k = 0; (k < ndirect) && (direct[k] != prun->pmbxarray[canmap_tbl.pdirect[i]]); k++);
+		if (k == ndirect) baddirect += 1;
+	}
+	CHECK(baddirect == 0);
+}
+/* *************************************************************************
+ * Filter banks
+ * *************************************************************************/
+static void test_filters(void)
+{
+	struct FILTREGS run, gen;
+	int i, retrun, retgen, bad = 0;
+
+	/* Runtime: compile the registered mailboxes' ids */
+	filtfirst();
+	retrun = canfilter_setup_mbx(1, &hostcan[0], &mbxcannum[0], &safe[0], nsafe);
+	CHECK(retrun >= 0);
+	filtregs(&run);
+
+	/* Generated words, against the banks the runtime compile stored */
+	CHECK(__builtin_popcount(run.fa1r) == CANMAPFILTNUM);
+	CHECK(run.fa1r == ((1u << CANMAPFILTNUM) - 1));
+	for (i = 0; i < CANMAPFILTNUM; i++)
+	{
+		if ((canmap_filt[i].fr1 != run.fr1[i]) || (canmap_filt[i].fr2 != run.fr2[i])) bad += 1;
+		if (((canmap_filt[i].mode == CAN_FILTERMODE_IDLIST) ? 1 : 0) != ((run.fm1r >> i) & 1)) bad += 1;
+		if (((canmap_filt[i].scale == CAN_FILTERSCALE_32BIT) ? 1 : 0) != ((run.fs1r >> i) & 1)) bad += 1;
+		if (canmap_filt[i].fifo != ((run.ffa1r >> i) & 1)) bad += 1;
+	}
+	CHECK(bad == 0);
+
+	/* Generated: loaded as the target does; registers the same */
+	filtfirst();
+	retgen = canfilter_setup_table(1, &hostcan[0], &canmap_filt[0], CANMAPFILTNUM);
+	CHECK(retgen == retrun);
+	CHECK(canfilter_setup_banksleft(1) == retrun);
+	filtregs(&gen);
+	CHECK(memcmp(&run, &gen, sizeof(run)) == 0);
+}
+
+int main(void)
+{
+	alarm(HOSTTIMEOUT);
+	test_mailboxes();
+	test_filters();
+	return hostreport("test_canmap");
+}
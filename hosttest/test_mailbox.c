@@ -0,0 +1,634 @@
+/******************************************************************************
+* File Name          : test_mailbox.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host test: MailboxTask mailbox update & snapshot
+*******************************************************************************/
+/*
+  - seqlock: one thread updates a mailbox ('mbxwrite', as MailboxTask or the RX
+    ISR does) while another takes 'MailboxTask_snapshot' copies.  Every copy that
+    returns 0 must be one whole update: msg, extracted readings, 'ctr' and 'seq'
+    all from the same msg.  The writer gives up the cpu between some updates, and
+    in the middle of others (inside 'payload_extract'), so the reader also meets
+    odd 'seq'.  The reader gives the cpu back after each copy: on a one cpu host
+    the two take turns (plus time slice preemption); on more they run at once.
+  - lookup: 'bsearchid'/'lookup' give the same hit/miss and mailbox as the old
+    straight pass down the mailbox pointers, for 8 - 256 mailboxes (own arrays;
+    the static ones hold MBXNUMMAX), std & ext ids, every id, its neighbours,
+    and ids below/above all; a miss returns its insert position.
+    'MailboxTask_add' in random id order keeps the arrays sorted.
+  - notification blocks: adding one to an earlier mailbox moves the later
+    mailboxes' blocks, and their policy state with them ('ppol'), until a
+    block pointer is handed out; after that it traps (39) and nothing moves,
+    while adds at the end of the pool still go in.
+  - notification policies, one mailbox with two subscribers (the second one
+    always notified, so each msg is seen to arrive): the 'skip' flag (no
+    notify, not counted as saved); on change (dlc or any payload byte, first
+    msg, back from stale); deadband FF & U32 (from the reading at the last
+    notify, so a slow drift notifies; NaN notifies); at most one per interval
+    (tick count wrap); setting a policy primes it (next msg notifies); 'savect'
+    per block and the total.
+  - history ring: registration (power of two depth, one ring a mailbox, the
+    MBXHISTBUDGET budget); batch reads in order with 'pnext' carried on; a
+    reader lapped starts at the oldest kept; 'seqfrom' ahead of the writer; a
+    slot the writer has claimed but not yet filled ends the read there; a slot
+    overwritten while it is being copied is left out (writer run from a
+    barrier in 'MailboxTask_history_read').
+*/
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include "hostrtos.h"
+#include "hostcan.h"
+#include "can_iface.c"
+#include "payload_extract.c"
+
+/* Writer hook: every SEQYIELD'th update gives up the cpu with 'seq' odd */
+#define SEQYIELD 61
+static uint32_t extractct;
+static void test_payload_extract(struct MAILBOXCAN* pmbx)
+{
+	if ((++extractct % SEQYIELD) == 0)
+		sched_yield(); // Msg copied, readings not yet
+	payload_extract(pmbx);
+}
+#define payload_extract test_payload_extract
+
+/* Barrier hook: the 'dmbct'th barrier from now runs 'pdmb' (as if the writer
+   preempted there) */
+static void (*pdmb)(void);
+static int dmbct;
+static void test_dmb(void)
+{
+	void (*pf)(void) = pdmb;
+	__sync_synchronize();
+	if ((pf != NULL) && (--dmbct == 0))
+	{
+		pdmb = NULL;
+		(*pf)();
+	}
+}
+#define __DMB test_dmb
+#include "MailboxTask.c"
+#undef __DMB
+#undef payload_extract
+
+/* *************************************************************************
+ * seqlock: 'mbxwrite' vs 'MailboxTask_snapshot'
+ * *************************************************************************/
+#define SEQWRITES  2000000 // Updates by the writer (at least)
+#define SEQSNAPMIN 10000   // Snapshots by the reader (at least)
+
+static struct MAILBOXCAN seqmbx;
+static volatile int seqdone;  // 1 = writer finished
+/* Reader results */
+static uint32_t seqok;        // Snapshots returned 0
+static uint32_t seqbusy;      // Snapshots returned -1 (update in progress)
+static uint32_t seqtorn;      // Snapshots not from one update
+static uint32_t seqback;      // Snapshot older than the one before
+
+/* Update n: payload n, ~n; DTW n.  U32_U32: readings are the eight payload bytes. */
+static int seqwhole(struct MAILBOXSNAP* ps)
+{
+	uint32_t n = ps->ncan.can.cd.ui[0];
+	if (ps->ncan.can.cd.ui[1] != ~n) return 0;
+	if (ps->ncan.toa != n) return 0;
+	if (memcmp(&ps->mbx.u, &ps->ncan.can.cd, 8) != 0) return 0;
+	if (ps->ctr != n + 1) return 0;   // Counted by 'payload_extract' on each update
+	if (ps->seq != 2*(n + 1)) return 0; // Even, two per update
+	return 1;
+}
+static void* seqreader(void* arg)
+{
+	struct MAILBOXSNAP snap;
+	uint32_t last = 0;
+	(void)arg;
+
+	while (seqdone == 0)
+	{
+		if (MailboxTask_snapshot(&seqmbx, &snap) != 0)
+			seqbusy += 1;
+		else
+		{
+			seqok += 1;
+			if (snap.seq != 0)
+			{ // Here, at least one update
+				if (seqwhole(&snap) == 0)
+					seqtorn += 1;
+				if ((int32_t)(snap.seq - last) < 0)
+					seqback += 1;
+				last = snap.seq;
+			}
+		}
+		sched_yield(); // One cpu: back to the writer
+	}
+	return NULL;
+}
+static void test_seqlock(void)
+{
+	struct CANRCVBUFN ncan;
+	struct MAILBOXSNAP snap;
+	pthread_t rd;
+	uint32_t n;
+
+	memset(&seqmbx, 0, sizeof(seqmbx));
+	memset(&ncan, 0, sizeof(ncan));
+	seqmbx.paytype = U32_U32;
+	ncan.can.id  = 0x12345678;
+	ncan.can.dlc = 8;
+
+	seqdone = 0;
+	CHECK(pthread_create(&rd, NULL, seqreader, NULL) == 0);
+	for (n = 0; (n < SEQWRITES) || (seqok < SEQSNAPMIN); n++)
+	{
+		ncan.can.cd.ui[0] = n;
+		ncan.can.cd.ui[1] = ~n;
+		ncan.toa = n;
+		mbxwrite(&seqmbx, &ncan, n);
+		if ((n % (SEQYIELD * 2)) == 0)
+			sched_yield(); // Between updates ('seq' even)
+	}
+	seqdone = 1;
+	CHECK(pthread_join(rd, NULL) == 0);
+
+	printf("seqlock: %u updates, %u snapshots, %u busy (-1)\n", n, seqok, seqbusy);
+	CHECK(seqtorn == 0);
+	CHECK(seqback == 0);
+	CHECK((seqmbx.seq == 2*n) && (seqmbx.ctr == n));
+
+	/* Writer done: a snapshot is the last update */
+	CHECK(MailboxTask_snapshot(&seqmbx, &snap) == 0);
+	CHECK((seqwhole(&snap) == 1) && (snap.ncan.can.cd.ui[0] == n - 1));
+
+	/* Update left in progress (writer preempted): no copy */
+	seqmbx.seq += 1;
+	CHECK(MailboxTask_snapshot(&seqmbx, &snap) == -1);
+	seqmbx.seq += 1;
+}
+
+/* *************************************************************************
+ * lookup: binary search vs. straight pass
+ * *************************************************************************/
+#define LOOKMAX 256
+
+static uint32_t lcg = 1;
+static uint32_t rnd(void)
+{
+	lcg = (lcg * 1664525u) + 1013904223u;
+	return lcg;
+}
+/* CAN id as the driver holds it: std 11 bits << 21, ext 29 bits << 3 | IDE */
+static uint32_t rndid(void)
+{
+	if ((rnd() & 0x100) != 0)
+		return (rnd() & 0x7ff) << 21;
+	return ((rnd() & 0x1fffffff) << 3) | 0x4;
+}
+/* The old 'lookup': straight pass down the array of mailbox pointers */
+static struct MAILBOXCAN* linlookup(struct MAILBOXCANNUM* pmbxnum, uint32_t canid)
+{
+	int i;
+	for (i = 0; i < pmbxnum->arraysizecur; i++)
+		if (pmbxnum->pmbxarray[i]->ncan.can.id == canid)
+			return pmbxnum->pmbxarray[i];
+	return NULL;
+}
+/* One id: binary and straight agree; a miss gives the insert position */
+static int lookone(struct MAILBOXCANNUM* pmbxnum, uint32_t canid)
+{
+	struct CANRCVBUFN ncan;
+	struct MAILBOXCAN* plin = linlookup(pmbxnum, canid);
+	int i = bsearchid(pmbxnum, canid);
+
+	ncan.can.id = canid;
+	if (lookup(pmbxnum, &ncan) != plin) return 0;
+	if (i >= 0)
+		return (plin != NULL) && (pmbxnum->pmbxarray[i] == plin);
+	if (plin != NULL) return 0;
+	i = -i - 1;
+	if ((i > 0) && (pmbxnum->pidarray[i-1] >= canid)) return 0;
+	if ((i < pmbxnum->arraysizecur) && (pmbxnum->pidarray[i] <= canid)) return 0;
+	return 1;
+}
+/* Every id, its neighbours, and the ends */
+static int lookall(struct MAILBOXCANNUM* pmbxnum)
+{
+	int i, bad = 0;
+	bad += (lookone(pmbxnum, 0) == 0);
+	bad += (lookone(pmbxnum, 0xffffffff) == 0);
+	for (i = 0; i < pmbxnum->arraysizecur; i++)
+	{
+		bad += (lookone(pmbxnum, pmbxnum->pidarray[i]) == 0);
+		bad += (lookone(pmbxnum, pmbxnum->pidarray[i] - 1) == 0);
+		bad += (lookone(pmbxnum, pmbxnum->pidarray[i] + 1) == 0);
+	}
+	for (i = 0; i < 1000; i++)
+		bad += (lookone(pmbxnum, rndid()) == 0);
+	return bad;
+}
+static int idcmp(const void* a, const void* b)
+{
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+static void test_lookup(void)
+{
+	static struct MAILBOXCAN pool[LOOKMAX];
+	static struct MAILBOXCAN* ptrs[LOOKMAX];
+	static uint32_t ids[LOOKMAX];
+	struct MAILBOXCANNUM num;
+	struct CANRCVBUFN ncan;
+	struct CAN_CTLBLOCK* pctl;
+	struct MAILBOXCAN* pmbx;
+	int n, i, k, ok;
+
+	/* Own arrays: sizes past MBXNUMMAX */
+	for (n = 8; n <= LOOKMAX; n *= 2)
+	{
+		for (k = 0; k < 20; k++)
+		{
+			for (i = 0; i < n; i++)
+			{ // Distinct ids, sorted
+				do ids[i] = rndid();
+				while (bsearch(&ids[i], ids, i, sizeof(ids[0]), idcmp) != NULL);
+				qsort(ids, i + 1, sizeof(ids[0]), idcmp);
+			}
+			memset(&num, 0, sizeof(num));
+			for (i = 0; i < n; i++)
+			{
+				memset(&pool[i], 0, sizeof(pool[i]));
+				pool[i].ncan.can.id = ids[i];
+				ptrs[i] = &pool[i];
+			}
+			num.pmbxarray = ptrs;
+			num.pidarray = ids;
+			num.arraysizecur = n;
+			CHECK(lookall(&num) == 0);
+		}
+	}
+
+	/* 'direct' mailbox: found, but not for MailboxTask */
+	pool[3].direct = 1;
+	CHECK(bsearchid(&num, ids[3]) == 3);
+	ncan.can.id = ids[3];
+	CHECK(lookup(&num, &ncan) == NULL);
+	pool[3].direct = 0;
+
+	/* 'MailboxTask_add', random id order: arrays sorted, each id its own mailbox */
+	pctlinst[CANINSTIDX(hostcan_reset(0, HOSTCANBTR500K))] = NULL;
+	pctl = can_iface_init(&hostcan[0], 0, 16, 16);
+	CHECK(xMailboxTaskCreate(0) != NULL);
+	CHECK(MailboxTask_add_CANlist(pctl, MBXNUMMAX) != NULL);
+	for (i = 0; i < MBXNUMMAX - 1; i++)
+	{ // 'arraysizemax' traps the add that fills the array
+		do ids[i] = rndid();
+		while (bsearchid(&mbxcannum[0], ids[i]) >= 0);
+		pmbx = MailboxTask_add(pctl, ids[i], NULL, 0, 0, U32);
+		CHECK((pmbx != NULL) && (pmbx->ncan.can.id == ids[i]));
+	}
+	CHECK(mbxcannum[0].arraysizecur == MBXNUMMAX - 1);
+	ok = 1;
+	for (i = 0; i < mbxcannum[0].arraysizecur; i++)
+	{
+		if (mbxcannum[0].pmbxarray[i]->ncan.can.id != mbxcannum[0].pidarray[i]) ok = 0;
+		if ((i > 0) && (mbxcannum[0].pidarray[i-1] >= mbxcannum[0].pidarray[i])) ok = 0;
+	}
+	CHECK(ok == 1);
+	CHECK(lookall(&mbxcannum[0]) == 0);
+	ok = 1;
+	for (i = 0; i < MBXNUMMAX - 1; i++)
+	{
+		pmbx = linlookup(&mbxcannum[0], ids[i]);
+		if ((pmbx == NULL) || (pmbx->ncan.can.id != ids[i])) ok = 0;
+	}
+	CHECK(ok == 1);
+}
+
+/* *************************************************************************
+ * Notification blocks: no move after a block pointer is handed out
+ * *************************************************************************/
+static struct CAN_CTLBLOCK* mbxreset(void)
+{
+	memset(mbxpool, 0, sizeof(mbxpool)); mbxpoolct = 0;
+	memset(notepool, 0, sizeof(notepool)); notepoolct = 0;
+	memset(notepol, 0, sizeof(notepol));
+	memset(mbxcannum, 0, sizeof(mbxcannum));
+	notefrozen = 0;
+	pctlinst[CANINSTIDX(hostcan_reset(0, HOSTCANBTR500K))] = NULL;
+	return can_iface_init(&hostcan[0], 0, 16, 16);
+}
+/* Policy state of a mailbox's block */
+static struct MBXNOTEPOL* pol(struct MAILBOXCAN* pmbx, struct CANNOTIFYLIST* p)
+{
+	return &pmbx->ppol[p - pmbx->pnote];
+}
+static void test_notefreeze(void)
+{
+	struct CAN_CTLBLOCK* pctl = mbxreset();
+	struct MAILBOXCAN* pa;
+	struct MAILBOXCAN* pb;
+	struct MAILBOXCAN* pc;
+	struct CANNOTIFYLIST* p;
+
+	CHECK(MailboxTask_add_CANlist(pctl, MBXNUMMAX) != NULL);
+	pa = MailboxTask_add(pctl, 0x100 << 21, hosttask(1), 0x10, 0, U32);
+	pb = MailboxTask_add(pctl, 0x200 << 21, hosttask(2), 0x20, 0, U32);
+	CHECK((pa->ppol == &notepol[0]) && (pb->ppol == &notepol[1]));
+	notepol[1].savect = 7; // Policy state moves with its block
+
+	/* Second block for 'pa': 'pb's block moves up, 'pb' follows it */
+	CHECK(MailboxTask_add(pctl, 0x100 << 21, hosttask(3), 0x30, 0, U32) == pa);
+	CHECK((pa->notect == 2) && (pa->pnote == &notepool[0]) && (pa->ppol == &notepol[0]));
+	CHECK((pa->pnote[1].tskhandle == hosttask(3)) && (pa->pnote[1].notebit == 0x30));
+	CHECK((pa->ppol[1].savect == 0) && (pa->ppol[1].policy == MBXNOTEALWAYS));
+	CHECK((pb->notect == 1) && (pb->pnote == &notepool[2]) && (pb->pnote->tskhandle == hosttask(2)));
+	CHECK((pb->ppol == &notepol[2]) && (pb->ppol->savect == 7));
+
+	/* Task 2 takes its block pointer */
+	hostcurtask = hosttask(2);
+	p = MailboxTask_notify_onchange(pb);
+	CHECK((p == pb->pnote) && (pb->ppol->policy == MBXNOTECHANGE));
+
+	/* At the end of the pool: nothing moves */
+	CHECK(MailboxTask_add(pctl, 0x200 << 21, hosttask(4), 0x40, 0, U32) == pb);
+	CHECK((pb->notect == 2) && (pb->pnote == p) && (pb->pnote[1].tskhandle == hosttask(4)));
+	pc = MailboxTask_add(pctl, 0x300 << 21, hosttask(5), 0x50, 0, U32);
+	CHECK((pc != NULL) && (pc->pnote == &notepool[4]));
+
+	/* Before 'pb': would move task 2's block */
+	CHECK(HOSTTRAP(MailboxTask_add(pctl, 0x100 << 21, hosttask(6), 0x60, 0, U32)) == 39);
+	CHECK(hostcrit_depth() == 0);
+	CHECK((notepoolct == 5) && (pa->notect == 2) && (pb->pnote == p));
+	CHECK((p->tskhandle == hosttask(2)) && (p->notebit == 0x20) && (pol(pb, p)->policy == MBXNOTECHANGE));
+	/* A new mailbox with a notification still goes at the end */
+	CHECK(HOSTTRAP(MailboxTask_add(pctl, 0x050 << 21, hosttask(6), 0x60, 0, U32)) == -1);
+	CHECK((notepoolct == 6) && (notepool[5].tskhandle == hosttask(6)));
+	hostcurtask = NULL;
+}
+
+/* *************************************************************************
+ * Notification policies
+ * *************************************************************************/
+static void arrive(struct MAILBOXCAN* pmbx, uint32_t dlc, uint32_t w0, uint32_t w1)
+{
+	struct CANRCVBUFN ncan;
+
+	memset(&ncan, 0, sizeof(ncan));
+	ncan.can.id  = pmbx->ncan.can.id;
+	ncan.can.dlc = dlc;
+	ncan.can.cd.ui[0] = w0;
+	ncan.can.cd.ui[1] = w1;
+	CHECK(loadmbx(&mbxcannum[0], &ncan) == pmbx);
+}
+/* Task 1 notified; task 2 (always) must be, every msg */
+static int note1(void)
+{
+	int ok = (hostnotes(hosttask(2)) == 0x20);
+	uint32_t x = hostnotes(hosttask(1));
+	if (ok == 0) return -1;
+	return (x == 0x10);
+}
+static uint32_t ffu(float f)
+{
+	union MBXNOTEVAL v = {.f = f};
+	return v.u;
+}
+/* Mailbox 'id' with task 1 (policy under test) and task 2 (always) */
+static struct MAILBOXCAN* twonotes(struct CAN_CTLBLOCK* pctl, uint32_t id, uint8_t paytype, uint8_t skip1)
+{
+	struct MAILBOXCAN* pmbx;
+	pmbx = MailboxTask_add(pctl, id, hosttask(1), 0x10, skip1, paytype);
+	CHECK(MailboxTask_add(pctl, id, hosttask(2), 0x20, 0, paytype) == pmbx);
+	hostcurtask = hosttask(1);
+	return pmbx;
+}
+static void test_notepolicy(void)
+{
+	struct CAN_CTLBLOCK* pctl = mbxreset();
+	struct MAILBOXCAN* pskip;
+	struct MAILBOXCAN* pchg;
+	struct MAILBOXCAN* pff;
+	struct MAILBOXCAN* pu32;
+	struct MAILBOXCAN* prate;
+	struct CANNOTIFYLIST* p;
+	struct MBXNOTEPOL* pp;
+	uint32_t save = 0;
+	int i, ct;
+
+	CHECK(MailboxTask_add_CANlist(pctl, MBXNUMMAX) != NULL);
+	pskip = twonotes(pctl, 0x100 << 21, U32, 1);
+	pchg  = twonotes(pctl, 0x200 << 21, U32, 0);
+	pff   = twonotes(pctl, 0x300 << 21, FF, 0);
+	pu32  = twonotes(pctl, 0x400 << 21, U32, 0);
+	prate = twonotes(pctl, 0x500 << 21, U32, 0);
+	hostnotes(hosttask(1)); hostnotes(hosttask(2));
+
+	/* 'skip': added skipped, enabled, disabled; not a policy, so nothing saved */
+	arrive(pskip, 4, 1, 0);
+	CHECK(note1() == 0);
+	CHECK(MailboxTask_enable_notifications(pskip) == pskip->pnote);
+	arrive(pskip, 4, 1, 0);
+	CHECK(note1() == 1);
+	CHECK(MailboxTask_disable_notifications(pskip) == pskip->pnote);
+	arrive(pskip, 4, 2, 0);
+	CHECK(note1() == 0);
+	CHECK(pskip->ppol->savect == 0);
+
+	/* On change */
+	p = MailboxTask_notify_onchange(pchg);
+	pp = pol(pchg, p);
+	CHECK((p == pchg->pnote) && (pp->policy == MBXNOTECHANGE));
+	arrive(pchg, 4, 7, 0);
+	CHECK(note1() == 1); // First msg
+	for (i = 0, ct = 0; i < 5; i++)
+	{
+		arrive(pchg, 4, 7, 0);
+		ct += note1();
+	}
+	CHECK((ct == 0) && (pp->savect == 5));
+	arrive(pchg, 5, 7, 0);         // dlc
+	CHECK(note1() == 1);
+	arrive(pchg, 5, 7, 0x1000000); // A byte U32 does not extract
+	CHECK(note1() == 1);
+	arrive(pchg, 5, 7, 0x1000000);
+	CHECK(note1() == 0);
+	pchg->stale = 1;               // As the deadline sweep leaves it
+	arrive(pchg, 5, 7, 0x1000000);
+	CHECK(note1() == 1);
+	CHECK(pp->savect == 6);
+
+	/* Deadband FF 0.5, from the reading at the last notify (dyadic: exact) */
+	p = MailboxTask_notify_deadband_ff(pff, 0.5f);
+	pp = pol(pff, p);
+	arrive(pff, 4, ffu(10.0f), 0);
+	CHECK(note1() == 1); // Primed by the first msg
+	arrive(pff, 4, ffu(10.375f), 0); CHECK(note1() == 0);
+	arrive(pff, 4, ffu(9.5f), 0);    CHECK(note1() == 0); // Exactly 0.5: inside
+	arrive(pff, 4, ffu(9.375f), 0);  CHECK(note1() == 1);
+	for (i = 1, ct = 0; i <= 5; i++)
+	{ // Slow drift up from 9.375: the fifth step is 0.625 from the last notify
+		arrive(pff, 4, ffu(9.375f + 0.125f * i), 0);
+		ct += note1();
+	}
+	CHECK((ct == 1) && (pp->last.f == 10.0f));
+	arrive(pff, 4, ffu(__builtin_nanf("")), 0); CHECK(note1() == 1);
+	arrive(pff, 4, ffu(10.0f), 0);              CHECK(note1() == 1); // From NaN
+	CHECK(pp->savect == 6);
+
+	/* Deadband U32 100, both directions */
+	p = MailboxTask_notify_deadband_u32(pu32, 100);
+	pp = pol(pu32, p);
+	arrive(pu32, 4, 1000, 0); CHECK(note1() == 1);
+	arrive(pu32, 4, 1100, 0); CHECK(note1() == 0);
+	arrive(pu32, 4, 1101, 0); CHECK(note1() == 1);
+	arrive(pu32, 4, 1001, 0); CHECK(note1() == 0);
+	arrive(pu32, 4, 1000, 0); CHECK(note1() == 1);
+	arrive(pu32, 4, 1050, 0); CHECK(note1() == 0);
+
+	/* Setting a policy primes it: the next msg notifies, and is the reference */
+	CHECK(MailboxTask_notify_deadband_u32(pu32, 100) == p);
+	CHECK(pp->primed == 0);
+	arrive(pu32, 4, 1050, 0); CHECK(note1() == 1);
+	arrive(pu32, 4, 1150, 0); CHECK(note1() == 0);
+	CHECK(pp->savect == 4);
+
+	/* At most one per 50 ms (ticks) */
+	hosttick = 1000;
+	p = MailboxTask_notify_ratelimit(prate, 50);
+	pp = pol(prate, p);
+	CHECK(pp->param.u == pdMS_TO_TICKS(50));
+	arrive(prate, 4, 1, 0); CHECK(note1() == 1);
+	for (i = 0, ct = 0; i < 100; i++)
+	{ // Burst in one tick
+		arrive(prate, 4, i, 0);
+		ct += note1();
+	}
+	CHECK((ct == 0) && (pp->savect == 100));
+	hosttick += 49;
+	arrive(prate, 4, 1, 0); CHECK(note1() == 0);
+	hosttick += 1;
+	arrive(prate, 4, 1, 0); CHECK(note1() == 1);
+	hosttick = 0xffffffe0; // Across the tick count wrap
+	MailboxTask_notify_ratelimit(prate, 50);
+	arrive(prate, 4, 1, 0); CHECK(note1() == 1);
+	hosttick = 0x10;       // 48 ticks later
+	arrive(prate, 4, 1, 0); CHECK(note1() == 0);
+	hosttick = 0x12;
+	arrive(prate, 4, 1, 0); CHECK(note1() == 1);
+	CHECK(pp->savect == 102);
+
+	/* Back to always */
+	CHECK(MailboxTask_notify_always(prate) == p);
+	arrive(prate, 4, 1, 0); CHECK(note1() == 1);
+
+	/* Total: the always blocks (task 2) saved none */
+	for (i = 0; i < notepoolct; i++)
+	{
+		if (notepool[i].tskhandle == hosttask(2)) CHECK(notepol[i].savect == 0);
+		save += notepol[i].savect;
+	}
+	CHECK((save == 6 + 6 + 4 + 102) && (MailboxTask_notify_savect() == save));
+	hosttick = 0;
+	hostcurtask = NULL;
+}
+
+/* *************************************************************************
+ * History ring
+ * *************************************************************************/
+static struct MAILBOXCAN* phistmbx;
+static uint32_t histn; // Msg n: payload n, ~n
+static void histput(void)
+{
+	arrive(phistmbx, 8, histn, ~histn);
+	histn += 1;
+}
+/* Entries 'ph[0..ct)' are msgs 'first', 'first'+1, ... with their own seq */
+static int histrun(struct MBXHISTENTRY* ph, int ct, uint32_t first)
+{
+	int i;
+	for (i = 0; i < ct; i++)
+	{
+		if ((ph[i].seq != first + i) || (ph[i].ncan.can.cd.ui[0] != first + i) ||
+		    (ph[i].ncan.can.cd.ui[1] != ~(first + i))) return 0;
+	}
+	return 1;
+}
+static void test_history(void)
+{
+	struct CAN_CTLBLOCK* pctl = mbxreset();
+	struct MAILBOXCAN* pb;
+	struct MAILBOXCAN* pc;
+	struct MAILBOXCAN* pd;
+	struct MBXHISTENTRY h[16];
+	uint32_t next;
+	int i;
+
+	histpoolct = 0;
+	histn = 0;
+	CHECK(MailboxTask_add_CANlist(pctl, MBXNUMMAX) != NULL);
+	phistmbx = MailboxTask_add(pctl, 0x100 << 21, NULL, 0, 0, U32);
+	pb = MailboxTask_add(pctl, 0x200 << 21, NULL, 0, 0, U32);
+	pc = MailboxTask_add(pctl, 0x300 << 21, NULL, 0, 0, U32);
+	pd = MailboxTask_add(pctl, 0x400 << 21, NULL, 0, 0, U32);
+
+	/* Registration */
+	CHECK(MailboxTask_history_read(phistmbx, 0, h, 16, &next) == -1);
+	CHECK(MailboxTask_history(phistmbx, 0) == -1);
+	CHECK(MailboxTask_history(phistmbx, 6) == -1);
+	CHECK(MailboxTask_history(phistmbx, 8) == 0);
+	CHECK(MailboxTask_history(phistmbx, 8) == -1); // Has one
+	CHECK(MailboxTask_history(pb, MBXHISTBUDGET) == -1);
+	CHECK(MailboxTask_history(pb, 16) == 0);
+	CHECK(MailboxTask_history(pc, 16) == -1);      // 8 left
+	CHECK(MailboxTask_history(pc, 8) == 0);
+	CHECK(MailboxTask_history(pd, 1) == -1);       // Budget used up
+	CHECK(histpoolct == MBXHISTBUDGET);
+
+	/* Empty; then five, read in batches of two */
+	CHECK((MailboxTask_history_read(phistmbx, 0, h, 16, &next) == 0) && (next == 0));
+	for (i = 0; i < 5; i++) histput();
+	CHECK((MailboxTask_history_read(phistmbx, 0, h, 16, &next) == 5) && (next == 5));
+	CHECK(histrun(h, 5, 0));
+	next = 0;
+	CHECK((MailboxTask_history_read(phistmbx, next, h, 2, &next) == 2) && histrun(h, 2, 0));
+	CHECK((MailboxTask_history_read(phistmbx, next, h, 2, &next) == 2) && histrun(h, 2, 2));
+	CHECK((MailboxTask_history_read(phistmbx, next, h, 2, &next) == 1) && histrun(h, 1, 4));
+	CHECK((MailboxTask_history_read(phistmbx, next, h, 2, &next) == 0) && (next == 5));
+	CHECK((phistmbx->histseq == 5) && (phistmbx->ncan.can.cd.ui[0] == 4)); // Mailbox: the latest
+
+	/* Lapped: 20 msgs in a ring of 8; a reader at 3 gets the oldest kept, 12 - 19 */
+	for (i = 5; i < 20; i++) histput();
+	CHECK((MailboxTask_history_read(phistmbx, 3, h, 16, &next) == 8) && (next == 20));
+	CHECK(histrun(h, 8, 12));
+	CHECK((MailboxTask_history_read(phistmbx, 0, h, 16, &next) == 8) && histrun(h, 8, 12)); // 0 = all kept
+	CHECK((MailboxTask_history_read(phistmbx, 100, h, 16, &next) == 0) && (next == 20));     // Ahead: none
+
+	/* Writer preempted: slot claimed ('histseq' advanced), msg not in yet */
+	phistmbx->histseq += 1;
+	CHECK((MailboxTask_history_read(phistmbx, 18, h, 16, &next) == 2) && (next == 20));
+	CHECK(histrun(h, 2, 18));
+	phistmbx->histseq -= 1;
+	histput();
+	CHECK((MailboxTask_history_read(phistmbx, next, h, 16, &next) == 1) && histrun(h, 1, 20));
+
+	/* Overwritten during the copy: the writer laps the slot being copied */
+	pdmb = histput;
+	dmbct = 2; // The barrier after the first copy
+	CHECK((MailboxTask_history_read(phistmbx, 0, h, 16, &next) == 7) && (next == 21));
+	CHECK(histrun(h, 7, 14)); // 13 left out: its slot now holds 21
+	CHECK((MailboxTask_history_read(phistmbx, next, h, 16, &next) == 1) && histrun(h, 1, 21));
+	CHECK(pdmb == NULL);
+}
+
+int main(void)
+{
+	alarm(HOSTTIMEOUT);
+	test_seqlock();
+	test_lookup();
+	test_notefreeze();
+	test_notepolicy();
+	test_history();
+	return hostreport("test_mailbox");
+}
@@ -0,0 +1,132 @@
+/******************************************************************************
+* File Name          : test_payload.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host test: payload_extract descriptor table vs. the old switch
+*******************************************************************************/
+/*
+  - parity: for every paytype code (0 - 255: the table, UNDEF, and codes not in
+    it) and every dlc 0 - 15, 'payload_extract' leaves the mailbox readings
+    ('mbx': union and 'pre8') and 'ctr' byte for byte as the old paytype switch
+    ('payload_switch.c') did.  Payloads and the mailbox contents before the call
+    are random, so bytes a layout must not touch are seen to be left alone, and
+    a dlc below the layout's min (no update, no count) is covered.
+  - payload_decode agrees with 'payload_extract' on what it extracts, and refuses
+    the same short dlc, where 'payload_extract' changes nothing: each line's
+    'copy' matches its dlcmin/npre/off/len.
+*/
+#include <string.h>
+#include "hostrtos.h"
+#include "payload_extract.c"
+#include "payload_switch.c"
+
+#define PAYREPS 50 // Random payloads per paytype & dlc
+
+static uint32_t lcg = 7;
+static uint32_t rnd(void)
+{
+	lcg = (lcg * 1664525u) + 1013904223u;
+	return lcg;
+}
+static void rndfill(void* p, int n)
+{
+	uint8_t* pc = (uint8_t*)p;
+	while (n-- > 0) *pc++ = (uint8_t)(rnd() >> 24);
+}
+/* *************************************************************************
+ * Table vs. switch
+ * *************************************************************************/
+static void test_parity(void)
+{
+	struct MAILBOXCAN a, b;
+	const struct PAYDESC* pd;
+	int paytype, dlc, k;
+	int badmbx = 0, badctr = 0, badall = 0;
+	int upd = 0, skip = 0;
+
+	for (paytype = 0; paytype < 256; paytype++)
+	{
+		for (dlc = 0; dlc < 16; dlc++)
+		{
+			for (k = 0; k < PAYREPS; k++)
+			{
+				rndfill(&a, sizeof(a));
+				a.paytype = paytype;
+				a.ncan.can.dlc = dlc;
+				memcpy(&b, &a, sizeof(a)); // Padding too
+
+				payload_extract(&a);
+				payload_extract_switch(&b);
+
+				if (memcmp(&a.mbx, &b.mbx, sizeof(a.mbx)) != 0) badmbx += 1;
+				if (a.ctr != b.ctr) badctr += 1;
+				if (memcmp(&a, &b, sizeof(a)) != 0) badall += 1; // Nothing else either
+			}
+		}
+	}
+	CHECK(badmbx == 0);
+	CHECK(badctr == 0);
+	CHECK(badall == 0);
+
+	/* Short dlc: the old switch left the readings alone too; both kinds were seen */
+	for (paytype = 0; paytype < 256; paytype++)
+	{
+		pd = payload_desc(paytype);
+		for (dlc = 0; dlc < 9; dlc++)
+		{
+			rndfill(&a, sizeof(a));
+			a.paytype = paytype;
+			a.ncan.can.dlc = dlc;
+			memcpy(&b, &a, sizeof(a));
+			payload_extract_switch(&b);
+			if (memcmp(&a.mbx, &b.mbx, sizeof(a.mbx)) != 0) upd += 1;
+			else skip += 1;
+			CHECK((dlc >= pd->dlcmin) || (memcmp(&a.mbx, &b.mbx, sizeof(a.mbx)) == 0));
+		}
+	}
+	CHECK((upd != 0) && (skip != 0));
+}
+/* *************************************************************************
+ * payload_decode vs. payload_extract
+ * *************************************************************************/
+static void test_decode(void)
+{
+	struct MAILBOXCAN m, m0;
+	struct PAYLOADOUT out;
+	const struct PAYDESC* pd;
+	int paytype, dlc, i, r;
+	int bad = 0;
+
+	for (paytype = 0; paytype < 256; paytype++)
+	{
+		pd = payload_desc(paytype);
+		for (dlc = 0; dlc < 9; dlc++)
+		{
+			rndfill(&m, sizeof(m));
+			m.paytype = paytype;
+			m.ncan.can.dlc = dlc;
+			r = payload_decode(&m.ncan.can, paytype, &out);
+			memcpy(&m0, &m, sizeof(m));
+			payload_extract(&m);
+			if (dlc < pd->dlcmin)
+			{
+				if (r != -1) bad += 1;
+				if (memcmp(&m0, &m, sizeof(m)) != 0) bad += 1;
+				continue;
+			}
+			if (m.ctr != (m0.ctr + (pd->len != 0))) bad += 1;
+			if ((r != 0) || (out.npre != pd->npre) || (out.nval != (pd->len >> 2))) {bad += 1; continue;}
+			if (memcmp(out.pre8, m.mbx.pre8, out.npre) != 0) bad += 1;
+			for (i = 0; i < out.nval; i++)
+				if (out.v[i].u != m.mbx.u.i32[i]) bad += 1;
+		}
+	}
+	CHECK(bad == 0);
+}
+
+int main(void)
+{
+	test_parity();
+	test_decode();
+	return hostreport("test_payload");
+}
@@ -0,0 +1,226 @@
+/******************************************************************************
+* File Name          : test_ttcm.c
+* Date First Issued  : 10/17/2026
+* Board              : Linux host (gcc)
+* Description        : Host test: CANTTCM 16 bit SOF timestamp to DTW ticks
+*******************************************************************************/
+/*
+The driver built with CANTTCM (off by default in can_iface.h):
+  - 'ttcmtpb' (DTW ticks per CAN bit) from BTR at 500K & 1M equals the model's
+  - 'ttcm_toa' called directly, msgs at known SOF bit times:
+      first msg: the anchor assumes no latency, toa = 'now' - shortest frame;
+      the shortest frame for std/ext, RTR (no data), dlc > 8
+      a later msg that came in faster than that moves the anchor back; after
+      one with no stuff bits and no latency, toa is the SOF exactly
+      the 16 bit timer wrapping (TIME below the last one), a SOF just before a
+      wrap read just after it, gaps of many wraps, and the DTW 32 bit wrap
+      (not a multiple of the timer wrap)
+      read under 1/2 timer wrap late: exact; over: the anchor starts over
+  - on the bus model with TTCM (RDTxR and TDTxR TIME at SOF): every RX msg's
+    and each TX done 'toa' against the SOF in the model's bus log, with random
+    gaps (to many timer wraps, across the DTW wrap), bursts and ISR latency
+*/
+#include <string.h>
+#include <unistd.h>
+#include "hostrtos.h"
+#include "bxcan_model.h"
+#define CANTTCM
+#include "can_iface.c"
+
+#define STD(id)  ((uint32_t)(id) << 21)
+#define EXT(id)  (((uint32_t)(id) << 3) | CAN_ID_EXT)
+#define RTR      CAN_RTR_REMOTE
+
+static struct CAN_CTLBLOCK* pctl[2];
+static struct CANTAKEPTR* ptake;
+
+static uint32_t lcg = 11;
+static uint32_t rnd(void)
+{
+	lcg = (lcg * 1664525u) + 1013904223u;
+	return lcg;
+}
+static void bus(uint32_t btr)
+{
+	int n;
+	bxcan_model_init(2, btr, CAN_MCR_NART | CAN_MCR_TTCM);
+	for (n = 0; n < 2; n++)
+	{
+		pctlinst[CANINSTIDX(&hostcan[n])] = NULL;
+		pctl[n] = can_iface_init(&hostcan[n], n, 16, 16);
+		bxcan_model_acceptall(n, CAN_FILTER_FIFO0);
+	}
+	ptake = can_iface_mbx_init(pctl[1], hosttask(1), 0x1);
+}
+/* *************************************************************************
+ * DTW ticks per bit
+ * *************************************************************************/
+static void test_tpb(void)
+{
+	bus(HOSTCANBTR500K);
+	CHECK((pctl[0]->ttcmtpb == 144) && (pctl[0]->ttcmtpb == bxcan_model_tpb()));
+	CHECK(pctl[0]->ttcmsync == 0);
+	bus(HOSTCANBTR1M);
+	CHECK((pctl[0]->ttcmtpb == 72) && (pctl[0]->ttcmtpb == bxcan_model_tpb()));
+}
+/* *************************************************************************
+ * ttcm_toa, msgs at known times
+ * *************************************************************************/
+#define TPB  144
+#define SPAN (TPB << 16) // DTW ticks per CAN timer wrap
+static struct CAN_CTLBLOCK ctl;
+static uint32_t dtw0; // DTW tick when the CAN timer was 0
+
+/* SOF at bit 'b' (the timer's count, not wrapped), 'len' bits SOF through EOF,
+   read 'late' DTW ticks after the EOF: toa minus the SOF (DTW ticks) */
+static int32_t toaerr(struct CANRCVBUF* pcan, uint64_t b, uint32_t len, uint32_t late)
+{
+	uint32_t sof = dtw0 + (uint32_t)(b * TPB);
+	uint32_t now = sof + (len * TPB) + late;
+	return (int32_t)(ttcm_toa(&ctl, (uint32_t)b & 0xffff, pcan, now) - sof);
+}
+static void ctlreset(void)
+{
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.ttcmtpb = TPB;
+}
+static void test_toa(void)
+{
+	struct CANRCVBUF can;
+	uint64_t b;
+	int i, bad;
+
+	memset(&can, 0, sizeof(can));
+	can.id = STD(0x123); can.dlc = 8; // Shortest: 44 + 64 bits
+
+	/* Shortest frame: first msg, no latency assumed */
+	ctlreset();
+	CHECK(toaerr(&can, 100, 108, 0) == 0);
+	ctlreset(); can.dlc = 0;
+	CHECK(toaerr(&can, 100, 44, 0) == 0);
+	ctlreset(); can.id = EXT(0x1234567); can.dlc = 8;
+	CHECK(toaerr(&can, 100, 128, 0) == 0);
+	ctlreset(); can.id = STD(0x123) | RTR;   // No data field, whatever the dlc
+	CHECK(toaerr(&can, 100, 44, 0) == 0);
+	ctlreset(); can.id = STD(0x123); can.dlc = 9;
+	CHECK(toaerr(&can, 100, 108, 0) == 0);
+	CHECK(ctl.ttcmsync == 1);
+	can.dlc = 8;
+
+	/* First msg: 5 stuff bits and read 300 ticks late; the anchor is that late */
+	ctlreset();
+	dtw0 = 1000000;
+	CHECK(toaerr(&can, 100, 113, 300) == (5 * TPB + 300));
+	CHECK(ctl.ttcmsync == 1);
+	/* Next: in 'now' - 'toa' 300 ticks under the shortest frame; anchor moves back */
+	CHECK(toaerr(&can, 1000, 113, 0) == (5 * TPB));
+	CHECK(toaerr(&can, 2000, 115, 40) == (5 * TPB)); // Slower: no change
+	/* No stuff bits, no latency: exact from here on */
+	CHECK(toaerr(&can, 3000, 108, 0) == 0);
+	CHECK(toaerr(&can, 4000, 120, 500) == 0);
+	CHECK(ctl.ttcmsync == 1);
+
+	/* Timer wraps: 7001 bits apart for 4 wraps, random stuff bits & latency */
+	bad = 0;
+	for (b = 5000; b < (5 * 65536); b += 7001)
+		if (toaerr(&can, b, 108 + (rnd() % 20), rnd() % 20000) != 0) bad += 1;
+	CHECK(bad == 0);
+	/* SOF 10 bits before a wrap, read after it */
+	CHECK(toaerr(&can, (6 * 65536) - 10, 108, 1000) == 0);
+	/* Gaps of many wraps (seconds) */
+	b = 7 * 65536;
+	for (i = 0; i < 50; i++)
+	{
+		b += rnd() % (40 * 65536);
+		if (toaerr(&can, b, 108 + (rnd() % 20), rnd() % 20000) != 0) bad += 1;
+	}
+	CHECK(bad == 0);
+	/* DTW wrap: 2^32 is not a multiple of the timer wrap */
+	b = (((((dtw0 + (b * TPB)) >> 32) + 1) << 32) - dtw0) / TPB - 200; // The next one
+	for (i = 0; i < 400; i += 7)
+		if (toaerr(&can, b + i, 108, rnd() % 100) != 0) bad += 1;
+	b += 10 * 65536;
+	CHECK(toaerr(&can, b, 108, 0) == 0);
+	CHECK(bad == 0);
+	CHECK(ctl.ttcmsync == 1);
+
+	/* Read late: under 1/2 timer wrap exact; over, start over ('now' - shortest) */
+	CHECK(toaerr(&can, b + 1000, 108, (SPAN / 2) - 1000) == 0);
+	CHECK(ctl.ttcmsync == 1);
+	CHECK(toaerr(&can, b + 2000, 108, (SPAN / 2) + 1000) == ((SPAN / 2) + 1000));
+	CHECK(ctl.ttcmsync == 2);
+	CHECK(toaerr(&can, b + 3000, 108, 0) == 0); // Anchor back in step
+}
+/* *************************************************************************
+ * On the bus model
+ * *************************************************************************/
+/* Random msg, 'i' in id bits 2:1; 'nostuff': one whose frame has no stuff bits */
+static void rndmsg(struct CANRCVBUF* pcan, uint32_t i, int nostuff)
+{
+	do
+	{
+		pcan->id = STD(((rnd() >> 21) & ~0x6) | (i << 1));
+		pcan->dlc = 1 + (rnd() >> 29);
+		pcan->cd.ui[0] = rnd();
+		pcan->cd.ui[1] = rnd();
+	} while ((nostuff != 0) && (bxcan_model_framebits(pcan->id, pcan->dlc, pcan->cd.ui[0], pcan->cd.ui[1]) !=
+	          (44 + (pcan->dlc * 8u) + 3)));
+}
+static void test_bus(void)
+{
+	struct CANRCVBUF can;
+	struct CANTXDONE done[4];
+	struct CANRCVBUFN* pn;
+	struct BXLOG* pl;
+	uint32_t tpb, sof, log0;
+	int32_t err, errmin = 0x7fffffff, errmax = -0x7fffffff;
+	int r, i, k, bad = 0, rxct = 0;
+
+	hostdtw = 0xfff00000; // Crosses the DTW wrap early on
+	bus(HOSTCANBTR500K);
+	tpb = bxcan_model_tpb();
+	memset(done, 0, sizeof(done));
+	for (r = 0; r < 300; r++)
+	{
+		k = 1 + (rnd() % 3);
+		bxnode[1].rxdelay = (r == 0) ? 0 : (rnd() % (200 * tpb));
+		log0 = bxlogct;
+		for (i = 0; i < k; i++)
+		{
+			rndmsg(&can, i, (r == 0)); // First: no stuff bits, so the anchor starts exact
+			CHECK(can_driver_put_done(pctl[0], &can, 0, 0, &done[i]) == CANPUT_OK);
+		}
+		bxcan_model_run(100);
+		if (bxlogct != (log0 + k)) {bad += 1; break;}
+		for (i = 0; i < k; i++)
+		{
+			pl = &bxlog[(log0 + i) % BXLOGSZ];
+			sof = pl->dtw - (bxcan_model_framebits(pl->tir, pl->tdtr, pl->tdlr, pl->tdhr) * tpb);
+			pn = can_iface_get_CANmsg(ptake);
+			if ((pn == NULL) || (pn->can.id != pl->tir)) {bad += 1; continue;}
+			rxct += 1;
+			err = (int32_t)(pn->toa - sof);
+			if (err < errmin) errmin = err;
+			if (err > errmax) errmax = err;
+			err = (int32_t)(done[(pl->tir >> 22) & 0x3].toa - sof); // Bus order is by id
+			if (err < errmin) errmin = err;
+			if (err > errmax) errmax = err;
+		}
+		bxcan_model_idle(rnd() % (3 * (tpb << 16))); // Up to three timer wraps
+	}
+	CHECK(bad == 0);
+	CHECK(rxct > 500);
+	CHECK((pctl[0]->ttcmsync == 1) && (pctl[1]->ttcmsync == 1));
+	/* The model's ISRs run after the 3 bit intermission, which the anchor takes
+	   as latency; less the part bit the timer had counted at the SOF */
+	CHECK((errmin > (int32_t)(2 * tpb)) && (errmax <= (int32_t)(3 * tpb)));
+}
+
+int main(void)
+{
+	alarm(HOSTTIMEOUT);
+	test_tpb();
+	test_toa();
+	test_bus();
+	return hostreport("test_ttcm");
+}